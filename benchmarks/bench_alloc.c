@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "bench_common.h"
+#include "compilation.h"
+#include "lexer.h"
+
+// Allocation benchmark: heap-allocated token stream and error list versus an
+// arena-backed compilation context. Linked with --wrap so every malloc, calloc,
+// realloc and free made by the front end is counted and timed.
+// Usage: bench_alloc <file> [iterations]
+
+extern void *__real_malloc(size_t size);
+extern void *__real_calloc(size_t count, size_t size);
+extern void *__real_realloc(void *pointer, size_t size);
+extern void __real_free(void *pointer);
+
+static long allocation_calls, free_calls;
+static double allocator_seconds;
+
+#define TIMED_CALL(result, call)                        \
+    do                                                  \
+    {                                                   \
+        double started = bench_now_seconds();           \
+        result = call;                                  \
+        allocator_seconds += bench_now_seconds() - started; \
+    } while (0)
+
+void *__wrap_malloc(size_t size)
+{
+    void *pointer;
+    allocation_calls++;
+    TIMED_CALL(pointer, __real_malloc(size));
+    return pointer;
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    void *pointer;
+    allocation_calls++;
+    TIMED_CALL(pointer, __real_calloc(count, size));
+    return pointer;
+}
+
+void *__wrap_realloc(void *pointer, size_t size)
+{
+    void *new_pointer;
+    allocation_calls++;
+    TIMED_CALL(new_pointer, __real_realloc(pointer, size));
+    return new_pointer;
+}
+
+void __wrap_free(void *pointer)
+{
+    double started = bench_now_seconds();
+    free_calls++;
+    __real_free(pointer);
+    allocator_seconds += bench_now_seconds() - started;
+}
+
+static void reset_counters()
+{
+    allocation_calls = free_calls = 0;
+    allocator_seconds = 0;
+}
+
+static void print_counters(const char *mode, int iterations, double elapsed)
+{
+    printf("%s: %ld allocations, %ld frees, %.2f ms in the allocator, %.2f ms total (per iteration)\n",
+           mode, allocation_calls / iterations, free_calls / iterations,
+           allocator_seconds * 1e3 / iterations, elapsed * 1e3 / iterations);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <file> [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    const char *path = argv[1];
+    int iterations = argc > 2 ? atoi(argv[2]) : 5;
+    int tokens = 0, errors = 0;
+
+    reset_counters();
+    double start = bench_now_seconds();
+    for (int i = 0; i < iterations; i++)
+    {
+        ErrorList *error_list = create_new_error_list(NULL);
+        TokenStream *token_stream = get_token_stream_from_path(path, error_list);
+        tokens = token_stream ? token_stream->size : 0;
+        errors = error_list->size;
+        free_token_stream(token_stream);
+        free_error_list(error_list);
+    }
+    print_counters("heap", iterations, bench_now_seconds() - start);
+
+    reset_counters();
+    start = bench_now_seconds();
+    for (int i = 0; i < iterations; i++)
+    {
+        CompilationContext *context = create_new_compilation_context();
+        if (load_source_file(context, path))
+        {
+            run_lexer(context);
+        }
+        free_compilation_context(context);
+    }
+    print_counters("arena", iterations, bench_now_seconds() - start);
+
+    printf("tokens=%d errors=%d iterations=%d\n", tokens, errors, iterations);
+    return 0;
+}
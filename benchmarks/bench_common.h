@@ -0,0 +1,51 @@
+#ifndef BENCH_COMMON_H
+#define BENCH_COMMON_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/resource.h>
+
+// Monotonic wall clock in seconds
+static inline double bench_now_seconds(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+// Peak resident set size of this process in kilobytes
+static inline long bench_peak_rss_kb(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// Read a whole file into a NUL-terminated heap buffer
+static inline char *bench_read_file(const char *path, size_t *length)
+{
+    FILE *file = fopen(path, "rb");
+    if (!file)
+    {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char *buffer = malloc(size + 1);
+    if (!buffer)
+    {
+        fclose(file);
+        return NULL;
+    }
+
+    *length = fread(buffer, 1, size, file);
+    buffer[*length] = '\0';
+    fclose(file);
+    return buffer;
+}
+
+#endif
@@ -0,0 +1,65 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench_common.h"
+#include "compilation.h"
+
+// Front-end benchmark for the regression harness: lexes and parses one file in a
+// fresh compilation context per iteration and prints one line of key=value pairs,
+// the best iteration of each phase, so benchmarks/run_bench.sh can compare runs.
+// Programs with errors are timed like any other, the error count is printed.
+// Usage: bench_frontend <file> [iterations]
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <file> [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    int iterations = argc > 2 ? atoi(argv[2]) : 5;
+    double best_lex = 0, best_parse = 0;
+    size_t bytes = 0;
+    int tokens = 0, errors = 0;
+    uint32_t nodes = 0;
+
+    for (int i = 0; i < iterations; i++)
+    {
+        CompilationContext *context = create_new_compilation_context();
+        if (!context || !load_source_file(context, argv[1]))
+        {
+            report_errors(context ? context->error_list : NULL);
+            return 1;
+        }
+
+        double start = bench_now_seconds();
+        int lexed = run_lexer(context);
+        double lexed_at = bench_now_seconds();
+        int parsed = lexed && run_parser(context);
+        double parsed_at = bench_now_seconds();
+
+        if (!parsed)
+        {
+            report_errors(context->error_list);
+            return 1;
+        }
+
+        if (i == 0 || lexed_at - start < best_lex)
+        {
+            best_lex = lexed_at - start;
+        }
+        if (i == 0 || parsed_at - lexed_at < best_parse)
+        {
+            best_parse = parsed_at - lexed_at;
+        }
+        bytes = context->source->length;
+        tokens = context->token_stream->size;
+        nodes = context->ast->node_count;
+        errors = context->error_list->size;
+
+        free_compilation_context(context);
+    }
+
+    printf("bytes=%zu tokens=%d nodes=%u errors=%d lex_mb_s=%.1f parse_nodes_s=%.0f peak_rss_kb=%ld\n", bytes,
+           tokens, nodes, errors, bytes / 1048576.0 / best_lex, nodes / best_parse, bench_peak_rss_kb());
+    return 0;
+}
@@ -0,0 +1,173 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_common.h"
+#include "incremental.h"
+
+// Incremental recompilation benchmark: time to bring a document up to date after a
+// keystroke in a number and after inserting statements into a function body, for
+// several edit sizes, against lexing and parsing the whole source again. Each edit
+// is undone right after, so the source size holds.
+// Usage: bench_incremental <file> [edits_per_size]
+
+// Statement repeated to make up the inserted text
+static const char edit_statement[] = "    x = x + 1;\n";
+
+// Offset just after a newline that starts an indented line, at or after from
+static size_t find_body_line(const char *source, size_t length, size_t from)
+{
+    for (size_t i = from; i + 4 < length; i++)
+    {
+        if (source[i] == '\n' && memcmp(source + i + 1, "    ", 4) == 0)
+        {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+// Offset of the first digit at or after from, 0 if there is none
+static size_t find_digit(const char *source, size_t length, size_t from)
+{
+    for (size_t i = from; i < length; i++)
+    {
+        if (source[i] >= '0' && source[i] <= '9')
+        {
+            return i;
+        }
+    }
+    return 0;
+}
+
+// Replace removed bytes at start with inserted_length bytes of inserted in a new buffer
+static char *apply_edit(const char *source, size_t length, SourceEdit edit, const char *inserted, size_t *new_length)
+{
+    *new_length = length - edit.removed_length + edit.inserted_length;
+    char *edited = malloc(*new_length + 1);
+    if (!edited)
+    {
+        return NULL;
+    }
+
+    memcpy(edited, source, edit.start);
+    memcpy(edited + edit.start, inserted, edit.inserted_length);
+    memcpy(edited + edit.start + edit.inserted_length, source + edit.start + edit.removed_length,
+           length - edit.start - edit.removed_length);
+    edited[*new_length] = '\0';
+    return edited;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <file> [edits_per_size]\n", argv[0]);
+        return 1;
+    }
+
+    int edits = argc > 2 ? atoi(argv[2]) : 200;
+    size_t length;
+    char *source = bench_read_file(argv[1], &length);
+    if (!source)
+    {
+        fprintf(stderr, "Cannot read %s\n", argv[1]);
+        return 1;
+    }
+
+    double full_time = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        double start = bench_now_seconds();
+        IncrementalDocument *document = create_incremental_document(source, length);
+        full_time += bench_now_seconds() - start;
+        free_incremental_document(document);
+    }
+    full_time /= 3;
+
+    IncrementalDocument *document = create_incremental_document(source, length);
+    if (!document || !document->ast)
+    {
+        fprintf(stderr, "%s does not lex and parse\n", argv[1]);
+        return 1;
+    }
+
+    printf("source: %zu bytes, %d tokens, %u nodes\n", length, document->token_stream->size, document->ast->node_count);
+    printf("full lex and parse: %.3f ms\n", full_time * 1e3);
+
+    // A keystroke inside a number literal changes no token or node counts, only positions
+    double keystroke_time = 0;
+    unsigned int seed = 1;
+    for (int i = 0; i < edits; i++)
+    {
+        seed = seed * 1103515245u + 12345u;
+        size_t position = find_digit(source, length, (seed >> 8) % length);
+
+        SourceEdit insert = {position, 0, 1};
+        SourceEdit undo = {position, 1, 0};
+        size_t edited_length, restored_length;
+        char *edited = apply_edit(source, length, insert, "7", &edited_length);
+        char *restored = apply_edit(edited, edited_length, undo, NULL, &restored_length);
+
+        double start = bench_now_seconds();
+        update_incremental_document(document, edited, edited_length, insert);
+        update_incremental_document(document, restored, restored_length, undo);
+        keystroke_time += bench_now_seconds() - start;
+
+        free(source);
+        free(edited);
+        source = restored;
+    }
+    double per_keystroke = keystroke_time / (2.0 * edits);
+    printf("digit keystroke:        %9.1f us/edit, %7.1fx faster than a full lex and parse\n",
+            per_keystroke * 1e6, full_time / per_keystroke);
+
+    size_t statement_length = sizeof(edit_statement) - 1;
+    static const int statement_counts[] = {1, 16, 256, 4096};
+
+    for (size_t s = 0; s < sizeof(statement_counts) / sizeof(statement_counts[0]); s++)
+    {
+        size_t inserted_length = statement_counts[s] * statement_length;
+        char *inserted = malloc(inserted_length);
+        for (int i = 0; i < statement_counts[s]; i++)
+        {
+            memcpy(inserted + i * statement_length, edit_statement, statement_length);
+        }
+
+        double edit_time = 0;
+        for (int i = 0; i < edits; i++)
+        {
+            seed = seed * 1103515245u + 12345u;
+            size_t position = find_body_line(source, length, (seed >> 8) % length);
+
+            // Insert the statements, then take them out again
+            SourceEdit insert = {position, 0, inserted_length};
+            SourceEdit undo = {position, inserted_length, 0};
+            size_t edited_length, restored_length;
+            char *edited = apply_edit(source, length, insert, inserted, &edited_length);
+            char *restored = apply_edit(edited, edited_length, undo, NULL, &restored_length);
+
+            double start = bench_now_seconds();
+            update_incremental_document(document, edited, edited_length, insert);
+            edit_time += bench_now_seconds() - start;
+
+            start = bench_now_seconds();
+            update_incremental_document(document, restored, restored_length, undo);
+            edit_time += bench_now_seconds() - start;
+
+            free(source);
+            free(edited);
+            source = restored;
+        }
+
+        double per_edit = edit_time / (2.0 * edits);
+        printf("edit of %6zu bytes: %9.1f us/edit, %7.1fx faster than a full lex and parse\n",
+                inserted_length, per_edit * 1e6, full_time / per_edit);
+        free(inserted);
+    }
+
+    printf("peak RSS: %ld KB\n", bench_peak_rss_kb());
+
+    free_incremental_document(document);
+    free(source);
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "bench_common.h"
+#include "lexer.h"
+#include "token.h"
+#include "errors.h"
+#include "lexer_simd.h"
+
+// Lexer throughput benchmark.
+// Usage: bench_lexer <read|mmap|stream> <file> [iterations]
+//   read: read the file into a heap buffer and lex it with get_token_stream_from_input_file
+//   mmap: lex the file in place with get_token_stream_from_path
+//   stream: pull tokens one at a time with lexer_next_token over a chunked fd reader
+// Run each mode in its own process so the peak RSS figures do not mix.
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s <read|mmap|stream> <file> [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    const char *mode = argv[1];
+    const char *path = argv[2];
+    int iterations = argc > 3 ? atoi(argv[3]) : 5;
+    int use_mmap = strcmp(mode, "mmap") == 0;
+    int use_stream = strcmp(mode, "stream") == 0;
+
+    if (!use_mmap && !use_stream && strcmp(mode, "read") != 0)
+    {
+        fprintf(stderr, "Unknown mode '%s'\n", mode);
+        return 1;
+    }
+
+    size_t bytes = 0, identifier_bytes = 0, name_bytes = 0;
+    int tokens = 0;
+    uint32_t symbols = 0;
+    double start = bench_now_seconds();
+
+    for (int i = 0; i < iterations; i++)
+    {
+        ErrorList *error_list = create_new_error_list(NULL);
+        TokenStream *token_stream;
+
+        if (use_stream)
+        {
+            int fd = open(path, O_RDONLY);
+            Lexer *lexer = create_lexer_from_fd(fd, 0, error_list);
+            Token token;
+
+            tokens = 0;
+            while (lexer_next_token(lexer, &token))
+            {
+                tokens++;
+            }
+            bytes = token.offset;
+            free_lexer(lexer);
+            close(fd);
+            free_error_list(error_list);
+            continue;
+        }
+
+        if (use_mmap)
+        {
+            token_stream = get_token_stream_from_path(path, error_list);
+        }
+        else
+        {
+            char *input = bench_read_file(path, &bytes);
+            if (!input)
+            {
+                fprintf(stderr, "Failed to read '%s'\n", path);
+                return 1;
+            }
+            token_stream = get_token_stream_from_input_file(input, error_list);
+            tokens = token_stream ? token_stream->size : 0;
+            free_token_stream(token_stream);
+            free(input);
+            free_error_list(error_list);
+            continue;
+        }
+
+        if (!token_stream)
+        {
+            report_errors(error_list);
+            return 1;
+        }
+
+        bytes = token_stream->mapped_source->length;
+        tokens = token_stream->size;
+
+        // What copying every identifier would cost against storing each distinct name once
+        identifier_bytes = name_bytes = 0;
+        for (int t = 0; t < token_stream->size; t++)
+        {
+            if (token_stream->types[t] == TOKEN_IDENTIFIER)
+            {
+                identifier_bytes += token_stream->lengths[t] + 1;
+            }
+        }
+        symbols = token_stream->symbol_table->symbol_count;
+        for (uint32_t symbol = 0; symbol < symbols; symbol++)
+        {
+            name_bytes += token_stream->symbol_table->name_lengths[symbol];
+        }
+        free_token_stream(token_stream);
+        free_error_list(error_list);
+    }
+
+    double elapsed = bench_now_seconds() - start;
+    double megabytes = (double)bytes * iterations / (1024.0 * 1024.0);
+
+    printf("mode=%s simd=%s bytes=%zu tokens=%d iterations=%d\n", mode, lexer_simd_implementation(), bytes, tokens, iterations);
+    printf("throughput: %.1f MB/s\n", megabytes / elapsed);
+    if (use_mmap)
+    {
+        printf("symbols: %u distinct names in %zu bytes (%zu bytes as per-token copies)\n", symbols, name_bytes, identifier_bytes);
+    }
+    printf("peak RSS: %ld KB\n", bench_peak_rss_kb());
+
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench_common.h"
+#include "lexer.h"
+#include "source.h"
+#include "thread_pool.h"
+
+// Scaling of the parallel lexer: lexes one file with lex_into_token_stream_parallel
+// on 1, 2, 4, ... threads up to max_threads, into a fresh arena-owned stream each
+// iteration as run_lexer does, and prints the best throughput of each thread count
+// with its speedup over one thread. The tokens must match at every thread count.
+// Usage: bench_lexer_scaling <file> [max_threads] [iterations]
+static double time_lexing(SourceBuffer *source, int threads, int *tokens, uint32_t *symbols)
+{
+    Arena *arena = create_arena(DEFAULT_ARENA_BLOCK_SIZE);
+    ErrorList *errors = create_new_error_list(arena);
+    TokenStream *token_stream = create_new_token_stream(arena);
+    if (!arena || !errors || !token_stream)
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    reserve_token_stream(token_stream, source->length / 6 + DEFAULT_TOKEN_STREAM_CAPACITY);
+
+    double start = bench_now_seconds();
+    int lexed = lex_into_token_stream_parallel(token_stream, source->data, source->length, errors, threads);
+    double elapsed = bench_now_seconds() - start;
+
+    if (!lexed)
+    {
+        report_errors(errors);
+        exit(1);
+    }
+    *tokens = token_stream->size;
+    *symbols = token_stream->symbol_table->symbol_count;
+    free_arena(arena);
+    return elapsed;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <file> [max_threads] [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    int max_threads = argc > 2 ? atoi(argv[2]) : get_processor_count();
+    int iterations = argc > 3 ? atoi(argv[3]) : 5;
+    SourceBuffer *source = open_source_file(argv[1], NULL);
+    if (!source)
+    {
+        fprintf(stderr, "Cannot open %s\n", argv[1]);
+        return 1;
+    }
+
+    double single_thread = 0;
+    int expected_tokens = -1;
+    uint32_t expected_symbols = 0;
+    printf("%8s %10s %10s %8s\n", "threads", "ms", "MB/s", "speedup");
+    // Doubling, with max_threads itself last even if it is not a power of two
+    for (int threads = 1;; threads = threads * 2 < max_threads ? threads * 2 : max_threads)
+    {
+        double best = 0;
+        for (int i = 0; i < iterations; i++)
+        {
+            int tokens;
+            uint32_t symbols;
+            double elapsed = time_lexing(source, threads, &tokens, &symbols);
+            if (expected_tokens < 0)
+            {
+                expected_tokens = tokens;
+                expected_symbols = symbols;
+            }
+            else if (tokens != expected_tokens || symbols != expected_symbols)
+            {
+                fprintf(stderr, "%d threads gave %d tokens and %u symbols, expected %d and %u\n", threads, tokens,
+                        symbols, expected_tokens, expected_symbols);
+                return 1;
+            }
+            if (i == 0 || elapsed < best)
+            {
+                best = elapsed;
+            }
+        }
+        if (threads == 1)
+        {
+            single_thread = best;
+        }
+        printf("%8d %10.2f %10.1f %8.2f\n", threads, best * 1000, source->length / 1048576.0 / best,
+               single_thread / best);
+        if (threads >= max_threads)
+        {
+            break;
+        }
+    }
+
+    close_source_file(source);
+    return 0;
+}
@@ -0,0 +1,264 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_common.h"
+#include "compilation.h"
+#include "parser.h"
+
+// Parser benchmark: parse time, node count and AST bytes per source line, compared
+// with the tree the grammar gives when every production, tail and epsilon included,
+// becomes a pointer-linked node.
+// Usage: bench_parser <file> [iterations]
+
+typedef struct
+{
+    size_t nodes;
+    size_t bytes;
+} TreeSize;
+
+// One node of the pointer tree: type, children pointer and count, plus its children
+// array, each rounded up to the 16-byte arena alignment
+static void add_tree_node(TreeSize *size, int num_children)
+{
+    size->nodes++;
+    size->bytes += 32 + ((num_children * 8 + 15) & ~15);
+}
+
+static int operator_level(TokenType type)
+{
+    switch (type)
+    {
+    case TOKEN_AND:
+    case TOKEN_OR:
+        return 0;
+    case TOKEN_LT:
+    case TOKEN_GT:
+    case TOKEN_LTE:
+    case TOKEN_GTE:
+    case TOKEN_EQ:
+    case TOKEN_NEQ:
+        return 1;
+    case TOKEN_PLUS:
+    case TOKEN_MINUS:
+        return 2;
+    default:
+        return 3;
+    }
+}
+
+static void count_expression(AST *ast, uint32_t index, TreeSize *size);
+
+// unary_expression -> ! unary_expression | - unary_expression | term,
+// term -> identifier | NUMBER | ( expression ) | call | READ_PIN ( GPIO_PIN )
+static void count_term(AST *ast, uint32_t index, TreeSize *size)
+{
+    ASTNode *node = get_ast_node(ast, index);
+    add_tree_node(size, 1);
+
+    switch (node->type)
+    {
+    case BINARY_EXPRESSION:
+        count_expression(ast, index, size);
+        break;
+    case CALL_EXPRESSION:
+        add_tree_node(size, node->num_children);
+        for (uint32_t i = 0; i < node->num_children; i++)
+        {
+            count_expression(ast, get_ast_child(ast, index, i), size);
+        }
+        break;
+    case GPIO_OPERATION:
+        add_tree_node(size, 1);
+        add_tree_node(size, 0);
+        break;
+    case UNARY_EXPRESSION:
+        add_tree_node(size, 1);
+        count_term(ast, get_ast_child(ast, index, 0), size);
+        break;
+    default:
+        add_tree_node(size, 0);
+        break;
+    }
+}
+
+// level_expression -> next_level level_tail, level_tail -> op next_level level_tail | ε
+static void count_level(AST *ast, uint32_t index, int level, TreeSize *size)
+{
+    if (level == 4)
+    {
+        count_term(ast, index, size);
+        return;
+    }
+
+    uint32_t operand = index;
+    while (get_ast_node(ast, operand)->type == BINARY_EXPRESSION &&
+           operator_level(ast->token_stream->types[get_ast_node(ast, operand)->token]) == level)
+    {
+        add_tree_node(size, 2);
+        count_level(ast, get_ast_child(ast, operand, 1), level + 1, size);
+        operand = get_ast_child(ast, operand, 0);
+    }
+
+    add_tree_node(size, 2);
+    count_level(ast, operand, level + 1, size);
+    add_tree_node(size, 0);
+}
+
+static void count_expression(AST *ast, uint32_t index, TreeSize *size)
+{
+    add_tree_node(size, 1);
+    count_level(ast, index, 0, size);
+}
+
+static void count_statement_list(AST *ast, uint32_t index, TreeSize *size);
+
+static void count_statement(AST *ast, uint32_t index, TreeSize *size)
+{
+    ASTNode *node = get_ast_node(ast, index);
+    add_tree_node(size, 1);
+
+    switch (node->type)
+    {
+    case IDENTIFIER_DECLARATION:
+        add_tree_node(size, 2);
+        add_tree_node(size, 0);
+        add_tree_node(size, 0);
+        break;
+    case IDENTIFIER_DEFINITION:
+        add_tree_node(size, 3);
+        add_tree_node(size, 0);
+        add_tree_node(size, 0);
+        count_expression(ast, get_ast_child(ast, index, 0), size);
+        break;
+    case ASSIGNMENT:
+        add_tree_node(size, 2);
+        add_tree_node(size, 0);
+        count_expression(ast, get_ast_child(ast, index, 0), size);
+        break;
+    case CONDITIONAL:
+        add_tree_node(size, 3);
+        count_expression(ast, get_ast_child(ast, index, 0), size);
+        count_statement_list(ast, get_ast_child(ast, index, 1), size);
+        add_tree_node(size, node->num_children == 3);
+        if (node->num_children == 3)
+        {
+            count_statement_list(ast, get_ast_child(ast, index, 2), size);
+        }
+        break;
+    case WHILE_LOOP:
+        add_tree_node(size, 2);
+        count_expression(ast, get_ast_child(ast, index, 0), size);
+        count_statement_list(ast, get_ast_child(ast, index, 1), size);
+        break;
+    case RETURN_STATEMENT:
+        add_tree_node(size, 1);
+        count_expression(ast, get_ast_child(ast, index, 0), size);
+        break;
+    case GPIO_OPERATION:
+        add_tree_node(size, 2);
+        add_tree_node(size, 0);
+        add_tree_node(size, 0);
+        break;
+    default:
+        count_expression(ast, get_ast_child(ast, index, 0), size);
+        break;
+    }
+}
+
+// statementList -> statement statementList | ε
+static void count_statement_list(AST *ast, uint32_t index, TreeSize *size)
+{
+    ASTNode *node = get_ast_node(ast, index);
+    for (uint32_t i = 0; i < node->num_children; i++)
+    {
+        add_tree_node(size, 2);
+        count_statement(ast, get_ast_child(ast, index, i), size);
+    }
+    add_tree_node(size, 0);
+}
+
+static TreeSize count_grammar_tree(AST *ast)
+{
+    TreeSize size = {0, 0};
+    ASTNode *root = get_ast_node(ast, ast->root);
+
+    for (uint32_t f = 0; f < root->num_children; f++)
+    {
+        uint32_t function = get_ast_child(ast, ast->root, f);
+        uint32_t parameters = get_ast_child(ast, function, 0);
+
+        add_tree_node(&size, 2);
+        add_tree_node(&size, 4);
+        add_tree_node(&size, 0);
+        add_tree_node(&size, 0);
+        for (uint32_t p = 0; p < get_ast_node(ast, parameters)->num_children; p++)
+        {
+            add_tree_node(&size, 3);
+            add_tree_node(&size, 0);
+            add_tree_node(&size, 0);
+        }
+        add_tree_node(&size, 0);
+        count_statement_list(ast, get_ast_child(ast, function, 1), &size);
+    }
+    add_tree_node(&size, 0);
+
+    return size;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <file> [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    int iterations = argc > 2 ? atoi(argv[2]) : 5;
+    double parse_time = 0;
+    uint32_t nodes = 0;
+    size_t flat_bytes = 0, lines = 0, tokens = 0;
+    TreeSize grammar_tree = {0, 0};
+
+    for (int i = 0; i < iterations; i++)
+    {
+        CompilationContext *context = create_new_compilation_context();
+        if (!context || !load_source_file(context, argv[1]) || !run_lexer(context))
+        {
+            report_errors(context ? context->error_list : NULL);
+            return 1;
+        }
+
+        double start = bench_now_seconds();
+        int parsed = run_parser(context);
+        parse_time += bench_now_seconds() - start;
+
+        if (!parsed || context->error_list->size > 0)
+        {
+            report_errors(context->error_list);
+            return 1;
+        }
+
+        AST *ast = context->ast;
+        nodes = ast->node_count;
+        flat_bytes = ast->node_count * sizeof(ASTNode) + ast->child_count * sizeof(uint32_t);
+        tokens = context->token_stream->size;
+        lines = context->token_stream->lines[tokens - 1];
+        if (i == 0)
+        {
+            grammar_tree = count_grammar_tree(ast);
+        }
+
+        free_compilation_context(context);
+    }
+
+    printf("lines=%zu tokens=%zu iterations=%d\n", lines, tokens, iterations);
+    printf("parse: %.2f ns/token, %.1f M nodes/s\n", parse_time * 1e9 / ((double)tokens * iterations),
+            (double)nodes * iterations / parse_time / 1e6);
+    printf("flat pool: %u nodes, %.2f nodes/line, %.1f bytes/line\n", nodes,
+            (double)nodes / lines, (double)flat_bytes / lines);
+    printf("grammar tree: %zu nodes, %.2f nodes/line, %.1f bytes/line\n", grammar_tree.nodes,
+            (double)grammar_tree.nodes / lines, (double)grammar_tree.bytes / lines);
+    printf("peak RSS: %ld KB\n", bench_peak_rss_kb());
+
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench_common.h"
+#include "lexer.h"
+#include "parser.h"
+#include "thread_pool.h"
+
+// Scaling of the parallel parser: lexes one file once, then parses it with
+// parse_token_stream_parallel on 1, 2, 4, ... threads up to max_threads and prints
+// the best throughput of each thread count with its speedup over one thread. The
+// AST must have the same size at every thread count.
+// Usage: bench_parser_scaling <file> [max_threads] [iterations]
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <file> [max_threads] [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    int max_threads = argc > 2 ? atoi(argv[2]) : get_processor_count();
+    int iterations = argc > 3 ? atoi(argv[3]) : 5;
+    ErrorList *lexer_errors = create_new_error_list(NULL);
+    TokenStream *token_stream = get_token_stream_from_path(argv[1], lexer_errors);
+    if (!token_stream)
+    {
+        report_errors(lexer_errors);
+        return 1;
+    }
+
+    double single_thread = 0;
+    uint32_t expected_nodes = 0;
+    printf("%8s %10s %14s %8s\n", "threads", "ms", "nodes/s", "speedup");
+
+    // Doubling, with max_threads itself last even if it is not a power of two
+    for (int threads = 1;; threads = threads * 2 < max_threads ? threads * 2 : max_threads)
+    {
+        double best = 0;
+        for (int i = 0; i < iterations; i++)
+        {
+            ErrorList *errors = create_new_error_list(NULL);
+            double start = bench_now_seconds();
+            AST *ast = parse_token_stream_parallel(token_stream, errors, threads);
+            double elapsed = bench_now_seconds() - start;
+
+            if (!ast)
+            {
+                report_errors(errors);
+                return 1;
+            }
+            if (expected_nodes == 0)
+            {
+                expected_nodes = ast->node_count;
+            }
+            else if (ast->node_count != expected_nodes)
+            {
+                fprintf(stderr, "%d threads gave %u nodes, expected %u\n", threads, ast->node_count, expected_nodes);
+                return 1;
+            }
+            if (i == 0 || elapsed < best)
+            {
+                best = elapsed;
+            }
+            free_ast(ast);
+            free_error_list(errors);
+        }
+        if (threads == 1)
+        {
+            single_thread = best;
+        }
+        printf("%8d %10.2f %14.0f %8.2f\n", threads, best * 1000, expected_nodes / best, single_thread / best);
+        if (threads >= max_threads)
+        {
+            break;
+        }
+    }
+
+    free_token_stream(token_stream);
+    free_error_list(lexer_errors);
+    return 0;
+}
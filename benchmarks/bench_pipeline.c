@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench_common.h"
+#include "compilation.h"
+
+// Times one file through the sequential front end, run_lexer then run_parser, and
+// through run_pipelined_front_end, which lexes on a second thread into a token
+// queue while the parser consumes it. Each iteration uses a fresh compilation
+// context, the best iteration of each is printed as key=value pairs.
+// Usage: bench_pipeline <file> [iterations]
+static double time_front_end(const char *path, int pipelined, int *tokens, uint32_t *nodes)
+{
+    CompilationContext *context = create_new_compilation_context();
+    if (!context || !load_source_file(context, path))
+    {
+        report_errors(context ? context->error_list : NULL);
+        exit(1);
+    }
+
+    double start = bench_now_seconds();
+    int parsed = pipelined ? run_pipelined_front_end(context) : run_lexer(context) && run_parser(context);
+    double elapsed = bench_now_seconds() - start;
+
+    if (!parsed)
+    {
+        report_errors(context->error_list);
+        exit(1);
+    }
+    *tokens = context->token_stream->size;
+    *nodes = context->ast->node_count;
+    free_compilation_context(context);
+    return elapsed;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <file> [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    int iterations = argc > 2 ? atoi(argv[2]) : 5;
+    double best_sequential = 0, best_pipelined = 0;
+    int tokens = 0, pipelined_tokens = 0;
+    uint32_t nodes = 0, pipelined_nodes = 0;
+
+    for (int i = 0; i < iterations; i++)
+    {
+        double sequential = time_front_end(argv[1], 0, &tokens, &nodes);
+        double pipelined = time_front_end(argv[1], 1, &pipelined_tokens, &pipelined_nodes);
+        if (i == 0 || sequential < best_sequential)
+        {
+            best_sequential = sequential;
+        }
+        if (i == 0 || pipelined < best_pipelined)
+        {
+            best_pipelined = pipelined;
+        }
+    }
+
+    if (tokens != pipelined_tokens || nodes != pipelined_nodes)
+    {
+        fprintf(stderr, "Pipelined front end disagrees: %d tokens %u nodes, sequential %d tokens %u nodes\n",
+                pipelined_tokens, pipelined_nodes, tokens, nodes);
+        return 1;
+    }
+
+    printf("tokens=%d nodes=%u sequential_ms=%.2f pipelined_ms=%.2f speedup=%.2f\n", tokens, nodes,
+           best_sequential * 1000, best_pipelined * 1000, best_sequential / best_pipelined);
+    return 0;
+}
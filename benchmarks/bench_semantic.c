@@ -0,0 +1,58 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench_common.h"
+#include "compilation.h"
+#include "semantic.h"
+
+// Semantic check benchmark: lexes and parses one file once, then resolves and
+// type-checks its AST repeatedly and prints the best iteration as key=value pairs.
+// The check only reads the AST, so every iteration sees the same input. The file
+// must be free of errors, one that is not is reported and fails the run.
+// Usage: bench_semantic <file> [iterations]
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <file> [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    int iterations = argc > 2 ? atoi(argv[2]) : 5;
+    CompilationContext *context = create_new_compilation_context();
+    if (!context || !load_source_file(context, argv[1]) || !run_lexer(context) || !run_parser(context) ||
+        context->error_list->size > 0)
+    {
+        report_errors(context ? context->error_list : NULL);
+        return 1;
+    }
+
+    TokenStream *token_stream = context->token_stream;
+    int identifiers = 0;
+    for (int i = 0; i < token_stream->size; i++)
+    {
+        identifiers += token_stream->types[i] == TOKEN_IDENTIFIER;
+    }
+
+    double best = 0;
+    for (int i = 0; i < iterations; i++)
+    {
+        double start = bench_now_seconds();
+        int checked = check_semantics(context->ast, context->error_list);
+        double elapsed = bench_now_seconds() - start;
+        if (!checked)
+        {
+            report_errors(context->error_list);
+            return 1;
+        }
+        if (i == 0 || elapsed < best)
+        {
+            best = elapsed;
+        }
+    }
+
+    printf("identifiers=%d symbols=%u nodes=%u check_ms=%.2f identifiers_s=%.0f peak_rss_kb=%ld\n", identifiers,
+           token_stream->symbol_table->symbol_count, context->ast->node_count, best * 1000, identifiers / best,
+           bench_peak_rss_kb());
+    free_compilation_context(context);
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "bench_common.h"
+#include "compilation.h"
+#include "serialize.h"
+
+// Serialized file benchmark: how long a tool waits for tokens and an AST when it
+// maps a file written earlier, against lexing and parsing the source again.
+// Times are with the file in the page cache, as after a build that just wrote it.
+// Usage: bench_serialize <file> [iterations]
+
+// Touch every token record, as a tool scanning the stream would
+static uint64_t walk_tokens(SerializedFile *file)
+{
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < file->header->token_count; i++)
+    {
+        sum += file->tokens[i].type + file->tokens[i].line;
+    }
+    return sum;
+}
+
+// Touch every node and child index
+static uint64_t walk_nodes(SerializedFile *file)
+{
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < file->header->node_count; i++)
+    {
+        sum += file->nodes[i].type + file->nodes[i].token;
+    }
+    for (uint32_t i = 0; i < file->header->child_count; i++)
+    {
+        sum += file->children[i];
+    }
+    return sum;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <file> [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    int iterations = argc > 2 ? atoi(argv[2]) : 5;
+    char binary_path[] = "/tmp/bench_serialize_XXXXXX";
+    int fd = mkstemp(binary_path);
+    if (fd < 0)
+    {
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+
+    double lex_time = 0, parse_time = 0, write_time = 0, open_time = 0, walk_time = 0, verify_time = 0;
+    size_t tokens = 0, file_size = 0;
+    uint64_t checksum = 0;
+
+    for (int i = 0; i < iterations; i++)
+    {
+        CompilationContext *context = create_new_compilation_context();
+        if (!context || !load_source_file(context, argv[1]))
+        {
+            report_errors(context ? context->error_list : NULL);
+            return 1;
+        }
+
+        double start = bench_now_seconds();
+        int lexed = run_lexer(context);
+        double lexed_at = bench_now_seconds();
+        int parsed = lexed && run_parser(context);
+        double parsed_at = bench_now_seconds();
+        int written = parsed && write_serialized_file(binary_path, context->token_stream, context->ast, context->error_list);
+        double written_at = bench_now_seconds();
+
+        if (!written)
+        {
+            report_errors(context->error_list);
+            unlink(binary_path);
+            return 1;
+        }
+        lex_time += lexed_at - start;
+        parse_time += parsed_at - lexed_at;
+        write_time += written_at - parsed_at;
+        tokens = context->token_stream->size;
+        free_compilation_context(context);
+
+        start = bench_now_seconds();
+        SerializedFile *file = open_serialized_file(binary_path, NULL);
+        double opened_at = bench_now_seconds();
+        if (!file)
+        {
+            fprintf(stderr, "Failed to open %s\n", binary_path);
+            unlink(binary_path);
+            return 1;
+        }
+        checksum += walk_tokens(file) + walk_nodes(file);
+        double walked_at = bench_now_seconds();
+        verify_serialized_file(file, NULL);
+        double verified_at = bench_now_seconds();
+
+        open_time += opened_at - start;
+        walk_time += walked_at - opened_at;
+        verify_time += verified_at - walked_at;
+        file_size = file->size;
+        close_serialized_file(file);
+    }
+
+    unlink(binary_path);
+
+    printf("tokens=%zu file=%.1f MB iterations=%d (checksum %llu)\n", tokens, file_size / 1048576.0, iterations,
+            (unsigned long long)checksum);
+    printf("lex:               %8.3f ms\n", lex_time * 1e3 / iterations);
+    printf("lex + parse:       %8.3f ms\n", (lex_time + parse_time) * 1e3 / iterations);
+    printf("write:             %8.3f ms\n", write_time * 1e3 / iterations);
+    printf("open:              %8.3f ms\n", open_time * 1e3 / iterations);
+    printf("open + walk:       %8.3f ms (%.1fx faster than lex + parse)\n", (open_time + walk_time) * 1e3 / iterations,
+            (lex_time + parse_time) / (open_time + walk_time));
+    printf("verify:            %8.3f ms\n", verify_time * 1e3 / iterations);
+
+    return 0;
+}
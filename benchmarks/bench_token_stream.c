@@ -0,0 +1,55 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "bench_common.h"
+#include "token.h"
+
+// Token stream layout benchmark: append, lookahead-scan and free cost per token.
+// Usage: bench_token_stream [tokens] [iterations]
+int main(int argc, char **argv)
+{
+    int count = argc > 1 ? atoi(argv[1]) : 10000000;
+    int iterations = argc > 2 ? atoi(argv[2]) : 5;
+    double build_time = 0, scan_time = 0, free_time = 0;
+    long checksum = 0;
+    size_t bytes_per_token = 0;
+
+    for (int i = 0; i < iterations; i++)
+    {
+        double start = bench_now_seconds();
+        TokenStream *token_stream = create_new_token_stream(NULL);
+        for (int t = 0; t < count; t++)
+        {
+            add_new_token(token_stream, (TokenType)(t % TOKEN_EOF), t * 4, 3, t / 16 + 1, t % 16 * 4 + 1, NO_SYMBOL);
+        }
+        double built = bench_now_seconds();
+
+        // The parser's access pattern: walk the types, touching positions only occasionally
+        for (int t = 0; t < token_stream->size; t++)
+        {
+            checksum += token_stream->types[t];
+            if (token_stream->types[t] == TOKEN_SEMICOLON)
+            {
+                checksum += token_stream->lines[t];
+            }
+        }
+        double scanned = bench_now_seconds();
+
+        bytes_per_token = (size_t)token_stream->capacity * (4 * sizeof(int) + sizeof(uint32_t) + 1) / token_stream->size;
+        free_token_stream(token_stream);
+        double freed = bench_now_seconds();
+
+        build_time += built - start;
+        scan_time += scanned - built;
+        free_time += freed - scanned;
+    }
+
+    double total_tokens = (double)count * iterations;
+    printf("tokens=%d iterations=%d checksum=%ld\n", count, iterations, checksum);
+    printf("build: %.2f ns/token\n", build_time * 1e9 / total_tokens);
+    printf("scan: %.2f ns/token\n", scan_time * 1e9 / total_tokens);
+    printf("free: %.3f ms/stream\n", free_time * 1e3 / iterations);
+    printf("memory: %zu bytes/token (including growth slack)\n", bytes_per_token);
+    printf("peak RSS: %ld KB\n", bench_peak_rss_kb());
+
+    return 0;
+}
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bench_common.h"
+#include "lexer.h"
+#include "parser.h"
+#include "bytecode.h"
+#include "vm.h"
+#include "gpio.h"
+
+// VM microbenchmarks: instructions and loop iterations per second for a few
+// kernels, each a single main run from start to finish.
+// Usage: bench_vm [scale]
+
+typedef struct
+{
+    const char *name;
+    const char *source;  // %d is replaced by the iteration count
+    int iterations;
+} Kernel;
+
+static const Kernel kernels[] = {
+    {"count", "int main() { int i = 0; while (i < %d) { i = i + 1; } return i; }", 100000000},
+    {"arithmetic",
+     "int main() {\n"
+     "    int i = 0; int x = 1; int y = 7;\n"
+     "    while (i < %d) {\n"
+     "        x = (x * 31 + y) / 3 - i;\n"
+     "        y = y + x * 2 - (i - 5);\n"
+     "        i = i + 1;\n"
+     "    }\n"
+     "    return x + y;\n"
+     "}\n",
+     20000000},
+    {"calls",
+     "int add(int a, int b) { return a + b; }\n"
+     "int main() { int i = 0; int x = 0; while (i < %d) { x = add(x, i); i = i + 1; } return x; }\n",
+     20000000},
+    {"logic",
+     "int main() {\n"
+     "    int i = 0; int hits = 0;\n"
+     "    while (i < %d) {\n"
+     "        if (i > 100 && !(i == 500) || i < 10) { hits = hits + 1; }\n"
+     "        i = i + 1;\n"
+     "    }\n"
+     "    return hits;\n"
+     "}\n",
+     20000000},
+    // Blink pin 3 while polling pin 4, which the trace never raises
+    {"gpio_poll",
+     "int main() {\n"
+     "    int i = 0;\n"
+     "    while (i < %d && READ_PIN(4) == 0) {\n"
+     "        SET_PIN(3, HIGH);\n"
+     "        SET_PIN(3, LOW);\n"
+     "        i = i + 1;\n"
+     "    }\n"
+     "    return i;\n"
+     "}\n",
+     20000000},
+};
+
+int main(int argc, char **argv)
+{
+    double scale = argc > 1 ? atof(argv[1]) : 1.0;
+
+    printf("%-12s %12s %12s %10s %14s %14s\n", "kernel", "iterations", "cycles", "ms", "M instr/s", "M iter/s");
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++)
+    {
+        const Kernel *kernel = &kernels[k];
+        int iterations = (int)(kernel->iterations * scale);
+        char source[1024];
+        snprintf(source, sizeof(source), kernel->source, iterations);
+
+        ErrorList *error_list = create_new_error_list(NULL);
+        TokenStream *token_stream = get_token_stream_from_input_file(source, error_list);
+        AST *ast = token_stream ? parse_token_stream(token_stream, error_list) : NULL;
+        BytecodeProgram *program = ast && error_list->size == 0 ? compile_bytecode(ast, error_list) : NULL;
+        PinBank *bank = create_pin_bank();
+        VMResult result;
+
+        double start = bench_now_seconds();
+        int ran = program && bank && run_bytecode_program(program, bank, 0, &result, error_list);
+        double elapsed = bench_now_seconds() - start;
+
+        if (!ran)
+        {
+            printf("%s failed\n", kernel->name);
+            report_errors(error_list);
+        }
+        else
+        {
+            printf("%-12s %12d %12llu %10.1f %14.1f %14.1f\n", kernel->name, iterations,
+                    (unsigned long long)result.cycles, elapsed * 1e3, result.cycles / elapsed / 1e6,
+                    iterations / elapsed / 1e6);
+        }
+
+        free_pin_bank(bank);
+        free_bytecode_program(program);
+        free_ast(ast);
+        free_token_stream(token_stream);
+        free_error_list(error_list);
+    }
+
+    return 0;
+}
@@ -0,0 +1,494 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdarg.h>
+
+// Synthetic DSL program generator for the front-end benchmarks. The same seed
+// and options always give the same program. Without --errors every program is
+// valid and well typed: variables are declared before use and in scope, calls
+// go to earlier functions with the right argument types, and conditions are
+// bool. --errors breaks that many statements per thousand in ways the parser
+// has to recover from.
+// Usage: generate_program [--seed N] [--size BYTES[K|M|G]] [--depth N]
+//                         [--expression-length N] [--pins N] [--errors PER_MILLE]
+
+#define MAX_VARIABLES 256
+#define MAX_PARAMETERS 4
+
+typedef enum
+{
+    TYPE_INT,
+    TYPE_BOOL
+} ValueType;
+
+typedef struct
+{
+    uint8_t return_type;
+    uint8_t parameter_types[MAX_PARAMETERS];
+    int parameter_count;
+} Signature;
+
+typedef struct
+{
+    char name[32];
+    uint8_t type;
+} Variable;
+
+typedef struct
+{
+    uint64_t state;
+    uint64_t size;            // Stop after the function that reaches this many bytes
+    int depth;                // Deepest nesting of if and while blocks
+    int expression_length;    // Most operators in one expression
+    int pins;
+    int errors;               // Broken statements per thousand
+    uint64_t written;
+    Signature *functions;
+    int function_count;
+    int function_capacity;
+    Variable variables[MAX_VARIABLES];  // In scope, innermost last
+    int variable_count;
+    int next_variable;        // Keeps names unique within a function
+} Generator;
+
+static const char *const NAMES[] = {
+    "counter", "sensor", "threshold", "level", "duty", "ticks", "limit", "sample",
+    "delta", "offset", "state", "mode", "ready", "enabled", "error", "scale",
+};
+
+// splitmix64, fixed across platforms unlike rand()
+static uint64_t next_random(Generator *generator)
+{
+    uint64_t z = (generator->state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// Uniform in [0, bound)
+static int random_below(Generator *generator, int bound)
+{
+    return (int)(next_random(generator) % (uint64_t)bound);
+}
+
+static void emit(Generator *generator, const char *format, ...)
+{
+    va_list arguments;
+    va_start(arguments, format);
+    int length = vprintf(format, arguments);
+    va_end(arguments);
+    generator->written += length > 0 ? (uint64_t)length : 0;
+}
+
+static void emit_indent(Generator *generator, int level)
+{
+    emit(generator, "%*s", level * 4, "");
+}
+
+static const Variable *pick_variable(Generator *generator, ValueType type)
+{
+    if (generator->variable_count == 0)
+    {
+        return NULL;
+    }
+
+    int start = random_below(generator, generator->variable_count);
+    for (int i = 0; i < generator->variable_count; i++)
+    {
+        const Variable *variable = &generator->variables[(start + i) % generator->variable_count];
+        if (variable->type == type)
+        {
+            return variable;
+        }
+    }
+    return NULL;
+}
+
+static void emit_expression(Generator *generator, ValueType type, int budget);
+
+// A call to an earlier function returning type, 0 if there is none
+static int emit_call(Generator *generator, ValueType type, int budget)
+{
+    if (generator->function_count == 0)
+    {
+        return 0;
+    }
+
+    int start = random_below(generator, generator->function_count);
+    for (int i = 0; i < generator->function_count && i < 8; i++)
+    {
+        int index = (start + i) % generator->function_count;
+        const Signature *signature = &generator->functions[index];
+        if (signature->return_type != type)
+        {
+            continue;
+        }
+
+        emit(generator, "f%d(", index);
+        for (int p = 0; p < signature->parameter_count; p++)
+        {
+            emit(generator, p ? ", " : "");
+            emit_expression(generator, signature->parameter_types[p], budget / 2);
+        }
+        emit(generator, ")");
+        return 1;
+    }
+    return 0;
+}
+
+// A leaf of the expression tree
+static void emit_operand(Generator *generator, ValueType type, int budget)
+{
+    int choice = random_below(generator, 10);
+    const Variable *variable = pick_variable(generator, type);
+
+    if (choice < 5 && variable)
+    {
+        emit(generator, "%s", variable->name);
+    }
+    else if (choice == 5 && budget > 1 && emit_call(generator, type, budget))
+    {
+        return;
+    }
+    else if (choice == 6 && budget > 1)
+    {
+        emit(generator, type == TYPE_INT ? "-(" : "!(");
+        emit_expression(generator, type, budget / 2);
+        emit(generator, ")");
+    }
+    else if (type == TYPE_BOOL)
+    {
+        if (choice < 8)
+        {
+            emit(generator, "READ_PIN(%d)", random_below(generator, generator->pins));
+        }
+        else
+        {
+            emit(generator, random_below(generator, 2) ? "true" : "false");
+        }
+    }
+    else
+    {
+        // Never 0, so no constant divisor folds to a division by zero
+        emit(generator, "%d", 1 + random_below(generator, choice < 9 ? 16 : 100000));
+    }
+}
+
+// Sums and products of int operands
+static void emit_arithmetic(Generator *generator, int operators)
+{
+    static const char *const OPERATORS[] = {" + ", " - ", " * ", " / "};
+    emit_operand(generator, TYPE_INT, operators);
+    for (int i = 0; i < operators; i++)
+    {
+        emit(generator, "%s", OPERATORS[random_below(generator, 4)]);
+        if (random_below(generator, 4) == 0 && i + 2 < operators)
+        {
+            emit(generator, "(");
+            emit_arithmetic(generator, 1 + random_below(generator, 2));
+            emit(generator, ")");
+            i += 2;
+        }
+        else
+        {
+            emit_operand(generator, TYPE_INT, operators - i);
+        }
+    }
+}
+
+// Comparisons of int expressions joined by && and ||
+static void emit_condition(Generator *generator, int operators)
+{
+    static const char *const COMPARISONS[] = {" < ", " > ", " <= ", " >= ", " == ", " != "};
+    int terms = 1 + random_below(generator, operators / 3 + 1);
+    for (int i = 0; i < terms; i++)
+    {
+        if (i)
+        {
+            emit(generator, random_below(generator, 2) ? " && " : " || ");
+        }
+        if (random_below(generator, 3) == 0)
+        {
+            emit_operand(generator, TYPE_BOOL, operators / terms);
+            continue;
+        }
+
+        int share = operators / (2 * terms);
+        emit_arithmetic(generator, random_below(generator, share + 1));
+        emit(generator, "%s", COMPARISONS[random_below(generator, 6)]);
+        emit_arithmetic(generator, random_below(generator, share + 1));
+    }
+}
+
+static void emit_expression(Generator *generator, ValueType type, int budget)
+{
+    int operators = budget > 0 ? random_below(generator, budget + 1) : 0;
+    if (type == TYPE_INT)
+    {
+        emit_arithmetic(generator, operators);
+    }
+    else
+    {
+        emit_condition(generator, operators);
+    }
+}
+
+static void declare_variable(Generator *generator, ValueType type, const char *name)
+{
+    if (generator->variable_count < MAX_VARIABLES)
+    {
+        Variable *variable = &generator->variables[generator->variable_count++];
+        snprintf(variable->name, sizeof(variable->name), "%s", name);
+        variable->type = type;
+    }
+}
+
+static void emit_definition(Generator *generator, int level)
+{
+    char name[32];
+    ValueType type = random_below(generator, 4) == 0 ? TYPE_BOOL : TYPE_INT;
+    snprintf(name, sizeof(name), "%s_%d", NAMES[random_below(generator, 16)], generator->next_variable++);
+
+    emit_indent(generator, level);
+    emit(generator, "%s %s = ", type == TYPE_INT ? "int" : "bool", name);
+    emit_expression(generator, type, generator->expression_length);
+    emit(generator, ";\n");
+    declare_variable(generator, type, name);
+}
+
+// One statement the parser has to report and recover from
+static void emit_broken_statement(Generator *generator, int level)
+{
+    emit_indent(generator, level);
+    switch (random_below(generator, 5))
+    {
+    case 0:
+        emit(generator, "int missing_semicolon = 1\n");
+        break;
+    case 1:
+        emit(generator, "counter = (1 + ;\n");
+        break;
+    case 2:
+        emit(generator, "int = 3;\n");
+        break;
+    case 3:
+        emit(generator, "SET_PIN(%d, MAYBE);\n", random_below(generator, generator->pins));
+        break;
+    default:
+        emit(generator, "level = 2 @ 3;\n");
+        break;
+    }
+}
+
+static void emit_block(Generator *generator, int level, int statements);
+
+static void emit_statement(Generator *generator, int level)
+{
+    if (generator->errors && random_below(generator, 1000) < generator->errors)
+    {
+        emit_broken_statement(generator, level);
+        return;
+    }
+
+    int choice = random_below(generator, 12);
+    int nested = level <= generator->depth;
+    const Variable *target = pick_variable(generator, choice & 1 ? TYPE_BOOL : TYPE_INT);
+
+    if (choice < 2)
+    {
+        emit_definition(generator, level);
+    }
+    else if (choice < 6 && target)
+    {
+        emit_indent(generator, level);
+        emit(generator, "%s = ", target->name);
+        emit_expression(generator, target->type, generator->expression_length);
+        emit(generator, ";\n");
+    }
+    else if (choice < 8 && nested)
+    {
+        emit_indent(generator, level);
+        emit(generator, "if (");
+        emit_expression(generator, TYPE_BOOL, generator->expression_length);
+        emit(generator, ") {\n");
+        emit_block(generator, level + 1, 1 + random_below(generator, 4));
+        emit_indent(generator, level);
+        if (random_below(generator, 2))
+        {
+            emit(generator, "} else {\n");
+            emit_block(generator, level + 1, 1 + random_below(generator, 4));
+            emit_indent(generator, level);
+        }
+        emit(generator, "}\n");
+    }
+    else if (choice < 9 && nested)
+    {
+        emit_indent(generator, level);
+        emit(generator, "while (");
+        emit_expression(generator, TYPE_BOOL, generator->expression_length);
+        emit(generator, ") {\n");
+        emit_block(generator, level + 1, 1 + random_below(generator, 4));
+        emit_indent(generator, level);
+        emit(generator, "}\n");
+    }
+    else if (choice < 11)
+    {
+        emit_indent(generator, level);
+        emit(generator, "SET_PIN(%d, %s);\n", random_below(generator, generator->pins),
+             random_below(generator, 2) ? "HIGH" : "LOW");
+    }
+    else
+    {
+        emit_indent(generator, level);
+        if (!emit_call(generator, random_below(generator, 2) ? TYPE_INT : TYPE_BOOL, generator->expression_length))
+        {
+            emit(generator, "READ_PIN(%d)", random_below(generator, generator->pins));
+        }
+        emit(generator, ";\n");
+    }
+}
+
+// Variables defined in a block go out of scope at its end
+static void emit_block(Generator *generator, int level, int statements)
+{
+    int variable_count = generator->variable_count;
+    for (int i = 0; i < statements; i++)
+    {
+        emit_statement(generator, level);
+    }
+    generator->variable_count = variable_count;
+}
+
+static int emit_function(Generator *generator)
+{
+    if (generator->function_count == generator->function_capacity)
+    {
+        int capacity = generator->function_capacity ? generator->function_capacity * 2 : 256;
+        Signature *functions = realloc(generator->functions, capacity * sizeof(Signature));
+        if (!functions)
+        {
+            return 0;
+        }
+        generator->functions = functions;
+        generator->function_capacity = capacity;
+    }
+
+    Signature signature = {.return_type = random_below(generator, 4) == 0 ? TYPE_BOOL : TYPE_INT};
+    signature.parameter_count = random_below(generator, MAX_PARAMETERS + 1);
+    generator->variable_count = 0;
+    generator->next_variable = 0;
+
+    emit(generator, "%s f%d(", signature.return_type == TYPE_INT ? "int" : "bool", generator->function_count);
+    for (int p = 0; p < signature.parameter_count; p++)
+    {
+        char name[32];
+        signature.parameter_types[p] = random_below(generator, 3) == 0 ? TYPE_BOOL : TYPE_INT;
+        snprintf(name, sizeof(name), "p%d", p);
+        emit(generator, "%s%s %s", p ? ", " : "", signature.parameter_types[p] == TYPE_INT ? "int" : "bool", name);
+        declare_variable(generator, signature.parameter_types[p], name);
+    }
+    emit(generator, ") {\n");
+
+    // Every function starts with an int and a bool so every statement has one to use
+    for (int i = 0; i < 2 || i < 1 + random_below(generator, 4); i++)
+    {
+        char name[32];
+        ValueType type = i == 1 ? TYPE_BOOL : TYPE_INT;
+        snprintf(name, sizeof(name), "%s_%d", NAMES[random_below(generator, 16)], generator->next_variable++);
+        emit(generator, "    %s %s = ", type == TYPE_INT ? "int" : "bool", name);
+        emit_expression(generator, type, 2);
+        emit(generator, ";\n");
+        declare_variable(generator, type, name);
+    }
+
+    emit_block(generator, 1, 2 + random_below(generator, 10));
+    emit(generator, "    return ");
+    emit_expression(generator, signature.return_type, generator->expression_length);
+    emit(generator, ";\n}\n\n");
+
+    generator->functions[generator->function_count++] = signature;
+    return 1;
+}
+
+// A byte count with an optional K, M or G suffix
+static uint64_t parse_size(const char *text)
+{
+    char *end;
+    uint64_t size = strtoull(text, &end, 10);
+    switch (*end)
+    {
+    case 'K':
+    case 'k':
+        return size << 10;
+    case 'M':
+    case 'm':
+        return size << 20;
+    case 'G':
+    case 'g':
+        return size << 30;
+    default:
+        return *end ? 0 : size;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Generator generator = {.state = 1, .size = 1 << 20, .depth = 4, .expression_length = 8, .pins = 64};
+
+    for (int i = 1; i < argc; i++)
+    {
+        const char *value = i + 1 < argc ? argv[i + 1] : "";
+        if (strcmp(argv[i], "--seed") == 0)
+        {
+            generator.state = strtoull(value, NULL, 10);
+        }
+        else if (strcmp(argv[i], "--size") == 0)
+        {
+            generator.size = parse_size(value);
+        }
+        else if (strcmp(argv[i], "--depth") == 0)
+        {
+            generator.depth = atoi(value);
+        }
+        else if (strcmp(argv[i], "--expression-length") == 0)
+        {
+            generator.expression_length = atoi(value);
+        }
+        else if (strcmp(argv[i], "--pins") == 0)
+        {
+            generator.pins = atoi(value);
+        }
+        else if (strcmp(argv[i], "--errors") == 0)
+        {
+            generator.errors = atoi(value);
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [--seed N] [--size BYTES[K|M|G]] [--depth N] [--expression-length N]"
+                    " [--pins N] [--errors PER_MILLE]\n", argv[0]);
+            return 1;
+        }
+        i++;
+    }
+
+    if (generator.size == 0 || generator.depth < 0 || generator.expression_length < 0 || generator.pins <= 0 ||
+        generator.errors < 0 || generator.errors > 1000)
+    {
+        fprintf(stderr, "Invalid generator option\n");
+        return 1;
+    }
+
+    while (generator.written < generator.size)
+    {
+        if (!emit_function(&generator))
+        {
+            fprintf(stderr, "Out of memory\n");
+            free(generator.functions);
+            return 1;
+        }
+    }
+
+    free(generator.functions);
+    return fflush(stdout) != 0;
+}
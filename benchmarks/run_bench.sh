@@ -0,0 +1,82 @@
+#!/bin/bash
+
+# Front-end regression benchmark: lex and parse generated programs of several
+# sizes, valid and with errors, and compare lexer MB/s, parser nodes/s and peak
+# RSS with benchmarks/baseline.txt. A throughput below the baseline, or a peak
+# RSS above it, by more than the tolerance fails the run.
+# Usage: benchmarks/run_bench.sh [--update-baseline]
+# Environment: BENCH_SIZES (default "64K 4M 32M"), BENCH_SEED (default 1),
+#              BENCH_ITERATIONS (default 10), BENCH_TOLERANCE in percent (default 30)
+
+SIZES=${BENCH_SIZES:-"64K 4M 32M"}
+SEED=${BENCH_SEED:-1}
+ITERATIONS=${BENCH_ITERATIONS:-10}
+TOLERANCE=${BENCH_TOLERANCE:-30}
+BASELINE="benchmarks/baseline.txt"
+INPUT_DIR="build/bench/programs"
+RESULTS="build/bench/results.txt"
+
+make -s benchmarks || exit 1
+mkdir -p "$INPUT_DIR"
+: > "$RESULTS"
+
+for SIZE in $SIZES; do
+    for VARIANT in valid errors; do
+        NAME="$SIZE-$VARIANT"
+        INPUT="$INPUT_DIR/seed${SEED}_$NAME.txt"
+        ERRORS=0
+        [ "$VARIANT" = errors ] && ERRORS=20
+
+        # The generator is deterministic, so an input once written is reused
+        if [ ! -f "$INPUT" ]; then
+            ./build/bench/generate_program --seed "$SEED" --size "$SIZE" --errors "$ERRORS" > "$INPUT" || exit 1
+        fi
+
+        LINE=$(./build/bench/bench_frontend "$INPUT" "$ITERATIONS") || exit 1
+        echo "name=$NAME $LINE" | tee -a "$RESULTS"
+    done
+done
+
+if [ "$1" = "--update-baseline" ] || [ ! -f "$BASELINE" ]; then
+    {
+        echo "# Front-end baseline written by benchmarks/run_bench.sh --update-baseline"
+        echo "# seed=$SEED iterations=$ITERATIONS on $(uname -m), figures are machine specific"
+        cat "$RESULTS"
+    } > "$BASELINE"
+    echo "Baseline written to $BASELINE"
+    exit 0
+fi
+
+# Each result line is compared with the baseline line of the same name, sizes
+# missing from either side are skipped
+awk -v tolerance="$TOLERANCE" '
+    function field(line, key,    parts, i, pair) {
+        split(line, parts, " ")
+        for (i in parts) {
+            split(parts[i], pair, "=")
+            if (pair[1] == key) return pair[2]
+        }
+        return ""
+    }
+    function check(name, key, now, then, higher_is_better,    change) {
+        if (then == "" || then == 0) return
+        change = (now - then) * 100 / then
+        if (!higher_is_better) change = -change
+        status = change < -tolerance ? "REGRESSION" : "ok"
+        printf "%-12s %-14s %14.1f %14.1f %+7.1f%%  %s\n", name, key, then, now, change, status
+        if (status == "REGRESSION") regressions++
+    }
+    FNR == NR { if ($0 !~ /^#/) baseline[field($0, "name")] = $0; next }
+    {
+        name = field($0, "name")
+        if (!(name in baseline)) next
+        check(name, "lex_mb_s", field($0, "lex_mb_s"), field(baseline[name], "lex_mb_s"), 1)
+        check(name, "parse_nodes_s", field($0, "parse_nodes_s"), field(baseline[name], "parse_nodes_s"), 1)
+        check(name, "peak_rss_kb", field($0, "peak_rss_kb"), field(baseline[name], "peak_rss_kb"), 0)
+    }
+    BEGIN { printf "%-12s %-14s %14s %14s %8s\n", "input", "metric", "baseline", "now", "change" }
+    END {
+        if (regressions) { printf "%d regressions beyond %d%%\n", regressions, tolerance; exit 1 }
+        print "No regressions"
+    }
+' "$BASELINE" "$RESULTS"
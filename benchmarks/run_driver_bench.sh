@@ -0,0 +1,58 @@
+#!/bin/bash
+
+# Compile many files with the driver at every thread count from 1 to the number of processors.
+# Usage: benchmarks/run_driver_bench.sh [file_count] [file_size_in_kb] [max_threads]
+
+FILE_COUNT=${1:-256}
+FILE_KB=${2:-256}
+MAX_THREADS=${3:-$(nproc)}
+INPUT_DIR="build/bench/driver_input"
+
+make -s compiler || exit 1
+mkdir -p "$INPUT_DIR"
+
+# One template file of the requested size, copied so every job does the same work
+TEMPLATE="$INPUT_DIR/template.txt"
+if [ ! -f "$TEMPLATE" ] || [ $(stat -c %s "$TEMPLATE") -lt $((FILE_KB * 1024)) ]; then
+    : > "$TEMPLATE"
+    i=0
+    while [ $(stat -c %s "$TEMPLATE") -lt $((FILE_KB * 1024)) ]; do
+        i=$((i + 1))
+        cat >> "$TEMPLATE" <<PROGRAM
+int control_$i(int threshold, bool enabled) {
+    int counter = 0;
+    bool flag = false;
+    SET_PIN($((i % 32)), HIGH);
+    while (counter < threshold && enabled) {
+        if (READ_PIN($((i % 16)))) {
+            counter = counter + 1;
+        } else {
+            flag = true;
+        }
+    }
+    SET_PIN($((i % 32)), LOW);
+    return counter * 2 + 1;
+}
+
+PROGRAM
+    done
+fi
+for i in $(seq 1 "$FILE_COUNT"); do
+    [ -f "$INPUT_DIR/file_$i.txt" ] || cp "$TEMPLATE" "$INPUT_DIR/file_$i.txt"
+done
+
+FILES=$(seq -f "$INPUT_DIR/file_%g.txt" 1 "$FILE_COUNT")
+TOTAL_BYTES=$((FILE_COUNT * $(stat -c %s "$TEMPLATE")))
+
+BASE_TIME=""
+for THREADS in $(seq 1 "$MAX_THREADS"); do
+    START=$(date +%s.%N)
+    ./compiler -j "$THREADS" $FILES > /dev/null || { echo "Compilation failed"; exit 1; }
+    END=$(date +%s.%N)
+
+    ELAPSED=$(awk "BEGIN { print $END - $START }")
+    BASE_TIME=${BASE_TIME:-$ELAPSED}
+    awk -v threads="$THREADS" -v files="$FILE_COUNT" -v elapsed="$ELAPSED" -v base="$BASE_TIME" -v bytes="$TOTAL_BYTES" \
+        'BEGIN { printf "threads=%d files=%d time=%.3fs throughput=%.1f MB/s speedup=%.2fx\n",
+                 threads, files, elapsed, bytes / 1048576 / elapsed, base / elapsed }'
+done
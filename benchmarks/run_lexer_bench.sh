@@ -0,0 +1,54 @@
+#!/bin/bash
+
+# Compare the heap-buffer and mmap lexer input paths on a large synthetic source.
+# Usage: benchmarks/run_lexer_bench.sh [size_in_mb]
+
+SIZE_MB=${1:-64}
+INPUT_FILE="build/bench/lexer_input.txt"
+
+make -s benchmarks || exit 1
+
+# Build the input by repeating a representative program until it reaches the requested size
+if [ ! -f "$INPUT_FILE" ] || [ $(stat -c %s "$INPUT_FILE") -lt $((SIZE_MB * 1024 * 1024)) ]; then
+    CHUNK=$(mktemp)
+    for i in $(seq 1 64); do
+        cat >> "$CHUNK" <<PROGRAM
+# Generated controller $i
+# Template expansion leaves long comment banners and deep indentation behind, the
+# lexer should spend as little time as possible on them.
+int control_$i(int threshold, bool enabled) {
+                                        # section: setup
+
+    int counter = 0;
+    bool flag = false;
+    SET_PIN($((i % 32)), HIGH);
+    while (counter < threshold && enabled) {
+        if (READ_PIN($((i % 16)))) {
+            counter = counter + 1;
+        } else {
+            flag = true;
+        }
+    }
+    SET_PIN($((i % 32)), LOW);
+    return counter * 2 + 1;
+}
+
+PROGRAM
+    done
+    : > "$INPUT_FILE"
+    while [ $(stat -c %s "$INPUT_FILE") -lt $((SIZE_MB * 1024 * 1024)) ]; do
+        cat "$CHUNK" "$CHUNK" "$CHUNK" "$CHUNK" >> "$INPUT_FILE"
+    done
+    rm -f "$CHUNK"
+fi
+
+for MODE in read mmap stream; do
+    ./build/bench/bench_lexer $MODE "$INPUT_FILE" 5
+    echo
+done
+
+# Scanning kernels, DSL_LEXER_SIMD overrides the runtime CPU dispatch
+for KERNELS in scalar sse2 avx2; do
+    DSL_LEXER_SIMD=$KERNELS ./build/bench/bench_lexer mmap "$INPUT_FILE" 5
+    echo
+done
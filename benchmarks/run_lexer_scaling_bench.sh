@@ -0,0 +1,17 @@
+#!/bin/bash
+
+# Scaling of the parallel lexer over a generated program, from one thread up to
+# the number of processors or the given thread count.
+# Usage: benchmarks/run_lexer_scaling_bench.sh [size] [max_threads]
+# size takes the generator's K, M and G suffixes (default 64M)
+
+SIZE=${1:-64M}
+INPUT="build/bench/programs/seed1_$SIZE-valid.txt"
+
+make -s benchmarks || exit 1
+mkdir -p build/bench/programs
+if [ ! -f "$INPUT" ]; then
+    ./build/bench/generate_program --seed 1 --size "$SIZE" > "$INPUT" || exit 1
+fi
+
+./build/bench/bench_lexer_scaling "$INPUT" $2
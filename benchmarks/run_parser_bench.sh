@@ -0,0 +1,40 @@
+#!/bin/bash
+
+# Parse an expression-heavy synthetic source with the recursive Pratt parser and
+# with every expression on the explicit stack.
+# Usage: benchmarks/run_parser_bench.sh [size_in_mb]
+
+SIZE_MB=${1:-16}
+INPUT_FILE="build/bench/parser_input.txt"
+
+make -s benchmarks || exit 1
+
+# Build the input by repeating expression-heavy functions until it reaches the requested size
+if [ ! -f "$INPUT_FILE" ] || [ $(stat -c %s "$INPUT_FILE") -lt $((SIZE_MB * 1024 * 1024)) ]; then
+    CHUNK=$(mktemp)
+    for i in $(seq 1 64); do
+        cat >> "$CHUNK" <<PROGRAM
+int filter_$i(int a, int b, int c) {
+    int x = (a + b * c - (a / 2 + $i) * (b - c)) * 4 + c / (a + 1);
+    bool y = a < b && b <= c || !(a == c) && -a + b * -c != $i;
+    x = ((((((((a + 1) * 2) - 3) / 4) + 5) * 6) - 7) / 8) + scale(x - $i, a * b + c);
+    while (x > 0 && !y || a * a + b * b < c * c) {
+        x = x - (a + b) * (c - a) / ($i + 1);
+    }
+    return x * (a - -b) - clamp(a + b, c * 2, limit(a, b - c));
+}
+
+PROGRAM
+    done
+    : > "$INPUT_FILE"
+    while [ $(stat -c %s "$INPUT_FILE") -lt $((SIZE_MB * 1024 * 1024)) ]; do
+        cat "$CHUNK" "$CHUNK" "$CHUNK" "$CHUNK" >> "$INPUT_FILE"
+    done
+    rm -f "$CHUNK"
+fi
+
+./build/bench/bench_parser "$INPUT_FILE" 5
+echo
+
+# DSL_PARSER_RECURSION_LIMIT=0 sends every expression through the explicit-stack engine
+DSL_PARSER_RECURSION_LIMIT=0 ./build/bench/bench_parser "$INPUT_FILE" 5
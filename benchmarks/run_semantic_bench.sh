@@ -0,0 +1,39 @@
+#!/bin/bash
+
+# Check two inputs with 100k+ identifiers: a generated program of many small
+# functions, and one function whose body declares every variable in one block,
+# the case that makes a linear scope-list lookup quadratic.
+# Usage: benchmarks/run_semantic_bench.sh [variables]
+# Environment: BENCH_SEED (default 1), BENCH_SIZE of the generated program (default 4M)
+
+VARIABLES=${1:-100000}
+SEED=${BENCH_SEED:-1}
+SIZE=${BENCH_SIZE:-4M}
+INPUT_DIR="build/bench/programs"
+GENERATED="$INPUT_DIR/seed${SEED}_$SIZE-valid.txt"
+WIDE="$INPUT_DIR/wide_$VARIABLES.txt"
+
+make -s benchmarks || exit 1
+mkdir -p "$INPUT_DIR"
+
+if [ ! -f "$GENERATED" ]; then
+    ./build/bench/generate_program --seed "$SEED" --size "$SIZE" > "$GENERATED" || exit 1
+fi
+
+# Each variable is read by the next one, and again near the end of the block
+if [ ! -f "$WIDE" ]; then
+    awk -v count="$VARIABLES" 'BEGIN {
+        print "int main() {"
+        print "    int v0 = 1;"
+        for (i = 1; i < count; i++) {
+            printf "    int v%d = v%d + %d;\n", i, i - 1, i % 7 + 1
+        }
+        for (i = 0; i < count; i += 97) {
+            printf "    v%d = v%d * 2;\n", count - 1, i
+        }
+        printf "    return v%d;\n}\n", count - 1
+    }' > "$WIDE"
+fi
+
+echo "name=generated-$SIZE $(./build/bench/bench_semantic "$GENERATED" 5)"
+echo "name=wide-$VARIABLES $(./build/bench/bench_semantic "$WIDE" 5)"
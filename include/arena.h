@@ -0,0 +1,45 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DEFAULT_ARENA_BLOCK_SIZE (64 * 1024)
+
+// Memory block owned by an arena, either a bump block shared by small
+// allocations or a dedicated block holding one large allocation
+typedef struct ArenaBlock {
+    struct ArenaBlock *prev;
+    struct ArenaBlock *next;
+    size_t capacity;       // Usable bytes in data
+    size_t used;           // Bytes handed out from data
+    _Alignas(16) char data[];
+} ArenaBlock;
+
+// Bump allocator: objects are never freed individually, the whole arena is released at once
+typedef struct {
+    ArenaBlock *current;   // Bump block new small allocations come from
+    ArenaBlock *blocks;    // Every block owned by the arena
+    size_t block_size;     // Size of each bump block
+    size_t block_count;    // Number of blocks requested from the heap
+    size_t bytes_used;     // Bytes handed out to callers
+} Arena;
+
+// What the calling thread asked the functions below for, whether served by an
+// arena or the heap. Callers measure a stretch of work by the difference.
+typedef struct {
+    uint64_t allocations;
+    uint64_t bytes;
+} ArenaStatistics;
+
+extern Arena *create_arena(size_t block_size);
+extern void free_arena(Arena *arena);
+
+// A NULL arena means the plain heap, so the same code serves arena-owned and standalone objects
+extern void *arena_alloc(Arena *arena, size_t size);
+extern void *arena_calloc(Arena *arena, size_t count, size_t size);
+extern void *arena_realloc(Arena *arena, void *pointer, size_t old_size, size_t new_size);
+extern void arena_free(Arena *arena, void *pointer);
+extern ArenaStatistics get_arena_statistics();
+
+#endif
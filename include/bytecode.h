@@ -0,0 +1,95 @@
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "arena.h"
+#include "errors.h"
+#include "intern.h"
+#include "parser.h"
+
+#define BYTECODE_MAX_REGISTERS 256
+#define BYTECODE_NO_FUNCTION UINT32_MAX
+
+// Register machine instructions. Every function has its own window of up to 256
+// 32-bit registers, its parameters in the first ones. Jump targets are absolute
+// instruction indices. Booleans and pin levels are 0 or 1.
+typedef enum
+{
+    OP_LOAD_CONST,       // a = immediate
+    OP_MOVE,             // a = b
+    OP_ADD,              // a = b + c, integer arithmetic wraps
+    OP_SUB,              // a = b - c
+    OP_MUL,              // a = b * c
+    OP_DIV,              // a = b / c, a runtime error when c is 0
+    OP_ADD_IMMEDIATE,    // a = b + immediate
+    OP_EQ,               // a = b == c
+    OP_NEQ,              // a = b != c
+    OP_LT,               // a = b < c
+    OP_GT,               // a = b > c
+    OP_LTE,              // a = b <= c
+    OP_GTE,              // a = b >= c
+    OP_NOT,              // a = !b
+    OP_NEG,              // a = -b
+    OP_JUMP,             // Go to immediate
+    OP_JUMP_IF_FALSE,    // Go to immediate if a is 0
+    OP_JUMP_IF_TRUE,     // Go to immediate if a is not 0
+    OP_JUMP_UNLESS_EQ,   // Go to immediate unless b == c
+    OP_JUMP_UNLESS_NEQ,  // Go to immediate unless b != c
+    OP_JUMP_UNLESS_LT,   // Go to immediate unless b < c
+    OP_JUMP_UNLESS_GT,   // Go to immediate unless b > c
+    OP_JUMP_UNLESS_LTE,  // Go to immediate unless b <= c
+    OP_JUMP_UNLESS_GTE,  // Go to immediate unless b >= c
+    OP_READ_PIN,         // a = level of pin immediate
+    OP_SET_PIN,          // Set pin immediate to level a
+    OP_CALL,             // a = function immediate called with the c registers from b, which become its first ones
+    OP_RETURN,           // Return a to the caller
+    OPCODE_COUNT
+} Opcode;
+
+typedef struct
+{
+    uint8_t opcode;    // Opcode
+    uint8_t a;
+    uint8_t b;
+    uint8_t c;
+    int32_t immediate;
+} Instruction;
+
+typedef struct
+{
+    uint32_t symbol;          // Name
+    uint32_t entry;           // First instruction
+    uint32_t parameter_count;
+    uint32_t register_count;  // Size of its register window
+} BytecodeFunction;
+
+// Lowered program. lines and columns give the source position of each instruction
+// for runtime errors.
+typedef struct
+{
+    Instruction *code;
+    int *lines;
+    int *columns;
+    uint32_t instruction_count;
+    uint32_t instruction_capacity;
+    BytecodeFunction *functions;
+    uint32_t function_count;
+    uint32_t main_function;   // Index of main, BYTECODE_NO_FUNCTION if there is none
+    InternTable *symbol_table; // Names of the functions, owned by the token stream
+    Arena *arena;             // Arena the program lives in, NULL for the heap
+} BytecodeProgram;
+
+// The program comes from the AST's arena (the heap when it has none). Names that
+// do not resolve, calls with the wrong number of arguments and functions that
+// need more than BYTECODE_MAX_REGISTERS registers are reported to error_list,
+// after which NULL is returned.
+extern BytecodeProgram *compile_bytecode(AST *ast, ErrorList *error_list);
+extern void free_bytecode_program(BytecodeProgram *program);
+
+extern const char *opcode_to_string(Opcode opcode);
+
+// One line per instruction, grouped by function
+extern void print_bytecode_program(BytecodeProgram *program, FILE *file);
+
+#endif
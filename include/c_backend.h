@@ -0,0 +1,35 @@
+#ifndef C_BACKEND_H
+#define C_BACKEND_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "errors.h"
+#include "parser.h"
+#include "target.h"
+
+// Pin traffic of one generated program, counted over the code rather than a run
+typedef struct
+{
+    uint32_t pin_writes;      // SET_PIN operations
+    uint32_t port_writes;     // Masked register updates they were batched into
+    uint32_t pin_reads;       // READ_PIN operations
+    uint32_t port_reads;      // Input register reads left once cached
+    uint32_t naive_accesses;  // Register accesses with a read-modify-write per SET_PIN and a read per READ_PIN
+    uint32_t accesses;        // Register accesses of the generated code
+} CBackendReport;
+
+// Write the program as C for target. Each DSL function becomes an int32_t
+// function dsl_<name>, with the VM's wrapping arithmetic; division by zero calls
+// DSL_DIVISION_BY_ZERO(), __builtin_trap() unless the including build defines it.
+// Consecutive SET_PIN statements become one write per port to its set and clear
+// registers, until a pin repeats so no pulse is lost. With cache_reads each port's
+// input register is read once per straight-line block; a call, a write to the
+// port or any branch ends the block. Names that do not resolve, calls with the
+// wrong number of arguments and pins the target does not map are reported to
+// error_list, and nothing is written.
+extern int generate_c_program(AST *ast, const TargetConfig *target, FILE *file, CBackendReport *report,
+                              ErrorList *error_list);
+
+extern void print_c_backend_report(CBackendReport *report, FILE *file);
+
+#endif
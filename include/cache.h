@@ -0,0 +1,61 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <pthread.h>
+#include "errors.h"
+#include "sha256.h"
+
+#define DEFAULT_CACHE_MAX_BYTES (64 * 1024 * 1024)
+
+// SHA-256 of the compiler version, the options and the source bytes. Options that
+// read a file, like a target, put a digest of its bytes into the options.
+typedef struct {
+    unsigned char bytes[SHA256_DIGEST_SIZE];
+} CacheKey;
+
+// On-disk cache of compilation results, one file per key named by its hex digest.
+// Entries are written to a temporary file and renamed into place, so concurrent
+// compilers sharing the directory only ever see whole entries. A hit refreshes the
+// entry's modification time, which is what least-recently-used eviction goes by.
+// The counters cover this process only; the cache is safe to use from several threads.
+typedef struct {
+    char *directory;
+    size_t max_bytes;       // Size trim_compilation_cache brings the entries down to
+    pthread_mutex_t lock;   // Guards the counters below
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long stores;
+    unsigned long evictions;
+    unsigned long next_temp_id;
+} CompilationCache;
+
+// Creates directory if it does not exist yet, returns NULL if it cannot be used
+extern CompilationCache *create_compilation_cache(const char *directory, size_t max_bytes);
+extern void free_compilation_cache(CompilationCache *cache);
+
+// Something a compilation produced besides its diagnostics, like printed text or
+// a written file. data is NULL when the compilation did not produce it.
+typedef struct {
+    char *data;
+    size_t size;
+} CacheOutput;
+
+extern CacheKey compute_cache_key(const char *source, size_t length, const char *options);
+
+// On a hit the stored diagnostics are appended to error_list exactly as they were
+// reported, *succeeded is set to the stored outcome and each of the output_count
+// outputs to a copy of the stored one, which the caller frees. An entry stored with
+// a different number of outputs is a miss. Returns whether it was a hit.
+extern int lookup_compilation_cache(CompilationCache *cache, const CacheKey *key, ErrorList *error_list, int *succeeded,
+                                    CacheOutput *outputs, int output_count);
+extern int store_compilation_cache(CompilationCache *cache, const CacheKey *key, ErrorList *error_list, int succeeded,
+                                   const CacheOutput *outputs, int output_count);
+
+// Evict least recently used entries until the cache fits in max_bytes
+extern void trim_compilation_cache(CompilationCache *cache);
+
+extern void report_cache_statistics(CompilationCache *cache, FILE *stream);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef COMPILATION_H
+#define COMPILATION_H
+
+#include "arena.h"
+#include "errors.h"
+#include "source.h"
+#include "token.h"
+#include "parser.h"
+#include "optimize.h"
+
+// Everything one compilation produces. The token stream, error list and AST are
+// all allocated from the context's arena, so the whole compilation is released
+// by a single free_compilation_context call.
+typedef struct {
+    Arena *arena;               // Owns every front-end object below
+    SourceBuffer *source;       // Mapped input file
+    ErrorList *error_list;
+    TokenStream *token_stream;
+    AST *ast;
+    int lex_threads;            // Threads run_lexer may split a large source across, 1 or less for none
+    int parse_threads;          // Threads run_parser may split a large token stream across, likewise
+} CompilationContext;
+
+extern CompilationContext *create_new_compilation_context();
+extern int load_source_file(CompilationContext *context, const char *path);
+extern int run_lexer(CompilationContext *context);
+extern int run_parser(CompilationContext *context);
+// run_lexer and run_parser at once, lexing on a thread of its own
+extern int run_pipelined_front_end(CompilationContext *context);
+extern int run_semantic_analysis(CompilationContext *context);
+extern int run_optimizer(CompilationContext *context, OptimizationReport *report);
+extern void free_compilation_context(CompilationContext *context);
+
+#endif
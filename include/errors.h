@@ -1,31 +1,102 @@
 #ifndef ERRORS_H
 #define ERRORS_H
 
+#include <stdio.h>
+#include <stdint.h>
+#include "arena.h"
+
 #define DEFAULT_ERROR_LIST_CAPACITY 20
 
+// Longest message text kept, longer ones are cut
+#define MAX_ERROR_MESSAGE_LENGTH 256
+
+#define ERROR_WRITER_BUFFER_SIZE (64 * 1024)
+
 // Enum for the stage where error occurs
 typedef enum {
     LEXER,
     PARSER,
-    CODEGEN
+    SEMANTIC,
+    CODEGEN,
+    RUNTIME
 } ErrorStage;
 
+extern const char *const ErrorStageNames[];
+
+// What an error says. Frequent errors are codes whose text is only formatted
+// when reported, every other error keeps its own message text.
+typedef enum {
+    ERROR_TEXT,                // The message is the error's text
+    ERROR_INVALID_TOKEN,       // A word or number that is no token
+    ERROR_UNRECOGNIZED_TOKEN,  // A character no token starts with
+    ERROR_UNEXPECTED_TOKEN     // Text is the lexeme, details are its type name and what was expected
+} ErrorCode;
+
+// One error, or a run of the same error at one column or adjacent ones of a line, which is
+// stored once with its count so a cascade costs one record
 typedef struct {
-    int line;          // Line where error occured
-    int column;        // Column where error occured
-    ErrorStage stage;  // Stage of compiler where the error occured
-    char message[256]; // Error message
+    int line;                 // Line where error occured
+    int column;               // Column where error occured
+    int last_column;          // Column of the run's last error, column for a single one
+    uint32_t count;           // Errors in the run
+    uint8_t stage;            // ErrorStage
+    uint8_t code;             // ErrorCode, says which of the arguments below are used
+    uint32_t text;            // Offset of the error's text in the list's text pool
+    uint32_t text_length;
+    const char *details[2];   // Static strings the message is formatted with
 } Error;
 
 typedef struct {
-    Error **errors;    // Array of error pointers
-    int capacity;      // Maximum size of the list
-    int size;          // Current size of the list
+    Error *errors;            // In the order they were added
+    int capacity;             // Maximum size of the list
+    int size;                 // Current size of the list
+    char *text;               // Text of every error, each NUL-terminated
+    uint32_t text_length;
+    uint32_t text_capacity;
+    int max_errors;           // Records past this many are dropped, 0 for no limit
+    int dropped;              // How many were
+    Arena *arena;             // Arena the errors live in, NULL for the heap
 } ErrorList;
 
-extern ErrorList *create_new_error_list();
+typedef enum {
+    ERROR_FORMAT_TEXT,
+    ERROR_FORMAT_JSON
+} ErrorFormat;
+
+// Collects formatted diagnostics and writes them to file in large blocks
+typedef struct {
+    FILE *file;
+    ErrorFormat format;
+    size_t length;
+    char buffer[ERROR_WRITER_BUFFER_SIZE];
+} ErrorWriter;
+
+// With an arena the list lives in it and is released with it
+extern ErrorList *create_new_error_list(Arena *arena);
 extern void add_new_error(ErrorList *error_list, int line, int column, ErrorStage stage, char* message);
+// An error whose message needs no argument
+extern void add_new_coded_error(ErrorList *error_list, int line, int column, ErrorStage stage, ErrorCode code);
+// expected and type_name must be static strings
+extern void add_unexpected_token_error(ErrorList *error_list, int line, int column, const char *lexeme, int length,
+                                       const char *type_name, const char *expected);
+// Add from's error at index, with its whole run, to error_list at a new position
+extern void copy_error(ErrorList *error_list, ErrorList *from, int index, int line, int column);
+// Once it has, stages should stop rather than report more
+extern int error_limit_reached(ErrorList *error_list);
+
+// The error's message, formatted into buffer of MAX_ERROR_MESSAGE_LENGTH bytes if it is not stored as text
+extern const char *format_error_message(ErrorList *error_list, Error *error, char *buffer);
+
+extern void init_error_writer(ErrorWriter *writer, FILE *file, ErrorFormat format);
+// Pass bytes through unchanged, in order with the diagnostics around them
+extern void write_error_writer_bytes(ErrorWriter *writer, const char *data, size_t length);
+// Write every error of the list, a run as one diagnostic with its count. The text
+// format leaves naming the file to the caller, JSON writes one line per file naming path.
+extern void write_errors(ErrorWriter *writer, const char *path, ErrorList *error_list);
+extern int flush_error_writer(ErrorWriter *writer);
+
+// Print the errors as text to stdout
 extern void report_errors(ErrorList *error_list);
 extern void free_error_list(ErrorList *error_list);
 
-#endif
\ No newline at end of file
+#endif
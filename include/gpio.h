@@ -0,0 +1,72 @@
+#ifndef GPIO_H
+#define GPIO_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "errors.h"
+
+#define GPIO_PIN_COUNT 64
+
+// Time in a simulation is the number of VM instructions executed so far
+typedef struct {
+    uint64_t cycle;
+    uint8_t pin;
+    uint8_t level;
+} PinEvent;
+
+// Simulated pin bank. Inputs come from a trace of timed level changes and are
+// applied lazily, only a pin access can tell when they happened. Writes that
+// change a level are logged to output in the same trace format, so one run's
+// output can drive another.
+typedef struct {
+    uint8_t levels[GPIO_PIN_COUNT];
+    PinEvent *inputs;       // Scripted level changes in cycle order
+    size_t input_count;
+    size_t input_capacity;
+    size_t next_input;      // First input not applied yet
+    FILE *output;           // Log of level changes made by the program, NULL for none
+    uint64_t reads;
+    uint64_t writes;
+} PinBank;
+
+extern PinBank *create_pin_bank();
+// A fresh bank with the inputs of script, which may be NULL for none
+extern PinBank *create_pin_bank_from(const PinBank *script);
+extern void free_pin_bank(PinBank *bank);
+
+// Read a trace, one "<cycle> <pin> HIGH|LOW" per line with cycles in order and
+// '#' starting a comment, and append its events to the bank's inputs
+extern int load_pin_trace(PinBank *bank, FILE *file, const char *name, ErrorList *error_list);
+
+// Apply every input due by cycle
+extern void apply_pin_inputs(PinBank *bank, uint64_t cycle);
+
+static inline int read_pin(PinBank *bank, uint32_t pin, uint64_t cycle)
+{
+    if (bank->next_input < bank->input_count && bank->inputs[bank->next_input].cycle <= cycle)
+    {
+        apply_pin_inputs(bank, cycle);
+    }
+    bank->reads++;
+    return bank->levels[pin];
+}
+
+static inline void write_pin(PinBank *bank, uint32_t pin, int level, uint64_t cycle)
+{
+    if (bank->next_input < bank->input_count && bank->inputs[bank->next_input].cycle <= cycle)
+    {
+        apply_pin_inputs(bank, cycle);
+    }
+    bank->writes++;
+    if (bank->levels[pin] != level)
+    {
+        bank->levels[pin] = level;
+        if (bank->output)
+        {
+            fprintf(bank->output, "%llu %u %s\n", (unsigned long long)cycle, pin, level ? "HIGH" : "LOW");
+        }
+    }
+}
+
+#endif
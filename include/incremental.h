@@ -0,0 +1,31 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <stddef.h>
+#include "errors.h"
+#include "token.h"
+#include "lexer.h"
+#include "parser.h"
+
+// Front-end state of a source that is edited and recompiled over and over, as in
+// an editor. Everything lives on the heap so each edit can replace parts of it;
+// the source text itself stays with the caller and must outlive the next update.
+typedef struct {
+    const char *source;
+    size_t length;
+    TokenStream *token_stream; // Empty when the last lex failed
+    AST *ast;                  // NULL when the last lex or parse failed
+    ErrorList *lexer_errors;
+    ErrorList *parser_errors;
+} IncrementalDocument;
+
+extern IncrementalDocument *create_incremental_document(const char *source, size_t length);
+
+// source is the whole text after edit, which was applied to the previous source.
+// Only the tokens and functions the edit touches are lexed and parsed again.
+// Returns whether the document lexed and parsed, errors are in the two lists.
+extern int update_incremental_document(IncrementalDocument *document, const char *source, size_t length, SourceEdit edit);
+
+extern void free_incremental_document(IncrementalDocument *document);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stdint.h>
+#include "arena.h"
+
+#define DEFAULT_INTERN_TABLE_CAPACITY 256
+#define NO_SYMBOL UINT32_MAX
+
+// Interning table mapping identifier text to dense symbol IDs (0, 1, 2, ...).
+// Every distinct name is stored once, later stages compare and hash the IDs.
+typedef struct {
+    uint32_t *slots;          // Open-addressing table of symbol ID + 1, 0 marks an empty slot
+    uint32_t slot_count;      // Power of two, kept at most half full
+    const char **names;       // Name of each symbol, not NUL-terminated
+    uint32_t *name_lengths;   // Length of each name
+    uint32_t *hashes;         // Hash of each name, reused when the slots grow
+    uint32_t symbol_count;
+    uint32_t symbol_capacity;
+    Arena *arena;             // Arena everything lives in, NULL for the heap
+} InternTable;
+
+extern InternTable *create_intern_table(Arena *arena);
+extern void free_intern_table(InternTable *table);
+
+// Returns the ID of name, adding it if it is new, or NO_SYMBOL if memory ran out
+extern uint32_t intern_symbol(InternTable *table, const char *name, int length);
+
+// Returns the ID of name without adding it, NO_SYMBOL if it was never interned
+extern uint32_t find_symbol(InternTable *table, const char *name, int length);
+
+extern const char *get_symbol_name(InternTable *table, uint32_t symbol, int *length);
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef IR_H
+#define IR_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "arena.h"
+#include "errors.h"
+#include "intern.h"
+#include "parser.h"
+
+#define IR_NO_VALUE UINT32_MAX
+#define IR_NO_BLOCK UINT32_MAX
+
+// SSA instructions. Every instruction that produces a value defines exactly one,
+// named by the instruction's index; operands are such values. Integer arithmetic
+// wraps and booleans and pin levels are 0 or 1, as in the VM.
+typedef enum
+{
+    IR_CONST,      // immediate
+    IR_PARAM,      // Parameter number immediate, only in the entry block
+    IR_ADD,        // operand 0 + operand 1
+    IR_SUB,
+    IR_MUL,
+    IR_DIV,        // A runtime error when operand 1 is 0
+    IR_EQ,         // operand 0 == operand 1
+    IR_NEQ,
+    IR_LT,
+    IR_GT,
+    IR_LTE,
+    IR_GTE,
+    IR_NOT,        // !operand 0
+    IR_NEG,        // -operand 0
+    IR_PHI,        // The value of the operand pair (block, value) for the predecessor control came from
+    IR_CALL,       // Function immediate called with the operands
+    IR_GPIO_READ,  // Level of pin immediate
+    IR_GPIO_SET,   // Set pin immediate to level operand 0. No value
+    IR_JUMP,       // Go to targets[0]. No value
+    IR_BRANCH,     // Go to targets[0] if operand 0 is not 0, else targets[1]. No value
+    IR_RETURN,     // Return operand 0. No value
+    IR_OPCODE_COUNT
+} IROpcode;
+
+typedef struct
+{
+    uint8_t opcode;          // IROpcode
+    int32_t immediate;
+    uint32_t block;          // Block holding the instruction
+    uint32_t first_operand;  // Offset of the first operand in IRProgram.operands
+    uint32_t operand_count;  // A phi has two per predecessor
+    uint32_t targets[2];     // Successors of a jump or branch
+    uint32_t token;          // Source token, for diagnostics
+} IRInstruction;
+
+// A straight run of instructions: phis first, one jump, branch or return last.
+// Its predecessors are predecessors[first_predecessor] onwards.
+typedef struct
+{
+    uint32_t first_instruction;
+    uint32_t instruction_count;
+    uint32_t first_predecessor;
+    uint32_t predecessor_count;
+    uint32_t loop_depth;     // Number of while loops around it
+} IRBlock;
+
+// Blocks and instructions of a function are contiguous, its entry block first
+typedef struct
+{
+    uint32_t symbol;
+    uint32_t parameter_count;
+    uint32_t first_block;
+    uint32_t block_count;
+    uint32_t first_instruction;
+    uint32_t instruction_count;
+} IRFunction;
+
+// Whole program in SSA form. Instructions are laid out in block order, and the
+// blocks of a loop lie between its header and the block after it.
+typedef struct
+{
+    IRInstruction *instructions;
+    uint32_t instruction_count;
+    uint32_t *operands;
+    uint32_t operand_count;
+    IRBlock *blocks;
+    uint32_t block_count;
+    uint32_t *predecessors;
+    uint32_t predecessor_count;
+    IRFunction *functions;
+    uint32_t function_count;
+    InternTable *symbol_table; // Names of the functions, owned by the token stream
+    Arena *arena;              // Arena the program lives in, NULL for the heap
+} IRProgram;
+
+// The program comes from the AST's arena (the heap when it has none). Variables
+// become SSA values as the AST is walked: an if merges the values its arms leave
+// with phis, and a while loop's header has a phi for every variable in scope,
+// those a loop does not change are removed again. Code after a return is checked
+// but not lowered. Names that do not resolve and calls with the wrong number of
+// arguments are reported to error_list, after which NULL is returned.
+extern IRProgram *lower_to_ir(AST *ast, ErrorList *error_list);
+extern void free_ir_program(IRProgram *program);
+
+// Check what the rest of the compiler relies on: blocks end in exactly one
+// terminator with phis only at their start, every block but the entry is
+// reached, phis have one operand per predecessor, targets and operands are in
+// range, and every use is dominated by its definition. Problems are reported to
+// error_list.
+extern int verify_ir_program(IRProgram *program, ErrorList *error_list);
+
+struct RegisterAllocation;
+
+// One line per instruction, grouped by function and block, with values and blocks
+// numbered from 0 in each function. With an allocation (NULL for none) every value
+// shows the register or spill slot it lives in.
+extern void print_ir_program(IRProgram *program, const struct RegisterAllocation *allocation, FILE *file);
+
+extern const char *ir_opcode_to_string(IROpcode opcode);
+static inline int ir_defines_value(IROpcode opcode)
+{
+    return opcode < IR_GPIO_SET;
+}
+
+#endif
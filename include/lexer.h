@@ -1,9 +1,83 @@
 #ifndef LEXER_H
 #define LEXER_H
 
+#include <stdio.h>
 #include "token.h"
 #include "errors.h"
+#include "token_queue.h"
 
+#define DEFAULT_LEXER_CHUNK_SIZE 65536
+#define MAX_TOKEN_LENGTH 65536
+// Smallest share of a buffer worth handing to a thread of its own
+#define MIN_PARALLEL_LEXER_CHUNK_SIZE (256 * 1024)
+
+// Pull-based lexer over either a caller-owned buffer or a chunked reader (fd or FILE *).
+// A reader-backed lexer holds at most one chunk plus the token being scanned, so its
+// memory use does not depend on the size of the source.
+typedef struct {
+    ErrorList *error_list;
+    int fd;                 // Descriptor to read from, -1 if none
+    FILE *file;             // Stream to read from, NULL if none
+    char *buffer;           // Refill buffer, NULL when lexing a caller's buffer in place
+    size_t buffer_capacity; // Size of buffer, grows only to fit a single long token
+    const char *data;       // First byte currently available
+    const char *cursor;     // Next byte to examine
+    const char *end;        // One past the last available byte
+    long data_offset;       // Source offset of data[0]
+    int input_exhausted;    // No bytes will arrive after end
+    int line_number;
+    int column_number;
+    int has_content;        // Whether anything other than spaces, tabs and newlines was seen
+    int ends_with_newline;  // Whether the last byte read so far is '\n'
+    int finished;           // EOF was delivered or lexing failed
+    int partial;            // Lexing one chunk of a larger buffer, stop at end without an EOF token
+    int reached_end;        // A partial lexer got through its whole chunk
+    InternTable *symbol_table; // Table identifiers are interned into, NULL to leave them as NO_SYMBOL
+} Lexer;
+
+// An edit replaced removed_length bytes at start with inserted_length new bytes
+typedef struct {
+    size_t start;
+    size_t removed_length;
+    size_t inserted_length;
+} SourceEdit;
+
+// The returned stream's lexemes point into input, which must outlive the stream
 extern TokenStream *get_token_stream_from_input_file(char *input, ErrorList *error_list);
+extern TokenStream *get_token_stream_from_path(const char *path, ErrorList *error_list);
+extern int lex_into_token_stream(TokenStream *token_stream, const char *input, size_t length, ErrorList *error_list);
+
+// lex_into_token_stream on up to thread_count threads. The input is split into
+// chunks at newlines, where no token can be open, and each chunk is lexed on its
+// own with its own symbols and errors, which are then joined in source order. The
+// tokens, symbol IDs and errors are exactly those lex_into_token_stream gives.
+extern int lex_into_token_stream_parallel(TokenStream *token_stream, const char *input, size_t length,
+                                          ErrorList *error_list, int thread_count);
+
+// Lex length bytes of input into queue for a consumer on another thread, closing
+// it as finished once EOF is published. Identifiers are left as NO_SYMBOL for the
+// consumer to intern, error_list must be this thread's own. Returns 0 if the
+// input holds no tokens, lexing stopped before EOF or the consumer cancelled.
+extern int lex_into_token_queue(TokenQueue *queue, const char *input, size_t length, ErrorList *error_list);
+
+// Bring token_stream, lexed from the source before edit, up to date with the edited
+// input by re-lexing from the start of the edited line until the tokens line up
+// with the previous ones again. previous_errors are the lexer errors of the previous
+// source (NULL if none); those outside the re-lexed range are carried over, moved,
+// into error_list. On failure the stream is left empty and the next call lexes it whole.
+extern int relex_token_stream(TokenStream *token_stream, const char *input, size_t length, SourceEdit edit,
+                              ErrorList *previous_errors, ErrorList *error_list, TokenEdit *token_edit);
+
+extern Lexer *create_lexer_from_buffer(const char *input, size_t length, ErrorList *error_list);
+// chunk_size of 0 selects DEFAULT_LEXER_CHUNK_SIZE
+extern Lexer *create_lexer_from_fd(int fd, size_t chunk_size, ErrorList *error_list);
+extern Lexer *create_lexer_from_file(FILE *file, size_t chunk_size, ErrorList *error_list);
+extern void free_lexer(Lexer *lexer);
+
+// Produce the next token, returns 0 once EOF has been delivered or when the input holds no tokens
+extern int lexer_next_token(Lexer *lexer, Token *token);
+
+// Lexeme of the token lexer_next_token just returned, valid until the next call
+extern const char *lexer_get_lexeme(Lexer *lexer, Token *token, int *length);
 
-#endif
\ No newline at end of file
+#endif
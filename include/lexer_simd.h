@@ -0,0 +1,23 @@
+#ifndef LEXER_SIMD_H
+#define LEXER_SIMD_H
+
+#include <stddef.h>
+
+// Vectorised scanning kernels used by the lexer's hot loops. Each kernel looks at
+// [cursor, end) and never reads past end. The implementation (AVX2, SSE2 or scalar)
+// is picked once at startup from the CPU features; setting DSL_LEXER_SIMD to
+// "avx2", "sse2" or "scalar" forces a particular one.
+
+// Number of leading ' ' and '\t' bytes
+extern size_t scan_spaces(const char *cursor, const char *end);
+
+// Number of leading [A-Za-z0-9_] bytes
+extern size_t scan_word(const char *cursor, const char *end);
+
+// Pointer to the first '\n', or end if there is none
+extern const char *find_newline(const char *cursor, const char *end);
+
+// Name of the implementation in use
+extern const char *lexer_simd_implementation();
+
+#endif
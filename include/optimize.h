@@ -0,0 +1,33 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "errors.h"
+#include "parser.h"
+
+// What one optimize_ast call did
+typedef struct
+{
+    uint32_t nodes_before;
+    uint32_t nodes_after;
+    uint32_t folded;               // Operators replaced by their constant result
+    uint32_t propagated;           // Variable reads replaced by the constant the variable holds
+    uint32_t branches_pruned;      // if/else arms that can never run
+    uint32_t loops_removed;        // while loops whose condition is constant false
+    uint32_t statements_removed;   // Statements after a return
+    int skipped;                   // Nesting too deep to optimize, the AST was left as it was
+} OptimizationReport;
+
+// Rewrite ast in place. Constant integer and boolean subexpressions become CONSTANT
+// nodes, with the VM's wrapping arithmetic; division by a constant zero is left for
+// run time. Variables defined or assigned a constant are replaced by it wherever no
+// other assignment can reach. An if whose condition is constant keeps only the arm
+// that runs, a while whose condition is constant false is dropped, and statements
+// after a return are dropped. The nodes are rebuilt in the same post-order layout.
+// The parse segments no longer apply, so a later reparse parses everything again.
+extern int optimize_ast(AST *ast, OptimizationReport *report, ErrorList *error_list);
+
+extern void print_optimization_report(OptimizationReport *report, FILE *file);
+
+#endif
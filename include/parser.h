@@ -1,49 +1,128 @@
 #ifndef PARSER_H
 #define PARSER_H
 
+#include <stdint.h>
 #include "token.h"
 #include "errors.h"
 
+#define AST_NO_NODE UINT32_MAX
+
+// Fewest tokens worth handing to a parsing thread of its own
+#define MIN_PARALLEL_PARSER_TOKENS 32768
+
+// Node types. Each grammar tail production is folded into the node that owns it,
+// so an operator chain like a + b * c becomes BINARY_EXPRESSION nodes only.
+// The main token of each node (see ASTNode.token) is noted alongside.
 typedef enum
 {
-    FUNCTION,
-    FUNCTION_LIST,
-    FUNCTION_PARAMETERS,
-    STATEMENT,
-    STATEMENT_LIST,
-    TYPE,
-    IDENTIFIER,
-    IDENTIFIER_DECLARATION,
-    IDENTIFIER_DEFINITION,
-    BOOL_VALUE,
-    CONDITIONAL,
-    OPTIONAL_ELSE,
-    EXPRESSION,
-    LOGICAL_EXPRESSION,
-    LOGICAL_EXPRESSION_TAIL,
-    RELATIONAL_EXPRESSION,
-    RELATIONAL_EXPRESSION_TAIL,
-    ADDITIVE_EXPRESSION,
-    ADDITIVE_EXPRESSION_TAIL,
-    MULTIPLICATIVE_EXPRESSION,
-    MULTIPLICATIVE_EXPRESSION_TAIL,
-    TERM,
-    GPIO_OPERATION,
-    GPIO_VALUES,
-    GPIO_PIN,
-    WHILE_LOOP,
-    RETURN_STATEMENT
+    FUNCTION_LIST,          // Children: FUNCTION...
+    FUNCTION,               // Name; return type keyword is the token before it. Children: FUNCTION_PARAMETERS, STATEMENT_LIST
+    FUNCTION_PARAMETERS,    // '('. Children: IDENTIFIER_DECLARATION...
+    STATEMENT_LIST,         // '{'. Children: statements
+    IDENTIFIER_DECLARATION, // Name; type keyword is the token before it. No children
+    IDENTIFIER_DEFINITION,  // Name; type keyword is the token before it. Children: value
+    ASSIGNMENT,             // Name. Children: value
+    CONDITIONAL,            // 'if'. Children: condition, STATEMENT_LIST, optional else STATEMENT_LIST
+    WHILE_LOOP,             // 'while'. Children: condition, STATEMENT_LIST
+    RETURN_STATEMENT,       // 'return'. Children: value
+    EXPRESSION_STATEMENT,   // First token of the expression. Children: expression
+    GPIO_OPERATION,         // SET_PIN or READ_PIN. Children: GPIO_PIN, and GPIO_VALUES for SET_PIN
+    GPIO_PIN,               // Pin number. No children
+    GPIO_VALUES,            // HIGH or LOW. No children
+    BINARY_EXPRESSION,      // Operator. Children: left, right
+    UNARY_EXPRESSION,       // '!' or '-'. Children: operand
+    CALL_EXPRESSION,        // Callee name. Children: arguments
+    IDENTIFIER,             // Name. No children
+    NUMBER_LITERAL,         // Number. No children
+    BOOL_VALUE,             // true or false. No children
+    CONSTANT,               // Value the optimizer folded an expression to; that expression's main token. No children
+    AST_NODE_TYPE_COUNT
 } ASTNodeType;
 
-// Structure for AST nodes
-typedef struct ASTNode
+// Nodes are addressed by 32-bit index into AST.nodes. A node's children are the
+// num_children entries of AST.children starting at first_child.
+typedef struct
 {
-    ASTNodeType type;          // Node type (e.g., "expression", "statement")
-    struct ASTNode **children; // Array of child nodes
-    int num_children;          // Number of children
+    uint8_t type;          // ASTNodeType
+    uint32_t token;        // Index of the node's main token in the token stream
+    union
+    {
+        uint32_t first_child; // Offset of the first child index in AST.children
+        int32_t value;        // Of a CONSTANT, which has no children
+    };
+    uint32_t num_children; // Number of children
 } ASTNode;
 
-// Parser function
-extern ASTNode *parse_token_stream(TokenStream *token_stream, ErrorList *error_list);
+// Where one top-level parse attempt (a function, or a broken one and the tokens
+// skipped after it) starts. The results of an attempt depend only on the tokens
+// from its start up to the next attempt's, which is what lets a reparse keep it.
+typedef struct
+{
+    uint32_t token; // First token
+    uint32_t node;  // First node created
+    uint32_t child; // First child index created
+    uint32_t error; // Errors reported before it by this parse
+} ParseSegment;
+
+// Flat node pool. Nodes are appended once complete, so every node comes after its
+// children and each function's subtree occupies one contiguous run of nodes.
+typedef struct
+{
+    ASTNode *nodes;
+    uint32_t node_count;
+    uint32_t node_capacity;
+    uint32_t *children;         // Child node indices, one contiguous range per node
+    uint32_t child_count;
+    uint32_t child_capacity;
+    ParseSegment *segments;     // Top-level attempts in order, closed by one at the EOF token
+    uint32_t segment_count;
+    uint32_t segment_capacity;
+    uint32_t root;              // FUNCTION_LIST node, AST_NO_NODE before parsing
+    TokenStream *token_stream;  // Stream the node tokens index into
+    Arena *arena;               // Arena the pool lives in, NULL for the heap
+} AST;
+
+static inline ASTNode *get_ast_node(AST *ast, uint32_t index)
+{
+    return &ast->nodes[index];
+}
+
+static inline uint32_t get_ast_child(AST *ast, uint32_t index, uint32_t child)
+{
+    return ast->children[ast->nodes[index].first_child + child];
+}
+
+// The AST comes from the token stream's arena (the heap when it has none) and
+// refers to the stream, which must outlive it. Syntax errors are recovered from
+// at statement and function level and reported to error_list; NULL is returned
+// only if the stream is unusable or memory runs out.
+extern AST *parse_token_stream(TokenStream *token_stream, ErrorList *error_list);
+
+// parse_token_stream on up to thread_count threads. A pass over the token types
+// cuts the stream into ranges at top-level function starts, found by brace depth,
+// and each range is parsed on its own thread. The ranges are joined in order,
+// with their errors, into the AST and diagnostics parse_token_stream gives: a range
+// is only used if the parse before it ends exactly where it starts, and the rest
+// is parsed sequentially otherwise. Unbalanced braces parse it all sequentially.
+extern AST *parse_token_stream_parallel(TokenStream *token_stream, ErrorList *error_list, int thread_count);
+
+// Appends at least one token to token_stream, or returns 0 once there are no more
+typedef int (*TokenFeed)(void *feed_state, TokenStream *token_stream);
+
+// Parse tokens while they are still being lexed: whenever the parse looks past
+// the end of token_stream, feed appends more. If the feed runs out before EOF the
+// parse is abandoned and NULL returned without an error, the lexer has reported
+// why. expected_tokens sizes the AST up front.
+extern AST *parse_token_feed(TokenStream *token_stream, int expected_tokens, TokenFeed feed, void *feed_state,
+                             ErrorList *error_list);
+
+// Bring ast up to date after relex_token_stream edited its token stream in place.
+// Top-level attempts before the edit are kept where they are, those after it are
+// moved once the reparse lines up with one of them, and only the rest is parsed.
+// previous_errors must hold just the errors of the parse that built ast, the ones
+// still standing are carried over into error_list. On failure ast must be freed.
+extern int reparse_token_stream(AST *ast, const TokenEdit *edit, ErrorList *previous_errors, ErrorList *error_list);
+extern void free_ast(AST *ast);
+extern const char *ast_node_type_to_string(ASTNodeType type);
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,38 @@
+#ifndef REGALLOC_H
+#define REGALLOC_H
+
+#include <stdint.h>
+#include "errors.h"
+#include "ir.h"
+
+#define REGALLOC_NO_LOCATION UINT32_MAX
+#define REGALLOC_SPILLED 0x80000000u  // Set in the location of a value kept in a stack slot, the slot number below it
+
+typedef struct
+{
+    uint32_t registers_used;
+    uint32_t spill_slots;
+    uint32_t spilled_values;
+} FunctionAllocation;
+
+// Where every IR value lives
+typedef struct RegisterAllocation
+{
+    uint32_t *locations;            // A register number or REGALLOC_SPILLED | slot, REGALLOC_NO_LOCATION for no value
+    FunctionAllocation *functions;  // One per IR function
+    uint32_t function_count;
+    uint32_t register_count;        // Registers there were to give out
+} RegisterAllocation;
+
+// Linear scan over each function's instructions in layout order. A value lives from
+// its definition to its last use, and across the whole of any loop it is live into.
+// When every register is taken, the value used least often, counting each use ten
+// times per enclosing loop, goes to a stack slot, so loop variables keep theirs.
+// Registers are not saved around calls; the code generator using this saves them.
+extern RegisterAllocation *allocate_registers(IRProgram *program, uint32_t register_count);
+extern void free_register_allocation(RegisterAllocation *allocation);
+
+// Check that no two values live at the same time share a register or a spill slot
+extern int verify_register_allocation(IRProgram *program, RegisterAllocation *allocation, ErrorList *error_list);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef SEMANTIC_H
+#define SEMANTIC_H
+
+#include <stdint.h>
+#include "errors.h"
+#include "parser.h"
+
+// Types an expression can have. TYPE_ERROR is given to anything already reported,
+// operators accept it silently so one mistake is not reported again by every
+// expression around it.
+typedef enum
+{
+    TYPE_NONE,   // Not an expression
+    TYPE_ERROR,
+    TYPE_INT,
+    TYPE_BOOL
+} ValueType;
+
+// Resolve every name in ast and type-check it, reporting to error_list at the
+// SEMANTIC stage. Functions may be called before they are defined; variables are
+// visible from their declaration to the end of their block, may shadow those of
+// enclosing blocks but not be declared twice in one. Arithmetic takes ints,
+// comparisons ints and give bool, == and != take two of the same type, logic
+// operators take bools, READ_PIN gives bool. Initial and assigned values must have
+// the variable's type, conditions must be bool and returned values the function's
+// type, calls must pass as many arguments of the parameter types. Returns 1 if
+// nothing was reported. The AST is only read, it must not have been optimized.
+extern int check_semantics(AST *ast, ErrorList *error_list);
+
+extern const char *value_type_to_string(ValueType type);
+
+#endif
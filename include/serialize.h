@@ -0,0 +1,109 @@
+#ifndef SERIALIZE_H
+#define SERIALIZE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "errors.h"
+#include "token.h"
+#include "parser.h"
+
+#define SERIALIZED_FILE_MAGIC "DSLF"
+#define SERIALIZED_FILE_VERSION 1
+
+// Set in SerializedHeader.flags when the file holds an AST after the tokens
+#define SERIALIZED_HAS_AST 1u
+
+// Binary form of a token stream and optionally its AST, for tools that consume
+// front-end output. Everything is little-endian and every section starts on an
+// 8-byte boundary at the offset the header gives, so a mapped file is used in
+// place: the records below are read straight out of the mapping.
+//
+//   header | source bytes | symbol names | symbols | tokens | nodes | children
+typedef struct {
+    char magic[4];            // SERIALIZED_FILE_MAGIC
+    uint32_t version;         // SERIALIZED_FILE_VERSION, readers reject any other
+    uint32_t header_size;     // sizeof(SerializedHeader) for this version
+    uint32_t flags;
+    uint64_t file_size;
+    uint64_t source_offset;   // Source text the token offsets point into
+    uint64_t source_size;
+    uint64_t names_offset;    // String table: every symbol name back to back, not NUL-terminated
+    uint64_t names_size;
+    uint64_t symbols_offset;  // SerializedSymbol per symbol ID
+    uint64_t tokens_offset;   // SerializedToken per token
+    uint64_t nodes_offset;    // SerializedNode per AST node
+    uint64_t children_offset; // uint32_t child node indices
+    uint32_t symbol_count;
+    uint32_t token_count;
+    uint32_t node_count;
+    uint32_t child_count;
+    uint32_t root;            // FUNCTION_LIST node, AST_NO_NODE without an AST
+    uint32_t reserved;
+} SerializedHeader;
+
+typedef struct {
+    uint32_t name_offset;     // Into the string table
+    uint32_t name_length;
+} SerializedSymbol;
+
+typedef struct {
+    uint32_t offset;          // Lexeme position in the source section
+    uint32_t length;
+    uint32_t line;
+    uint32_t column;
+    uint32_t symbol;          // Symbol ID of an identifier, NO_SYMBOL otherwise
+    uint8_t type;             // TokenType
+    uint8_t reserved[3];
+} SerializedToken;
+
+typedef struct {
+    uint32_t token;           // As in ASTNode
+    uint32_t first_child;     // The value of a CONSTANT
+    uint32_t num_children;
+    uint8_t type;             // ASTNodeType
+    uint8_t reserved[3];
+} SerializedNode;
+
+// A serialized file mapped read-only, with pointers to its sections
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+    const SerializedHeader *header;
+    const char *source;
+    const char *names;
+    const SerializedSymbol *symbols;
+    const SerializedToken *tokens;
+    const SerializedNode *nodes;    // NULL without an AST
+    const uint32_t *children;
+} SerializedFile;
+
+// Write token_stream, and ast unless it is NULL, to path
+extern int write_serialized_file(const char *path, TokenStream *token_stream, AST *ast, ErrorList *error_list);
+
+// Map path and check its header and section bounds, which costs the same for any
+// file size. The records themselves are trusted; verify_serialized_file checks
+// every index in them for files that may come from elsewhere.
+extern SerializedFile *open_serialized_file(const char *path, ErrorList *error_list);
+extern int verify_serialized_file(SerializedFile *file, ErrorList *error_list);
+extern void close_serialized_file(SerializedFile *file);
+
+static inline const char *get_serialized_lexeme(SerializedFile *file, uint32_t index, int *length)
+{
+    const SerializedToken *token = &file->tokens[index];
+    if (token->type == TOKEN_EOF)
+    {
+        *length = 3;
+        return "EOF";
+    }
+
+    *length = (int)token->length;
+    return file->source + token->offset;
+}
+
+static inline const char *get_serialized_symbol_name(SerializedFile *file, uint32_t symbol, int *length)
+{
+    *length = (int)file->symbols[symbol].name_length;
+    return file->names + file->symbols[symbol].name_offset;
+}
+
+#endif
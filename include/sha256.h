@@ -0,0 +1,21 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHA256_DIGEST_SIZE 32
+
+// Incremental SHA-256 (FIPS 180-4), feed the message in any number of pieces
+typedef struct {
+    uint32_t state[8];
+    uint64_t length;       // Bytes hashed so far
+    unsigned char block[64];
+    size_t block_size;     // Bytes waiting in block
+} Sha256;
+
+extern void sha256_init(Sha256 *sha);
+extern void sha256_update(Sha256 *sha, const void *data, size_t length);
+extern void sha256_final(Sha256 *sha, unsigned char digest[SHA256_DIGEST_SIZE]);
+
+#endif
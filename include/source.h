@@ -0,0 +1,17 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stddef.h>
+#include "errors.h"
+
+// Read-only view of a source file. The bytes are NOT NUL-terminated.
+typedef struct {
+    const char *data;  // First byte of the source (NULL for an empty file)
+    size_t length;     // Number of bytes in the source
+    int is_mapped;     // 1 if data is an mmap'd view of the file
+} SourceBuffer;
+
+extern SourceBuffer *open_source_file(const char *path, ErrorList *error_list);
+extern void close_source_file(SourceBuffer *source);
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef TARGET_H
+#define TARGET_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "errors.h"
+#include "gpio.h"
+
+#define TARGET_MAX_PORTS 32
+#define TARGET_NO_PORT 0xFF
+#define TARGET_NAME_LENGTH 64
+#define TARGET_DEFAULT_REGISTERS 12
+#define TARGET_MAX_REGISTERS 1024
+
+// Classes of operation the timing analysis charges cycles for
+typedef enum
+{
+    TARGET_COST_CONSTANT,    // Loading a literal
+    TARGET_COST_ARITHMETIC,  // +, - and negation
+    TARGET_COST_MULTIPLY,
+    TARGET_COST_DIVIDE,
+    TARGET_COST_COMPARE,
+    TARGET_COST_LOGIC,       // !, and the combining step of && and ||
+    TARGET_COST_MOVE,        // Storing a variable or passing an argument
+    TARGET_COST_BRANCH,      // Any jump, taken or not
+    TARGET_COST_CALL,
+    TARGET_COST_RETURN,
+    TARGET_COST_SET_PIN,
+    TARGET_COST_READ_PIN,
+    TARGET_COST_COUNT
+} TargetCost;
+
+// One GPIO port of the target. Writing a mask to set_register drives those pins
+// high and writing one to clear_register drives them low. A port without a clear
+// register has a plain output register in set_register, updated read-modify-write.
+typedef struct
+{
+    char name[TARGET_NAME_LENGTH];            // An identifier
+    char set_register[TARGET_NAME_LENGTH];    // C lvalues, e.g. GPIOA->BSRR
+    char clear_register[TARGET_NAME_LENGTH];  // Empty when there is none
+    char input_register[TARGET_NAME_LENGTH];
+} TargetPort;
+
+// How the C backend reaches the pins of a microcontroller
+typedef struct
+{
+    char header[TARGET_NAME_LENGTH];       // Included by the generated code to declare the registers, empty for none
+    TargetPort ports[TARGET_MAX_PORTS];
+    uint32_t port_count;
+    uint8_t pin_ports[GPIO_PIN_COUNT];     // Port of each pin, TARGET_NO_PORT if it is not wired to one
+    uint8_t pin_bits[GPIO_PIN_COUNT];      // Bit of the pin in its port's registers
+    int cache_reads;                       // Inputs are stable for a straight-line block, so one read of a port serves it
+    uint32_t register_count;               // General-purpose registers the register allocator may hand out
+    uint32_t cycle_costs[TARGET_COST_COUNT]; // Worst-case cycles of each class of operation
+} TargetConfig;
+
+// A target with no ports, TARGET_DEFAULT_REGISTERS registers and the cycle costs
+// of a small in-order core without a hardware divider
+extern TargetConfig *create_target_config();
+// Pins 8n to 8n+7 are bits 0 to 7 of port PORTn, with registers PORTn_SET,
+// PORTn_CLEAR and PORTn_IN, and reads are not cached
+extern TargetConfig *create_default_target_config();
+extern void free_target_config(TargetConfig *target);
+
+// Read a target description into target, one directive per line and '#' starting
+// a comment:
+//   header FILE                      #include FILE in the generated code, quoted unless it is in <>
+//   port NAME SET CLEAR|- INPUT      registers of a port, '-' for no clear register
+//   pins FIRST LAST PORT BIT         pins FIRST to LAST are bits BIT onwards of PORT
+//   cache-reads yes|no
+//   registers N                      registers to allocate IR values to, at most TARGET_MAX_REGISTERS
+//   cycles CLASS N                   each operation of CLASS (see target_cost_to_string) takes N cycles
+extern int load_target_config(TargetConfig *target, FILE *file, const char *name, ErrorList *error_list);
+
+// Name of a cost class in target files, e.g. "set-pin"
+extern const char *target_cost_to_string(TargetCost cost);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <pthread.h>
+
+#define DEFAULT_WORKER_QUEUE_CAPACITY 64
+
+typedef void (*ThreadPoolFunction)(void *argument);
+
+typedef struct
+{
+    ThreadPoolFunction function;
+    void *argument;
+} ThreadPoolTask;
+
+// Double-ended task queue owned by one worker. The owner pushes and pops at the
+// bottom, idle workers steal the oldest task from the top.
+typedef struct
+{
+    pthread_mutex_t lock;
+    ThreadPoolTask *tasks;  // Ring buffer of capacity tasks
+    int capacity;
+    int top;                // Index of the oldest task
+    int size;
+} WorkerQueue;
+
+// Fixed set of worker threads with one queue each. Tasks submitted from outside the
+// pool are dealt round-robin across the queues, tasks submitted by a worker go on
+// its own queue, and a worker whose queue runs dry steals from the others.
+typedef struct
+{
+    pthread_t *threads;
+    WorkerQueue *queues;
+    int thread_count;
+    pthread_mutex_t lock;           // Guards the fields below
+    pthread_cond_t work_available;  // Signalled when a task is queued or the pool shuts down
+    pthread_cond_t all_done;        // Signalled when the last pending task finishes
+    int queued;                     // Tasks sitting in queues
+    int pending;                    // Tasks submitted and not yet finished
+    int next_queue;                 // Queue the next outside submission goes to
+    int shutting_down;
+} ThreadPool;
+
+extern ThreadPool *create_thread_pool(int thread_count);
+extern int submit_thread_pool_task(ThreadPool *pool, ThreadPoolFunction function, void *argument);
+
+// Block until every submitted task, including tasks those tasks submitted, has finished
+extern void wait_thread_pool(ThreadPool *pool);
+
+// Finish the queued tasks, then stop and release the workers
+extern void free_thread_pool(ThreadPool *pool);
+
+// Number of processors online, at least 1
+extern int get_processor_count();
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef TIME_REPORT_H
+#define TIME_REPORT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "arena.h"
+
+#define TIME_REPORT_MAX_PHASES 16
+
+// What one phase of a compilation cost
+typedef struct
+{
+    const char *name;            // Static string, e.g. "lex"
+    const char *unit;            // What items counts, e.g. "tokens", NULL when nothing is counted
+    uint64_t items;
+    uint64_t nanoseconds;        // Monotonic wall time
+    uint64_t allocations;        // Requests made through the arena allocators by the phase's thread
+    uint64_t allocated_bytes;
+    long peak_rss_kb;            // Peak resident set of the whole process when the phase ended
+} PhaseTiming;
+
+// Phases of one compilation in the order they ran. Phases must not nest, and
+// each must run on one thread. Nothing is measured unless enabled is set.
+typedef struct
+{
+    int enabled;
+    PhaseTiming phases[TIME_REPORT_MAX_PHASES];
+    uint32_t phase_count;
+    uint64_t started;                       // Clock reading when the open phase began
+    ArenaStatistics started_statistics;     // Allocator counts when the open phase began
+} TimeReport;
+
+extern void begin_phase(TimeReport *report, const char *name);
+// Close the open phase, which handled items of unit (NULL for none)
+extern void end_phase(TimeReport *report, uint64_t items, const char *unit);
+
+// A table with one row per phase and a total row
+extern void print_time_report(TimeReport *report, FILE *file);
+// One JSON object for the file at path, with its phases and their totals
+extern void print_time_report_json(TimeReport *report, const char *path, int succeeded, FILE *file);
+
+#endif
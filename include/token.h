@@ -1,6 +1,11 @@
 #ifndef TOKEN_H
 #define TOKEN_H
 
+#include <stdint.h>
+#include "source.h"
+#include "arena.h"
+#include "intern.h"
+
 #define DEFAULT_TOKEN_STREAM_CAPACITY 128
 
 // Enum for token types
@@ -18,6 +23,7 @@ typedef enum
     TOKEN_READ_PIN,
     TOKEN_HIGH,
     TOKEN_LOW,
+    TOKEN_RETURN,
 
     // Identifiers and literals
     TOKEN_IDENTIFIER,
@@ -52,24 +58,68 @@ typedef enum
     TOKEN_ERROR
 } TokenType;
 
-// Structure for a token
+// By-value view of a single token, the lexeme is a slice of the token stream's source buffer
 typedef struct
 {
     TokenType type; // Type of the token
-    char *lexeme;   // The actual string value of the token
+    int offset;     // Byte offset of the lexeme in the source buffer
+    int length;     // Length of the lexeme in bytes
     int line;       // Line number where the token appears
     int column;     // Column number where the token starts
+    uint32_t symbol; // Interned name of an identifier, NO_SYMBOL for every other token
 } Token;
 
+// Result of re-lexing an edited source in place: tokens [first, old_end) of the
+// previous stream were replaced by [first, new_end). Every token from new_end on is
+// a previous token moved by line_delta lines, and by column_delta columns if it was
+// on resync_line, the line of the first token that lined up again.
+typedef struct
+{
+    int first;
+    int old_end;
+    int new_end;
+    int line_delta;
+    int column_delta;
+    int resync_line;
+} TokenEdit;
+
+// Move a position that came after the edit to where it is now
+static inline void shift_position_past_edit(const TokenEdit *edit, int *line, int *column)
+{
+    if (*line == edit->resync_line)
+    {
+        *column += edit->column_delta;
+    }
+    *line += edit->line_delta;
+}
+
+// Tokens are stored as parallel arrays, so scanning the types for lookahead
+// touches one byte per token and freeing does not depend on the token count
 typedef struct {
-    Token ** tokens;
+    uint8_t *types;             // Packed TokenType of each token
+    int *lines;                 // Line number of each token
+    int *columns;               // Column number of each token
+    int *offsets;               // Byte offset of each lexeme in source
+    int *lengths;               // Length of each lexeme in bytes
+    uint32_t *symbols;          // Symbol ID of each identifier, NO_SYMBOL for other tokens
+    InternTable *symbol_table;  // Names behind the symbol IDs, owned by the stream
+    const char *source;         // Buffer the token lexemes point into (not owned unless mapped_source is set)
+    SourceBuffer *mapped_source; // Source file owned by the stream, released with it
+    Arena *arena;               // Arena the arrays live in, NULL for the heap
     int capacity;
     int size;
 } TokenStream;
 
-extern int add_new_token(TokenStream *token_stream, TokenType token_type, char *string, int line, int column);
-extern TokenStream *create_new_token_stream();
+extern int add_new_token(TokenStream *token_stream, TokenType token_type, int offset, int length, int line, int column, uint32_t symbol);
+// With an arena the stream lives in it and is released with it, free_token_stream only unmaps the source
+extern TokenStream *create_new_token_stream(Arena *arena);
+extern int reserve_token_stream(TokenStream *token_stream, int capacity);
+// Replace tokens [first, old_end) with count tokens, moving the later tokens by offset_delta bytes and as the edit says
+extern int replace_token_range(TokenStream *token_stream, int first, int old_end, const Token *tokens, int count,
+                               int offset_delta, const TokenEdit *edit);
 extern void free_token_stream(TokenStream *token_stream);
+extern Token get_token(TokenStream *token_stream, int index);
+extern const char *get_token_lexeme(TokenStream *token_stream, int index, int *length);
 extern const char *token_type_to_string(TokenType type);
 
 #endif // TOKEN_H
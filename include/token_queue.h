@@ -0,0 +1,60 @@
+#ifndef TOKEN_QUEUE_H
+#define TOKEN_QUEUE_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "token.h"
+
+#define TOKEN_BATCH_SIZE 64
+#define DEFAULT_TOKEN_QUEUE_BATCHES 256
+#define CACHE_LINE_SIZE 64
+
+// Aligned so no two batches share a cache line
+typedef struct
+{
+    _Alignas(CACHE_LINE_SIZE) Token tokens[TOKEN_BATCH_SIZE];
+    uint32_t count;
+} TokenBatch;
+
+// How the producer ended
+typedef enum
+{
+    TOKEN_QUEUE_OPEN,
+    TOKEN_QUEUE_FINISHED,   // Every token up to EOF was published
+    TOKEN_QUEUE_FAILED      // The producer stopped before EOF
+} TokenQueueState;
+
+// Lock-free ring of token batches between one producing and one consuming
+// thread. Each side owns one index and only reads the other's, the indices sit on
+// cache lines of their own, and a batch is published or released whole, so the
+// two threads touch shared lines once per TOKEN_BATCH_SIZE tokens. A full ring
+// holds the producer back and an empty one the consumer, both by yielding.
+typedef struct
+{
+    TokenBatch *batches;
+    uint32_t capacity;                                     // Batches, a power of two
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint32_t head;       // Next batch to consume, written by the consumer
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint32_t tail;       // Next batch to publish, written by the producer
+    _Atomic int state;                                     // TokenQueueState, set after the last publish
+    _Alignas(CACHE_LINE_SIZE) _Atomic int cancelled;       // Set by the consumer to stop the producer
+} TokenQueue;
+
+// capacity is rounded up to a power of two, 0 selects DEFAULT_TOKEN_QUEUE_BATCHES
+extern TokenQueue *create_token_queue(uint32_t capacity);
+extern void free_token_queue(TokenQueue *queue);
+
+// Producer: the batch to fill next, waiting while the ring is full. NULL once the consumer cancelled.
+extern TokenBatch *reserve_token_batch(TokenQueue *queue);
+// Producer: hand over the reserved batch, with its count set
+extern void publish_token_batch(TokenQueue *queue);
+// Producer: say how it ended, after the last publish
+extern void close_token_queue(TokenQueue *queue, TokenQueueState state);
+
+// Consumer: the oldest published batch, waiting while the ring is empty. NULL
+// once the producer closed the queue and every batch is consumed.
+extern TokenBatch *next_token_batch(TokenQueue *queue);
+extern void release_token_batch(TokenQueue *queue);
+// Consumer: stop the producer, which then closes the queue as failed
+extern void cancel_token_queue(TokenQueue *queue);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef VERSION_H
+#define VERSION_H
+
+// Part of every compilation cache key: bump it with any change to what the
+// compiler reports or produces, or stale cache entries will be replayed
+#define COMPILER_VERSION "0.15.0"
+
+#endif
@@ -0,0 +1,25 @@
+#ifndef VM_H
+#define VM_H
+
+#include <stdint.h>
+#include "bytecode.h"
+#include "errors.h"
+#include "gpio.h"
+
+#define VM_MAX_CALL_DEPTH 65536
+
+// Outcome of running a program's main
+typedef struct
+{
+    int32_t result;   // What main returned
+    uint64_t cycles;  // Instructions executed, the simulation's clock
+} VMResult;
+
+// Run main with pin operations going to bank. Execution stops with a runtime
+// error, reported to error_list, on division by zero, on running out of call
+// stack, or once max_cycles instructions have run (0 for no limit), noticed at
+// the next taken jump.
+extern int run_bytecode_program(BytecodeProgram *program, PinBank *bank, uint64_t max_cycles, VMResult *result,
+                                ErrorList *error_list);
+
+#endif
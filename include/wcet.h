@@ -0,0 +1,69 @@
+#ifndef WCET_H
+#define WCET_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "errors.h"
+#include "parser.h"
+#include "target.h"
+
+// Where the iteration bound of a while loop came from
+typedef enum
+{
+    LOOP_UNBOUNDED,   // Neither inferred nor annotated
+    LOOP_INFERRED,    // Counter compared against a constant and stepped by a constant
+    LOOP_ANNOTATED    // A '# @bound N' comment, used when it is lower than what was inferred
+} LoopBoundSource;
+
+typedef struct
+{
+    uint32_t token;       // The 'while'
+    uint64_t bound;       // Most times the body runs
+    uint8_t source;       // LoopBoundSource
+} LoopTiming;
+
+// Why a function has no worst case
+typedef enum
+{
+    TIMING_BOUNDED,
+    TIMING_UNBOUNDED_LOOP,      // reason_token is a while loop without a bound
+    TIMING_RECURSIVE,           // reason_token is a call that can come back to the caller
+    TIMING_UNBOUNDED_CALLEE     // reason_token is a call to a function without a worst case
+} TimingStatus;
+
+typedef struct
+{
+    uint32_t symbol;
+    uint64_t cycles;          // Worst case, saturating at UINT64_MAX; meaningless unless status is TIMING_BOUNDED
+    uint8_t status;           // TimingStatus
+    uint32_t reason_token;
+    uint32_t first_loop;      // Its loops are loops[first_loop] onwards, in source order
+    uint32_t loop_count;
+} FunctionTiming;
+
+typedef struct
+{
+    FunctionTiming *functions;  // In source order
+    uint32_t function_count;
+    LoopTiming *loops;
+    uint32_t loop_count;
+    TokenStream *token_stream;  // The analysed program's tokens, for names and lines
+} TimingReport;
+
+// Worst-case cycles of every function, with the target's cycle cost of each
+// operation. Every path is assumed to run to the end of its function, an if
+// costs its dearer arm and a call its callee's worst case. A while loop runs as
+// often as its bound: one is inferred for a counter compared against a constant
+// and stepped by a constant once per iteration, counting from a constant it is
+// set to just before the loop. Otherwise a '# @bound N' comment on the line of
+// the while or on the lines just above it bounds the loop. The report lives on
+// the heap; NULL is returned if memory runs out or an annotation or call is
+// malformed, which is reported to error_list.
+extern TimingReport *estimate_timing(AST *ast, const TargetConfig *target, ErrorList *error_list);
+extern void free_timing_report(TimingReport *report);
+
+// One line per function, 'name: N cycles' or 'name: unbounded, <reason>', then
+// one indented line per loop with its bound
+extern void print_timing_report(TimingReport *report, FILE *file);
+
+#endif
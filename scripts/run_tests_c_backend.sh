@@ -0,0 +1,42 @@
+#!/bin/bash
+
+# Compile the program
+gcc -I include -o c_backend tests/c_backend/test_c_backend.c src/c_backend.c src/target.c src/parser.c src/semantic.c src/lexer.c src/token_queue.c src/token.c src/errors.c src/source.c src/lexer_simd.c src/arena.c src/intern.c
+if [ $? -ne 0 ]; then
+    echo "Compilation failed. Please fix the errors and try again."
+    exit 1
+fi
+
+# Write each case as C, for the .target next to it or the default target. Output
+# that is C must also build on its own.
+CASES_DIR="tests/c_backend/cases_c_backend"
+EXPECTED_DIR="tests/c_backend/expected_c_backend"
+ACTUAL_DIR="tests/c_backend/actual_c_backend"
+
+mkdir -p "$ACTUAL_DIR"
+
+for i in {1..4}; do
+    TEST_CASE="$CASES_DIR/test_c_backend_$i.txt"
+    EXPECTED_OUTPUT="$EXPECTED_DIR/expected_c_backend_$i.txt"
+    ACTUAL_OUTPUT="$ACTUAL_DIR/actual_c_backend_$i.txt"
+    TARGET=""
+    if [ -f "$CASES_DIR/test_c_backend_$i.target" ]; then
+        TARGET="$CASES_DIR/test_c_backend_$i.target"
+    fi
+
+    echo "Running C Backend Test $i..."
+    ./c_backend $TARGET < "$TEST_CASE" > "$ACTUAL_OUTPUT"
+
+    if ! diff -q "$ACTUAL_OUTPUT" "$EXPECTED_OUTPUT" > /dev/null; then
+        echo "C Backend Test $i FAILED!"
+        echo "Diff:"
+        diff "$ACTUAL_OUTPUT" "$EXPECTED_OUTPUT"
+    elif head -n 1 "$ACTUAL_OUTPUT" | grep -q '^//' &&
+         ! gcc -std=c99 -Wall -Wno-unused-variable -Wno-unused-but-set-variable -Werror -I "$CASES_DIR" \
+               -x c -c "$ACTUAL_OUTPUT" -o /dev/null; then
+        echo "C Backend Test $i FAILED!"
+        echo "Generated C does not build"
+    else
+        echo "C Backend Test $i PASSED!"
+    fi
+done
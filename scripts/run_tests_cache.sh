@@ -0,0 +1,73 @@
+#!/bin/bash
+
+# Compile the test cases without a cache, then twice through a fresh one: a cold
+# run that fills it, a warm run that must replay everything, and a run after an
+# entry is damaged, which must fall back to compiling. Every output must match.
+
+CASES="tests/parser/cases_parser/*.txt tests/lexer/cases_lexer/*.txt"
+ACTUAL_DIR="tests/cache/actual_cache"
+CACHE_DIR=$(mktemp -d)
+trap 'rm -rf "$CACHE_DIR"' EXIT
+
+mkdir -p "$ACTUAL_DIR"
+./compiler $CASES > "$ACTUAL_DIR/uncached.txt"
+
+check_run() {
+    local NAME=$1 EXPECTED_STATS=$2
+    ./compiler --cache-dir "$CACHE_DIR" --cache-stats $CASES > "$ACTUAL_DIR/$NAME.txt" 2> "$ACTUAL_DIR/$NAME.err"
+
+    if diff -q "$ACTUAL_DIR/$NAME.txt" "$ACTUAL_DIR/uncached.txt" > /dev/null && grep -q "$EXPECTED_STATS" "$ACTUAL_DIR/$NAME.err"; then
+        echo "Cache Test $NAME PASSED!"
+    else
+        echo "Cache Test $NAME FAILED!"
+        cat "$ACTUAL_DIR/$NAME.err"
+        diff "$ACTUAL_DIR/$NAME.txt" "$ACTUAL_DIR/uncached.txt"
+    fi
+}
+
+check_run cold " 0 hits"
+check_run warm " 0 misses"
+
+ENTRY=$(ls "$CACHE_DIR"/*.entry | head -n 1)
+printf 'XYZ' | dd of="$ENTRY" bs=1 seek=$(( $(stat -c %s "$ENTRY") - 3 )) conv=notrunc 2> /dev/null
+check_run damaged " 1 misses"
+
+# The same for --emit-c and --emit-binary over copies of the C back end cases: a
+# warm run must write the same .c and .dslb files and print the same report
+# without compiling, and a run for another target must miss
+EMIT_DIR=$(mktemp -d)
+EMIT_CACHE_DIR=$(mktemp -d)
+trap 'rm -rf "$CACHE_DIR" "$EMIT_DIR" "$EMIT_CACHE_DIR"' EXIT
+cp tests/c_backend/cases_c_backend/*.txt tests/c_backend/cases_c_backend/board.h "$EMIT_DIR"
+EMIT_CASES=$(ls "$EMIT_DIR"/*.txt)
+TARGET=tests/c_backend/cases_c_backend/test_c_backend_2.target
+OTHER_TARGET=tests/c_backend/cases_c_backend/test_c_backend_4.target
+
+# Append what the run wrote to its output, then remove it for the next run
+collect_emit_run() {
+    cat "${EMIT_DIR:?}"/*.c "${EMIT_DIR:?}"/*.dslb >> "$1" 2> /dev/null
+    rm -f "${EMIT_DIR:?}"/*.c "${EMIT_DIR:?}"/*.dslb
+}
+
+./compiler --emit-c --emit-binary --target "$TARGET" $EMIT_CASES > "$ACTUAL_DIR/emit_uncached.txt"
+collect_emit_run "$ACTUAL_DIR/emit_uncached.txt"
+
+check_emit_run() {
+    local NAME=$1 EXPECTED_STATS=$2 RUN_TARGET=$3
+    ./compiler --cache-dir "$EMIT_CACHE_DIR" --cache-stats --emit-c --emit-binary --target "$RUN_TARGET" $EMIT_CASES \
+        > "$ACTUAL_DIR/$NAME.txt" 2> "$ACTUAL_DIR/$NAME.err"
+    collect_emit_run "$ACTUAL_DIR/$NAME.txt"
+
+    if grep -q "$EXPECTED_STATS" "$ACTUAL_DIR/$NAME.err" &&
+       { [ "$RUN_TARGET" != "$TARGET" ] || diff -q "$ACTUAL_DIR/$NAME.txt" "$ACTUAL_DIR/emit_uncached.txt" > /dev/null; }; then
+        echo "Cache Test $NAME PASSED!"
+    else
+        echo "Cache Test $NAME FAILED!"
+        cat "$ACTUAL_DIR/$NAME.err"
+        diff "$ACTUAL_DIR/$NAME.txt" "$ACTUAL_DIR/emit_uncached.txt"
+    fi
+}
+
+check_emit_run emit_cold " 0 hits" "$TARGET"
+check_emit_run emit_warm " 0 misses" "$TARGET"
+check_emit_run emit_other_target " 0 hits" "$OTHER_TARGET"
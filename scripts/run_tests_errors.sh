@@ -0,0 +1,30 @@
+#!/bin/bash
+
+# Compile each case with the driver arguments in the .args file next to it, if
+# any, and compare the diagnostics it prints
+CASES_DIR="tests/errors/cases_errors"
+EXPECTED_DIR="tests/errors/expected_errors"
+ACTUAL_DIR="tests/errors/actual_errors"
+
+mkdir -p "$ACTUAL_DIR"
+
+for i in {1..3}; do
+    TEST_CASE="$CASES_DIR/test_errors_$i.txt"
+    EXPECTED_OUTPUT="$EXPECTED_DIR/expected_errors_$i.txt"
+    ACTUAL_OUTPUT="$ACTUAL_DIR/actual_errors_$i.txt"
+    ARGS=""
+    if [ -f "$CASES_DIR/test_errors_$i.args" ]; then
+        ARGS=$(cat "$CASES_DIR/test_errors_$i.args")
+    fi
+
+    echo "Running Errors Test $i..."
+    ./compiler $ARGS "$TEST_CASE" > "$ACTUAL_OUTPUT"
+
+    if diff -q "$ACTUAL_OUTPUT" "$EXPECTED_OUTPUT" > /dev/null; then
+        echo "Errors Test $i PASSED!"
+    else
+        echo "Errors Test $i FAILED!"
+        echo "Diff:"
+        diff "$ACTUAL_OUTPUT" "$EXPECTED_OUTPUT"
+    fi
+done
@@ -0,0 +1,32 @@
+#!/bin/bash
+
+# The benchmark program generator must be deterministic, its valid programs must
+# compile without a diagnostic even when optimized, and its broken ones must not.
+
+GENERATOR="build/bench/generate_program"
+ACTUAL_DIR="tests/generator/actual_generator"
+
+mkdir -p "$ACTUAL_DIR"
+
+for SEED in 1 2 3; do
+    PROGRAM="$ACTUAL_DIR/program_$SEED.txt"
+    $GENERATOR --seed $SEED --size 64K > "$PROGRAM"
+
+    echo "Running Generator Test $SEED..."
+    if $GENERATOR --seed $SEED --size 64K | cmp -s - "$PROGRAM" && ./compiler -O "$PROGRAM" > "$ACTUAL_DIR/output_$SEED.txt" &&
+        [ ! -s "$ACTUAL_DIR/output_$SEED.txt" ]; then
+        echo "Generator Test $SEED PASSED!"
+    else
+        echo "Generator Test $SEED FAILED!"
+        head -n 20 "$ACTUAL_DIR/output_$SEED.txt"
+    fi
+done
+
+echo "Running Generator Test errors..."
+$GENERATOR --seed 1 --size 64K --errors 50 > "$ACTUAL_DIR/program_errors.txt"
+if ! ./compiler "$ACTUAL_DIR/program_errors.txt" > "$ACTUAL_DIR/output_errors.txt" &&
+    grep -q "during stage PARSER" "$ACTUAL_DIR/output_errors.txt"; then
+    echo "Generator Test errors PASSED!"
+else
+    echo "Generator Test errors FAILED!"
+fi
@@ -0,0 +1,37 @@
+#!/bin/bash
+
+# Compile the program
+gcc -I include -o ir tests/ir/test_ir.c src/ir.c src/ir_verify.c src/regalloc.c src/parser.c src/semantic.c src/lexer.c src/token_queue.c src/token.c src/errors.c src/source.c src/lexer_simd.c src/arena.c src/intern.c
+if [ $? -ne 0 ]; then
+    echo "Compilation failed. Please fix the errors and try again."
+    exit 1
+fi
+
+# Lower each case to IR and allocate its registers, with the driver arguments in
+# the .args file next to it if there is one
+CASES_DIR="tests/ir/cases_ir"
+EXPECTED_DIR="tests/ir/expected_ir"
+ACTUAL_DIR="tests/ir/actual_ir"
+
+mkdir -p "$ACTUAL_DIR"
+
+for i in {1..6}; do
+    TEST_CASE="$CASES_DIR/test_ir_$i.txt"
+    EXPECTED_OUTPUT="$EXPECTED_DIR/expected_ir_$i.txt"
+    ACTUAL_OUTPUT="$ACTUAL_DIR/actual_ir_$i.txt"
+    ARGS=""
+    if [ -f "$CASES_DIR/test_ir_$i.args" ]; then
+        ARGS=$(cat "$CASES_DIR/test_ir_$i.args")
+    fi
+
+    echo "Running IR Test $i..."
+    ./ir $ARGS < "$TEST_CASE" > "$ACTUAL_OUTPUT"
+
+    if diff -q "$ACTUAL_OUTPUT" "$EXPECTED_OUTPUT" > /dev/null; then
+        echo "IR Test $i PASSED!"
+    else
+        echo "IR Test $i FAILED!"
+        echo "Diff:"
+        diff "$ACTUAL_OUTPUT" "$EXPECTED_OUTPUT"
+    fi
+done
@@ -0,0 +1,58 @@
+#!/bin/bash
+
+# Lexing a large file on several threads must give what lexing it on one does: the
+# same diagnostics in the same order, error limit included, and the same binary.
+# The inputs are generated programs, valid and with errors, and the lexer cases
+# repeated until they are large enough to be split.
+
+GENERATOR="build/bench/generate_program"
+ACTUAL_DIR="tests/lex_threads/actual_lex_threads"
+
+mkdir -p "$ACTUAL_DIR"
+
+$GENERATOR --seed 1 --size 2M > "$ACTUAL_DIR/program_valid.txt"
+$GENERATOR --seed 2 --size 2M --errors 50 > "$ACTUAL_DIR/program_errors.txt"
+: > "$ACTUAL_DIR/lexer_cases.txt"
+for i in $(seq 1 2000); do
+    cat tests/lexer/cases_lexer/*.txt >> "$ACTUAL_DIR/lexer_cases.txt"
+done
+
+# Compile name.txt on one thread and on threads, with the driver arguments given after them
+compare_outputs()
+{
+    local NAME="$1"
+    local THREADS="$2"
+    shift 2
+    local INPUT="$ACTUAL_DIR/$NAME.txt"
+
+    ./compiler "$@" --emit-binary "$INPUT" > "$ACTUAL_DIR/single_$NAME.out" 2>&1
+    local SINGLE_STATUS=$?
+    mv -f "$INPUT.dslb" "$ACTUAL_DIR/single_$NAME.dslb" 2>/dev/null
+    ./compiler "$@" --lex-threads "$THREADS" --emit-binary "$INPUT" > "$ACTUAL_DIR/threaded_$NAME.out" 2>&1
+    local THREADED_STATUS=$?
+    mv -f "$INPUT.dslb" "$ACTUAL_DIR/threaded_$NAME.dslb" 2>/dev/null
+
+    [ $SINGLE_STATUS -eq $THREADED_STATUS ] &&
+        cmp -s "$ACTUAL_DIR/single_$NAME.out" "$ACTUAL_DIR/threaded_$NAME.out" &&
+        { [ ! -f "$ACTUAL_DIR/single_$NAME.dslb" ] ||
+            cmp -s "$ACTUAL_DIR/single_$NAME.dslb" "$ACTUAL_DIR/threaded_$NAME.dslb"; }
+}
+
+run_test()
+{
+    local TEST="$1"
+    shift
+    rm -f "$ACTUAL_DIR"/*.dslb
+    echo "Running Lex Threads Test $TEST..."
+    if compare_outputs "$@"; then
+        echo "Lex Threads Test $TEST PASSED!"
+    else
+        echo "Lex Threads Test $TEST FAILED!"
+        diff "$ACTUAL_DIR/single_$2.out" "$ACTUAL_DIR/threaded_$2.out" | head -n 20
+    fi
+}
+
+run_test valid program_valid 4
+run_test errors program_errors 3
+run_test lexer_cases lexer_cases 5
+run_test lexer_cases_limit lexer_cases 4 --max-errors 1000
@@ -1,7 +1,7 @@
 #!/bin/bash
 
 # Compile the program
-gcc -I include -o lexer tests/lexer/test_lexer.c src/lexer.c src/token.c src/errors.c
+gcc -I include -o lexer tests/lexer/test_lexer.c src/lexer.c src/token_queue.c src/token.c src/errors.c src/source.c src/lexer_simd.c src/arena.c src/intern.c
 if [ $? -ne 0 ]; then
     echo "Compilation failed. Please fix the errors and try again."
     exit 1
@@ -21,14 +21,17 @@ for i in {1..20}; do
     EXPECTED_OUTPUT="$EXPECTED_DIR/expected_lexer_$i.txt"
     ACTUAL_OUTPUT="$ACTUAL_DIR/actual_lexer_$i.txt"
 
-    echo "Running Test $i..."
-    ./lexer < "$TEST_CASE" > "$ACTUAL_OUTPUT"
+    # Streaming lexer over small chunks, then the whole-buffer token stream
+    for MODE in "" "--whole"; do
+        echo "Running Test $i $MODE..."
+        ./lexer $MODE < "$TEST_CASE" > "$ACTUAL_OUTPUT"
 
-    if diff -q "$ACTUAL_OUTPUT" "$EXPECTED_OUTPUT" > /dev/null; then
-        echo "Test $i PASSED!"
-    else
-        echo "Test $i FAILED!"
-        echo "Diff:"
-        diff "$ACTUAL_OUTPUT" "$EXPECTED_OUTPUT"
-    fi
+        if diff -q "$ACTUAL_OUTPUT" "$EXPECTED_OUTPUT" > /dev/null; then
+            echo "Test $i PASSED!"
+        else
+            echo "Test $i FAILED!"
+            echo "Diff:"
+            diff "$ACTUAL_OUTPUT" "$EXPECTED_OUTPUT"
+        fi
+    done
 done
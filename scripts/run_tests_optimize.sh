@@ -0,0 +1,48 @@
+#!/bin/bash
+
+# Compile the program
+gcc -I include -o optimize tests/optimize/test_optimize.c src/optimize.c src/parser.c src/semantic.c src/lexer.c src/token_queue.c src/token.c src/errors.c src/source.c src/lexer_simd.c src/arena.c src/intern.c
+if [ $? -ne 0 ]; then
+    echo "Compilation failed. Please fix the errors and try again."
+    exit 1
+fi
+
+# Define paths
+CASES_DIR="tests/optimize/cases_optimize"
+EXPECTED_DIR="tests/optimize/expected_optimize"
+ACTUAL_DIR="tests/optimize/actual_optimize"
+
+mkdir -p "$ACTUAL_DIR"
+
+for i in {1..5}; do
+    TEST_CASE="$CASES_DIR/test_optimize_$i.txt"
+    EXPECTED_OUTPUT="$EXPECTED_DIR/expected_optimize_$i.txt"
+    ACTUAL_OUTPUT="$ACTUAL_DIR/actual_optimize_$i.txt"
+
+    echo "Running Optimize Test $i..."
+    ./optimize < "$TEST_CASE" > "$ACTUAL_OUTPUT"
+
+    if diff -q "$ACTUAL_OUTPUT" "$EXPECTED_OUTPUT" > /dev/null; then
+        echo "Optimize Test $i PASSED!"
+    else
+        echo "Optimize Test $i FAILED!"
+        echo "Diff:"
+        diff "$ACTUAL_OUTPUT" "$EXPECTED_OUTPUT"
+    fi
+done
+
+# The optimized VM cases must behave as they do unoptimized, bar the cycle counts
+for i in 1 2 3 8; do
+    OPTIONS=""
+    if [ -f "tests/vm/cases_vm/test_vm_$i.trace" ]; then
+        OPTIONS="--trace tests/vm/cases_vm/test_vm_$i.trace"
+    fi
+
+    echo "Running Optimized VM Test $i..."
+    if diff -q <(./compiler --run $OPTIONS "tests/vm/cases_vm/test_vm_$i.txt" | grep -v '^[0-9]' | sed 's/ after .*//') \
+               <(./compiler -O --run $OPTIONS "tests/vm/cases_vm/test_vm_$i.txt" | grep -v '^[0-9]' | sed 's/ after .*//') > /dev/null; then
+        echo "Optimized VM Test $i PASSED!"
+    else
+        echo "Optimized VM Test $i FAILED!"
+    fi
+done
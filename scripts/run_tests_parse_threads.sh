@@ -0,0 +1,55 @@
+#!/bin/bash
+
+# Parsing a large file on several threads must give what parsing it on one does:
+# the same diagnostics in the same order, error limit included, and the same
+# binary. The inputs are generated programs, valid, with errors, and with a stray
+# '}' that unbalances the braces and so parses on one thread after all.
+
+GENERATOR="build/bench/generate_program"
+ACTUAL_DIR="tests/parse_threads/actual_parse_threads"
+
+mkdir -p "$ACTUAL_DIR"
+
+$GENERATOR --seed 3 --size 2M > "$ACTUAL_DIR/program_valid.txt"
+$GENERATOR --seed 4 --size 2M --errors 100 > "$ACTUAL_DIR/program_errors.txt"
+{ cat "$ACTUAL_DIR/program_valid.txt"; echo "}"; } > "$ACTUAL_DIR/program_unbalanced.txt"
+
+# Compile name.txt on one thread and on threads, with the driver arguments given after them
+compare_outputs()
+{
+    local NAME="$1"
+    local THREADS="$2"
+    shift 2
+    local INPUT="$ACTUAL_DIR/$NAME.txt"
+
+    ./compiler "$@" --emit-binary "$INPUT" > "$ACTUAL_DIR/single_$NAME.out" 2>&1
+    local SINGLE_STATUS=$?
+    mv -f "$INPUT.dslb" "$ACTUAL_DIR/single_$NAME.dslb" 2>/dev/null
+    ./compiler "$@" --parse-threads "$THREADS" --emit-binary "$INPUT" > "$ACTUAL_DIR/threaded_$NAME.out" 2>&1
+    local THREADED_STATUS=$?
+    mv -f "$INPUT.dslb" "$ACTUAL_DIR/threaded_$NAME.dslb" 2>/dev/null
+
+    [ $SINGLE_STATUS -eq $THREADED_STATUS ] &&
+        cmp -s "$ACTUAL_DIR/single_$NAME.out" "$ACTUAL_DIR/threaded_$NAME.out" &&
+        { [ ! -f "$ACTUAL_DIR/single_$NAME.dslb" ] ||
+            cmp -s "$ACTUAL_DIR/single_$NAME.dslb" "$ACTUAL_DIR/threaded_$NAME.dslb"; }
+}
+
+run_test()
+{
+    local TEST="$1"
+    shift
+    rm -f "$ACTUAL_DIR"/*.dslb
+    echo "Running Parse Threads Test $TEST..."
+    if compare_outputs "$@"; then
+        echo "Parse Threads Test $TEST PASSED!"
+    else
+        echo "Parse Threads Test $TEST FAILED!"
+        diff "$ACTUAL_DIR/single_$2.out" "$ACTUAL_DIR/threaded_$2.out" | head -n 20
+    fi
+}
+
+run_test valid program_valid 4
+run_test errors program_errors 5
+run_test errors_limit program_errors 3 --max-errors 200
+run_test unbalanced program_unbalanced 4
@@ -0,0 +1,62 @@
+#!/bin/bash
+
+# Compile the program
+gcc -I include -o parser tests/parser/test_parser.c src/parser.c src/lexer.c src/token_queue.c src/token.c src/errors.c src/source.c src/lexer_simd.c src/arena.c src/intern.c &&
+gcc -I include -o incremental tests/parser/test_incremental.c src/incremental.c src/parser.c src/lexer.c src/token_queue.c src/token.c src/errors.c src/source.c src/lexer_simd.c src/arena.c src/intern.c
+if [ $? -ne 0 ]; then
+    echo "Compilation failed. Please fix the errors and try again."
+    exit 1
+fi
+
+# Define paths
+CASES_DIR="tests/parser/cases_parser"
+EXPECTED_DIR="tests/parser/expected_parser"
+EXPECTED_INCREMENTAL_DIR="tests/parser/expected_incremental"
+ACTUAL_DIR="tests/parser/actual_parser"
+
+# Ensure the actual_parser directory exists
+mkdir -p "$ACTUAL_DIR"
+
+# Run tests
+for i in {1..10}; do
+    TEST_CASE="$CASES_DIR/test_parser_$i.txt"
+    EXPECTED_OUTPUT="$EXPECTED_DIR/expected_parser_$i.txt"
+    ACTUAL_OUTPUT="$ACTUAL_DIR/actual_parser_$i.txt"
+
+    # Default recursion limit, then every expression on the explicit stack
+    for LIMIT in "" "0"; do
+        echo "Running Test $i ${LIMIT:+(recursion limit $LIMIT)}..."
+        DSL_PARSER_RECURSION_LIMIT=$LIMIT ./parser < "$TEST_CASE" > "$ACTUAL_OUTPUT"
+
+        if diff -q "$ACTUAL_OUTPUT" "$EXPECTED_OUTPUT" > /dev/null; then
+            echo "Test $i PASSED!"
+        else
+            echo "Test $i FAILED!"
+            echo "Diff:"
+            diff "$ACTUAL_OUTPUT" "$EXPECTED_OUTPUT"
+        fi
+    done
+done
+
+# Edit every case at random and check each incremental update against a full lex and parse.
+# The deeply nested case is re-parsed whole after every edit, so it gets fewer of them.
+for i in {1..10}; do
+    TEST_CASE="$CASES_DIR/test_parser_$i.txt"
+    EXPECTED_OUTPUT="$EXPECTED_INCREMENTAL_DIR/expected_incremental_$i.txt"
+    ACTUAL_OUTPUT="$ACTUAL_DIR/actual_incremental_$i.txt"
+    EDITS=300
+    if [ $i -eq 9 ]; then
+        EDITS=20
+    fi
+
+    echo "Running Incremental Test $i..."
+    ./incremental $EDITS $i < "$TEST_CASE" > "$ACTUAL_OUTPUT"
+
+    if diff -q "$ACTUAL_OUTPUT" "$EXPECTED_OUTPUT" > /dev/null; then
+        echo "Incremental Test $i PASSED!"
+    else
+        echo "Incremental Test $i FAILED!"
+        echo "Diff:"
+        diff "$ACTUAL_OUTPUT" "$EXPECTED_OUTPUT"
+    fi
+done
@@ -0,0 +1,55 @@
+#!/bin/bash
+
+# The pipelined front end must be indistinguishable from the sequential one: the
+# same diagnostics in the same order for every lexer, parser and error case, and
+# the same binary for generated programs, valid and with errors.
+
+GENERATOR="build/bench/generate_program"
+ACTUAL_DIR="tests/pipeline/actual_pipeline"
+
+mkdir -p "$ACTUAL_DIR"
+
+for SEED in 1 2; do
+    for ERRORS in 0 50; do
+        $GENERATOR --seed $SEED --size 256K --errors $ERRORS > "$ACTUAL_DIR/program_${SEED}_$ERRORS.txt"
+    done
+done
+
+# Each case is copied next to its outputs so the .dslb files land there too
+compare_outputs()
+{
+    local NAME="$1"
+    shift
+    local INPUT="$ACTUAL_DIR/$NAME.txt"
+
+    ./compiler "$@" --emit-binary "$INPUT" > "$ACTUAL_DIR/sequential_$NAME.txt" 2>&1
+    local SEQUENTIAL_STATUS=$?
+    mv -f "$INPUT.dslb" "$ACTUAL_DIR/sequential_$NAME.dslb" 2>/dev/null
+    ./compiler "$@" --pipeline --emit-binary "$INPUT" > "$ACTUAL_DIR/pipelined_$NAME.txt" 2>&1
+    local PIPELINED_STATUS=$?
+    mv -f "$INPUT.dslb" "$ACTUAL_DIR/pipelined_$NAME.dslb" 2>/dev/null
+
+    [ $SEQUENTIAL_STATUS -eq $PIPELINED_STATUS ] &&
+        cmp -s "$ACTUAL_DIR/sequential_$NAME.txt" "$ACTUAL_DIR/pipelined_$NAME.txt" &&
+        { [ ! -f "$ACTUAL_DIR/sequential_$NAME.dslb" ] ||
+            cmp -s "$ACTUAL_DIR/sequential_$NAME.dslb" "$ACTUAL_DIR/pipelined_$NAME.dslb"; }
+}
+
+for CASE in tests/lexer/cases_lexer/*.txt tests/parser/cases_parser/*.txt tests/errors/cases_errors/*.txt \
+    "$ACTUAL_DIR"/program_*.txt; do
+    NAME=$(basename "$CASE" .txt)
+    ARGS=""
+    if [ -f "${CASE%.txt}.args" ]; then
+        ARGS=$(cat "${CASE%.txt}.args")
+    fi
+
+    [ "$CASE" -ef "$ACTUAL_DIR/$NAME.txt" ] || cp "$CASE" "$ACTUAL_DIR/$NAME.txt"
+    rm -f "$ACTUAL_DIR/sequential_$NAME.dslb" "$ACTUAL_DIR/pipelined_$NAME.dslb"
+    echo "Running Pipeline Test $NAME..."
+    if compare_outputs "$NAME" $ARGS; then
+        echo "Pipeline Test $NAME PASSED!"
+    else
+        echo "Pipeline Test $NAME FAILED!"
+        diff "$ACTUAL_DIR/sequential_$NAME.txt" "$ACTUAL_DIR/pipelined_$NAME.txt" | head -n 20
+    fi
+done
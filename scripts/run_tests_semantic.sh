@@ -0,0 +1,30 @@
+#!/bin/bash
+
+# Check each case with the driver arguments in the .args file next to it, if
+# any, and compare the diagnostics, or the run, it prints
+CASES_DIR="tests/semantic/cases_semantic"
+EXPECTED_DIR="tests/semantic/expected_semantic"
+ACTUAL_DIR="tests/semantic/actual_semantic"
+
+mkdir -p "$ACTUAL_DIR"
+
+for i in {1..4}; do
+    TEST_CASE="$CASES_DIR/test_semantic_$i.txt"
+    EXPECTED_OUTPUT="$EXPECTED_DIR/expected_semantic_$i.txt"
+    ACTUAL_OUTPUT="$ACTUAL_DIR/actual_semantic_$i.txt"
+    ARGS=""
+    if [ -f "$CASES_DIR/test_semantic_$i.args" ]; then
+        ARGS=$(cat "$CASES_DIR/test_semantic_$i.args")
+    fi
+
+    echo "Running Semantic Test $i..."
+    ./compiler $ARGS "$TEST_CASE" > "$ACTUAL_OUTPUT"
+
+    if diff -q "$ACTUAL_OUTPUT" "$EXPECTED_OUTPUT" > /dev/null; then
+        echo "Semantic Test $i PASSED!"
+    else
+        echo "Semantic Test $i FAILED!"
+        echo "Diff:"
+        diff "$ACTUAL_OUTPUT" "$EXPECTED_OUTPUT"
+    fi
+done
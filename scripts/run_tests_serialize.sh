@@ -0,0 +1,35 @@
+#!/bin/bash
+
+# Compile the program
+gcc -I include -o serialize tests/serialize/test_serialize.c src/serialize.c src/parser.c src/lexer.c src/token_queue.c src/token.c src/errors.c src/source.c src/lexer_simd.c src/arena.c src/intern.c
+if [ $? -ne 0 ]; then
+    echo "Compilation failed. Please fix the errors and try again."
+    exit 1
+fi
+
+# Write each parser case out, map it back and print the AST from the mapping,
+# which must match what the parser itself printed
+CASES_DIR="tests/parser/cases_parser"
+EXPECTED_DIR="tests/parser/expected_parser"
+ACTUAL_DIR="tests/serialize/actual_serialize"
+FILE=$(mktemp)
+trap 'rm -f "$FILE"' EXIT
+
+mkdir -p "$ACTUAL_DIR"
+
+for i in {1..10}; do
+    TEST_CASE="$CASES_DIR/test_parser_$i.txt"
+    EXPECTED_OUTPUT="$EXPECTED_DIR/expected_parser_$i.txt"
+    ACTUAL_OUTPUT="$ACTUAL_DIR/actual_serialize_$i.txt"
+
+    echo "Running Serialize Test $i..."
+    ./serialize "$FILE" < "$TEST_CASE" > "$ACTUAL_OUTPUT"
+
+    if diff -q "$ACTUAL_OUTPUT" "$EXPECTED_OUTPUT" > /dev/null; then
+        echo "Serialize Test $i PASSED!"
+    else
+        echo "Serialize Test $i FAILED!"
+        echo "Diff:"
+        diff "$ACTUAL_OUTPUT" "$EXPECTED_OUTPUT"
+    fi
+done
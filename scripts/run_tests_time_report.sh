@@ -0,0 +1,32 @@
+#!/bin/bash
+
+# Time two cases, one that compiles and one with errors. The figures change from
+# run to run, so only check that every phase that ran is reported in the table
+# and in the JSON, and that the JSON parses.
+
+CASES="tests/vm/cases_vm/test_vm_1.txt tests/parser/cases_parser/test_parser_3.txt"
+ACTUAL_DIR="tests/time_report/actual_time_report"
+
+mkdir -p "$ACTUAL_DIR"
+./compiler -O --run --time-report --time-report-json "$ACTUAL_DIR/report.json" $CASES > "$ACTUAL_DIR/report.txt"
+
+check() {
+    local NAME=$1
+    shift
+    if "$@"; then
+        echo "Time Report Test $NAME PASSED!"
+    else
+        echo "Time Report Test $NAME FAILED!"
+        cat "$ACTUAL_DIR/report.txt" "$ACTUAL_DIR/report.json"
+    fi
+}
+
+check text bash -c "[ \$(grep -cE '^(load|lex|parse|optimize|bytecode|total) ' '$ACTUAL_DIR/report.txt') -ge 9 ]"
+check json python3 -c "
+import json, sys
+files = json.load(open('$ACTUAL_DIR/report.json'))['files']
+assert [f['path'] for f in files] == '$CASES'.split()
+assert [p['name'] for p in files[0]['phases']] == ['load', 'lex', 'parse', 'check', 'optimize', 'bytecode']
+assert files[0]['succeeded'] and not files[1]['succeeded']
+assert files[0]['total']['allocations'] == sum(p['allocations'] for p in files[0]['phases'])
+"
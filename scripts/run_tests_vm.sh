@@ -0,0 +1,33 @@
+#!/bin/bash
+
+# Run each case in the VM. A case may come with a .trace driving its input pins
+# and an .args file of extra compiler options.
+CASES_DIR="tests/vm/cases_vm"
+EXPECTED_DIR="tests/vm/expected_vm"
+ACTUAL_DIR="tests/vm/actual_vm"
+
+mkdir -p "$ACTUAL_DIR"
+
+for i in {1..9}; do
+    TEST_CASE="$CASES_DIR/test_vm_$i.txt"
+    EXPECTED_OUTPUT="$EXPECTED_DIR/expected_vm_$i.txt"
+    ACTUAL_OUTPUT="$ACTUAL_DIR/actual_vm_$i.txt"
+    OPTIONS=""
+    if [ -f "$CASES_DIR/test_vm_$i.trace" ]; then
+        OPTIONS="--trace $CASES_DIR/test_vm_$i.trace"
+    fi
+    if [ -f "$CASES_DIR/test_vm_$i.args" ]; then
+        OPTIONS="$OPTIONS $(cat "$CASES_DIR/test_vm_$i.args")"
+    fi
+
+    echo "Running VM Test $i..."
+    ./compiler --run $OPTIONS "$TEST_CASE" > "$ACTUAL_OUTPUT"
+
+    if diff -q "$ACTUAL_OUTPUT" "$EXPECTED_OUTPUT" > /dev/null; then
+        echo "VM Test $i PASSED!"
+    else
+        echo "VM Test $i FAILED!"
+        echo "Diff:"
+        diff "$ACTUAL_OUTPUT" "$EXPECTED_OUTPUT"
+    fi
+done
@@ -0,0 +1,37 @@
+#!/bin/bash
+
+# Compile the program
+gcc -I include -o wcet tests/wcet/test_wcet.c src/wcet.c src/target.c src/parser.c src/semantic.c src/lexer.c src/token_queue.c src/token.c src/errors.c src/source.c src/lexer_simd.c src/arena.c src/intern.c
+if [ $? -ne 0 ]; then
+    echo "Compilation failed. Please fix the errors and try again."
+    exit 1
+fi
+
+# Estimate each case's worst-case cycles with the .target next to it or the
+# default target
+CASES_DIR="tests/wcet/cases_wcet"
+EXPECTED_DIR="tests/wcet/expected_wcet"
+ACTUAL_DIR="tests/wcet/actual_wcet"
+
+mkdir -p "$ACTUAL_DIR"
+
+for i in {1..4}; do
+    TEST_CASE="$CASES_DIR/test_wcet_$i.txt"
+    EXPECTED_OUTPUT="$EXPECTED_DIR/expected_wcet_$i.txt"
+    ACTUAL_OUTPUT="$ACTUAL_DIR/actual_wcet_$i.txt"
+    TARGET=""
+    if [ -f "$CASES_DIR/test_wcet_$i.target" ]; then
+        TARGET="$CASES_DIR/test_wcet_$i.target"
+    fi
+
+    echo "Running WCET Test $i..."
+    ./wcet $TARGET < "$TEST_CASE" > "$ACTUAL_OUTPUT"
+
+    if diff -q "$ACTUAL_OUTPUT" "$EXPECTED_OUTPUT" > /dev/null; then
+        echo "WCET Test $i PASSED!"
+    else
+        echo "WCET Test $i FAILED!"
+        echo "Diff:"
+        diff "$ACTUAL_OUTPUT" "$EXPECTED_OUTPUT"
+    fi
+done
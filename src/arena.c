@@ -0,0 +1,218 @@
+#include "arena.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+
+#define ARENA_ALIGNMENT 16
+
+// Allocations above this share of a block get a dedicated block, which
+// arena_realloc can grow with realloc instead of copying inside the arena
+#define LARGE_ALLOCATION(arena, size) ((size) > (arena)->block_size / 4)
+
+// Requests made through arena_alloc, arena_calloc and arena_realloc on this thread
+static _Thread_local ArenaStatistics statistics;
+
+static void count_allocation(size_t size)
+{
+    statistics.allocations++;
+    statistics.bytes += size;
+}
+
+ArenaStatistics get_arena_statistics()
+{
+    return statistics;
+}
+
+static size_t align_size(size_t size)
+{
+    return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+static void link_block(Arena *arena, ArenaBlock *block)
+{
+    block->prev = NULL;
+    block->next = arena->blocks;
+    if (arena->blocks)
+    {
+        arena->blocks->prev = block;
+    }
+    arena->blocks = block;
+}
+
+static ArenaBlock *create_block(Arena *arena, size_t capacity)
+{
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + capacity);
+    if (!block)
+    {
+        return NULL;
+    }
+
+    block->capacity = capacity;
+    block->used = 0;
+    link_block(arena, block);
+    arena->block_count++;
+
+    return block;
+}
+
+Arena *create_arena(size_t block_size)
+{
+    Arena *arena = calloc(1, sizeof(Arena));
+    if (!arena)
+    {
+        return NULL;
+    }
+
+    arena->block_size = block_size ? align_size(block_size) : DEFAULT_ARENA_BLOCK_SIZE;
+    return arena;
+}
+
+void free_arena(Arena *arena)
+{
+    if (!arena)
+    {
+        return;
+    }
+
+    ArenaBlock *block = arena->blocks;
+    while (block)
+    {
+        ArenaBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+
+    free(arena);
+}
+
+static void *allocate(Arena *arena, size_t size)
+{
+    if (!arena)
+    {
+        return malloc(size);
+    }
+
+    size = align_size(size ? size : 1);
+
+    if (LARGE_ALLOCATION(arena, size))
+    {
+        ArenaBlock *block = create_block(arena, size);
+        if (!block)
+        {
+            return NULL;
+        }
+        block->used = size;
+        arena->bytes_used += size;
+        return block->data;
+    }
+
+    if (!arena->current || arena->current->capacity - arena->current->used < size)
+    {
+        arena->current = create_block(arena, arena->block_size);
+        if (!arena->current)
+        {
+            return NULL;
+        }
+    }
+
+    void *pointer = arena->current->data + arena->current->used;
+    arena->current->used += size;
+    arena->bytes_used += size;
+    return pointer;
+}
+
+void *arena_alloc(Arena *arena, size_t size)
+{
+    count_allocation(size);
+    return allocate(arena, size);
+}
+
+void *arena_calloc(Arena *arena, size_t count, size_t size)
+{
+    count_allocation(count * size);
+    if (!arena)
+    {
+        return calloc(count, size);
+    }
+
+    void *pointer = allocate(arena, count * size);
+    if (pointer)
+    {
+        memset(pointer, 0, count * size);
+    }
+    return pointer;
+}
+
+// Grow an allocation, old_size must be the size it was allocated with
+void *arena_realloc(Arena *arena, void *pointer, size_t old_size, size_t new_size)
+{
+    count_allocation(new_size);
+    if (!arena)
+    {
+        return realloc(pointer, new_size);
+    }
+
+    if (!pointer)
+    {
+        return allocate(arena, new_size);
+    }
+
+    old_size = align_size(old_size ? old_size : 1);
+    new_size = align_size(new_size ? new_size : 1);
+
+    // A dedicated block can be resized by the heap, usually without copying
+    if (LARGE_ALLOCATION(arena, old_size))
+    {
+        ArenaBlock *block = (ArenaBlock *)((char *)pointer - offsetof(ArenaBlock, data));
+        ArenaBlock *prev = block->prev, *next = block->next;
+        ArenaBlock *new_block = realloc(block, sizeof(ArenaBlock) + new_size);
+        if (!new_block)
+        {
+            return NULL;
+        }
+
+        if (prev)
+        {
+            prev->next = new_block;
+        }
+        else
+        {
+            arena->blocks = new_block;
+        }
+        if (next)
+        {
+            next->prev = new_block;
+        }
+
+        new_block->capacity = new_size;
+        new_block->used = new_size;
+        arena->bytes_used += new_size - old_size;
+        return new_block->data;
+    }
+
+    // The most recent bump allocation can grow in place while its block has room
+    ArenaBlock *current = arena->current;
+    if (current && (char *)pointer + old_size == current->data + current->used &&
+        !LARGE_ALLOCATION(arena, new_size) && current->used - old_size + new_size <= current->capacity)
+    {
+        current->used += new_size - old_size;
+        arena->bytes_used += new_size - old_size;
+        return pointer;
+    }
+
+    void *new_pointer = allocate(arena, new_size);
+    if (new_pointer)
+    {
+        memcpy(new_pointer, pointer, old_size < new_size ? old_size : new_size);
+    }
+    return new_pointer;
+}
+
+void arena_free(Arena *arena, void *pointer)
+{
+    // Arena memory is only released with the whole arena
+    if (!arena)
+    {
+        free(pointer);
+    }
+}
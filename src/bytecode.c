@@ -0,0 +1,757 @@
+#include "bytecode.h"
+#include "gpio.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_BYTECODE_CAPACITY 256
+
+// Expression nesting compiled before giving up rather than overflowing the call stack
+#define MAX_BYTECODE_DEPTH 20000
+
+// End of a chain of jumps waiting for their target, each links to the next
+// through its immediate
+#define NO_JUMP -1
+
+// A name bound to a register, innermost last
+typedef struct
+{
+    uint32_t symbol;
+    uint8_t reg;
+} Binding;
+
+// State of lowering one AST
+typedef struct
+{
+    AST *ast;
+    TokenStream *token_stream;
+    BytecodeProgram *program;
+    ErrorList *error_list;
+    int error_base;          // Size of error_list when compiling started
+    Binding *bindings;
+    uint32_t binding_count;
+    uint32_t binding_capacity;
+    uint32_t next_register;  // First free register of the current function
+    uint32_t register_count; // Registers the current function has needed so far
+    int registers_exhausted; // Reported for the current function
+    int depth;
+    int out_of_memory;
+} BytecodeCompiler;
+
+const char *opcode_to_string(Opcode opcode)
+{
+    static const char *const names[OPCODE_COUNT] = {
+        [OP_LOAD_CONST] = "LOAD_CONST",
+        [OP_MOVE] = "MOVE",
+        [OP_ADD] = "ADD",
+        [OP_SUB] = "SUB",
+        [OP_MUL] = "MUL",
+        [OP_DIV] = "DIV",
+        [OP_ADD_IMMEDIATE] = "ADD_IMMEDIATE",
+        [OP_EQ] = "EQ",
+        [OP_NEQ] = "NEQ",
+        [OP_LT] = "LT",
+        [OP_GT] = "GT",
+        [OP_LTE] = "LTE",
+        [OP_GTE] = "GTE",
+        [OP_NOT] = "NOT",
+        [OP_NEG] = "NEG",
+        [OP_JUMP] = "JUMP",
+        [OP_JUMP_IF_FALSE] = "JUMP_IF_FALSE",
+        [OP_JUMP_IF_TRUE] = "JUMP_IF_TRUE",
+        [OP_JUMP_UNLESS_EQ] = "JUMP_UNLESS_EQ",
+        [OP_JUMP_UNLESS_NEQ] = "JUMP_UNLESS_NEQ",
+        [OP_JUMP_UNLESS_LT] = "JUMP_UNLESS_LT",
+        [OP_JUMP_UNLESS_GT] = "JUMP_UNLESS_GT",
+        [OP_JUMP_UNLESS_LTE] = "JUMP_UNLESS_LTE",
+        [OP_JUMP_UNLESS_GTE] = "JUMP_UNLESS_GTE",
+        [OP_READ_PIN] = "READ_PIN",
+        [OP_SET_PIN] = "SET_PIN",
+        [OP_CALL] = "CALL",
+        [OP_RETURN] = "RETURN",
+    };
+    return opcode < OPCODE_COUNT ? names[opcode] : "UNKNOWN";
+}
+
+// Report an error at a token, quoting name when it is given
+static void report_bytecode_error(BytecodeCompiler *compiler, int token, const char *format, const char *name,
+                                  int name_length)
+{
+    char message[256];
+    snprintf(message, sizeof(message), format, name_length, name ? name : "");
+    add_new_error(compiler->error_list, compiler->token_stream->lines[token], compiler->token_stream->columns[token],
+                  CODEGEN, message);
+}
+
+static void report_token_error(BytecodeCompiler *compiler, int token, const char *format)
+{
+    int length;
+    const char *lexeme = get_token_lexeme(compiler->token_stream, token, &length);
+    report_bytecode_error(compiler, token, format, lexeme, length > 64 ? 64 : length);
+}
+
+static int emit_instruction(BytecodeCompiler *compiler, Opcode opcode, int a, int b, int c, int32_t immediate,
+                            int token)
+{
+    BytecodeProgram *program = compiler->program;
+    if (program->instruction_count == program->instruction_capacity)
+    {
+        uint32_t capacity = program->instruction_capacity * 2;
+        Instruction *code = arena_realloc(program->arena, program->code,
+                                          program->instruction_capacity * sizeof(Instruction),
+                                          capacity * sizeof(Instruction));
+        int *lines = code ? arena_realloc(program->arena, program->lines, program->instruction_capacity * sizeof(int),
+                                          capacity * sizeof(int)) : NULL;
+        if (code)
+        {
+            program->code = code;
+        }
+        int *columns = lines ? arena_realloc(program->arena, program->columns,
+                                             program->instruction_capacity * sizeof(int), capacity * sizeof(int)) : NULL;
+        if (lines)
+        {
+            program->lines = lines;
+        }
+        if (!columns)
+        {
+            compiler->out_of_memory = 1;
+            return 0;
+        }
+        program->columns = columns;
+        program->instruction_capacity = capacity;
+    }
+
+    uint32_t index = program->instruction_count++;
+    program->code[index] = (Instruction){(uint8_t)opcode, (uint8_t)a, (uint8_t)b, (uint8_t)c, immediate};
+    program->lines[index] = compiler->token_stream->lines[token];
+    program->columns[index] = compiler->token_stream->columns[token];
+    return (int)index;
+}
+
+// Emit a jump whose target is not known yet, linking it into chain
+static void emit_pending_jump(BytecodeCompiler *compiler, Opcode opcode, int a, int b, int c, int token, int *chain)
+{
+    int index = emit_instruction(compiler, opcode, a, b, c, *chain, token);
+    if (!compiler->out_of_memory)
+    {
+        *chain = index;
+    }
+}
+
+// Point every jump in chain at target
+static void patch_jumps(BytecodeCompiler *compiler, int chain, uint32_t target)
+{
+    while (chain != NO_JUMP)
+    {
+        Instruction *instruction = &compiler->program->code[chain];
+        chain = instruction->immediate;
+        instruction->immediate = (int32_t)target;
+    }
+}
+
+static uint8_t allocate_register(BytecodeCompiler *compiler, int token)
+{
+    if (compiler->next_register == BYTECODE_MAX_REGISTERS)
+    {
+        if (!compiler->registers_exhausted)
+        {
+            report_token_error(compiler, token, "Function needs more than 256 registers at '%.*s'");
+            compiler->registers_exhausted = 1;
+        }
+        return 0;
+    }
+
+    uint8_t reg = (uint8_t)compiler->next_register++;
+    if (compiler->next_register > compiler->register_count)
+    {
+        compiler->register_count = compiler->next_register;
+    }
+    return reg;
+}
+
+static int bind_name(BytecodeCompiler *compiler, uint32_t symbol, uint8_t reg)
+{
+    if (compiler->binding_count == compiler->binding_capacity)
+    {
+        uint32_t capacity = compiler->binding_capacity ? compiler->binding_capacity * 2 : 64;
+        Binding *bindings = realloc(compiler->bindings, capacity * sizeof(Binding));
+        if (!bindings)
+        {
+            compiler->out_of_memory = 1;
+            return 0;
+        }
+        compiler->bindings = bindings;
+        compiler->binding_capacity = capacity;
+    }
+
+    compiler->bindings[compiler->binding_count++] = (Binding){symbol, reg};
+    return 1;
+}
+
+// Register of the innermost variable named by token, reporting it if there is none
+static int find_variable(BytecodeCompiler *compiler, int token, uint8_t *reg)
+{
+    uint32_t symbol = compiler->token_stream->symbols[token];
+    for (uint32_t i = compiler->binding_count; i-- > 0;)
+    {
+        if (compiler->bindings[i].symbol == symbol)
+        {
+            *reg = compiler->bindings[i].reg;
+            return 1;
+        }
+    }
+
+    report_token_error(compiler, token, "Undefined variable '%.*s'");
+    return 0;
+}
+
+static uint32_t find_function(BytecodeCompiler *compiler, uint32_t symbol)
+{
+    for (uint32_t i = 0; i < compiler->program->function_count; i++)
+    {
+        if (compiler->program->functions[i].symbol == symbol)
+        {
+            return i;
+        }
+    }
+    return BYTECODE_NO_FUNCTION;
+}
+
+// Value of a NUMBER token, reporting it if it does not fit an int
+static int32_t number_value(BytecodeCompiler *compiler, int token)
+{
+    int length;
+    const char *lexeme = get_token_lexeme(compiler->token_stream, token, &length);
+    int64_t value = 0;
+    for (int i = 0; i < length; i++)
+    {
+        value = value * 10 + (lexeme[i] - '0');
+        if (value > INT32_MAX)
+        {
+            report_token_error(compiler, token, "Number '%.*s' does not fit in an int");
+            return 0;
+        }
+    }
+    return (int32_t)value;
+}
+
+// Number of the GPIO_PIN node at index, reporting it if the bank has no such pin
+static int32_t pin_number(BytecodeCompiler *compiler, uint32_t index)
+{
+    int token = get_ast_node(compiler->ast, index)->token;
+    int32_t number = number_value(compiler, token);
+    if (number >= GPIO_PIN_COUNT)
+    {
+        report_token_error(compiler, token, "Pin number '%.*s' out of range");
+        return 0;
+    }
+    return number;
+}
+
+static int is_comparison(TokenType type)
+{
+    return type == TOKEN_EQ || type == TOKEN_NEQ || type == TOKEN_LT || type == TOKEN_GT || type == TOKEN_LTE ||
+           type == TOKEN_GTE;
+}
+
+static Opcode comparison_opcode(TokenType type)
+{
+    switch (type)
+    {
+    case TOKEN_EQ:
+        return OP_EQ;
+    case TOKEN_NEQ:
+        return OP_NEQ;
+    case TOKEN_LT:
+        return OP_LT;
+    case TOKEN_GT:
+        return OP_GT;
+    case TOKEN_LTE:
+        return OP_LTE;
+    default:
+        return OP_GTE;
+    }
+}
+
+// Jump taken when the comparison fails, or when it holds if negated (the negation
+// of an integer comparison is the opposite comparison)
+static Opcode comparison_jump(TokenType type, int negated)
+{
+    static const Opcode unless[] = {OP_JUMP_UNLESS_EQ, OP_JUMP_UNLESS_NEQ, OP_JUMP_UNLESS_LT,
+                                    OP_JUMP_UNLESS_GT, OP_JUMP_UNLESS_LTE, OP_JUMP_UNLESS_GTE};
+    static const Opcode opposite[] = {OP_JUMP_UNLESS_NEQ, OP_JUMP_UNLESS_EQ, OP_JUMP_UNLESS_GTE,
+                                      OP_JUMP_UNLESS_LTE, OP_JUMP_UNLESS_GT, OP_JUMP_UNLESS_LT};
+    int index = comparison_opcode(type) - OP_EQ;
+    return negated ? opposite[index] : unless[index];
+}
+
+static void compile_expression(BytecodeCompiler *compiler, uint32_t index, uint8_t destination);
+static void compile_jump(BytecodeCompiler *compiler, uint32_t index, int when_true, int *chain);
+
+// Register holding the value of an expression: a variable's own register, or a
+// new temporary it is computed into
+static uint8_t compile_operand(BytecodeCompiler *compiler, uint32_t index)
+{
+    ASTNode *node = get_ast_node(compiler->ast, index);
+    uint8_t reg;
+    if (node->type == IDENTIFIER)
+    {
+        return find_variable(compiler, node->token, &reg) ? reg : allocate_register(compiler, node->token);
+    }
+
+    reg = allocate_register(compiler, node->token);
+    compile_expression(compiler, index, reg);
+    return reg;
+}
+
+// Jump to chain when the condition at index is true (when_true) or false, fall through otherwise.
+// Comparisons become a single compare-and-branch, && and || branch without computing a value.
+static void compile_jump(BytecodeCompiler *compiler, uint32_t index, int when_true, int *chain)
+{
+    AST *ast = compiler->ast;
+    ASTNode *node = get_ast_node(ast, index);
+    TokenType type = compiler->token_stream->types[node->token];
+    uint32_t saved_register = compiler->next_register;
+
+    if (++compiler->depth > MAX_BYTECODE_DEPTH)
+    {
+        if (compiler->depth == MAX_BYTECODE_DEPTH + 1)
+        {
+            report_token_error(compiler, node->token, "Expression nested too deeply to compile at '%.*s'");
+        }
+    }
+    else if (node->type == BINARY_EXPRESSION && is_comparison(type))
+    {
+        uint8_t left = compile_operand(compiler, get_ast_child(ast, index, 0));
+        uint8_t right = compile_operand(compiler, get_ast_child(ast, index, 1));
+        emit_pending_jump(compiler, comparison_jump(type, when_true), 0, left, right, node->token, chain);
+    }
+    else if (node->type == BINARY_EXPRESSION && (type == TOKEN_AND || type == TOKEN_OR))
+    {
+        // Jumping when && is false or || is true can leave on either operand,
+        // otherwise the left operand can only skip the right one
+        if ((type == TOKEN_OR) == when_true)
+        {
+            compile_jump(compiler, get_ast_child(ast, index, 0), when_true, chain);
+            compile_jump(compiler, get_ast_child(ast, index, 1), when_true, chain);
+        }
+        else
+        {
+            int skip = NO_JUMP;
+            compile_jump(compiler, get_ast_child(ast, index, 0), !when_true, &skip);
+            compile_jump(compiler, get_ast_child(ast, index, 1), when_true, chain);
+            patch_jumps(compiler, skip, compiler->program->instruction_count);
+        }
+    }
+    else if (node->type == UNARY_EXPRESSION && type == TOKEN_NOT)
+    {
+        compile_jump(compiler, get_ast_child(ast, index, 0), !when_true, chain);
+    }
+    else if (node->type == BOOL_VALUE || node->type == CONSTANT)
+    {
+        if ((node->type == CONSTANT ? node->value != 0 : type == TOKEN_TRUE) == when_true)
+        {
+            emit_pending_jump(compiler, OP_JUMP, 0, 0, 0, node->token, chain);
+        }
+    }
+    else
+    {
+        uint8_t reg = compile_operand(compiler, index);
+        emit_pending_jump(compiler, when_true ? OP_JUMP_IF_TRUE : OP_JUMP_IF_FALSE, reg, 0, 0, node->token, chain);
+    }
+
+    compiler->depth--;
+    compiler->next_register = saved_register;
+}
+
+static Opcode arithmetic_opcode(TokenType type)
+{
+    switch (type)
+    {
+    case TOKEN_PLUS:
+        return OP_ADD;
+    case TOKEN_MINUS:
+        return OP_SUB;
+    case TOKEN_STAR:
+        return OP_MUL;
+    default:
+        return OP_DIV;
+    }
+}
+
+static void compile_binary_expression(BytecodeCompiler *compiler, uint32_t index, uint8_t destination)
+{
+    AST *ast = compiler->ast;
+    ASTNode *node = get_ast_node(ast, index);
+    TokenType type = compiler->token_stream->types[node->token];
+    uint32_t left_index = get_ast_child(ast, index, 0), right_index = get_ast_child(ast, index, 1);
+
+    if (type == TOKEN_AND || type == TOKEN_OR)
+    {
+        // destination is written only once both operands are read
+        int is_false = NO_JUMP, done = NO_JUMP;
+        compile_jump(compiler, index, 0, &is_false);
+        emit_instruction(compiler, OP_LOAD_CONST, destination, 0, 0, 1, node->token);
+        emit_pending_jump(compiler, OP_JUMP, 0, 0, 0, node->token, &done);
+        patch_jumps(compiler, is_false, compiler->program->instruction_count);
+        emit_instruction(compiler, OP_LOAD_CONST, destination, 0, 0, 0, node->token);
+        patch_jumps(compiler, done, compiler->program->instruction_count);
+        return;
+    }
+
+    // x + n and x - n add an immediate
+    ASTNode *right = get_ast_node(ast, right_index);
+    if ((type == TOKEN_PLUS || type == TOKEN_MINUS) && (right->type == NUMBER_LITERAL || right->type == CONSTANT))
+    {
+        uint8_t left = compile_operand(compiler, left_index);
+        int32_t value = right->type == CONSTANT ? right->value : number_value(compiler, right->token);
+        emit_instruction(compiler, OP_ADD_IMMEDIATE, destination, left, 0,
+                         type == TOKEN_PLUS ? value : (int32_t)(0u - (uint32_t)value), node->token);
+        return;
+    }
+
+    uint8_t left = compile_operand(compiler, left_index);
+    uint8_t right_register = compile_operand(compiler, right_index);
+    Opcode opcode = is_comparison(type) ? comparison_opcode(type) : arithmetic_opcode(type);
+    emit_instruction(compiler, opcode, destination, left, right_register, 0, node->token);
+}
+
+static void compile_call(BytecodeCompiler *compiler, uint32_t index, uint8_t destination)
+{
+    AST *ast = compiler->ast;
+    ASTNode *node = get_ast_node(ast, index);
+    uint32_t function = find_function(compiler, compiler->token_stream->symbols[node->token]);
+
+    if (function == BYTECODE_NO_FUNCTION)
+    {
+        report_token_error(compiler, node->token, "Call to undefined function '%.*s'");
+        return;
+    }
+    if (compiler->program->functions[function].parameter_count != node->num_children)
+    {
+        report_token_error(compiler, node->token, "Wrong number of arguments in call to '%.*s'");
+        return;
+    }
+
+    // Arguments go into consecutive registers, which become the callee's parameters
+    uint32_t first_argument = compiler->next_register;
+    for (uint32_t i = 0; i < node->num_children; i++)
+    {
+        uint8_t reg = allocate_register(compiler, node->token);
+        compile_expression(compiler, get_ast_child(ast, index, i), reg);
+    }
+
+    emit_instruction(compiler, OP_CALL, destination, first_argument < BYTECODE_MAX_REGISTERS ? first_argument : 0,
+                     node->num_children, (int32_t)function, node->token);
+}
+
+// Compute the expression at index into destination. Temporaries are released
+// afterwards, so destination is the only register left changed.
+static void compile_expression(BytecodeCompiler *compiler, uint32_t index, uint8_t destination)
+{
+    AST *ast = compiler->ast;
+    ASTNode *node = get_ast_node(ast, index);
+    TokenType type = compiler->token_stream->types[node->token];
+    uint32_t saved_register = compiler->next_register;
+    uint8_t reg;
+
+    if (++compiler->depth > MAX_BYTECODE_DEPTH)
+    {
+        if (compiler->depth == MAX_BYTECODE_DEPTH + 1)
+        {
+            report_token_error(compiler, node->token, "Expression nested too deeply to compile at '%.*s'");
+        }
+        compiler->depth--;
+        return;
+    }
+
+    switch (node->type)
+    {
+    case NUMBER_LITERAL:
+        emit_instruction(compiler, OP_LOAD_CONST, destination, 0, 0, number_value(compiler, node->token), node->token);
+        break;
+    case BOOL_VALUE:
+        emit_instruction(compiler, OP_LOAD_CONST, destination, 0, 0, type == TOKEN_TRUE, node->token);
+        break;
+    case CONSTANT:
+        emit_instruction(compiler, OP_LOAD_CONST, destination, 0, 0, node->value, node->token);
+        break;
+    case IDENTIFIER:
+        if (find_variable(compiler, node->token, &reg) && reg != destination)
+        {
+            emit_instruction(compiler, OP_MOVE, destination, reg, 0, 0, node->token);
+        }
+        break;
+    case UNARY_EXPRESSION:
+        reg = compile_operand(compiler, get_ast_child(ast, index, 0));
+        emit_instruction(compiler, type == TOKEN_NOT ? OP_NOT : OP_NEG, destination, reg, 0, 0, node->token);
+        break;
+    case BINARY_EXPRESSION:
+        compile_binary_expression(compiler, index, destination);
+        break;
+    case CALL_EXPRESSION:
+        compile_call(compiler, index, destination);
+        break;
+    case GPIO_OPERATION:
+        emit_instruction(compiler, OP_READ_PIN, destination, 0, 0, pin_number(compiler, get_ast_child(ast, index, 0)),
+                         node->token);
+        break;
+    default:
+        report_token_error(compiler, node->token, "Cannot compile expression at '%.*s'");
+        break;
+    }
+
+    compiler->depth--;
+    compiler->next_register = saved_register;
+}
+
+static void compile_statement_list(BytecodeCompiler *compiler, uint32_t index);
+
+static void compile_set_pin(BytecodeCompiler *compiler, uint32_t index)
+{
+    AST *ast = compiler->ast;
+    ASTNode *node = get_ast_node(ast, index);
+    int32_t number = pin_number(compiler, get_ast_child(ast, index, 0));
+
+    if (node->num_children < 2)
+    {
+        emit_instruction(compiler, OP_READ_PIN, allocate_register(compiler, node->token), 0, 0, number, node->token);
+        return;
+    }
+
+    ASTNode *value = get_ast_node(ast, get_ast_child(ast, index, 1));
+    emit_instruction(compiler, OP_SET_PIN, compiler->token_stream->types[value->token] == TOKEN_HIGH, 0, 0, number,
+                     node->token);
+}
+
+static void compile_statement(BytecodeCompiler *compiler, uint32_t index)
+{
+    AST *ast = compiler->ast;
+    ASTNode *node = get_ast_node(ast, index);
+    uint8_t reg;
+    int chain = NO_JUMP, done = NO_JUMP;
+    uint32_t saved_register = compiler->next_register;
+
+    switch (node->type)
+    {
+    case IDENTIFIER_DECLARATION:
+    case IDENTIFIER_DEFINITION:
+        // The name is bound once its value is computed, so the value cannot refer to it
+        reg = allocate_register(compiler, node->token);
+        if (node->type == IDENTIFIER_DEFINITION)
+        {
+            compile_expression(compiler, get_ast_child(ast, index, 0), reg);
+        }
+        else
+        {
+            emit_instruction(compiler, OP_LOAD_CONST, reg, 0, 0, 0, node->token);
+        }
+        bind_name(compiler, compiler->token_stream->symbols[node->token], reg);
+        return;
+    case ASSIGNMENT:
+        if (find_variable(compiler, node->token, &reg))
+        {
+            compile_expression(compiler, get_ast_child(ast, index, 0), reg);
+        }
+        break;
+    case CONDITIONAL:
+        compile_jump(compiler, get_ast_child(ast, index, 0), 0, &chain);
+        compile_statement_list(compiler, get_ast_child(ast, index, 1));
+        if (node->num_children == 3)
+        {
+            emit_pending_jump(compiler, OP_JUMP, 0, 0, 0, node->token, &done);
+            patch_jumps(compiler, chain, compiler->program->instruction_count);
+            compile_statement_list(compiler, get_ast_child(ast, index, 2));
+            chain = done;
+        }
+        patch_jumps(compiler, chain, compiler->program->instruction_count);
+        break;
+    case WHILE_LOOP:
+    {
+        // The condition is tested at the bottom, so each iteration takes one branch
+        emit_pending_jump(compiler, OP_JUMP, 0, 0, 0, node->token, &done);
+        uint32_t body = compiler->program->instruction_count;
+        compile_statement_list(compiler, get_ast_child(ast, index, 1));
+        patch_jumps(compiler, done, compiler->program->instruction_count);
+        compile_jump(compiler, get_ast_child(ast, index, 0), 1, &chain);
+        patch_jumps(compiler, chain, body);
+        break;
+    }
+    case RETURN_STATEMENT:
+        reg = compile_operand(compiler, get_ast_child(ast, index, 0));
+        emit_instruction(compiler, OP_RETURN, reg, 0, 0, 0, node->token);
+        break;
+    case GPIO_OPERATION:
+        compile_set_pin(compiler, index);
+        break;
+    default:
+        compile_expression(compiler, get_ast_child(ast, index, 0), allocate_register(compiler, node->token));
+        break;
+    }
+
+    compiler->next_register = saved_register;
+}
+
+// Variables declared in a block go out of scope, and free their registers, at its end
+static void compile_statement_list(BytecodeCompiler *compiler, uint32_t index)
+{
+    ASTNode *node = get_ast_node(compiler->ast, index);
+    uint32_t saved_binding_count = compiler->binding_count;
+    uint32_t saved_register = compiler->next_register;
+
+    for (uint32_t i = 0; i < node->num_children && !compiler->out_of_memory; i++)
+    {
+        compile_statement(compiler, get_ast_child(compiler->ast, index, i));
+    }
+
+    compiler->binding_count = saved_binding_count;
+    compiler->next_register = saved_register;
+}
+
+static void compile_function(BytecodeCompiler *compiler, uint32_t index, BytecodeFunction *function)
+{
+    AST *ast = compiler->ast;
+    uint32_t parameters = get_ast_child(ast, index, 0);
+    ASTNode *parameter_list = get_ast_node(ast, parameters);
+
+    compiler->binding_count = 0;
+    compiler->next_register = 0;
+    compiler->register_count = 0;
+    compiler->registers_exhausted = 0;
+    function->entry = compiler->program->instruction_count;
+
+    for (uint32_t i = 0; i < parameter_list->num_children; i++)
+    {
+        ASTNode *parameter = get_ast_node(ast, get_ast_child(ast, parameters, i));
+        bind_name(compiler, compiler->token_stream->symbols[parameter->token], allocate_register(compiler, parameter->token));
+    }
+
+    compile_statement_list(compiler, get_ast_child(ast, index, 1));
+
+    // Falling off the end returns 0
+    uint32_t body_end = get_ast_node(ast, get_ast_child(ast, index, 1))->token;
+    uint8_t reg = allocate_register(compiler, body_end);
+    emit_instruction(compiler, OP_LOAD_CONST, reg, 0, 0, 0, body_end);
+    emit_instruction(compiler, OP_RETURN, reg, 0, 0, 0, body_end);
+    function->register_count = compiler->register_count;
+}
+
+BytecodeProgram *compile_bytecode(AST *ast, ErrorList *error_list)
+{
+    if (!ast || ast->root == AST_NO_NODE)
+    {
+        add_new_error(error_list, 0, 0, CODEGEN, "Invalid AST passed");
+        return NULL;
+    }
+
+    Arena *arena = ast->arena;
+    ASTNode *root = get_ast_node(ast, ast->root);
+    BytecodeProgram *program = arena_calloc(arena, 1, sizeof(BytecodeProgram));
+    if (!program)
+    {
+        add_new_error(error_list, 0, 0, CODEGEN, "Failed to allocate bytecode program");
+        return NULL;
+    }
+
+    program->arena = arena;
+    program->main_function = BYTECODE_NO_FUNCTION;
+    program->symbol_table = ast->token_stream->symbol_table;
+    program->instruction_capacity = DEFAULT_BYTECODE_CAPACITY;
+    program->code = arena_alloc(arena, DEFAULT_BYTECODE_CAPACITY * sizeof(Instruction));
+    program->lines = arena_alloc(arena, DEFAULT_BYTECODE_CAPACITY * sizeof(int));
+    program->columns = arena_alloc(arena, DEFAULT_BYTECODE_CAPACITY * sizeof(int));
+    program->functions = arena_calloc(arena, root->num_children ? root->num_children : 1, sizeof(BytecodeFunction));
+    if (!program->code || !program->lines || !program->columns || !program->functions)
+    {
+        free_bytecode_program(program);
+        add_new_error(error_list, 0, 0, CODEGEN, "Failed to allocate bytecode program");
+        return NULL;
+    }
+
+    BytecodeCompiler compiler = {
+        .ast = ast,
+        .token_stream = ast->token_stream,
+        .program = program,
+        .error_list = error_list,
+        .error_base = error_list ? error_list->size : 0,
+    };
+
+    // Every function is known before any body, so calls can go forwards
+    for (uint32_t i = 0; i < root->num_children; i++)
+    {
+        ASTNode *function = get_ast_node(ast, get_ast_child(ast, ast->root, i));
+        uint32_t symbol = compiler.token_stream->symbols[function->token];
+        if (find_function(&compiler, symbol) != BYTECODE_NO_FUNCTION)
+        {
+            report_token_error(&compiler, function->token, "Function '%.*s' is defined more than once");
+            continue;
+        }
+
+        BytecodeFunction *entry = &program->functions[program->function_count++];
+        entry->symbol = symbol;
+        entry->parameter_count = get_ast_node(ast, get_ast_child(ast, get_ast_child(ast, ast->root, i), 0))->num_children;
+
+        int length;
+        const char *name = get_token_lexeme(compiler.token_stream, function->token, &length);
+        if (length == 4 && memcmp(name, "main", 4) == 0)
+        {
+            program->main_function = program->function_count - 1;
+        }
+    }
+
+    for (uint32_t i = 0, f = 0; i < root->num_children && !compiler.out_of_memory; i++)
+    {
+        uint32_t function = get_ast_child(ast, ast->root, i);
+        if (find_function(&compiler, compiler.token_stream->symbols[get_ast_node(ast, function)->token]) == f)
+        {
+            compile_function(&compiler, function, &program->functions[f++]);
+        }
+    }
+
+    free(compiler.bindings);
+
+    if (compiler.out_of_memory)
+    {
+        add_new_error(error_list, 0, 0, CODEGEN, "Out of memory while generating bytecode");
+    }
+    if (compiler.out_of_memory || (error_list && error_list->size > compiler.error_base))
+    {
+        free_bytecode_program(program);
+        return NULL;
+    }
+
+    return program;
+}
+
+void free_bytecode_program(BytecodeProgram *program)
+{
+    if (!program || program->arena)
+    {
+        return;
+    }
+
+    free(program->code);
+    free(program->lines);
+    free(program->columns);
+    free(program->functions);
+    free(program);
+}
+
+void print_bytecode_program(BytecodeProgram *program, FILE *file)
+{
+    for (uint32_t f = 0; f < program->function_count; f++)
+    {
+        BytecodeFunction *function = &program->functions[f];
+        uint32_t end = f + 1 < program->function_count ? program->functions[f + 1].entry : program->instruction_count;
+        int length;
+        const char *name = get_symbol_name(program->symbol_table, function->symbol, &length);
+
+        fprintf(file, "function %.*s (%u parameters, %u registers)\n", length, name, function->parameter_count,
+                function->register_count);
+        for (uint32_t i = function->entry; i < end; i++)
+        {
+            Instruction *instruction = &program->code[i];
+            fprintf(file, "%6u  %-16s a=%u b=%u c=%u imm=%d\n", i, opcode_to_string(instruction->opcode),
+                    instruction->a, instruction->b, instruction->c, instruction->immediate);
+        }
+    }
+}
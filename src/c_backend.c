@@ -0,0 +1,940 @@
+#include "c_backend.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Expression and statement nesting written before giving up rather than
+// overflowing the call stack
+#define MAX_C_BACKEND_DEPTH 20000
+
+// A variable in scope, innermost last. shadow counts the variables of the same
+// name in scope, itself included, so every C name in a function is distinct.
+typedef struct
+{
+    uint32_t symbol;
+    uint32_t shadow;
+} CBinding;
+
+typedef struct
+{
+    uint32_t symbol;
+    uint32_t parameter_count;
+} CFunction;
+
+// State of writing one AST as C
+typedef struct
+{
+    AST *ast;
+    TokenStream *token_stream;
+    const TargetConfig *target;
+    FILE *file;               // The functions, copied to the output once all of them compiled
+    CBackendReport *report;
+    ErrorList *error_list;
+    int error_base;           // Size of error_list when generating started
+    CBinding *bindings;
+    uint32_t binding_count;
+    uint32_t binding_capacity;
+    CFunction *functions;
+    uint32_t function_count;
+    uint32_t used_ports;      // Ports whose registers the code touches
+    uint32_t cached_ports;    // Ports whose input register port_<name>_in holds for the current block
+    uint32_t declared_ports;  // port_<name>_in variables in scope
+    int use_cache;            // The expression being written takes its pin reads from the cache
+    int indent;
+    int depth;
+    int out_of_memory;
+} CGenerator;
+
+// Wrapping arithmetic goes through unsigned, where overflow is defined
+static const char c_helpers[] =
+    "\n"
+    "static inline int32_t wrap_add(int32_t a, int32_t b)\n"
+    "{\n"
+    "    return (int32_t)((uint32_t)a + (uint32_t)b);\n"
+    "}\n"
+    "\n"
+    "static inline int32_t wrap_sub(int32_t a, int32_t b)\n"
+    "{\n"
+    "    return (int32_t)((uint32_t)a - (uint32_t)b);\n"
+    "}\n"
+    "\n"
+    "static inline int32_t wrap_mul(int32_t a, int32_t b)\n"
+    "{\n"
+    "    return (int32_t)((uint32_t)a * (uint32_t)b);\n"
+    "}\n"
+    "\n"
+    "static inline int32_t wrap_neg(int32_t a)\n"
+    "{\n"
+    "    return (int32_t)(0u - (uint32_t)a);\n"
+    "}\n"
+    "\n"
+    "#ifndef DSL_DIVISION_BY_ZERO\n"
+    "#define DSL_DIVISION_BY_ZERO() __builtin_trap()\n"
+    "#endif\n"
+    "\n"
+    "static inline int32_t wrap_div(int32_t a, int32_t b)\n"
+    "{\n"
+    "    if (b == 0)\n"
+    "    {\n"
+    "        DSL_DIVISION_BY_ZERO();\n"
+    "    }\n"
+    "    return b == -1 ? wrap_neg(a) : a / b;\n"
+    "}\n";
+
+// Report an error at a token, quoting its lexeme
+static void report_c_error(CGenerator *generator, int token, const char *format)
+{
+    char message[256];
+    int length;
+    const char *lexeme = get_token_lexeme(generator->token_stream, token, &length);
+    snprintf(message, sizeof(message), format, length > 64 ? 64 : length, lexeme);
+    add_new_error(generator->error_list, generator->token_stream->lines[token],
+                  generator->token_stream->columns[token], CODEGEN, message);
+}
+
+// Count one more level of nesting, reporting it at token the first time it is too deep
+static int enter_nesting(CGenerator *generator, int token)
+{
+    if (++generator->depth <= MAX_C_BACKEND_DEPTH)
+    {
+        return 1;
+    }
+    if (generator->depth == MAX_C_BACKEND_DEPTH + 1)
+    {
+        report_c_error(generator, token, "Expression nested too deeply to compile at '%.*s'");
+    }
+    return 0;
+}
+
+static void write_indent(CGenerator *generator)
+{
+    fprintf(generator->file, "%*s", generator->indent * 4, "");
+}
+
+static int bind_variable(CGenerator *generator, uint32_t symbol, uint32_t shadow)
+{
+    if (generator->binding_count == generator->binding_capacity)
+    {
+        uint32_t capacity = generator->binding_capacity ? generator->binding_capacity * 2 : 64;
+        CBinding *bindings = realloc(generator->bindings, capacity * sizeof(CBinding));
+        if (!bindings)
+        {
+            generator->out_of_memory = 1;
+            return 0;
+        }
+        generator->bindings = bindings;
+        generator->binding_capacity = capacity;
+    }
+
+    generator->bindings[generator->binding_count++] = (CBinding){symbol, shadow};
+    return 1;
+}
+
+// Shadow count a new variable named symbol gets
+static uint32_t next_shadow(CGenerator *generator, uint32_t symbol)
+{
+    for (uint32_t i = generator->binding_count; i-- > 0;)
+    {
+        if (generator->bindings[i].symbol == symbol)
+        {
+            return generator->bindings[i].shadow + 1;
+        }
+    }
+    return 1;
+}
+
+// Innermost variable named by token, reporting it if there is none
+static CBinding *find_variable(CGenerator *generator, int token)
+{
+    uint32_t symbol = generator->token_stream->symbols[token];
+    for (uint32_t i = generator->binding_count; i-- > 0;)
+    {
+        if (generator->bindings[i].symbol == symbol)
+        {
+            return &generator->bindings[i];
+        }
+    }
+
+    report_c_error(generator, token, "Undefined variable '%.*s'");
+    return NULL;
+}
+
+// v_<name>, or v<shadow>_<name> for a variable hiding others, which no DSL name can clash with
+static void write_variable(CGenerator *generator, uint32_t symbol, uint32_t shadow)
+{
+    int length;
+    const char *name = get_symbol_name(generator->token_stream->symbol_table, symbol, &length);
+    if (shadow > 1)
+    {
+        fprintf(generator->file, "v%u_%.*s", shadow, length, name);
+    }
+    else
+    {
+        fprintf(generator->file, "v_%.*s", length, name);
+    }
+}
+
+static void write_function_name(CGenerator *generator, FILE *file, uint32_t symbol)
+{
+    int length;
+    const char *name = get_symbol_name(generator->token_stream->symbol_table, symbol, &length);
+    fprintf(file, "dsl_%.*s", length, name);
+}
+
+static uint32_t find_function(CGenerator *generator, uint32_t symbol)
+{
+    for (uint32_t i = 0; i < generator->function_count; i++)
+    {
+        if (generator->functions[i].symbol == symbol)
+        {
+            return i;
+        }
+    }
+    return UINT32_MAX;
+}
+
+// Value of a NUMBER token, reporting it if it does not fit an int
+static int32_t number_value(CGenerator *generator, int token, int report)
+{
+    int length;
+    const char *lexeme = get_token_lexeme(generator->token_stream, token, &length);
+    int64_t value = 0;
+    for (int i = 0; i < length; i++)
+    {
+        value = value * 10 + (lexeme[i] - '0');
+        if (value > INT32_MAX)
+        {
+            if (report)
+            {
+                report_c_error(generator, token, "Number '%.*s' does not fit in an int");
+            }
+            return -1;
+        }
+    }
+    return (int32_t)value;
+}
+
+// Port and bit of the GPIO_PIN node at index, reporting a pin the target does not map if asked
+static int lookup_pin(CGenerator *generator, uint32_t index, uint32_t *pin, uint32_t *port, uint32_t *bit, int report)
+{
+    int token = get_ast_node(generator->ast, index)->token;
+    int32_t number = number_value(generator, token, report);
+    if (number < 0 || number >= GPIO_PIN_COUNT || generator->target->pin_ports[number] == TARGET_NO_PORT)
+    {
+        if (report && number >= 0)
+        {
+            report_c_error(generator, token, "Pin '%.*s' is not mapped to a port of the target");
+        }
+        return 0;
+    }
+
+    *pin = (uint32_t)number;
+    *port = generator->target->pin_ports[number];
+    *bit = generator->target->pin_bits[number];
+    return 1;
+}
+
+// Ports an expression reads pins of, those it reads more than once, and whether it calls a function
+static void scan_expression(CGenerator *generator, uint32_t index, uint32_t *ports, uint32_t *repeated, int *calls)
+{
+    AST *ast = generator->ast;
+    ASTNode *node = get_ast_node(ast, index);
+    uint32_t pin, port, bit;
+
+    // Too deep to write at all, which writing reports
+    if (++generator->depth <= MAX_C_BACKEND_DEPTH)
+    {
+        if (node->type == GPIO_OPERATION)
+        {
+            if (lookup_pin(generator, get_ast_child(ast, index, 0), &pin, &port, &bit, 0))
+            {
+                *repeated |= *ports & (1u << port);
+                *ports |= 1u << port;
+            }
+        }
+        else if (node->type != CONSTANT)
+        {
+            *calls |= node->type == CALL_EXPRESSION;
+            for (uint32_t i = 0; i < node->num_children; i++)
+            {
+                scan_expression(generator, get_ast_child(ast, index, i), ports, repeated, calls);
+            }
+        }
+    }
+    generator->depth--;
+}
+
+// Read the input registers of ports into their cache variables
+static void load_ports(CGenerator *generator, uint32_t ports)
+{
+    for (uint32_t port = 0; port < generator->target->port_count; port++)
+    {
+        if (!(ports & (1u << port)))
+        {
+            continue;
+        }
+
+        const TargetPort *entry = &generator->target->ports[port];
+        write_indent(generator);
+        fprintf(generator->file, "%sport_%s_in = %s;\n", generator->declared_ports & (1u << port) ? "" : "uint32_t ",
+                entry->name, entry->input_register);
+        generator->declared_ports |= 1u << port;
+        generator->cached_ports |= 1u << port;
+        generator->used_ports |= 1u << port;
+        generator->report->port_reads++;
+        generator->report->accesses++;
+    }
+}
+
+// Before a statement evaluating the expression at index: with cached reads, read
+// the ports it needs that the block has not read yet. An expression that calls a
+// function reads its pins where they occur, and ends the block.
+static void prepare_reads(CGenerator *generator, uint32_t index)
+{
+    uint32_t ports = 0, repeated = 0;
+    int calls = 0;
+
+    generator->use_cache = 0;
+    if (!generator->target->cache_reads)
+    {
+        return;
+    }
+
+    scan_expression(generator, index, &ports, &repeated, &calls);
+    if (calls)
+    {
+        generator->cached_ports = 0;
+        return;
+    }
+    load_ports(generator, ports & ~generator->cached_ports);
+    generator->use_cache = 1;
+}
+
+static void write_pin_read(CGenerator *generator, uint32_t index)
+{
+    uint32_t pin, port, bit;
+    generator->report->pin_reads++;
+    if (!lookup_pin(generator, get_ast_child(generator->ast, index, 0), &pin, &port, &bit, 1))
+    {
+        return;
+    }
+
+    const TargetPort *entry = &generator->target->ports[port];
+    char cache[TARGET_NAME_LENGTH + 16];
+    snprintf(cache, sizeof(cache), "port_%s_in", entry->name);
+    const char *source = generator->use_cache ? cache : entry->input_register;
+    if (!generator->use_cache)
+    {
+        generator->report->port_reads++;
+        generator->report->accesses++;
+    }
+
+    generator->used_ports |= 1u << port;
+    if (bit == 0)
+    {
+        fprintf(generator->file, "(int32_t)(%s & 1u)", source);
+    }
+    else
+    {
+        fprintf(generator->file, "(int32_t)((%s >> %u) & 1u)", source, bit);
+    }
+}
+
+static void write_expression(CGenerator *generator, uint32_t index, int top);
+
+static void write_call(CGenerator *generator, uint32_t index)
+{
+    AST *ast = generator->ast;
+    ASTNode *node = get_ast_node(ast, index);
+    uint32_t symbol = generator->token_stream->symbols[node->token];
+    uint32_t function = find_function(generator, symbol);
+
+    if (function == UINT32_MAX)
+    {
+        report_c_error(generator, node->token, "Call to undefined function '%.*s'");
+        return;
+    }
+    if (generator->functions[function].parameter_count != node->num_children)
+    {
+        report_c_error(generator, node->token, "Wrong number of arguments in call to '%.*s'");
+        return;
+    }
+
+    write_function_name(generator, generator->file, symbol);
+    fputc('(', generator->file);
+    for (uint32_t i = 0; i < node->num_children; i++)
+    {
+        fputs(i > 0 ? ", " : "", generator->file);
+        write_expression(generator, get_ast_child(ast, index, i), 1);
+    }
+    fputc(')', generator->file);
+}
+
+// Write the expression at index. Operators other than the top one are
+// parenthesized, arithmetic goes through the wrap_ helpers.
+static void write_expression(CGenerator *generator, uint32_t index, int top)
+{
+    AST *ast = generator->ast;
+    ASTNode *node = get_ast_node(ast, index);
+    TokenType type = generator->token_stream->types[node->token];
+    FILE *file = generator->file;
+    CBinding *binding;
+    int length;
+    const char *lexeme;
+
+    if (!enter_nesting(generator, node->token))
+    {
+        generator->depth--;
+        return;
+    }
+
+    switch (node->type)
+    {
+    case NUMBER_LITERAL:
+        fprintf(file, "%d", number_value(generator, node->token, 1));
+        break;
+    case BOOL_VALUE:
+        fprintf(file, "%d", type == TOKEN_TRUE);
+        break;
+    case CONSTANT:
+        // INT32_MIN has no literal
+        if (node->value == INT32_MIN)
+        {
+            fprintf(file, "(-2147483647 - 1)");
+        }
+        else
+        {
+            fprintf(file, "%d", node->value);
+        }
+        break;
+    case IDENTIFIER:
+        binding = find_variable(generator, node->token);
+        if (binding)
+        {
+            write_variable(generator, binding->symbol, binding->shadow);
+        }
+        break;
+    case UNARY_EXPRESSION:
+        fputs(type == TOKEN_NOT ? "!" : "wrap_neg(", file);
+        write_expression(generator, get_ast_child(ast, index, 0), type != TOKEN_NOT);
+        fputs(type == TOKEN_NOT ? "" : ")", file);
+        break;
+    case BINARY_EXPRESSION:
+        if (type == TOKEN_PLUS || type == TOKEN_MINUS || type == TOKEN_STAR || type == TOKEN_SLASH)
+        {
+            fprintf(file, "wrap_%s(", type == TOKEN_PLUS ? "add" : type == TOKEN_MINUS ? "sub" : type == TOKEN_STAR ? "mul" : "div");
+            write_expression(generator, get_ast_child(ast, index, 0), 1);
+            fputs(", ", file);
+            write_expression(generator, get_ast_child(ast, index, 1), 1);
+            fputc(')', file);
+        }
+        else
+        {
+            // Comparisons, && and || are spelled as in C and give 0 or 1 as in the VM
+            lexeme = get_token_lexeme(generator->token_stream, node->token, &length);
+            fputs(top ? "" : "(", file);
+            write_expression(generator, get_ast_child(ast, index, 0), 0);
+            fprintf(file, " %.*s ", length, lexeme);
+            write_expression(generator, get_ast_child(ast, index, 1), 0);
+            fputs(top ? "" : ")", file);
+        }
+        break;
+    case CALL_EXPRESSION:
+        write_call(generator, index);
+        break;
+    case GPIO_OPERATION:
+        write_pin_read(generator, index);
+        break;
+    default:
+        report_c_error(generator, node->token, "Cannot compile expression at '%.*s'");
+        break;
+    }
+
+    generator->depth--;
+}
+
+static int is_set_pin(CGenerator *generator, uint32_t index)
+{
+    ASTNode *node = get_ast_node(generator->ast, index);
+    return node->type == GPIO_OPERATION && node->num_children == 2;
+}
+
+// Write the run of SET_PIN statements starting at child first of a statement
+// list as one update per port, returning the child after the run. A pin set
+// twice ends the run, so every level the program sets is still driven.
+static uint32_t write_pin_writes(CGenerator *generator, uint32_t list, uint32_t first)
+{
+    AST *ast = generator->ast;
+    ASTNode *node = get_ast_node(ast, list);
+    uint32_t set[TARGET_MAX_PORTS] = {0}, clear[TARGET_MAX_PORTS] = {0};
+    uint32_t order[TARGET_MAX_PORTS], order_count = 0, touched = 0;
+    uint64_t pins = 0;
+    uint32_t i;
+
+    for (i = first; i < node->num_children; i++)
+    {
+        uint32_t index = get_ast_child(ast, list, i);
+        uint32_t pin, port, bit;
+        if (!is_set_pin(generator, index))
+        {
+            break;
+        }
+        if (!lookup_pin(generator, get_ast_child(ast, index, 0), &pin, &port, &bit, 1))
+        {
+            continue;
+        }
+        if (pins & (1ull << pin))
+        {
+            break;
+        }
+
+        pins |= 1ull << pin;
+        generator->report->pin_writes++;
+        if (!(touched & (1u << port)))
+        {
+            touched |= 1u << port;
+            order[order_count++] = port;
+        }
+
+        ASTNode *level = get_ast_node(ast, get_ast_child(ast, index, 1));
+        if (generator->token_stream->types[level->token] == TOKEN_HIGH)
+        {
+            set[port] |= 1u << bit;
+        }
+        else
+        {
+            clear[port] |= 1u << bit;
+        }
+    }
+
+    for (uint32_t j = 0; j < order_count; j++)
+    {
+        uint32_t port = order[j];
+        const TargetPort *entry = &generator->target->ports[port];
+        if (entry->clear_register[0])
+        {
+            if (set[port])
+            {
+                write_indent(generator);
+                fprintf(generator->file, "%s = 0x%Xu;\n", entry->set_register, set[port]);
+                generator->report->port_writes++;
+                generator->report->accesses++;
+            }
+            if (clear[port])
+            {
+                write_indent(generator);
+                fprintf(generator->file, "%s = 0x%Xu;\n", entry->clear_register, clear[port]);
+                generator->report->port_writes++;
+                generator->report->accesses++;
+            }
+        }
+        else
+        {
+            write_indent(generator);
+            if (set[port] && clear[port])
+            {
+                fprintf(generator->file, "%s = (%s | 0x%Xu) & ~0x%Xu;\n", entry->set_register, entry->set_register,
+                        set[port], clear[port]);
+            }
+            else if (set[port])
+            {
+                fprintf(generator->file, "%s |= 0x%Xu;\n", entry->set_register, set[port]);
+            }
+            else
+            {
+                fprintf(generator->file, "%s &= ~0x%Xu;\n", entry->set_register, clear[port]);
+            }
+            generator->report->port_writes++;
+            generator->report->accesses += 2;
+        }
+
+        // A pin written can read back differently
+        generator->used_ports |= 1u << port;
+        generator->cached_ports &= ~(1u << port);
+    }
+
+    return i > first ? i : first + 1;
+}
+
+static void write_statement(CGenerator *generator, uint32_t index);
+
+static void write_statements(CGenerator *generator, uint32_t list)
+{
+    ASTNode *node = get_ast_node(generator->ast, list);
+    for (uint32_t i = 0; i < node->num_children && !generator->out_of_memory;)
+    {
+        uint32_t index = get_ast_child(generator->ast, list, i);
+        if (is_set_pin(generator, index))
+        {
+            i = write_pin_writes(generator, list, i);
+        }
+        else
+        {
+            write_statement(generator, index);
+            i++;
+        }
+    }
+}
+
+// A braced block, its variables go out of scope at its end and it starts with nothing cached
+static void write_block(CGenerator *generator, uint32_t list)
+{
+    uint32_t saved_binding_count = generator->binding_count;
+    uint32_t saved_declared_ports = generator->declared_ports;
+
+    write_indent(generator);
+    fputs("{\n", generator->file);
+    generator->indent++;
+    generator->cached_ports = 0;
+    write_statements(generator, list);
+    generator->indent--;
+    write_indent(generator);
+    fputs("}\n", generator->file);
+
+    generator->binding_count = saved_binding_count;
+    generator->declared_ports = saved_declared_ports;
+    generator->cached_ports = 0;
+}
+
+// A condition that reads a port more than once is tested at the top of an
+// endless loop, after one read of each port it needs
+static void write_while_loop(CGenerator *generator, uint32_t index)
+{
+    AST *ast = generator->ast;
+    uint32_t condition = get_ast_child(ast, index, 0), body = get_ast_child(ast, index, 1);
+    uint32_t ports = 0, repeated = 0;
+    int calls = 0;
+
+    generator->cached_ports = 0;
+    if (generator->target->cache_reads)
+    {
+        scan_expression(generator, condition, &ports, &repeated, &calls);
+    }
+
+    if (!calls && repeated)
+    {
+        uint32_t saved_binding_count = generator->binding_count;
+        uint32_t saved_declared_ports = generator->declared_ports;
+
+        write_indent(generator);
+        fputs("for (;;)\n", generator->file);
+        write_indent(generator);
+        fputs("{\n", generator->file);
+        generator->indent++;
+        load_ports(generator, ports);
+        generator->use_cache = 1;
+        write_indent(generator);
+        fputs("if (!", generator->file);
+        write_expression(generator, condition, 0);
+        fputs(")\n", generator->file);
+        write_indent(generator);
+        fprintf(generator->file, "{\n%*sbreak;\n", (generator->indent + 1) * 4, "");
+        write_indent(generator);
+        fputs("}\n", generator->file);
+        generator->cached_ports = 0;
+        write_statements(generator, body);
+        generator->indent--;
+        write_indent(generator);
+        fputs("}\n", generator->file);
+
+        generator->binding_count = saved_binding_count;
+        generator->declared_ports = saved_declared_ports;
+    }
+    else
+    {
+        generator->use_cache = 0;
+        write_indent(generator);
+        fputs("while (", generator->file);
+        write_expression(generator, condition, 1);
+        fputs(")\n", generator->file);
+        write_block(generator, body);
+    }
+
+    generator->cached_ports = 0;
+}
+
+// A READ_PIN whose value is dropped only has to read the port, if the block has not
+static void write_dropped_read(CGenerator *generator, uint32_t index)
+{
+    uint32_t pin, port, bit;
+    prepare_reads(generator, index);
+    generator->report->pin_reads++;
+    if (lookup_pin(generator, get_ast_child(generator->ast, index, 0), &pin, &port, &bit, 1) && !generator->use_cache)
+    {
+        write_indent(generator);
+        fprintf(generator->file, "(void)%s;\n", generator->target->ports[port].input_register);
+        generator->used_ports |= 1u << port;
+        generator->report->port_reads++;
+        generator->report->accesses++;
+    }
+}
+
+static void write_statement(CGenerator *generator, uint32_t index)
+{
+    AST *ast = generator->ast;
+    ASTNode *node = get_ast_node(ast, index);
+    FILE *file = generator->file;
+    uint32_t symbol, shadow, child;
+    CBinding *binding;
+
+    if (!enter_nesting(generator, node->token))
+    {
+        generator->depth--;
+        return;
+    }
+
+    switch (node->type)
+    {
+    case IDENTIFIER_DECLARATION:
+    case IDENTIFIER_DEFINITION:
+        // The name is bound once its value is written, so the value cannot refer to it
+        symbol = generator->token_stream->symbols[node->token];
+        shadow = next_shadow(generator, symbol);
+        if (node->type == IDENTIFIER_DEFINITION)
+        {
+            prepare_reads(generator, get_ast_child(ast, index, 0));
+        }
+        write_indent(generator);
+        fputs("int32_t ", file);
+        write_variable(generator, symbol, shadow);
+        fputs(" = ", file);
+        if (node->type == IDENTIFIER_DEFINITION)
+        {
+            write_expression(generator, get_ast_child(ast, index, 0), 1);
+        }
+        else
+        {
+            fputc('0', file);
+        }
+        fputs(";\n", file);
+        bind_variable(generator, symbol, shadow);
+        break;
+    case ASSIGNMENT:
+        prepare_reads(generator, get_ast_child(ast, index, 0));
+        binding = find_variable(generator, node->token);
+        write_indent(generator);
+        if (binding)
+        {
+            write_variable(generator, binding->symbol, binding->shadow);
+        }
+        fputs(" = ", file);
+        write_expression(generator, get_ast_child(ast, index, 0), 1);
+        fputs(";\n", file);
+        break;
+    case CONDITIONAL:
+        prepare_reads(generator, get_ast_child(ast, index, 0));
+        write_indent(generator);
+        fputs("if (", file);
+        write_expression(generator, get_ast_child(ast, index, 0), 1);
+        fputs(")\n", file);
+        write_block(generator, get_ast_child(ast, index, 1));
+        if (node->num_children == 3)
+        {
+            write_indent(generator);
+            fputs("else\n", file);
+            write_block(generator, get_ast_child(ast, index, 2));
+        }
+        break;
+    case WHILE_LOOP:
+        write_while_loop(generator, index);
+        break;
+    case RETURN_STATEMENT:
+        prepare_reads(generator, get_ast_child(ast, index, 0));
+        write_indent(generator);
+        fputs("return ", file);
+        write_expression(generator, get_ast_child(ast, index, 0), 1);
+        fputs(";\n", file);
+        break;
+    case GPIO_OPERATION:
+        write_dropped_read(generator, index);
+        break;
+    default:
+        child = get_ast_child(ast, index, 0);
+        if (get_ast_node(ast, child)->type == GPIO_OPERATION)
+        {
+            write_dropped_read(generator, child);
+            break;
+        }
+        prepare_reads(generator, child);
+        write_indent(generator);
+        if (get_ast_node(ast, child)->type != CALL_EXPRESSION)
+        {
+            fputs("(void)", file);
+        }
+        write_expression(generator, child, get_ast_node(ast, child)->type == CALL_EXPRESSION);
+        fputs(";\n", file);
+        break;
+    }
+
+    generator->depth--;
+}
+
+static void write_function(CGenerator *generator, uint32_t index)
+{
+    AST *ast = generator->ast;
+    uint32_t parameters = get_ast_child(ast, index, 0), body = get_ast_child(ast, index, 1);
+    ASTNode *parameter_list = get_ast_node(ast, parameters);
+    ASTNode *body_list = get_ast_node(ast, body);
+    FILE *file = generator->file;
+
+    generator->binding_count = 0;
+    generator->cached_ports = 0;
+    generator->declared_ports = 0;
+
+    fputs("\nint32_t ", file);
+    write_function_name(generator, file, generator->token_stream->symbols[get_ast_node(ast, index)->token]);
+    fputc('(', file);
+    for (uint32_t i = 0; i < parameter_list->num_children; i++)
+    {
+        uint32_t symbol = generator->token_stream->symbols[get_ast_node(ast, get_ast_child(ast, parameters, i))->token];
+        uint32_t shadow = next_shadow(generator, symbol);
+        fputs(i > 0 ? ", int32_t " : "int32_t ", file);
+        write_variable(generator, symbol, shadow);
+        bind_variable(generator, symbol, shadow);
+    }
+    fputs(parameter_list->num_children ? ")\n{\n" : "void)\n{\n", file);
+
+    generator->indent = 1;
+    write_statements(generator, body);
+
+    // Falling off the end returns 0
+    if (body_list->num_children == 0 ||
+        get_ast_node(ast, get_ast_child(ast, body, body_list->num_children - 1))->type != RETURN_STATEMENT)
+    {
+        fputs("    return 0;\n", file);
+    }
+    fputs("}\n", file);
+    generator->indent = 0;
+}
+
+// Includes, register declarations, helpers and a prototype of every function
+static void write_c_prelude(CGenerator *generator, FILE *file)
+{
+    const TargetConfig *target = generator->target;
+    fputs("// Generated by the DSL compiler\n#include <stdint.h>\n", file);
+
+    if (target->header[0])
+    {
+        fprintf(file, target->header[0] == '<' || target->header[0] == '"' ? "#include %s\n" : "#include \"%s\"\n",
+                target->header);
+    }
+    else
+    {
+        // Without a header, registers named by identifiers are declared here and left for the linker
+        for (uint32_t port = 0; port < target->port_count; port++)
+        {
+            const TargetPort *entry = &target->ports[port];
+            const char *registers[] = {entry->set_register, entry->clear_register, entry->input_register};
+            for (int i = 0; i < 3 && (generator->used_ports & (1u << port)); i++)
+            {
+                const char *name = registers[i];
+                if (*name && strspn(name, "_0123456789abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ") ==
+                                 strlen(name))
+                {
+                    fprintf(file, "extern volatile uint32_t %s;\n", name);
+                }
+            }
+        }
+    }
+
+    fputs(c_helpers, file);
+
+    fputc('\n', file);
+    for (uint32_t f = 0; f < generator->function_count; f++)
+    {
+        fputs("int32_t ", file);
+        write_function_name(generator, file, generator->functions[f].symbol);
+        fputc('(', file);
+        for (uint32_t i = 0; i < generator->functions[f].parameter_count; i++)
+        {
+            fputs(i > 0 ? ", int32_t" : "int32_t", file);
+        }
+        fputs(generator->functions[f].parameter_count ? ");\n" : "void);\n", file);
+    }
+}
+
+int generate_c_program(AST *ast, const TargetConfig *target, FILE *file, CBackendReport *report,
+                       ErrorList *error_list)
+{
+    if (!ast || ast->root == AST_NO_NODE)
+    {
+        add_new_error(error_list, 0, 0, CODEGEN, "Invalid AST passed");
+        return 0;
+    }
+
+    ASTNode *root = get_ast_node(ast, ast->root);
+    *report = (CBackendReport){0};
+    CGenerator generator = {
+        .ast = ast,
+        .token_stream = ast->token_stream,
+        .target = target,
+        .report = report,
+        .error_list = error_list,
+        .error_base = error_list ? error_list->size : 0,
+    };
+
+    char *body = NULL;
+    size_t body_length = 0;
+    generator.functions = malloc((root->num_children ? root->num_children : 1) * sizeof(CFunction));
+    generator.file = generator.functions ? open_memstream(&body, &body_length) : NULL;
+    if (!generator.file)
+    {
+        free(generator.functions);
+        add_new_error(error_list, 0, 0, CODEGEN, "Failed to allocate C output");
+        return 0;
+    }
+
+    // Every function is known before any body, so calls can go forwards
+    for (uint32_t i = 0; i < root->num_children; i++)
+    {
+        uint32_t function = get_ast_child(ast, ast->root, i);
+        uint32_t symbol = generator.token_stream->symbols[get_ast_node(ast, function)->token];
+        if (find_function(&generator, symbol) != UINT32_MAX)
+        {
+            report_c_error(&generator, get_ast_node(ast, function)->token, "Function '%.*s' is defined more than once");
+            continue;
+        }
+        generator.functions[generator.function_count++] =
+            (CFunction){symbol, get_ast_node(ast, get_ast_child(ast, function, 0))->num_children};
+    }
+
+    for (uint32_t i = 0, f = 0; i < root->num_children && !generator.out_of_memory; i++)
+    {
+        uint32_t function = get_ast_child(ast, ast->root, i);
+        if (find_function(&generator, generator.token_stream->symbols[get_ast_node(ast, function)->token]) == f)
+        {
+            write_function(&generator, function);
+            f++;
+        }
+    }
+
+    fclose(generator.file);
+    free(generator.bindings);
+
+    if (generator.out_of_memory || !body)
+    {
+        add_new_error(error_list, 0, 0, CODEGEN, "Out of memory while generating C");
+    }
+    if (generator.out_of_memory || !body || (error_list && error_list->size > generator.error_base))
+    {
+        free(generator.functions);
+        free(body);
+        return 0;
+    }
+
+    report->naive_accesses = 2 * report->pin_writes + report->pin_reads;
+    write_c_prelude(&generator, file);
+    fwrite(body, 1, body_length, file);
+    fputs("\n// ", file);
+    print_c_backend_report(report, file);
+
+    free(generator.functions);
+    free(body);
+    return 1;
+}
+
+void print_c_backend_report(CBackendReport *report, FILE *file)
+{
+    fprintf(file, "c backend: %u SET_PIN in %u port writes, %u READ_PIN in %u port reads, "
+            "%u register accesses down to %u\n", report->pin_writes, report->port_writes, report->pin_reads,
+            report->port_reads, report->naive_accesses, report->accesses);
+}
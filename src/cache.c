@@ -0,0 +1,527 @@
+#include "cache.h"
+#include "version.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#define CACHE_ENTRY_MAGIC "DSLC"
+#define CACHE_ENTRY_FORMAT 6
+#define CACHE_ENTRY_SUFFIX ".entry"
+#define CACHE_TEMP_PREFIX ".tmp-"
+
+// Entries bigger than this are not ours, even a file full of errors with its C and
+// serialized outputs stays below it
+#define MAX_CACHE_ENTRY_SIZE (256 * 1024 * 1024)
+
+// Temporary files left behind by a compiler that died mid-write are removed after this long
+#define STALE_TEMP_SECONDS 600
+
+// Entry layout, all fields in host byte order as the cache never leaves the machine:
+//   magic[4] format(u32) key[32] succeeded(u32) error_count(u32) dropped_count(u32) output_count(u32)
+//   checksum(u64)
+//   then per error: line(i32) column(i32) last_column(i32) count(u32) stage(u32) message_length(u32)
+//   message bytes
+//   then per output: present(u32) reserved(u32) size(u64) bytes
+// The checksum covers everything after the header.
+typedef struct {
+    char magic[4];
+    uint32_t format;
+    unsigned char key[SHA256_DIGEST_SIZE];
+    uint32_t succeeded;
+    uint32_t error_count;
+    uint32_t dropped_count;   // Errors past the error limit, counted but not stored
+    uint32_t output_count;
+    uint64_t checksum;
+} CacheEntryHeader;
+
+typedef struct {
+    int32_t line;
+    int32_t column;
+    int32_t last_column;      // Of a run of the same error, see Error
+    uint32_t count;
+    uint32_t stage;
+    uint32_t message_length;
+} CacheEntryError;
+
+typedef struct {
+    uint32_t present;
+    uint32_t reserved;
+    uint64_t size;
+} CacheEntryOutput;
+
+// FNV-1a, enough to catch a damaged entry
+static uint64_t checksum_bytes(const unsigned char *data, size_t size)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+CompilationCache *create_compilation_cache(const char *directory, size_t max_bytes)
+{
+    if (!directory || !*directory || (mkdir(directory, 0777) != 0 && errno != EEXIST))
+    {
+        return NULL;
+    }
+
+    CompilationCache *cache = calloc(1, sizeof(CompilationCache));
+    if (!cache)
+    {
+        return NULL;
+    }
+
+    cache->directory = strdup(directory);
+    if (!cache->directory)
+    {
+        free(cache);
+        return NULL;
+    }
+    cache->max_bytes = max_bytes ? max_bytes : DEFAULT_CACHE_MAX_BYTES;
+    pthread_mutex_init(&cache->lock, NULL);
+    return cache;
+}
+
+void free_compilation_cache(CompilationCache *cache)
+{
+    if (!cache)
+    {
+        return;
+    }
+
+    pthread_mutex_destroy(&cache->lock);
+    free(cache->directory);
+    free(cache);
+}
+
+CacheKey compute_cache_key(const char *source, size_t length, const char *options)
+{
+    // Every part but the source is NUL-terminated, so no two inputs hash the same bytes
+    static const char domain[] = "dsl-compilation-cache";
+    uint64_t source_length = length;
+    Sha256 sha;
+    CacheKey key;
+
+    sha256_init(&sha);
+    sha256_update(&sha, domain, sizeof(domain));
+    sha256_update(&sha, COMPILER_VERSION, sizeof(COMPILER_VERSION));
+    sha256_update(&sha, options ? options : "", options ? strlen(options) + 1 : 1);
+    sha256_update(&sha, &source_length, sizeof(source_length));
+    if (length > 0)
+    {
+        sha256_update(&sha, source, length);
+    }
+    sha256_final(&sha, key.bytes);
+    return key;
+}
+
+// directory/<hex digest>.entry
+static void get_entry_path(CompilationCache *cache, const CacheKey *key, char *path, size_t size)
+{
+    char hex[SHA256_DIGEST_SIZE * 2 + 1];
+    for (int i = 0; i < SHA256_DIGEST_SIZE; i++)
+    {
+        snprintf(hex + i * 2, 3, "%02x", key->bytes[i]);
+    }
+    snprintf(path, size, "%s/%s%s", cache->directory, hex, CACHE_ENTRY_SUFFIX);
+}
+
+static void count_lookup(CompilationCache *cache, int hit)
+{
+    pthread_mutex_lock(&cache->lock);
+    if (hit)
+    {
+        cache->hits++;
+    }
+    else
+    {
+        cache->misses++;
+    }
+    pthread_mutex_unlock(&cache->lock);
+}
+
+// Read the whole entry file, NULL if it is missing or implausibly large
+static unsigned char *read_entry(const char *path, size_t *size)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+
+    struct stat info;
+    unsigned char *data = NULL;
+    if (fstat(fd, &info) == 0 && info.st_size >= (off_t)sizeof(CacheEntryHeader) && info.st_size <= MAX_CACHE_ENTRY_SIZE)
+    {
+        data = malloc(info.st_size);
+        size_t total = 0;
+        while (data && total < (size_t)info.st_size)
+        {
+            ssize_t count = read(fd, data + total, info.st_size - total);
+            if (count <= 0)
+            {
+                free(data);
+                data = NULL;
+                break;
+            }
+            total += count;
+        }
+        *size = total;
+    }
+
+    close(fd);
+    return data;
+}
+
+// Check an entry from end to end before replaying any of it, so a damaged file is a miss
+static int validate_entry(const unsigned char *data, size_t size, const CacheKey *key, int output_count)
+{
+    const CacheEntryHeader *header = (const CacheEntryHeader *)data;
+    if (memcmp(header->magic, CACHE_ENTRY_MAGIC, 4) != 0 || header->format != CACHE_ENTRY_FORMAT ||
+        memcmp(header->key, key->bytes, SHA256_DIGEST_SIZE) != 0 || header->succeeded > 1 ||
+        header->output_count != (uint32_t)output_count ||
+        header->checksum != checksum_bytes(data + sizeof(CacheEntryHeader), size - sizeof(CacheEntryHeader)))
+    {
+        return 0;
+    }
+
+    size_t offset = sizeof(CacheEntryHeader);
+    for (uint32_t i = 0; i < header->error_count; i++)
+    {
+        CacheEntryError error;
+        if (size - offset < sizeof(error))
+        {
+            return 0;
+        }
+        memcpy(&error, data + offset, sizeof(error));
+        offset += sizeof(error);
+        if (error.message_length >= MAX_ERROR_MESSAGE_LENGTH || size - offset < error.message_length ||
+            error.stage > RUNTIME || error.last_column < error.column || error.count == 0)
+        {
+            return 0;
+        }
+        offset += error.message_length;
+    }
+    for (uint32_t i = 0; i < header->output_count; i++)
+    {
+        CacheEntryOutput output;
+        if (size - offset < sizeof(output))
+        {
+            return 0;
+        }
+        memcpy(&output, data + offset, sizeof(output));
+        offset += sizeof(output);
+        if (output.present > 1 || (!output.present && output.size != 0) || size - offset < output.size)
+        {
+            return 0;
+        }
+        offset += output.size;
+    }
+    return offset == size;
+}
+
+int lookup_compilation_cache(CompilationCache *cache, const CacheKey *key, ErrorList *error_list, int *succeeded,
+                             CacheOutput *outputs, int output_count)
+{
+    char path[4096];
+    get_entry_path(cache, key, path, sizeof(path));
+
+    size_t size = 0;
+    unsigned char *data = read_entry(path, &size);
+    if (!data || !validate_entry(data, size, key, output_count))
+    {
+        free(data);
+        count_lookup(cache, 0);
+        return 0;
+    }
+
+    // Copy the outputs first, running out of memory for them is only a miss
+    const CacheEntryHeader *header = (const CacheEntryHeader *)data;
+    size_t offset = sizeof(CacheEntryHeader);
+    for (uint32_t i = 0; i < header->error_count; i++)
+    {
+        CacheEntryError error;
+        memcpy(&error, data + offset, sizeof(error));
+        offset += sizeof(error) + error.message_length;
+    }
+    for (int i = 0; i < output_count; i++)
+    {
+        CacheEntryOutput output;
+        memcpy(&output, data + offset, sizeof(output));
+        offset += sizeof(output);
+        outputs[i].data = output.present ? malloc(output.size + 1) : NULL;
+        outputs[i].size = output.size;
+        if (output.present && !outputs[i].data)
+        {
+            for (int j = 0; j < i; j++)
+            {
+                free(outputs[j].data);
+            }
+            free(data);
+            count_lookup(cache, 0);
+            return 0;
+        }
+        if (output.present)
+        {
+            memcpy(outputs[i].data, data + offset, output.size);
+            outputs[i].data[output.size] = '\0';
+        }
+        offset += output.size;
+    }
+
+    offset = sizeof(CacheEntryHeader);
+    for (uint32_t i = 0; i < header->error_count; i++)
+    {
+        CacheEntryError error;
+        char message[MAX_ERROR_MESSAGE_LENGTH];
+        memcpy(&error, data + offset, sizeof(error));
+        offset += sizeof(error);
+        memcpy(message, data + offset, error.message_length);
+        message[error.message_length] = '\0';
+        offset += error.message_length;
+
+        // A run is stored as one record, so it is replayed as one
+        int size = error_list->size;
+        add_new_error(error_list, error.line, error.column, (ErrorStage)error.stage, message);
+        if (error_list->size > size)
+        {
+            error_list->errors[size].count = error.count;
+            error_list->errors[size].last_column = error.last_column;
+        }
+    }
+    error_list->dropped += header->dropped_count;
+    *succeeded = header->succeeded != 0;
+    free(data);
+
+    // Mark it as just used for eviction, failing that only makes it look older
+    utimensat(AT_FDCWD, path, NULL, 0);
+    count_lookup(cache, 1);
+    return 1;
+}
+
+// Write all of data to fd
+static int write_all(int fd, const unsigned char *data, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t count = write(fd, data, size);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return 0;
+        }
+        data += count;
+        size -= count;
+    }
+    return 1;
+}
+
+int store_compilation_cache(CompilationCache *cache, const CacheKey *key, ErrorList *error_list, int succeeded,
+                            const CacheOutput *outputs, int output_count)
+{
+    // Entries hold messages as text, so a hit needs nothing the compilation had
+    char buffer[MAX_ERROR_MESSAGE_LENGTH];
+    int error_count = error_list ? error_list->size : 0;
+    size_t size = sizeof(CacheEntryHeader);
+    for (int i = 0; i < error_count; i++)
+    {
+        size += sizeof(CacheEntryError) + strlen(format_error_message(error_list, &error_list->errors[i], buffer));
+    }
+    for (int i = 0; i < output_count; i++)
+    {
+        size += sizeof(CacheEntryOutput) + (outputs[i].data ? outputs[i].size : 0);
+    }
+    if (size > MAX_CACHE_ENTRY_SIZE)
+    {
+        return 0;
+    }
+
+    unsigned char *data = malloc(size);
+    if (!data)
+    {
+        return 0;
+    }
+
+    size_t offset = sizeof(CacheEntryHeader);
+    for (int i = 0; i < error_count; i++)
+    {
+        Error *error = &error_list->errors[i];
+        const char *message = format_error_message(error_list, error, buffer);
+        CacheEntryError record = {error->line, error->column, error->last_column, error->count, error->stage,
+                                   strlen(message)};
+        memcpy(data + offset, &record, sizeof(record));
+        offset += sizeof(record);
+        memcpy(data + offset, message, record.message_length);
+        offset += record.message_length;
+    }
+    for (int i = 0; i < output_count; i++)
+    {
+        CacheEntryOutput record = {outputs[i].data != NULL, 0, outputs[i].data ? outputs[i].size : 0};
+        memcpy(data + offset, &record, sizeof(record));
+        offset += sizeof(record);
+        if (record.size > 0)
+        {
+            memcpy(data + offset, outputs[i].data, record.size);
+            offset += record.size;
+        }
+    }
+
+    CacheEntryHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_ENTRY_MAGIC, 4);
+    header.format = CACHE_ENTRY_FORMAT;
+    memcpy(header.key, key->bytes, SHA256_DIGEST_SIZE);
+    header.succeeded = succeeded != 0;
+    header.error_count = error_count;
+    header.dropped_count = error_list ? error_list->dropped : 0;
+    header.output_count = output_count;
+    header.checksum = checksum_bytes(data + sizeof(header), size - sizeof(header));
+    memcpy(data, &header, sizeof(header));
+
+    // Unique per process and per store, so concurrent writers never share a temporary file
+    pthread_mutex_lock(&cache->lock);
+    unsigned long temp_id = cache->next_temp_id++;
+    pthread_mutex_unlock(&cache->lock);
+
+    char temp_path[4096], path[4096];
+    snprintf(temp_path, sizeof(temp_path), "%s/%s%ld-%lu", cache->directory, CACHE_TEMP_PREFIX, (long)getpid(), temp_id);
+    get_entry_path(cache, key, path, sizeof(path));
+
+    int fd = open(temp_path, O_WRONLY | O_CREAT | O_EXCL, 0666);
+    int written = fd >= 0 && write_all(fd, data, size);
+    if (fd >= 0 && close(fd) != 0)
+    {
+        written = 0;
+    }
+    free(data);
+
+    // rename replaces any entry another compiler stored for the same key in one step
+    if (!written || rename(temp_path, path) != 0)
+    {
+        unlink(temp_path);
+        return 0;
+    }
+
+    pthread_mutex_lock(&cache->lock);
+    cache->stores++;
+    pthread_mutex_unlock(&cache->lock);
+    return 1;
+}
+
+typedef struct {
+    char *name;
+    long long last_used; // Modification time in nanoseconds
+    off_t size;
+} CacheFile;
+
+static int compare_last_used(const void *a, const void *b)
+{
+    const CacheFile *x = a, *y = b;
+    return (x->last_used > y->last_used) - (x->last_used < y->last_used);
+}
+
+void trim_compilation_cache(CompilationCache *cache)
+{
+    DIR *directory = opendir(cache->directory);
+    if (!directory)
+    {
+        return;
+    }
+
+    CacheFile *files = NULL;
+    size_t file_count = 0, file_capacity = 0, total_size = 0;
+    time_t now = time(NULL);
+    char path[4096];
+    struct dirent *entry;
+
+    while ((entry = readdir(directory)) != NULL)
+    {
+        size_t name_length = strlen(entry->d_name);
+        int is_entry = name_length > strlen(CACHE_ENTRY_SUFFIX) &&
+                       strcmp(entry->d_name + name_length - strlen(CACHE_ENTRY_SUFFIX), CACHE_ENTRY_SUFFIX) == 0;
+        int is_temp = strncmp(entry->d_name, CACHE_TEMP_PREFIX, strlen(CACHE_TEMP_PREFIX)) == 0;
+        struct stat info;
+
+        snprintf(path, sizeof(path), "%s/%s", cache->directory, entry->d_name);
+        if ((!is_entry && !is_temp) || stat(path, &info) != 0)
+        {
+            continue;
+        }
+
+        if (is_temp)
+        {
+            if (now - info.st_mtime > STALE_TEMP_SECONDS)
+            {
+                unlink(path);
+            }
+            continue;
+        }
+
+        if (file_count == file_capacity)
+        {
+            size_t new_capacity = file_capacity ? file_capacity * 2 : 64;
+            CacheFile *new_files = realloc(files, new_capacity * sizeof(CacheFile));
+            if (!new_files)
+            {
+                break;
+            }
+            files = new_files;
+            file_capacity = new_capacity;
+        }
+
+        files[file_count].name = strdup(entry->d_name);
+        files[file_count].last_used = info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+        files[file_count].size = info.st_size;
+        if (files[file_count].name)
+        {
+            total_size += info.st_size;
+            file_count++;
+        }
+    }
+    closedir(directory);
+
+    // Oldest first. Another compiler may be trimming too, an entry already gone still counts as freed.
+    qsort(files, file_count, sizeof(CacheFile), compare_last_used);
+    unsigned long evicted = 0;
+    for (size_t i = 0; i < file_count && total_size > cache->max_bytes; i++)
+    {
+        snprintf(path, sizeof(path), "%s/%s", cache->directory, files[i].name);
+        if (unlink(path) == 0)
+        {
+            evicted++;
+        }
+        total_size -= files[i].size;
+    }
+
+    for (size_t i = 0; i < file_count; i++)
+    {
+        free(files[i].name);
+    }
+    free(files);
+
+    pthread_mutex_lock(&cache->lock);
+    cache->evictions += evicted;
+    pthread_mutex_unlock(&cache->lock);
+}
+
+void report_cache_statistics(CompilationCache *cache, FILE *stream)
+{
+    pthread_mutex_lock(&cache->lock);
+    unsigned long lookups = cache->hits + cache->misses;
+    fprintf(stream, "Cache: %lu hits, %lu misses (%.1f%% hit rate), %lu stored, %lu evicted\n",
+            cache->hits, cache->misses, lookups ? 100.0 * cache->hits / lookups : 0.0,
+            cache->stores, cache->evictions);
+    pthread_mutex_unlock(&cache->lock);
+}
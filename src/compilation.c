@@ -0,0 +1,228 @@
+#include "compilation.h"
+#include "lexer.h"
+#include "parser.h"
+#include "token_queue.h"
+#include "semantic.h"
+#include <stdlib.h>
+#include <pthread.h>
+
+// What the lexer thread of a pipelined front end works on
+typedef struct
+{
+    TokenQueue *queue;
+    const char *input;
+    size_t length;
+    ErrorList *error_list;  // The thread's own, on the heap as the arena belongs to the parsing thread
+} LexerThread;
+
+// The parser's side of the queue
+typedef struct
+{
+    TokenQueue *queue;
+    int failed;             // Memory ran out appending a token
+} QueueFeed;
+
+CompilationContext *create_new_compilation_context()
+{
+    CompilationContext *context = calloc(1, sizeof(CompilationContext));
+    if (!context)
+    {
+        return NULL;
+    }
+
+    context->arena = create_arena(DEFAULT_ARENA_BLOCK_SIZE);
+    if (!context->arena)
+    {
+        free(context);
+        return NULL;
+    }
+
+    context->error_list = create_new_error_list(context->arena);
+    if (!context->error_list)
+    {
+        free_arena(context->arena);
+        free(context);
+        return NULL;
+    }
+
+    return context;
+}
+
+// Map the source file the compilation works on
+int load_source_file(CompilationContext *context, const char *path)
+{
+    context->source = open_source_file(path, context->error_list);
+    return context->source != NULL;
+}
+
+// Lex the loaded source into an arena-owned token stream, on lex_threads threads if it is large
+int run_lexer(CompilationContext *context)
+{
+    if (!context->source)
+    {
+        add_new_error(context->error_list, 0, 0, LEXER, "No source loaded");
+        return 0;
+    }
+
+    context->token_stream = create_new_token_stream(context->arena);
+    if (!context->token_stream)
+    {
+        add_new_error(context->error_list, 0, 0, LEXER, "Failed to initialise token stream");
+        return 0;
+    }
+
+    // Sources average well over six bytes per token, so this rarely has to grow
+    reserve_token_stream(context->token_stream, context->source->length / 6 + DEFAULT_TOKEN_STREAM_CAPACITY);
+
+    if (!lex_into_token_stream_parallel(context->token_stream, context->source->data, context->source->length,
+                                        context->error_list, context->lex_threads))
+    {
+        context->token_stream = NULL;
+        return 0;
+    }
+
+    return 1;
+}
+
+// Parse the token stream, on parse_threads threads if it is large. AST nodes come from the stream's arena.
+int run_parser(CompilationContext *context)
+{
+    context->ast = parse_token_stream_parallel(context->token_stream, context->error_list, context->parse_threads);
+    return context->ast != NULL;
+}
+
+static void *lex_on_thread(void *argument)
+{
+    LexerThread *lexer = argument;
+    lex_into_token_queue(lexer->queue, lexer->input, lexer->length, lexer->error_list);
+    return NULL;
+}
+
+// Append the next batch of tokens to the stream, interning identifiers here as
+// the symbol table lives in the parsing thread's arena
+static int feed_from_queue(void *feed_state, TokenStream *token_stream)
+{
+    QueueFeed *feed = feed_state;
+    TokenBatch *batch = feed->failed ? NULL : next_token_batch(feed->queue);
+    if (!batch)
+    {
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < batch->count; i++)
+    {
+        Token *token = &batch->tokens[i];
+        uint32_t symbol = NO_SYMBOL;
+        if (token->type == TOKEN_IDENTIFIER)
+        {
+            symbol = intern_symbol(token_stream->symbol_table, token_stream->source + token->offset, token->length);
+        }
+        if ((token->type == TOKEN_IDENTIFIER && symbol == NO_SYMBOL) ||
+            !add_new_token(token_stream, token->type, token->offset, token->length, token->line, token->column, symbol))
+        {
+            feed->failed = 1;
+            cancel_token_queue(feed->queue);
+            return 0;
+        }
+    }
+
+    release_token_batch(feed->queue);
+    return 1;
+}
+
+// Copy every error of from after those already in error_list
+static void append_errors(ErrorList *error_list, ErrorList *from)
+{
+    for (int i = 0; i < from->size; i++)
+    {
+        copy_error(error_list, from, i, from->errors[i].line, from->errors[i].column);
+    }
+    error_list->dropped += from->dropped;
+}
+
+// Lex on a second thread while this one parses the tokens as they arrive. Each
+// thread reports to a list of its own and the lists are joined afterwards, lexer
+// errors first, so the result is what run_lexer and run_parser give. Without
+// the memory or thread for a pipeline, they are simply run one after the other.
+int run_pipelined_front_end(CompilationContext *context)
+{
+    if (!context->source)
+    {
+        add_new_error(context->error_list, 0, 0, LEXER, "No source loaded");
+        return 0;
+    }
+
+    SourceBuffer *source = context->source;
+    ErrorList *lexer_errors = create_new_error_list(NULL);
+    ErrorList *parser_errors = create_new_error_list(NULL);
+    TokenQueue *queue = create_token_queue(0);
+    TokenStream *token_stream = create_new_token_stream(context->arena);
+    LexerThread lexer = {queue, source->data, source->length, lexer_errors};
+    pthread_t thread;
+    if (!lexer_errors || !parser_errors || !queue || !token_stream ||
+        pthread_create(&thread, NULL, lex_on_thread, &lexer) != 0)
+    {
+        free_error_list(lexer_errors);
+        free_error_list(parser_errors);
+        free_token_queue(queue);
+        return run_lexer(context) && run_parser(context);
+    }
+
+    lexer_errors->max_errors = context->error_list->max_errors;
+    parser_errors->max_errors = context->error_list->max_errors;
+    token_stream->source = source->data;
+    reserve_token_stream(token_stream, source->length / 6 + DEFAULT_TOKEN_STREAM_CAPACITY);
+
+    QueueFeed feed = {queue, 0};
+    AST *ast = parse_token_feed(token_stream, token_stream->capacity, feed_from_queue, &feed, parser_errors);
+
+    // A parse that stopped early leaves tokens behind, the stream still gets them all
+    while (feed_from_queue(&feed, token_stream))
+    {
+    }
+    pthread_join(thread, NULL);
+
+    int lexed = atomic_load(&queue->state) == TOKEN_QUEUE_FINISHED && !feed.failed;
+    append_errors(context->error_list, lexer_errors);
+    if (feed.failed)
+    {
+        add_new_error(context->error_list, 0, 0, LEXER, "Failed to create token");
+    }
+    if (lexed)
+    {
+        append_errors(context->error_list, parser_errors);
+    }
+
+    // Past the error limit the sequential parser would have stopped, its AST is not used
+    context->token_stream = lexed ? token_stream : NULL;
+    context->ast = lexed && !error_limit_reached(context->error_list) ? ast : NULL;
+    free_error_list(lexer_errors);
+    free_error_list(parser_errors);
+    free_token_queue(queue);
+    return context->ast != NULL;
+}
+
+// Resolve the parsed program's names and check its types
+int run_semantic_analysis(CompilationContext *context)
+{
+    return check_semantics(context->ast, context->error_list);
+}
+
+// Optimize the AST in place, the rebuilt nodes come from the same arena
+int run_optimizer(CompilationContext *context, OptimizationReport *report)
+{
+    return optimize_ast(context->ast, report, context->error_list);
+}
+
+// Release the whole compilation at once
+void free_compilation_context(CompilationContext *context)
+{
+    if (!context)
+    {
+        return;
+    }
+
+    close_source_file(context->source);
+    free_arena(context->arena);
+    free(context);
+}
@@ -2,13 +2,17 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdarg.h>
 
-const char *ErrorStageNames[] = {"LEXER", "PARSER", "CODEGEN"};
+// Read-only, so any number of compiler threads can format errors at once
+const char *const ErrorStageNames[] = {"LEXER", "PARSER", "SEMANTIC", "CODEGEN", "RUNTIME"};
 
 // Helper method to double the error list capacity
 static int resize_error_list(ErrorList *error_list)
 {
-    Error **temp_error_list = realloc(error_list->errors, error_list->capacity * 2 * sizeof(Error *));
+    Error *temp_error_list = arena_realloc(error_list->arena, error_list->errors,
+                                           error_list->capacity * sizeof(Error),
+                                           error_list->capacity * 2 * sizeof(Error));
     if (!temp_error_list)
     {
         return 0;
@@ -21,24 +25,112 @@ static int resize_error_list(ErrorList *error_list)
 }
 
 // Method to create a new error list with default capacity
-ErrorList *create_new_error_list() {
-    ErrorList *error_list = calloc(1, sizeof(ErrorList));
+ErrorList *create_new_error_list(Arena *arena) {
+    ErrorList *error_list = arena_calloc(arena, 1, sizeof(ErrorList));
     if (!error_list) {
         return NULL;
     }
 
+    error_list->arena = arena;
     error_list->capacity = DEFAULT_ERROR_LIST_CAPACITY;
     error_list->size = 0;
 
-    error_list->errors = calloc(error_list->capacity, sizeof(Error*));
+    error_list->errors = arena_calloc(arena, error_list->capacity, sizeof(Error));
     if (!error_list->errors) {
-        free(error_list);
+        arena_free(arena, error_list);
         return NULL;
     }
 
     return error_list;
 }
 
+int error_limit_reached(ErrorList *error_list)
+{
+    return error_list && error_list->max_errors > 0 && error_list->size >= error_list->max_errors;
+}
+
+// Copy text into the pool, NUL-terminated, returning its offset or UINT32_MAX if out of memory
+static uint32_t add_error_text(ErrorList *error_list, const char *text, uint32_t length)
+{
+    uint32_t needed = error_list->text_length + length + 1;
+    if (needed > error_list->text_capacity)
+    {
+        uint32_t capacity = error_list->text_capacity ? error_list->text_capacity : 256;
+        while (capacity < needed)
+        {
+            capacity *= 2;
+        }
+        char *new_text = arena_realloc(error_list->arena, error_list->text, error_list->text_capacity, capacity);
+        if (!new_text)
+        {
+            return UINT32_MAX;
+        }
+        error_list->text = new_text;
+        error_list->text_capacity = capacity;
+    }
+
+    uint32_t offset = error_list->text_length;
+    memcpy(error_list->text + offset, text, length);
+    error_list->text[offset + length] = '\0';
+    error_list->text_length = needed;
+    return offset;
+}
+
+// Whether error says what the list's last record says, at the column its run ends at or the next
+static int extends_last_error(ErrorList *error_list, Error *error, const char *text, uint32_t text_length)
+{
+    if (error_list->size == 0) {
+        return 0;
+    }
+
+    Error *last = &error_list->errors[error_list->size - 1];
+    return last->line == error->line && (error->column == last->last_column || error->column == last->last_column + 1) &&
+           last->stage == error->stage &&
+           last->code == error->code && last->details[0] == error->details[0] &&
+           last->details[1] == error->details[1] && last->text_length == text_length &&
+           (!text || memcmp(error_list->text + last->text, text, text_length) == 0);
+}
+
+// Append a record, with text (if any) copied into the pool. An error continuing the
+// last record's run only extends it. Past the error limit it is only counted.
+static void append_error(ErrorList *error_list, Error error, const char *text, uint32_t text_length)
+{
+    if (error.count == 0) {
+        error.count = 1;
+        error.last_column = error.column;
+    }
+
+    if (extends_last_error(error_list, &error, text, text_length)) {
+        Error *last = &error_list->errors[error_list->size - 1];
+        last->count += error.count;
+        last->last_column = error.last_column;
+        return;
+    }
+
+    if (error_limit_reached(error_list)) {
+        error_list->dropped++;
+        return;
+    }
+
+    // Resize list if needed
+    if (error_list->size == error_list->capacity) {
+        if (!resize_error_list(error_list)) {
+            return;
+        }
+    }
+
+    if (text) {
+        error.text = add_error_text(error_list, text, text_length);
+        error.text_length = text_length;
+        if (error.text == UINT32_MAX) {
+            return;
+        }
+    }
+
+    error_list->errors[error_list->size] = error;
+    error_list->size++;
+}
+
 // Method to create and add a new error to the error_list
 void add_new_error(ErrorList *error_list, int line, int column, ErrorStage stage, char* message) {
     if (!error_list || line < 0 || column < 0 || !message) {
@@ -46,48 +138,222 @@ void add_new_error(ErrorList *error_list, int line, int column, ErrorStage stage
     }
 
     // Check if the stage provided is a valid stage
-    if (stage < LEXER || stage > CODEGEN) {
+    if (stage < LEXER || stage > RUNTIME) {
         return;
     }
 
-    Error *error = calloc(1, sizeof(Error));
-    if (!error) {
+    // Keep only the first MAX_ERROR_MESSAGE_LENGTH - 1 characters of a longer message
+    size_t length = strnlen(message, MAX_ERROR_MESSAGE_LENGTH - 1);
+    Error error = {.line = line, .column = column, .stage = stage, .code = ERROR_TEXT};
+    append_error(error_list, error, message, (uint32_t)length);
+}
+
+void add_new_coded_error(ErrorList *error_list, int line, int column, ErrorStage stage, ErrorCode code)
+{
+    if (!error_list || line < 0 || column < 0 || stage > RUNTIME)
+    {
         return;
     }
 
-    // Copy only first 256 characters, add null at the end if the original message exceeds 256 characters
-    strncpy(error->message, message, 256);
-    error->message[255] = '\0';
-    error->line = line;
-    error->column = column;
-    error->stage = stage;
+    Error error = {.line = line, .column = column, .stage = stage, .code = code};
+    append_error(error_list, error, NULL, 0);
+}
 
-    // Resize list if needed
-    if (error_list->size == error_list->capacity) {
-        if (!resize_error_list(error_list)) {
+void add_unexpected_token_error(ErrorList *error_list, int line, int column, const char *lexeme, int length,
+                                const char *type_name, const char *expected)
+{
+    if (!error_list || line < 0 || column < 0 || !lexeme || length < 0)
+    {
+        return;
+    }
+
+    Error error = {.line = line, .column = column, .stage = PARSER, .code = ERROR_UNEXPECTED_TOKEN,
+                   .details = {type_name, expected}};
+    append_error(error_list, error, lexeme, (uint32_t)length);
+}
+
+void copy_error(ErrorList *error_list, ErrorList *from, int index, int line, int column)
+{
+    if (!error_list || !from || index < 0 || index >= from->size)
+    {
+        return;
+    }
+
+    Error error = from->errors[index];
+    error.line = line;
+    error.last_column += column - error.column;
+    error.column = column;
+    append_error(error_list, error, error.code == ERROR_TEXT || error.code == ERROR_UNEXPECTED_TOKEN ?
+                 from->text + error.text : NULL, error.text_length);
+}
+
+const char *format_error_message(ErrorList *error_list, Error *error, char *buffer)
+{
+    const char *text = error_list->text ? error_list->text + error->text : "";
+    switch (error->code)
+    {
+    case ERROR_INVALID_TOKEN:
+        return "Invalid token detected";
+    case ERROR_UNRECOGNIZED_TOKEN:
+        return "Unrecognized or invalid token";
+    case ERROR_UNEXPECTED_TOKEN:
+        snprintf(buffer, MAX_ERROR_MESSAGE_LENGTH, "Unexpected token '%s' of type '%s', expected %s.", text,
+                 error->details[0], error->details[1]);
+        return buffer;
+    default:
+        return text;
+    }
+}
+
+void init_error_writer(ErrorWriter *writer, FILE *file, ErrorFormat format)
+{
+    writer->file = file;
+    writer->format = format;
+    writer->length = 0;
+}
+
+int flush_error_writer(ErrorWriter *writer)
+{
+    int written = fwrite(writer->buffer, 1, writer->length, writer->file) == writer->length;
+    writer->length = 0;
+    return fflush(writer->file) == 0 && written;
+}
+
+void write_error_writer_bytes(ErrorWriter *writer, const char *data, size_t length)
+{
+    if (length > sizeof(writer->buffer) - writer->length)
+    {
+        fwrite(writer->buffer, 1, writer->length, writer->file);
+        writer->length = 0;
+        if (length > sizeof(writer->buffer))
+        {
+            fwrite(data, 1, length, writer->file);
             return;
         }
     }
 
-    error_list->errors[error_list->size] = error;
-    error_list->size++;
+    memcpy(writer->buffer + writer->length, data, length);
+    writer->length += length;
+}
+
+static void write_formatted(ErrorWriter *writer, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+// Format straight into the buffer, making room first if it may not fit
+static void write_formatted(ErrorWriter *writer, const char *format, ...)
+{
+    va_list arguments;
+    if (sizeof(writer->buffer) - writer->length < 2 * MAX_ERROR_MESSAGE_LENGTH + 256)
+    {
+        fwrite(writer->buffer, 1, writer->length, writer->file);
+        writer->length = 0;
+    }
+
+    va_start(arguments, format);
+    int length = vsnprintf(writer->buffer + writer->length, sizeof(writer->buffer) - writer->length, format,
+                           arguments);
+    va_end(arguments);
+    if (length > 0)
+    {
+        writer->length += (size_t)length < sizeof(writer->buffer) - writer->length ?
+                          (size_t)length : sizeof(writer->buffer) - writer->length - 1;
+    }
+}
+
+static void write_json_string(ErrorWriter *writer, const char *text)
+{
+    char escaped[2 * MAX_ERROR_MESSAGE_LENGTH + 8];
+    size_t length = 0;
+    escaped[length++] = '"';
+    for (const unsigned char *c = (const unsigned char *)text; *c && length < sizeof(escaped) - 8; c++)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            escaped[length++] = '\\';
+            escaped[length++] = *c;
+        }
+        else if (*c < 0x20)
+        {
+            length += snprintf(escaped + length, 7, "\\u%04x", *c);
+        }
+        else
+        {
+            escaped[length++] = *c;
+        }
+    }
+    escaped[length++] = '"';
+    write_error_writer_bytes(writer, escaped, length);
+}
+
+void write_errors(ErrorWriter *writer, const char *path, ErrorList *error_list)
+{
+    int json = writer->format == ERROR_FORMAT_JSON;
+    if (json)
+    {
+        write_error_writer_bytes(writer, "{\"file\": ", 9);
+        write_json_string(writer, path ? path : "");
+        write_error_writer_bytes(writer, ", \"errors\": [", 13);
+    }
+
+    int size = error_list ? error_list->size : 0;
+    for (int i = 0; i < size; i++)
+    {
+        Error *error = &error_list->errors[i];
+        char buffer[MAX_ERROR_MESSAGE_LENGTH];
+        const char *message = format_error_message(error_list, error, buffer);
+        if (json)
+        {
+            write_formatted(writer, "%s{\"line\": %d, \"column\": %d, \"stage\": \"%s\", \"message\": ", i ? ", " : "",
+                            error->line, error->column, ErrorStageNames[error->stage]);
+            write_json_string(writer, message);
+            write_formatted(writer, ", \"count\": %u, \"last_column\": %d}", error->count, error->last_column);
+        }
+        else if (error->count > 1 && error->last_column != error->column)
+        {
+            write_formatted(writer, "Error at line %d column %d during stage %s\nError message: %s (%u times, "
+                            "columns %d to %d)\n\n", error->line, error->column, ErrorStageNames[error->stage],
+                            message, error->count, error->column, error->last_column);
+        }
+        else if (error->count > 1)
+        {
+            write_formatted(writer, "Error at line %d column %d during stage %s\nError message: %s (%u times)\n\n",
+                            error->line, error->column, ErrorStageNames[error->stage], message, error->count);
+        }
+        else
+        {
+            write_formatted(writer, "Error at line %d column %d during stage %s\nError message: %s\n\n",
+                            error->line, error->column, ErrorStageNames[error->stage], message);
+        }
+    }
+
+    // Stages stop at the limit, so reaching it means errors may be missing
+    int truncated = error_list && (error_list->dropped > 0 || error_limit_reached(error_list));
+    if (json)
+    {
+        write_formatted(writer, "], \"truncated\": %s}\n", truncated ? "true" : "false");
+    }
+    else if (truncated)
+    {
+        write_formatted(writer, "Too many errors, stopped after %d\n\n", error_list->size);
+    }
 }
 
 // Method to print all the errors in the list
 void report_errors(ErrorList *error_list) {
-    for (int i = 0; i < error_list->size; i++) {
-        printf("Error at line %d column %d during stage %s\nError message: %s\n\n",
-                error_list->errors[i]->line, error_list->errors[i]->column,
-                ErrorStageNames[error_list->errors[i]->stage], error_list->errors[i]->message);
-    }
+    ErrorWriter writer;
+    init_error_writer(&writer, stdout, ERROR_FORMAT_TEXT);
+    write_errors(&writer, NULL, error_list);
+    flush_error_writer(&writer);
 }
 
 // Method to free the error list memory
 void free_error_list(ErrorList *error_list) {
-    for (int i = 0; i < error_list->size; i++) {
-        free(error_list->errors[i]);
+    if (!error_list) {
+        return;
     }
 
-    free(error_list->errors);
-    free(error_list);
-}
\ No newline at end of file
+    // Inside an arena this is a no-op, the errors go with the arena
+    Arena *arena = error_list->arena;
+    arena_free(arena, error_list->text);
+    arena_free(arena, error_list->errors);
+    arena_free(arena, error_list);
+}
@@ -0,0 +1,130 @@
+#include "gpio.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+PinBank *create_pin_bank()
+{
+    return calloc(1, sizeof(PinBank));
+}
+
+PinBank *create_pin_bank_from(const PinBank *script)
+{
+    PinBank *bank = create_pin_bank();
+    if (!bank || !script || script->input_count == 0)
+    {
+        return bank;
+    }
+
+    bank->inputs = malloc(script->input_count * sizeof(PinEvent));
+    if (!bank->inputs)
+    {
+        free(bank);
+        return NULL;
+    }
+    memcpy(bank->inputs, script->inputs, script->input_count * sizeof(PinEvent));
+    bank->input_count = bank->input_capacity = script->input_count;
+    return bank;
+}
+
+void free_pin_bank(PinBank *bank)
+{
+    if (!bank)
+    {
+        return;
+    }
+
+    free(bank->inputs);
+    free(bank);
+}
+
+static void report_trace_error(ErrorList *error_list, const char *name, int line, const char *reason)
+{
+    char message[256];
+    snprintf(message, sizeof(message), "In trace '%s': %s", name, reason);
+    add_new_error(error_list, line, 0, RUNTIME, message);
+}
+
+static int add_pin_input(PinBank *bank, PinEvent event)
+{
+    if (bank->input_count == bank->input_capacity)
+    {
+        size_t capacity = bank->input_capacity ? bank->input_capacity * 2 : 64;
+        PinEvent *inputs = realloc(bank->inputs, capacity * sizeof(PinEvent));
+        if (!inputs)
+        {
+            return 0;
+        }
+        bank->inputs = inputs;
+        bank->input_capacity = capacity;
+    }
+
+    bank->inputs[bank->input_count++] = event;
+    return 1;
+}
+
+int load_pin_trace(PinBank *bank, FILE *file, const char *name, ErrorList *error_list)
+{
+    char text[256];
+    int line = 0;
+    uint64_t last_cycle = bank->input_count ? bank->inputs[bank->input_count - 1].cycle : 0;
+
+    while (fgets(text, sizeof(text), file))
+    {
+        line++;
+        char *comment = strchr(text, '#');
+        if (comment)
+        {
+            *comment = '\0';
+        }
+
+        char *cursor = text;
+        while (isspace((unsigned char)*cursor))
+        {
+            cursor++;
+        }
+        if (*cursor == '\0')
+        {
+            continue;
+        }
+
+        unsigned long long cycle;
+        unsigned pin;
+        char level[8], extra;
+        int fields = sscanf(cursor, "%llu %u %7s %c", &cycle, &pin, level, &extra);
+        if (fields != 3 || (strcmp(level, "HIGH") != 0 && strcmp(level, "LOW") != 0))
+        {
+            report_trace_error(error_list, name, line, "expected '<cycle> <pin> HIGH|LOW'");
+            return 0;
+        }
+        if (pin >= GPIO_PIN_COUNT)
+        {
+            report_trace_error(error_list, name, line, "pin number out of range");
+            return 0;
+        }
+        if (cycle < last_cycle)
+        {
+            report_trace_error(error_list, name, line, "cycles must not decrease");
+            return 0;
+        }
+
+        PinEvent event = {cycle, (uint8_t)pin, strcmp(level, "HIGH") == 0};
+        if (!add_pin_input(bank, event))
+        {
+            report_trace_error(error_list, name, line, "out of memory");
+            return 0;
+        }
+        last_cycle = cycle;
+    }
+
+    return 1;
+}
+
+void apply_pin_inputs(PinBank *bank, uint64_t cycle)
+{
+    while (bank->next_input < bank->input_count && bank->inputs[bank->next_input].cycle <= cycle)
+    {
+        PinEvent *event = &bank->inputs[bank->next_input++];
+        bank->levels[event->pin] = event->level;
+    }
+}
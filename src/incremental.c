@@ -0,0 +1,100 @@
+#include "incremental.h"
+#include <stdlib.h>
+
+// Parse the whole token stream again, dropping any previous AST
+static int parse_document(IncrementalDocument *document)
+{
+    free_ast(document->ast);
+    document->ast = parse_token_stream(document->token_stream, document->parser_errors);
+    return document->ast != NULL;
+}
+
+IncrementalDocument *create_incremental_document(const char *source, size_t length)
+{
+    IncrementalDocument *document = calloc(1, sizeof(IncrementalDocument));
+    if (!document)
+    {
+        return NULL;
+    }
+
+    document->token_stream = create_new_token_stream(NULL);
+    document->lexer_errors = create_new_error_list(NULL);
+    document->parser_errors = create_new_error_list(NULL);
+    if (!document->token_stream || !document->lexer_errors || !document->parser_errors)
+    {
+        free_incremental_document(document);
+        return NULL;
+    }
+
+    document->source = source;
+    document->length = length;
+    if (lex_into_token_stream(document->token_stream, source, length, document->lexer_errors))
+    {
+        parse_document(document);
+    }
+    else
+    {
+        document->token_stream->size = 0;
+    }
+
+    return document;
+}
+
+int update_incremental_document(IncrementalDocument *document, const char *source, size_t length, SourceEdit edit)
+{
+    ErrorList *lexer_errors = create_new_error_list(NULL);
+    ErrorList *parser_errors = create_new_error_list(NULL);
+    if (!lexer_errors || !parser_errors)
+    {
+        free_error_list(lexer_errors);
+        free_error_list(parser_errors);
+        return 0;
+    }
+
+    TokenEdit token_edit;
+    int lexed = relex_token_stream(document->token_stream, source, length, edit,
+                                   document->lexer_errors, lexer_errors, &token_edit);
+
+    document->source = source;
+    document->length = length;
+    free_error_list(document->lexer_errors);
+    document->lexer_errors = lexer_errors;
+
+    ErrorList *previous_parser_errors = document->parser_errors;
+    document->parser_errors = parser_errors;
+
+    int parsed = 0;
+    if (!lexed)
+    {
+        free_ast(document->ast);
+        document->ast = NULL;
+    }
+    else if (document->ast && reparse_token_stream(document->ast, &token_edit, previous_parser_errors, parser_errors))
+    {
+        parsed = 1;
+    }
+    else
+    {
+        // No AST to start from, or the reparse failed part way and left it unusable
+        free_error_list(parser_errors);
+        document->parser_errors = create_new_error_list(NULL);
+        parsed = parse_document(document);
+    }
+
+    free_error_list(previous_parser_errors);
+    return parsed;
+}
+
+void free_incremental_document(IncrementalDocument *document)
+{
+    if (!document)
+    {
+        return;
+    }
+
+    free_ast(document->ast);
+    free_token_stream(document->token_stream);
+    free_error_list(document->lexer_errors);
+    free_error_list(document->parser_errors);
+    free(document);
+}
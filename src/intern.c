@@ -0,0 +1,201 @@
+#include "intern.h"
+#include <stdlib.h>
+#include <string.h>
+
+// FNV-1a over the name bytes
+static uint32_t hash_name(const char *name, int length)
+{
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)name[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Slot holding name, or the empty slot where it would go
+static uint32_t probe_slot(InternTable *table, const char *name, int length, uint32_t hash)
+{
+    uint32_t mask = table->slot_count - 1;
+    uint32_t slot = hash & mask;
+
+    for (;;)
+    {
+        uint32_t entry = table->slots[slot];
+        if (entry == 0)
+        {
+            return slot;
+        }
+
+        uint32_t symbol = entry - 1;
+        if (table->hashes[symbol] == hash && table->name_lengths[symbol] == (uint32_t)length &&
+            memcmp(table->names[symbol], name, length) == 0)
+        {
+            return slot;
+        }
+        slot = (slot + 1) & mask;
+    }
+}
+
+static int grow_slots(InternTable *table)
+{
+    uint32_t new_slot_count = table->slot_count * 2;
+    uint32_t *new_slots = arena_calloc(table->arena, new_slot_count, sizeof(uint32_t));
+    if (!new_slots)
+    {
+        return 0;
+    }
+
+    // Reinsert by the stored hashes, names never need to be compared here
+    uint32_t mask = new_slot_count - 1;
+    for (uint32_t symbol = 0; symbol < table->symbol_count; symbol++)
+    {
+        uint32_t slot = table->hashes[symbol] & mask;
+        while (new_slots[slot] != 0)
+        {
+            slot = (slot + 1) & mask;
+        }
+        new_slots[slot] = symbol + 1;
+    }
+
+    arena_free(table->arena, table->slots);
+    table->slots = new_slots;
+    table->slot_count = new_slot_count;
+    return 1;
+}
+
+static int grow_symbols(InternTable *table)
+{
+    Arena *arena = table->arena;
+    uint32_t old_capacity = table->symbol_capacity;
+    uint32_t new_capacity = old_capacity * 2;
+
+    const char **names = arena_realloc(arena, table->names, old_capacity * sizeof(char *), new_capacity * sizeof(char *));
+    if (!names)
+    {
+        return 0;
+    }
+    table->names = names;
+
+    uint32_t *name_lengths = arena_realloc(arena, table->name_lengths, old_capacity * sizeof(uint32_t), new_capacity * sizeof(uint32_t));
+    if (!name_lengths)
+    {
+        return 0;
+    }
+    table->name_lengths = name_lengths;
+
+    uint32_t *hashes = arena_realloc(arena, table->hashes, old_capacity * sizeof(uint32_t), new_capacity * sizeof(uint32_t));
+    if (!hashes)
+    {
+        return 0;
+    }
+    table->hashes = hashes;
+
+    table->symbol_capacity = new_capacity;
+    return 1;
+}
+
+InternTable *create_intern_table(Arena *arena)
+{
+    InternTable *table = arena_calloc(arena, 1, sizeof(InternTable));
+    if (!table)
+    {
+        return NULL;
+    }
+
+    table->arena = arena;
+    table->symbol_capacity = DEFAULT_INTERN_TABLE_CAPACITY;
+    table->slot_count = DEFAULT_INTERN_TABLE_CAPACITY * 2;
+    table->slots = arena_calloc(arena, table->slot_count, sizeof(uint32_t));
+    table->names = arena_alloc(arena, table->symbol_capacity * sizeof(char *));
+    table->name_lengths = arena_alloc(arena, table->symbol_capacity * sizeof(uint32_t));
+    table->hashes = arena_alloc(arena, table->symbol_capacity * sizeof(uint32_t));
+
+    if (!table->slots || !table->names || !table->name_lengths || !table->hashes)
+    {
+        free_intern_table(table);
+        return NULL;
+    }
+
+    return table;
+}
+
+void free_intern_table(InternTable *table)
+{
+    if (!table)
+    {
+        return;
+    }
+
+    Arena *arena = table->arena;
+    if (!arena)
+    {
+        for (uint32_t symbol = 0; symbol < table->symbol_count; symbol++)
+        {
+            free((void *)table->names[symbol]);
+        }
+    }
+
+    arena_free(arena, table->slots);
+    arena_free(arena, table->names);
+    arena_free(arena, table->name_lengths);
+    arena_free(arena, table->hashes);
+    arena_free(arena, table);
+}
+
+uint32_t intern_symbol(InternTable *table, const char *name, int length)
+{
+    uint32_t hash = hash_name(name, length);
+    uint32_t slot = probe_slot(table, name, length, hash);
+
+    if (table->slots[slot] != 0)
+    {
+        return table->slots[slot] - 1;
+    }
+
+    if (table->symbol_count == table->symbol_capacity && !grow_symbols(table))
+    {
+        return NO_SYMBOL;
+    }
+
+    // The name is copied, so a symbol outlives the buffer it was lexed from
+    char *copy = arena_alloc(table->arena, length);
+    if (!copy)
+    {
+        return NO_SYMBOL;
+    }
+    memcpy(copy, name, length);
+
+    uint32_t symbol = table->symbol_count++;
+    table->names[symbol] = copy;
+    table->name_lengths[symbol] = length;
+    table->hashes[symbol] = hash;
+    table->slots[slot] = symbol + 1;
+
+    // Keep the load factor at or below one half
+    if (table->symbol_count * 2 > table->slot_count && !grow_slots(table))
+    {
+        return NO_SYMBOL;
+    }
+
+    return symbol;
+}
+
+uint32_t find_symbol(InternTable *table, const char *name, int length)
+{
+    uint32_t slot = probe_slot(table, name, length, hash_name(name, length));
+    return table->slots[slot] != 0 ? table->slots[slot] - 1 : NO_SYMBOL;
+}
+
+const char *get_symbol_name(InternTable *table, uint32_t symbol, int *length)
+{
+    if (symbol >= table->symbol_count)
+    {
+        *length = 0;
+        return "";
+    }
+
+    *length = table->name_lengths[symbol];
+    return table->names[symbol];
+}
@@ -0,0 +1,1142 @@
+#include "ir.h"
+#include "regalloc.h"
+#include "gpio.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Expression and statement nesting lowered before giving up rather than
+// overflowing the call stack
+#define MAX_IR_DEPTH 20000
+
+// A name bound to the SSA value it holds at the current point, innermost last
+typedef struct
+{
+    uint32_t symbol;
+    uint32_t value;
+} IRBinding;
+
+// State of lowering one AST. Instructions, operands and blocks are built on the
+// heap and copied into the program once dead phis are gone. A block's
+// first_instruction is IR_NO_VALUE until it is started, and its
+// predecessor_count counts the edges into it so far.
+typedef struct
+{
+    AST *ast;
+    TokenStream *token_stream;
+    IRProgram *program;
+    ErrorList *error_list;
+    int error_base;              // Size of error_list when lowering started
+    IRInstruction *instructions;
+    uint32_t instruction_count;
+    uint32_t instruction_capacity;
+    uint32_t *operands;
+    uint32_t operand_count;
+    uint32_t operand_capacity;
+    IRBlock *blocks;
+    uint32_t block_count;
+    uint32_t block_capacity;
+    IRBinding *bindings;
+    uint32_t binding_count;
+    uint32_t binding_capacity;
+    uint32_t current;            // Block being filled, IR_NO_BLOCK where no path reaches
+    uint32_t loop_depth;
+    int depth;
+    int out_of_memory;
+} IRBuilder;
+
+const char *ir_opcode_to_string(IROpcode opcode)
+{
+    static const char *const names[IR_OPCODE_COUNT] = {
+        [IR_CONST] = "const",
+        [IR_PARAM] = "param",
+        [IR_ADD] = "add",
+        [IR_SUB] = "sub",
+        [IR_MUL] = "mul",
+        [IR_DIV] = "div",
+        [IR_EQ] = "eq",
+        [IR_NEQ] = "neq",
+        [IR_LT] = "lt",
+        [IR_GT] = "gt",
+        [IR_LTE] = "lte",
+        [IR_GTE] = "gte",
+        [IR_NOT] = "not",
+        [IR_NEG] = "neg",
+        [IR_PHI] = "phi",
+        [IR_CALL] = "call",
+        [IR_GPIO_READ] = "gpio_read",
+        [IR_GPIO_SET] = "gpio_set",
+        [IR_JUMP] = "jump",
+        [IR_BRANCH] = "branch",
+        [IR_RETURN] = "return",
+    };
+    return opcode < IR_OPCODE_COUNT ? names[opcode] : "unknown";
+}
+
+// Report an error at a token, quoting its lexeme
+static void report_ir_error(IRBuilder *builder, int token, const char *format)
+{
+    char message[256];
+    int length;
+    const char *lexeme = get_token_lexeme(builder->token_stream, token, &length);
+    snprintf(message, sizeof(message), format, length > 64 ? 64 : length, lexeme);
+    add_new_error(builder->error_list, builder->token_stream->lines[token], builder->token_stream->columns[token],
+                  CODEGEN, message);
+}
+
+// Count one more level of nesting, reporting it at token the first time it is too deep
+static int enter_nesting(IRBuilder *builder, int token)
+{
+    if (++builder->depth <= MAX_IR_DEPTH)
+    {
+        return 1;
+    }
+    if (builder->depth == MAX_IR_DEPTH + 1)
+    {
+        report_ir_error(builder, token, "Expression nested too deeply to compile at '%.*s'");
+    }
+    return 0;
+}
+
+// Make room for one more element of size bytes in *array
+static int grow_array(IRBuilder *builder, void **array, uint32_t count, uint32_t *capacity, size_t size)
+{
+    if (count < *capacity)
+    {
+        return 1;
+    }
+
+    uint32_t new_capacity = *capacity ? *capacity * 2 : 256;
+    void *grown = realloc(*array, new_capacity * size);
+    if (!grown)
+    {
+        builder->out_of_memory = 1;
+        return 0;
+    }
+    *array = grown;
+    *capacity = new_capacity;
+    return 1;
+}
+
+static uint32_t new_block(IRBuilder *builder)
+{
+    if (!grow_array(builder, (void **)&builder->blocks, builder->block_count, &builder->block_capacity, sizeof(IRBlock)))
+    {
+        return IR_NO_BLOCK;
+    }
+
+    builder->blocks[builder->block_count] = (IRBlock){IR_NO_VALUE, 0, 0, 0, 0};
+    return builder->block_count++;
+}
+
+// Make block the one being filled. A block no edge leads to stays unreached, as
+// does everything lowered until the next block that is reached. Returns whether
+// the block is reached.
+static int start_block(IRBuilder *builder, uint32_t block, int is_entry)
+{
+    builder->current = IR_NO_BLOCK;
+    if (block == IR_NO_BLOCK || (!is_entry && builder->blocks[block].predecessor_count == 0))
+    {
+        return 0;
+    }
+
+    builder->blocks[block].first_instruction = builder->instruction_count;
+    builder->blocks[block].loop_depth = builder->loop_depth;
+    builder->current = block;
+    return 1;
+}
+
+// Append an instruction to the current block, IR_NO_VALUE where no path reaches
+static uint32_t emit_instruction(IRBuilder *builder, IROpcode opcode, int32_t immediate, int token)
+{
+    if (builder->current == IR_NO_BLOCK ||
+        !grow_array(builder, (void **)&builder->instructions, builder->instruction_count,
+                    &builder->instruction_capacity, sizeof(IRInstruction)))
+    {
+        return IR_NO_VALUE;
+    }
+
+    uint32_t index = builder->instruction_count++;
+    builder->instructions[index] = (IRInstruction){
+        .opcode = (uint8_t)opcode,
+        .immediate = immediate,
+        .block = builder->current,
+        .first_operand = builder->operand_count,
+        .targets = {IR_NO_BLOCK, IR_NO_BLOCK},
+        .token = (uint32_t)token,
+    };
+    builder->blocks[builder->current].instruction_count++;
+    return index;
+}
+
+// Operands of an instruction are appended right after it, before the next one
+static void add_operand(IRBuilder *builder, uint32_t instruction, uint32_t operand)
+{
+    if (instruction == IR_NO_VALUE ||
+        !grow_array(builder, (void **)&builder->operands, builder->operand_count, &builder->operand_capacity,
+                    sizeof(uint32_t)))
+    {
+        return;
+    }
+
+    builder->operands[builder->operand_count++] = operand;
+    builder->instructions[instruction].operand_count++;
+}
+
+static uint32_t emit_unary(IRBuilder *builder, IROpcode opcode, uint32_t operand, int token)
+{
+    uint32_t instruction = emit_instruction(builder, opcode, 0, token);
+    add_operand(builder, instruction, operand);
+    return instruction;
+}
+
+static void emit_jump(IRBuilder *builder, uint32_t target, int token)
+{
+    uint32_t instruction = emit_instruction(builder, IR_JUMP, 0, token);
+    if (instruction != IR_NO_VALUE)
+    {
+        builder->instructions[instruction].targets[0] = target;
+        builder->blocks[target].predecessor_count++;
+    }
+    builder->current = IR_NO_BLOCK;
+}
+
+static void emit_branch(IRBuilder *builder, uint32_t condition, uint32_t when_true, uint32_t when_false, int token)
+{
+    uint32_t instruction = emit_unary(builder, IR_BRANCH, condition, token);
+    if (instruction != IR_NO_VALUE)
+    {
+        builder->instructions[instruction].targets[0] = when_true;
+        builder->instructions[instruction].targets[1] = when_false;
+        builder->blocks[when_true].predecessor_count++;
+        builder->blocks[when_false].predecessor_count++;
+    }
+    builder->current = IR_NO_BLOCK;
+}
+
+// A phi merging two paths, or the value itself when both bring the same one
+static uint32_t emit_phi(IRBuilder *builder, uint32_t first_block, uint32_t first_value, uint32_t second_block,
+                         uint32_t second_value, int token)
+{
+    if (first_value == second_value)
+    {
+        return first_value;
+    }
+
+    uint32_t phi = emit_instruction(builder, IR_PHI, 0, token);
+    add_operand(builder, phi, first_block);
+    add_operand(builder, phi, first_value);
+    add_operand(builder, phi, second_block);
+    add_operand(builder, phi, second_value);
+    return phi;
+}
+
+static int bind_name(IRBuilder *builder, uint32_t symbol, uint32_t value)
+{
+    if (!grow_array(builder, (void **)&builder->bindings, builder->binding_count, &builder->binding_capacity,
+                    sizeof(IRBinding)))
+    {
+        return 0;
+    }
+
+    builder->bindings[builder->binding_count++] = (IRBinding){symbol, value};
+    return 1;
+}
+
+// Binding of the innermost variable named by token, reporting it if there is none
+static uint32_t find_variable(IRBuilder *builder, int token)
+{
+    uint32_t symbol = builder->token_stream->symbols[token];
+    for (uint32_t i = builder->binding_count; i-- > 0;)
+    {
+        if (builder->bindings[i].symbol == symbol)
+        {
+            return i;
+        }
+    }
+
+    report_ir_error(builder, token, "Undefined variable '%.*s'");
+    return UINT32_MAX;
+}
+
+// Copy of the values of the first count bindings, NULL if memory ran out
+static uint32_t *save_values(IRBuilder *builder, uint32_t count)
+{
+    uint32_t *values = malloc((count ? count : 1) * sizeof(uint32_t));
+    if (!values)
+    {
+        builder->out_of_memory = 1;
+        return NULL;
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        values[i] = builder->bindings[i].value;
+    }
+    return values;
+}
+
+static uint32_t find_function(IRBuilder *builder, uint32_t symbol)
+{
+    for (uint32_t i = 0; i < builder->program->function_count; i++)
+    {
+        if (builder->program->functions[i].symbol == symbol)
+        {
+            return i;
+        }
+    }
+    return UINT32_MAX;
+}
+
+// Value of a NUMBER token, reporting it if it does not fit an int
+static int32_t number_value(IRBuilder *builder, int token)
+{
+    int length;
+    const char *lexeme = get_token_lexeme(builder->token_stream, token, &length);
+    int64_t value = 0;
+    for (int i = 0; i < length; i++)
+    {
+        value = value * 10 + (lexeme[i] - '0');
+        if (value > INT32_MAX)
+        {
+            report_ir_error(builder, token, "Number '%.*s' does not fit in an int");
+            return 0;
+        }
+    }
+    return (int32_t)value;
+}
+
+// Number of the GPIO_PIN node at index, reporting it if the bank has no such pin
+static int32_t pin_number(IRBuilder *builder, uint32_t index)
+{
+    int token = get_ast_node(builder->ast, index)->token;
+    int32_t number = number_value(builder, token);
+    if (number >= GPIO_PIN_COUNT)
+    {
+        report_ir_error(builder, token, "Pin number '%.*s' out of range");
+        return 0;
+    }
+    return number;
+}
+
+static IROpcode binary_opcode(TokenType type)
+{
+    switch (type)
+    {
+    case TOKEN_PLUS:
+        return IR_ADD;
+    case TOKEN_MINUS:
+        return IR_SUB;
+    case TOKEN_STAR:
+        return IR_MUL;
+    case TOKEN_SLASH:
+        return IR_DIV;
+    case TOKEN_EQ:
+        return IR_EQ;
+    case TOKEN_NEQ:
+        return IR_NEQ;
+    case TOKEN_LT:
+        return IR_LT;
+    case TOKEN_GT:
+        return IR_GT;
+    case TOKEN_LTE:
+        return IR_LTE;
+    default:
+        return IR_GTE;
+    }
+}
+
+static uint32_t lower_expression(IRBuilder *builder, uint32_t index);
+
+// Branch to when_true or when_false on the condition at index. && and || become
+// branches between blocks, so they never compute a value.
+static void lower_condition(IRBuilder *builder, uint32_t index, uint32_t when_true, uint32_t when_false)
+{
+    AST *ast = builder->ast;
+    ASTNode *node = get_ast_node(ast, index);
+    TokenType type = builder->token_stream->types[node->token];
+    uint32_t middle;
+
+    if (!enter_nesting(builder, node->token))
+    {
+        builder->depth--;
+        return;
+    }
+
+    if (node->type == BINARY_EXPRESSION && (type == TOKEN_AND || type == TOKEN_OR))
+    {
+        middle = new_block(builder);
+        if (type == TOKEN_AND)
+        {
+            lower_condition(builder, get_ast_child(ast, index, 0), middle, when_false);
+        }
+        else
+        {
+            lower_condition(builder, get_ast_child(ast, index, 0), when_true, middle);
+        }
+        start_block(builder, middle, 0);
+        lower_condition(builder, get_ast_child(ast, index, 1), when_true, when_false);
+    }
+    else if (node->type == UNARY_EXPRESSION && type == TOKEN_NOT)
+    {
+        lower_condition(builder, get_ast_child(ast, index, 0), when_false, when_true);
+    }
+    else if (node->type == BOOL_VALUE || node->type == CONSTANT)
+    {
+        int value = node->type == CONSTANT ? node->value != 0 : type == TOKEN_TRUE;
+        emit_jump(builder, value ? when_true : when_false, node->token);
+    }
+    else
+    {
+        emit_branch(builder, lower_expression(builder, index), when_true, when_false, node->token);
+    }
+
+    builder->depth--;
+}
+
+// The 0 or 1 of && or ||, a phi of a constant from each way the condition can go
+static uint32_t lower_logical_value(IRBuilder *builder, uint32_t index)
+{
+    int token = get_ast_node(builder->ast, index)->token;
+    uint32_t when_true = new_block(builder), when_false = new_block(builder), join = new_block(builder);
+    uint32_t true_value = IR_NO_VALUE, false_value = IR_NO_VALUE;
+
+    lower_condition(builder, index, when_true, when_false);
+    if (start_block(builder, when_true, 0))
+    {
+        true_value = emit_instruction(builder, IR_CONST, 1, token);
+        emit_jump(builder, join, token);
+    }
+    if (start_block(builder, when_false, 0))
+    {
+        false_value = emit_instruction(builder, IR_CONST, 0, token);
+        emit_jump(builder, join, token);
+    }
+    if (!start_block(builder, join, 0))
+    {
+        return IR_NO_VALUE;
+    }
+    if (true_value == IR_NO_VALUE || false_value == IR_NO_VALUE)
+    {
+        return true_value == IR_NO_VALUE ? false_value : true_value;
+    }
+    return emit_phi(builder, when_true, true_value, when_false, false_value, token);
+}
+
+static uint32_t lower_call(IRBuilder *builder, uint32_t index)
+{
+    AST *ast = builder->ast;
+    ASTNode *node = get_ast_node(ast, index);
+    uint32_t function = find_function(builder, builder->token_stream->symbols[node->token]);
+
+    if (function == UINT32_MAX)
+    {
+        report_ir_error(builder, node->token, "Call to undefined function '%.*s'");
+        return IR_NO_VALUE;
+    }
+    if (builder->program->functions[function].parameter_count != node->num_children)
+    {
+        report_ir_error(builder, node->token, "Wrong number of arguments in call to '%.*s'");
+        return IR_NO_VALUE;
+    }
+
+    // Every argument is computed before the call, whose operands are appended after it
+    uint32_t *arguments = malloc((node->num_children ? node->num_children : 1) * sizeof(uint32_t));
+    if (!arguments)
+    {
+        builder->out_of_memory = 1;
+        return IR_NO_VALUE;
+    }
+    for (uint32_t i = 0; i < node->num_children; i++)
+    {
+        arguments[i] = lower_expression(builder, get_ast_child(ast, index, i));
+    }
+
+    uint32_t call = emit_instruction(builder, IR_CALL, (int32_t)function, node->token);
+    for (uint32_t i = 0; i < node->num_children; i++)
+    {
+        add_operand(builder, call, arguments[i]);
+    }
+    free(arguments);
+    return call;
+}
+
+// Compute the expression at index, returning the value holding it
+static uint32_t lower_expression(IRBuilder *builder, uint32_t index)
+{
+    AST *ast = builder->ast;
+    ASTNode *node = get_ast_node(ast, index);
+    TokenType type = builder->token_stream->types[node->token];
+    uint32_t value = IR_NO_VALUE, left, right, binding;
+
+    if (!enter_nesting(builder, node->token))
+    {
+        builder->depth--;
+        return IR_NO_VALUE;
+    }
+
+    switch (node->type)
+    {
+    case NUMBER_LITERAL:
+        value = emit_instruction(builder, IR_CONST, number_value(builder, node->token), node->token);
+        break;
+    case BOOL_VALUE:
+        value = emit_instruction(builder, IR_CONST, type == TOKEN_TRUE, node->token);
+        break;
+    case CONSTANT:
+        value = emit_instruction(builder, IR_CONST, node->value, node->token);
+        break;
+    case IDENTIFIER:
+        binding = find_variable(builder, node->token);
+        value = binding != UINT32_MAX ? builder->bindings[binding].value : IR_NO_VALUE;
+        break;
+    case UNARY_EXPRESSION:
+        left = lower_expression(builder, get_ast_child(ast, index, 0));
+        value = emit_unary(builder, type == TOKEN_NOT ? IR_NOT : IR_NEG, left, node->token);
+        break;
+    case BINARY_EXPRESSION:
+        if (type == TOKEN_AND || type == TOKEN_OR)
+        {
+            value = lower_logical_value(builder, index);
+            break;
+        }
+        left = lower_expression(builder, get_ast_child(ast, index, 0));
+        right = lower_expression(builder, get_ast_child(ast, index, 1));
+        value = emit_instruction(builder, binary_opcode(type), 0, node->token);
+        add_operand(builder, value, left);
+        add_operand(builder, value, right);
+        break;
+    case CALL_EXPRESSION:
+        value = lower_call(builder, index);
+        break;
+    case GPIO_OPERATION:
+        value = emit_instruction(builder, IR_GPIO_READ, pin_number(builder, get_ast_child(ast, index, 0)),
+                                 node->token);
+        break;
+    default:
+        report_ir_error(builder, node->token, "Cannot compile expression at '%.*s'");
+        break;
+    }
+
+    builder->depth--;
+    return value;
+}
+
+static void lower_statement_list(IRBuilder *builder, uint32_t index);
+
+// Each arm starts from the values before the if, and the join merges what the
+// arms that reach it leave behind
+static void lower_conditional(IRBuilder *builder, uint32_t index)
+{
+    AST *ast = builder->ast;
+    ASTNode *node = get_ast_node(ast, index);
+    uint32_t count = builder->binding_count;
+    uint32_t then_block = new_block(builder), else_block = new_block(builder), join = new_block(builder);
+
+    lower_condition(builder, get_ast_child(ast, index, 0), then_block, else_block);
+    uint32_t *before = save_values(builder, count);
+    if (!before)
+    {
+        return;
+    }
+
+    start_block(builder, then_block, 0);
+    lower_statement_list(builder, get_ast_child(ast, index, 1));
+    uint32_t then_end = builder->current;
+    emit_jump(builder, join, node->token);
+    uint32_t *then_values = save_values(builder, count);
+    if (!then_values)
+    {
+        free(before);
+        return;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        builder->bindings[i].value = before[i];
+    }
+    start_block(builder, else_block, 0);
+    if (node->num_children == 3)
+    {
+        lower_statement_list(builder, get_ast_child(ast, index, 2));
+    }
+    uint32_t else_end = builder->current;
+    emit_jump(builder, join, node->token);
+
+    if (start_block(builder, join, 0))
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            IRBinding *binding = &builder->bindings[i];
+            if (else_end == IR_NO_BLOCK)
+            {
+                binding->value = then_values[i];
+            }
+            else if (then_end != IR_NO_BLOCK)
+            {
+                binding->value = emit_phi(builder, then_end, then_values[i], else_end, binding->value, node->token);
+            }
+        }
+    }
+
+    free(before);
+    free(then_values);
+}
+
+// The header starts with a phi for every variable in scope, whose second operand
+// comes from the end of the body once it is lowered. The condition is tested in
+// the header, and the variables after the loop are the header's phis.
+static void lower_while_loop(IRBuilder *builder, uint32_t index)
+{
+    AST *ast = builder->ast;
+    ASTNode *node = get_ast_node(ast, index);
+    uint32_t count = builder->binding_count;
+    uint32_t header = new_block(builder), body = new_block(builder), exit = new_block(builder);
+    uint32_t preheader = builder->current;
+
+    emit_jump(builder, header, node->token);
+    builder->loop_depth++;
+
+    uint32_t first_phi = builder->instruction_count;
+    int reached = start_block(builder, header, 0);
+    for (uint32_t i = 0; reached && i < count; i++)
+    {
+        uint32_t phi = emit_instruction(builder, IR_PHI, 0, node->token);
+        add_operand(builder, phi, preheader);
+        add_operand(builder, phi, builder->bindings[i].value);
+        add_operand(builder, phi, IR_NO_BLOCK);
+        add_operand(builder, phi, IR_NO_VALUE);
+        builder->bindings[i].value = phi;
+    }
+
+    lower_condition(builder, get_ast_child(ast, index, 0), body, exit);
+    start_block(builder, body, 0);
+    lower_statement_list(builder, get_ast_child(ast, index, 1));
+    uint32_t body_end = builder->current;
+    emit_jump(builder, header, node->token);
+    builder->loop_depth--;
+
+    // A body that always returns leaves the header one predecessor
+    for (uint32_t i = 0; reached && !builder->out_of_memory && i < count; i++)
+    {
+        IRInstruction *phi = &builder->instructions[first_phi + i];
+        if (body_end == IR_NO_BLOCK)
+        {
+            phi->operand_count = 2;
+        }
+        else
+        {
+            builder->operands[phi->first_operand + 2] = body_end;
+            builder->operands[phi->first_operand + 3] = builder->bindings[i].value;
+        }
+        builder->bindings[i].value = first_phi + i;
+    }
+
+    start_block(builder, exit, 0);
+}
+
+static void lower_statement(IRBuilder *builder, uint32_t index)
+{
+    AST *ast = builder->ast;
+    ASTNode *node = get_ast_node(ast, index);
+    uint32_t value, binding, instruction, level;
+
+    if (!enter_nesting(builder, node->token))
+    {
+        builder->depth--;
+        return;
+    }
+
+    switch (node->type)
+    {
+    case IDENTIFIER_DECLARATION:
+    case IDENTIFIER_DEFINITION:
+        // The name is bound once its value is computed, so the value cannot refer to it
+        if (node->type == IDENTIFIER_DEFINITION)
+        {
+            value = lower_expression(builder, get_ast_child(ast, index, 0));
+        }
+        else
+        {
+            value = emit_instruction(builder, IR_CONST, 0, node->token);
+        }
+        bind_name(builder, builder->token_stream->symbols[node->token], value);
+        break;
+    case ASSIGNMENT:
+        binding = find_variable(builder, node->token);
+        value = lower_expression(builder, get_ast_child(ast, index, 0));
+        if (binding != UINT32_MAX)
+        {
+            builder->bindings[binding].value = value;
+        }
+        break;
+    case CONDITIONAL:
+        lower_conditional(builder, index);
+        break;
+    case WHILE_LOOP:
+        lower_while_loop(builder, index);
+        break;
+    case RETURN_STATEMENT:
+        value = lower_expression(builder, get_ast_child(ast, index, 0));
+        emit_unary(builder, IR_RETURN, value, node->token);
+        builder->current = IR_NO_BLOCK;
+        break;
+    case GPIO_OPERATION:
+        if (node->num_children < 2)
+        {
+            emit_instruction(builder, IR_GPIO_READ, pin_number(builder, get_ast_child(ast, index, 0)), node->token);
+            break;
+        }
+        level = get_ast_node(ast, get_ast_child(ast, index, 1))->token;
+        value = emit_instruction(builder, IR_CONST, builder->token_stream->types[level] == TOKEN_HIGH, node->token);
+        instruction = emit_instruction(builder, IR_GPIO_SET, pin_number(builder, get_ast_child(ast, index, 0)),
+                                       node->token);
+        add_operand(builder, instruction, value);
+        break;
+    default:
+        lower_expression(builder, get_ast_child(ast, index, 0));
+        break;
+    }
+
+    builder->depth--;
+}
+
+// Variables declared in a block go out of scope at its end
+static void lower_statement_list(IRBuilder *builder, uint32_t index)
+{
+    ASTNode *node = get_ast_node(builder->ast, index);
+    uint32_t saved_binding_count = builder->binding_count;
+
+    for (uint32_t i = 0; i < node->num_children && !builder->out_of_memory; i++)
+    {
+        lower_statement(builder, get_ast_child(builder->ast, index, i));
+    }
+
+    builder->binding_count = saved_binding_count;
+}
+
+static void lower_function(IRBuilder *builder, uint32_t index, IRFunction *function)
+{
+    AST *ast = builder->ast;
+    uint32_t parameters = get_ast_child(ast, index, 0);
+    ASTNode *parameter_list = get_ast_node(ast, parameters);
+
+    builder->binding_count = 0;
+    builder->loop_depth = 0;
+    function->first_block = builder->block_count;
+    function->first_instruction = builder->instruction_count;
+    start_block(builder, new_block(builder), 1);
+
+    for (uint32_t i = 0; i < parameter_list->num_children; i++)
+    {
+        ASTNode *parameter = get_ast_node(ast, get_ast_child(ast, parameters, i));
+        bind_name(builder, builder->token_stream->symbols[parameter->token],
+                  emit_instruction(builder, IR_PARAM, (int32_t)i, parameter->token));
+    }
+
+    lower_statement_list(builder, get_ast_child(ast, index, 1));
+
+    // Falling off the end returns 0
+    uint32_t body_end = get_ast_node(ast, get_ast_child(ast, index, 1))->token;
+    emit_unary(builder, IR_RETURN, emit_instruction(builder, IR_CONST, 0, body_end), body_end);
+    builder->current = IR_NO_BLOCK;
+
+    function->block_count = builder->block_count - function->first_block;
+    function->instruction_count = builder->instruction_count - function->first_instruction;
+}
+
+// Follow the chain of phis found to stand for another value
+static uint32_t find_replacement(uint32_t *replacements, uint32_t value)
+{
+    while (value != IR_NO_VALUE && replacements[value] != value)
+    {
+        replacements[value] = replacements[replacements[value]];
+        value = replacements[value];
+    }
+    return value;
+}
+
+// A phi whose operands are all one other value, or itself, stands for that value.
+// Removing one can make others trivial, so repeat until none is left.
+static void find_trivial_phis(IRBuilder *builder, uint32_t *replacements)
+{
+    int changed = 1;
+    while (changed)
+    {
+        changed = 0;
+        for (uint32_t i = 0; i < builder->instruction_count; i++)
+        {
+            IRInstruction *instruction = &builder->instructions[i];
+            if (instruction->opcode != IR_PHI || replacements[i] != i)
+            {
+                continue;
+            }
+
+            uint32_t same = IR_NO_VALUE;
+            int trivial = 1;
+            for (uint32_t j = 1; j < instruction->operand_count && trivial; j += 2)
+            {
+                uint32_t value = find_replacement(replacements, builder->operands[instruction->first_operand + j]);
+                trivial = value == i || value == same || same == IR_NO_VALUE;
+                if (value != i)
+                {
+                    same = trivial ? value : same;
+                }
+            }
+            if (trivial && same != IR_NO_VALUE)
+            {
+                replacements[i] = same;
+                changed = 1;
+            }
+        }
+    }
+}
+
+// Copy the built program into its final arrays: trivial phis are dropped, blocks
+// that were never reached disappear, both are renumbered in layout order, and
+// the predecessor lists are derived from the terminators
+static int finish_ir_program(IRBuilder *builder)
+{
+    IRProgram *program = builder->program;
+    Arena *arena = program->arena;
+    uint32_t *replacements = malloc((builder->instruction_count + 1) * sizeof(uint32_t));
+    uint32_t *new_values = malloc((builder->instruction_count + 1) * sizeof(uint32_t));
+    uint32_t *new_blocks = malloc((builder->block_count + 1) * sizeof(uint32_t));
+    if (!replacements || !new_values || !new_blocks)
+    {
+        free(replacements);
+        free(new_values);
+        free(new_blocks);
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < builder->instruction_count; i++)
+    {
+        replacements[i] = i;
+    }
+    find_trivial_phis(builder, replacements);
+
+    // Blocks were started in layout order, each one's instructions follow the last one's
+    uint32_t instruction_count = 0, operand_count = 0, block_count = 0, edge_count = 0;
+    for (uint32_t i = 0; i < builder->block_count; i++)
+    {
+        new_blocks[i] = IR_NO_BLOCK;
+    }
+    for (uint32_t i = 0; i < builder->instruction_count; i++)
+    {
+        IRInstruction *instruction = &builder->instructions[i];
+        new_values[i] = IR_NO_VALUE;
+        if (new_blocks[instruction->block] == IR_NO_BLOCK)
+        {
+            new_blocks[instruction->block] = block_count++;
+        }
+        if (instruction->opcode == IR_PHI && replacements[i] != i)
+        {
+            continue;
+        }
+        new_values[i] = instruction_count++;
+        operand_count += instruction->operand_count;
+        edge_count += instruction->opcode == IR_JUMP ? 1 : instruction->opcode == IR_BRANCH ? 2 : 0;
+    }
+
+    program->instructions = arena_alloc(arena, (instruction_count ? instruction_count : 1) * sizeof(IRInstruction));
+    program->operands = arena_alloc(arena, (operand_count ? operand_count : 1) * sizeof(uint32_t));
+    program->blocks = arena_calloc(arena, block_count ? block_count : 1, sizeof(IRBlock));
+    program->predecessors = arena_alloc(arena, (edge_count ? edge_count : 1) * sizeof(uint32_t));
+    if (!program->instructions || !program->operands || !program->blocks || !program->predecessors)
+    {
+        free(replacements);
+        free(new_values);
+        free(new_blocks);
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < builder->instruction_count; i++)
+    {
+        if (new_values[i] == IR_NO_VALUE)
+        {
+            continue;
+        }
+
+        IRInstruction instruction = builder->instructions[i];
+        uint32_t *operands = &builder->operands[instruction.first_operand];
+        IRBlock *block = &program->blocks[new_blocks[instruction.block]];
+        if (block->instruction_count++ == 0)
+        {
+            block->first_instruction = new_values[i];
+            block->loop_depth = builder->blocks[instruction.block].loop_depth;
+        }
+
+        instruction.block = new_blocks[instruction.block];
+        instruction.first_operand = program->operand_count;
+        for (uint32_t j = 0; j < instruction.operand_count; j++)
+        {
+            int is_block = instruction.opcode == IR_PHI && j % 2 == 0;
+            program->operands[program->operand_count++] =
+                is_block ? new_blocks[operands[j]] : new_values[find_replacement(replacements, operands[j])];
+        }
+        for (int j = 0; j < 2; j++)
+        {
+            if (instruction.targets[j] != IR_NO_BLOCK)
+            {
+                instruction.targets[j] = new_blocks[instruction.targets[j]];
+                program->blocks[instruction.targets[j]].predecessor_count++;
+            }
+        }
+        program->instructions[program->instruction_count++] = instruction;
+    }
+    program->block_count = block_count;
+
+    for (uint32_t b = 0, offset = 0; b < block_count; b++)
+    {
+        program->blocks[b].first_predecessor = offset;
+        offset += program->blocks[b].predecessor_count;
+        program->blocks[b].predecessor_count = 0;
+    }
+    for (uint32_t i = 0; i < program->instruction_count; i++)
+    {
+        IRInstruction *instruction = &program->instructions[i];
+        for (int j = 0; j < 2; j++)
+        {
+            if (instruction->opcode != IR_PHI && instruction->targets[j] != IR_NO_BLOCK)
+            {
+                IRBlock *target = &program->blocks[instruction->targets[j]];
+                program->predecessors[target->first_predecessor + target->predecessor_count++] = instruction->block;
+            }
+        }
+    }
+    program->predecessor_count = edge_count;
+
+    for (uint32_t f = 0; f < program->function_count; f++)
+    {
+        IRFunction *function = &program->functions[f];
+        uint32_t first_instruction = function->first_instruction, end = first_instruction + function->instruction_count;
+        uint32_t count = 0;
+        for (uint32_t i = first_instruction; i < end; i++)
+        {
+            count += new_values[i] != IR_NO_VALUE;
+        }
+        function->first_instruction = count ? new_values[first_instruction] : program->instruction_count;
+        function->instruction_count = count;
+        function->first_block = count ? new_blocks[builder->instructions[first_instruction].block] : block_count;
+        function->block_count = count ? program->instructions[function->first_instruction + count - 1].block + 1 -
+                                        function->first_block : 0;
+    }
+
+    free(replacements);
+    free(new_values);
+    free(new_blocks);
+    return 1;
+}
+
+IRProgram *lower_to_ir(AST *ast, ErrorList *error_list)
+{
+    if (!ast || ast->root == AST_NO_NODE)
+    {
+        add_new_error(error_list, 0, 0, CODEGEN, "Invalid AST passed");
+        return NULL;
+    }
+
+    Arena *arena = ast->arena;
+    ASTNode *root = get_ast_node(ast, ast->root);
+    IRProgram *program = arena_calloc(arena, 1, sizeof(IRProgram));
+    IRFunction *functions = arena_calloc(arena, root->num_children ? root->num_children : 1, sizeof(IRFunction));
+    if (!program || !functions)
+    {
+        if (!arena)
+        {
+            free(program);
+            free(functions);
+        }
+        add_new_error(error_list, 0, 0, CODEGEN, "Failed to allocate IR program");
+        return NULL;
+    }
+
+    program->arena = arena;
+    program->functions = functions;
+    program->symbol_table = ast->token_stream->symbol_table;
+    IRBuilder builder = {
+        .ast = ast,
+        .token_stream = ast->token_stream,
+        .program = program,
+        .error_list = error_list,
+        .error_base = error_list ? error_list->size : 0,
+        .current = IR_NO_BLOCK,
+    };
+
+    // Every function is known before any body, so calls can go forwards
+    for (uint32_t i = 0; i < root->num_children; i++)
+    {
+        uint32_t function = get_ast_child(ast, ast->root, i);
+        uint32_t symbol = builder.token_stream->symbols[get_ast_node(ast, function)->token];
+        if (find_function(&builder, symbol) != UINT32_MAX)
+        {
+            report_ir_error(&builder, get_ast_node(ast, function)->token, "Function '%.*s' is defined more than once");
+            continue;
+        }
+
+        IRFunction *entry = &program->functions[program->function_count++];
+        entry->symbol = symbol;
+        entry->parameter_count = get_ast_node(ast, get_ast_child(ast, function, 0))->num_children;
+    }
+
+    for (uint32_t i = 0, f = 0; i < root->num_children && !builder.out_of_memory; i++)
+    {
+        uint32_t function = get_ast_child(ast, ast->root, i);
+        if (find_function(&builder, builder.token_stream->symbols[get_ast_node(ast, function)->token]) == f)
+        {
+            lower_function(&builder, function, &program->functions[f++]);
+        }
+    }
+
+    int failed = builder.out_of_memory || (error_list && error_list->size > builder.error_base);
+    if (!failed && !finish_ir_program(&builder))
+    {
+        builder.out_of_memory = 1;
+        failed = 1;
+    }
+
+    free(builder.instructions);
+    free(builder.operands);
+    free(builder.blocks);
+    free(builder.bindings);
+
+    if (builder.out_of_memory)
+    {
+        add_new_error(error_list, 0, 0, CODEGEN, "Out of memory while lowering to IR");
+    }
+    if (failed)
+    {
+        free_ir_program(program);
+        return NULL;
+    }
+
+    return program;
+}
+
+void free_ir_program(IRProgram *program)
+{
+    if (!program || program->arena)
+    {
+        return;
+    }
+
+    free(program->instructions);
+    free(program->operands);
+    free(program->blocks);
+    free(program->predecessors);
+    free(program->functions);
+    free(program);
+}
+
+static void print_location(const RegisterAllocation *allocation, uint32_t value, int column, FILE *file)
+{
+    uint32_t location = allocation ? allocation->locations[value] : REGALLOC_NO_LOCATION;
+    if (location == REGALLOC_NO_LOCATION)
+    {
+        fputc('\n', file);
+    }
+    else if (location & REGALLOC_SPILLED)
+    {
+        fprintf(file, "%*s; spill %u\n", column < 40 ? 40 - column : 1, "", location & ~REGALLOC_SPILLED);
+    }
+    else
+    {
+        fprintf(file, "%*s; r%u\n", column < 40 ? 40 - column : 1, "", location);
+    }
+}
+
+void print_ir_program(IRProgram *program, const RegisterAllocation *allocation, FILE *file)
+{
+    for (uint32_t f = 0; f < program->function_count; f++)
+    {
+        IRFunction *function = &program->functions[f];
+        uint32_t first_value = function->first_instruction, first_block = function->first_block;
+        int length;
+        const char *name = get_symbol_name(program->symbol_table, function->symbol, &length);
+
+        fprintf(file, "function %.*s (%u parameters", length, name, function->parameter_count);
+        if (allocation)
+        {
+            FunctionAllocation *usage = &allocation->functions[f];
+            fprintf(file, ", %u of %u registers, %u spilled to %u slots", usage->registers_used,
+                    allocation->register_count, usage->spilled_values, usage->spill_slots);
+        }
+        fputs(")\n", file);
+
+        for (uint32_t b = first_block; b < first_block + function->block_count; b++)
+        {
+            IRBlock *block = &program->blocks[b];
+            int column = fprintf(file, "b%u:", b - first_block);
+            if (block->predecessor_count > 0 || block->loop_depth > 0)
+            {
+                fprintf(file, "%*s;", column < 40 ? 40 - column : 1, "");
+                for (uint32_t p = 0; p < block->predecessor_count; p++)
+                {
+                    fprintf(file, "%s b%u", p == 0 ? " from" : ",",
+                            program->predecessors[block->first_predecessor + p] - first_block);
+                }
+                if (block->loop_depth > 0)
+                {
+                    fprintf(file, "%s loop depth %u", block->predecessor_count ? "," : "", block->loop_depth);
+                }
+            }
+            fputc('\n', file);
+
+            for (uint32_t i = block->first_instruction; i < block->first_instruction + block->instruction_count; i++)
+            {
+                IRInstruction *instruction = &program->instructions[i];
+                uint32_t *operands = &program->operands[instruction->first_operand];
+                IROpcode opcode = instruction->opcode;
+                column = fprintf(file, "    ");
+                if (ir_defines_value(opcode))
+                {
+                    column += fprintf(file, "%%%u = ", i - first_value);
+                }
+                column += fprintf(file, "%s", ir_opcode_to_string(opcode));
+
+                switch (opcode)
+                {
+                case IR_CONST:
+                case IR_PARAM:
+                case IR_GPIO_READ:
+                    column += fprintf(file, " %d", instruction->immediate);
+                    break;
+                case IR_GPIO_SET:
+                    column += fprintf(file, " %d, %%%u", instruction->immediate, operands[0] - first_value);
+                    break;
+                case IR_PHI:
+                    for (uint32_t j = 0; j < instruction->operand_count; j += 2)
+                    {
+                        column += fprintf(file, "%s[b%u: %%%u]", j ? ", " : " ", operands[j] - first_block,
+                                          operands[j + 1] - first_value);
+                    }
+                    break;
+                case IR_CALL:
+                    name = get_symbol_name(program->symbol_table, program->functions[instruction->immediate].symbol,
+                                           &length);
+                    column += fprintf(file, " %.*s(", length, name);
+                    for (uint32_t j = 0; j < instruction->operand_count; j++)
+                    {
+                        column += fprintf(file, "%s%%%u", j ? ", " : "", operands[j] - first_value);
+                    }
+                    column += fprintf(file, ")");
+                    break;
+                case IR_JUMP:
+                    column += fprintf(file, " b%u", instruction->targets[0] - first_block);
+                    break;
+                case IR_BRANCH:
+                    column += fprintf(file, " %%%u, b%u, b%u", operands[0] - first_value,
+                                      instruction->targets[0] - first_block, instruction->targets[1] - first_block);
+                    break;
+                default:
+                    for (uint32_t j = 0; j < instruction->operand_count; j++)
+                    {
+                        column += fprintf(file, "%s%%%u", j ? ", " : " ", operands[j] - first_value);
+                    }
+                    break;
+                }
+
+                print_location(ir_defines_value(opcode) ? allocation : NULL, i, column, file);
+            }
+        }
+    }
+}
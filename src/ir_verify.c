@@ -0,0 +1,451 @@
+#include "ir.h"
+#include <stdarg.h>
+#include <stdlib.h>
+
+// Function being checked, with the scratch arrays indexed by its blocks
+typedef struct
+{
+    IRProgram *program;
+    IRFunction *function;
+    ErrorList *error_list;
+    uint32_t *order;       // Blocks in reverse postorder from the entry
+    uint32_t *positions;   // Position of each block in order, IR_NO_BLOCK if unreached
+    uint32_t *dominators;  // Immediate dominator of each block, by position
+    uint32_t *edges;       // Number of terminator edges into each block
+} IRVerifier;
+
+// Report the first problem found in a function, naming it and the block
+static int report_verify_error(IRVerifier *verifier, uint32_t block, const char *format, ...)
+{
+    char reason[160], message[256];
+    int length;
+    const char *name = get_symbol_name(verifier->program->symbol_table, verifier->function->symbol, &length);
+    va_list arguments;
+
+    va_start(arguments, format);
+    vsnprintf(reason, sizeof(reason), format, arguments);
+    va_end(arguments);
+    snprintf(message, sizeof(message), "IR of function '%.*s', block b%u: %s", length > 64 ? 64 : length, name,
+             block - verifier->function->first_block, reason);
+    add_new_error(verifier->error_list, 0, 0, CODEGEN, message);
+    return 0;
+}
+
+static int in_function_blocks(IRFunction *function, uint32_t block)
+{
+    return block >= function->first_block && block - function->first_block < function->block_count;
+}
+
+static int is_terminator(IROpcode opcode)
+{
+    return opcode == IR_JUMP || opcode == IR_BRANCH || opcode == IR_RETURN;
+}
+
+static uint32_t expected_operand_count(IRProgram *program, IRInstruction *instruction)
+{
+    switch (instruction->opcode)
+    {
+    case IR_CONST:
+    case IR_PARAM:
+    case IR_GPIO_READ:
+    case IR_JUMP:
+        return 0;
+    case IR_NOT:
+    case IR_NEG:
+    case IR_GPIO_SET:
+    case IR_BRANCH:
+    case IR_RETURN:
+        return 1;
+    case IR_CALL:
+        return program->functions[instruction->immediate].parameter_count;
+    case IR_PHI:
+        return 2 * program->blocks[instruction->block].predecessor_count;
+    default:
+        return 2;
+    }
+}
+
+// Shape of every block and instruction on its own: ranges, terminators, phis,
+// operand counts and targets
+static int verify_blocks(IRVerifier *verifier)
+{
+    IRProgram *program = verifier->program;
+    IRFunction *function = verifier->function;
+    uint32_t next = function->first_instruction;
+
+    for (uint32_t b = function->first_block; b < function->first_block + function->block_count; b++)
+    {
+        IRBlock *block = &program->blocks[b];
+        if (block->first_instruction != next || block->instruction_count == 0 ||
+            block->instruction_count > function->first_instruction + function->instruction_count - next)
+        {
+            return report_verify_error(verifier, b, "instructions are not the next ones of the function");
+        }
+        if (block->first_predecessor > program->predecessor_count ||
+            block->predecessor_count > program->predecessor_count - block->first_predecessor)
+        {
+            return report_verify_error(verifier, b, "predecessor list out of range");
+        }
+        next += block->instruction_count;
+
+        int past_phis = 0;
+        for (uint32_t i = block->first_instruction; i < next; i++)
+        {
+            IRInstruction *instruction = &program->instructions[i];
+            uint32_t position = i - function->first_instruction;
+            if (instruction->opcode >= IR_OPCODE_COUNT)
+            {
+                return report_verify_error(verifier, b, "%%%u has unknown opcode %u", position, instruction->opcode);
+            }
+
+            const char *name = ir_opcode_to_string(instruction->opcode);
+            if (instruction->block != b)
+            {
+                return report_verify_error(verifier, b, "%%%u (%s) claims to be in another block", position, name);
+            }
+            if (is_terminator(instruction->opcode) != (i == next - 1))
+            {
+                return report_verify_error(verifier, b, "%%%u (%s) %s", position, name,
+                                           i == next - 1 ? "ends the block but is no terminator"
+                                                         : "is a terminator before the end of the block");
+            }
+            if (instruction->opcode == IR_PHI && past_phis)
+            {
+                return report_verify_error(verifier, b, "%%%u (phi) follows other instructions", position);
+            }
+            past_phis = instruction->opcode != IR_PHI;
+            if (instruction->opcode == IR_PARAM &&
+                (b != function->first_block || (uint32_t)instruction->immediate >= function->parameter_count))
+            {
+                return report_verify_error(verifier, b, "%%%u (param) is not a parameter of the entry block",
+                                           position);
+            }
+            if (instruction->opcode == IR_CALL && (uint32_t)instruction->immediate >= program->function_count)
+            {
+                return report_verify_error(verifier, b, "%%%u (call) calls no function", position);
+            }
+            if (instruction->first_operand > program->operand_count ||
+                instruction->operand_count > program->operand_count - instruction->first_operand ||
+                instruction->operand_count != expected_operand_count(program, instruction))
+            {
+                return report_verify_error(verifier, b, "%%%u (%s) has %u operands", position, name,
+                                           instruction->operand_count);
+            }
+
+            int target_count = instruction->opcode == IR_JUMP ? 1 : instruction->opcode == IR_BRANCH ? 2 : 0;
+            for (int t = 0; t < target_count; t++)
+            {
+                uint32_t target = instruction->targets[t];
+                if (!in_function_blocks(function, target) || target == function->first_block)
+                {
+                    return report_verify_error(verifier, b, "%%%u (%s) targets a block outside the function body",
+                                               position, name);
+                }
+                verifier->edges[target - function->first_block]++;
+            }
+        }
+    }
+
+    if (next != function->first_instruction + function->instruction_count)
+    {
+        return report_verify_error(verifier, function->first_block, "function has instructions outside its blocks");
+    }
+    return 1;
+}
+
+// Predecessor lists must list exactly the blocks whose terminators lead here
+static int verify_predecessors(IRVerifier *verifier)
+{
+    IRProgram *program = verifier->program;
+    IRFunction *function = verifier->function;
+
+    for (uint32_t b = function->first_block; b < function->first_block + function->block_count; b++)
+    {
+        IRBlock *block = &program->blocks[b];
+        if (block->predecessor_count != verifier->edges[b - function->first_block])
+        {
+            return report_verify_error(verifier, b, "has %u predecessors but %u edges lead to it",
+                                       block->predecessor_count, verifier->edges[b - function->first_block]);
+        }
+
+        for (uint32_t p = 0; p < block->predecessor_count; p++)
+        {
+            uint32_t predecessor = program->predecessors[block->first_predecessor + p];
+            IRInstruction *terminator = NULL;
+            if (in_function_blocks(function, predecessor))
+            {
+                IRBlock *from = &program->blocks[predecessor];
+                terminator = &program->instructions[from->first_instruction + from->instruction_count - 1];
+            }
+            if (!terminator || (terminator->targets[0] != b && terminator->targets[1] != b))
+            {
+                return report_verify_error(verifier, b, "predecessor %u does not lead to it",
+                                           predecessor - function->first_block);
+            }
+        }
+    }
+    return 1;
+}
+
+// Number the blocks reached from the entry in reverse postorder, with an explicit
+// stack so a long chain of blocks cannot overflow the call stack
+static int order_blocks(IRVerifier *verifier)
+{
+    IRProgram *program = verifier->program;
+    IRFunction *function = verifier->function;
+    uint32_t count = function->block_count, first = function->first_block;
+    uint32_t *stack = malloc(count * sizeof(uint32_t));
+    uint8_t *next_successor = calloc(count, 1);
+    if (!stack || !next_successor)
+    {
+        free(stack);
+        free(next_successor);
+        add_new_error(verifier->error_list, 0, 0, CODEGEN, "Out of memory while verifying IR");
+        return 0;
+    }
+
+    uint32_t depth = 0, finished = count;
+    for (uint32_t b = 0; b < count; b++)
+    {
+        verifier->positions[b] = IR_NO_BLOCK;
+    }
+    stack[depth++] = 0;
+    verifier->positions[0] = 0;
+    while (depth > 0)
+    {
+        uint32_t b = stack[depth - 1];
+        IRBlock *block = &program->blocks[first + b];
+        IRInstruction *terminator = &program->instructions[block->first_instruction + block->instruction_count - 1];
+        int successor_count = terminator->opcode == IR_JUMP ? 1 : terminator->opcode == IR_BRANCH ? 2 : 0;
+
+        if (next_successor[b] < successor_count)
+        {
+            uint32_t successor = terminator->targets[next_successor[b]++] - first;
+            if (verifier->positions[successor] == IR_NO_BLOCK)
+            {
+                verifier->positions[successor] = 0;
+                stack[depth++] = successor;
+            }
+            continue;
+        }
+
+        verifier->order[--finished] = b;
+        depth--;
+    }
+
+    // Unreached blocks leave the front of order unused; shift the rest down
+    uint32_t reached = count - finished;
+    for (uint32_t i = 0; i < reached; i++)
+    {
+        verifier->order[i] = verifier->order[finished + i];
+        verifier->positions[verifier->order[i]] = i;
+    }
+
+    free(stack);
+    free(next_successor);
+    if (reached < count)
+    {
+        for (uint32_t b = 0; b < count; b++)
+        {
+            if (verifier->positions[b] == IR_NO_BLOCK)
+            {
+                return report_verify_error(verifier, first + b, "is not reachable from the entry");
+            }
+        }
+    }
+    return 1;
+}
+
+static uint32_t intersect(uint32_t *dominators, uint32_t a, uint32_t b)
+{
+    while (a != b)
+    {
+        while (a > b)
+        {
+            a = dominators[a];
+        }
+        while (b > a)
+        {
+            b = dominators[b];
+        }
+    }
+    return a;
+}
+
+// Immediate dominators by the iterative algorithm of Cooper, Harvey and Kennedy,
+// over block positions in reverse postorder
+static void find_dominators(IRVerifier *verifier)
+{
+    IRProgram *program = verifier->program;
+    uint32_t first = verifier->function->first_block, count = verifier->function->block_count;
+    int changed = 1;
+
+    for (uint32_t i = 1; i < count; i++)
+    {
+        verifier->dominators[i] = IR_NO_BLOCK;
+    }
+    verifier->dominators[0] = 0;
+    while (changed)
+    {
+        changed = 0;
+        for (uint32_t i = 1; i < count; i++)
+        {
+            IRBlock *block = &program->blocks[first + verifier->order[i]];
+            uint32_t dominator = IR_NO_BLOCK;
+            for (uint32_t p = 0; p < block->predecessor_count; p++)
+            {
+                uint32_t position = verifier->positions[program->predecessors[block->first_predecessor + p] - first];
+                if (verifier->dominators[position] == IR_NO_BLOCK)
+                {
+                    continue;
+                }
+                dominator = dominator == IR_NO_BLOCK ? position : intersect(verifier->dominators, position, dominator);
+            }
+            if (verifier->dominators[i] != dominator)
+            {
+                verifier->dominators[i] = dominator;
+                changed = 1;
+            }
+        }
+    }
+}
+
+static int dominates(IRVerifier *verifier, uint32_t dominator, uint32_t block)
+{
+    uint32_t first = verifier->function->first_block;
+    uint32_t target = verifier->positions[dominator - first], position = verifier->positions[block - first];
+    while (position > target)
+    {
+        position = verifier->dominators[position];
+    }
+    return position == target;
+}
+
+// Every operand is a value of the function defined where it is available: earlier
+// in the same block or in a dominating one, and for a phi at the end of the
+// predecessor it names
+static int verify_operands(IRVerifier *verifier)
+{
+    IRProgram *program = verifier->program;
+    IRFunction *function = verifier->function;
+    uint32_t first = function->first_instruction, end = first + function->instruction_count;
+
+    for (uint32_t i = first; i < end; i++)
+    {
+        IRInstruction *instruction = &program->instructions[i];
+        uint32_t *operands = &program->operands[instruction->first_operand];
+        int is_phi = instruction->opcode == IR_PHI;
+
+        for (uint32_t j = is_phi; j < instruction->operand_count; j += 1 + is_phi)
+        {
+            uint32_t value = operands[j];
+            uint32_t use_block = is_phi ? operands[j - 1] : instruction->block;
+            if (value < first || value >= end || !ir_defines_value(program->instructions[value].opcode))
+            {
+                return report_verify_error(verifier, instruction->block, "%%%u uses something that is no value",
+                                           i - first);
+            }
+            if (is_phi)
+            {
+                IRBlock *block = &program->blocks[instruction->block];
+                uint32_t p = 0;
+                while (p < block->predecessor_count && program->predecessors[block->first_predecessor + p] != use_block)
+                {
+                    p++;
+                }
+                for (uint32_t k = 0; k + 1 < j && p < block->predecessor_count; k += 2)
+                {
+                    p = operands[k] == use_block ? block->predecessor_count : p;
+                }
+                if (p == block->predecessor_count)
+                {
+                    return report_verify_error(verifier, instruction->block,
+                                               "%%%u (phi) does not name each predecessor once", i - first);
+                }
+            }
+
+            uint32_t definition_block = program->instructions[value].block;
+            int available = definition_block == use_block && !is_phi ? value < i
+                                                                     : dominates(verifier, definition_block, use_block);
+            if (!available)
+            {
+                return report_verify_error(verifier, instruction->block, "%%%u uses %%%u where it is not defined",
+                                           i - first, value - first);
+            }
+        }
+    }
+    return 1;
+}
+
+static int verify_function(IRVerifier *verifier)
+{
+    IRFunction *function = verifier->function;
+    if (function->block_count == 0)
+    {
+        return report_verify_error(verifier, function->first_block, "function has no blocks");
+    }
+    if (!verify_blocks(verifier) || !verify_predecessors(verifier))
+    {
+        return 0;
+    }
+    if (verifier->program->blocks[function->first_block].predecessor_count != 0)
+    {
+        return report_verify_error(verifier, function->first_block, "entry block has predecessors");
+    }
+    if (!order_blocks(verifier))
+    {
+        return 0;
+    }
+    find_dominators(verifier);
+    return verify_operands(verifier);
+}
+
+int verify_ir_program(IRProgram *program, ErrorList *error_list)
+{
+    if (!program)
+    {
+        add_new_error(error_list, 0, 0, CODEGEN, "Invalid IR program passed");
+        return 0;
+    }
+
+    uint32_t block_count = 0;
+    for (uint32_t f = 0; f < program->function_count; f++)
+    {
+        IRFunction *function = &program->functions[f];
+        if (function->first_block > program->block_count ||
+            function->block_count > program->block_count - function->first_block ||
+            function->first_instruction > program->instruction_count ||
+            function->instruction_count > program->instruction_count - function->first_instruction)
+        {
+            add_new_error(error_list, 0, 0, CODEGEN, "IR function out of the program's range");
+            return 0;
+        }
+        block_count = function->block_count > block_count ? function->block_count : block_count;
+    }
+
+    IRVerifier verifier = {program, NULL, error_list, NULL, NULL, NULL, NULL};
+    uint32_t *scratch = malloc((block_count ? block_count : 1) * 4 * sizeof(uint32_t));
+    if (!scratch)
+    {
+        add_new_error(error_list, 0, 0, CODEGEN, "Out of memory while verifying IR");
+        return 0;
+    }
+    verifier.order = scratch;
+    verifier.positions = scratch + block_count;
+    verifier.dominators = scratch + 2 * block_count;
+    verifier.edges = scratch + 3 * block_count;
+
+    int valid = 1;
+    for (uint32_t f = 0; f < program->function_count && valid; f++)
+    {
+        verifier.function = &program->functions[f];
+        for (uint32_t b = 0; b < verifier.function->block_count; b++)
+        {
+            verifier.edges[b] = 0;
+        }
+        valid = verify_function(&verifier);
+    }
+
+    free(scratch);
+    return valid;
+}
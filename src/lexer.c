@@ -2,441 +2,1162 @@
 #include "token.h"
 #include <string.h>
 #include <stdlib.h>
-#include <ctype.h>
 #include "errors.h"
+#include "source.h"
+#include "lexer_simd.h"
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
 
-// Check if the token is a valid number
-static int is_valid_number_token(char *string)
+// Character classes, every input byte maps to exactly one of these
+typedef enum
 {
-    if (!string)
+    CHAR_OTHER,       // Bytes the language does not use
+    CHAR_NEWLINE,     // '\n'
+    CHAR_SPACE,       // Whitespace other than '\n'
+    CHAR_HASH,        // '#' starts a comment
+    CHAR_DIGIT,       // 0-9
+    CHAR_LETTER,      // a-z A-Z
+    CHAR_UNDERSCORE,  // '_'
+    CHAR_PUNCTUATION, // , ; ( ) { }
+    CHAR_ARITHMETIC,  // + - * /
+    CHAR_EQUALS,      // '='
+    CHAR_LESS,        // '<'
+    CHAR_GREATER,     // '>'
+    CHAR_BANG,        // '!'
+    CHAR_AMPERSAND,   // '&'
+    CHAR_PIPE,        // '|'
+    CHAR_CLASS_COUNT
+} CharClass;
+
+// DFA states for recognising a single token, LEX_REJECT ends the token
+typedef enum
+{
+    LEX_REJECT,
+    LEX_START,
+    LEX_NUMBER,       // Digits only
+    LEX_IDENTIFIER,   // Letter followed by letters, digits or underscores
+    LEX_BAD_WORD,     // Word characters that form neither a number nor an identifier
+    LEX_SINGLE,       // Complete one-character token
+    LEX_LESS,         // '<' which may become '<='
+    LEX_GREATER,      // '>' which may become '>='
+    LEX_EQUALS,       // '=' which may become '=='
+    LEX_BANG,         // '!' which may become '!='
+    LEX_AMPERSAND,    // '&' which must become '&&'
+    LEX_PIPE,         // '|' which must become '||'
+    LEX_DOUBLE,       // Complete two-character operator
+    LEX_STATE_COUNT
+} LexerState;
+
+static const unsigned char char_classes[256] = {
+    ['\n'] = CHAR_NEWLINE,
+    [' '] = CHAR_SPACE, ['\t'] = CHAR_SPACE, ['\v'] = CHAR_SPACE, ['\f'] = CHAR_SPACE, ['\r'] = CHAR_SPACE,
+    ['#'] = CHAR_HASH,
+    ['0' ... '9'] = CHAR_DIGIT,
+    ['a' ... 'z'] = CHAR_LETTER,
+    ['A' ... 'Z'] = CHAR_LETTER,
+    ['_'] = CHAR_UNDERSCORE,
+    [','] = CHAR_PUNCTUATION, [';'] = CHAR_PUNCTUATION, ['('] = CHAR_PUNCTUATION,
+    [')'] = CHAR_PUNCTUATION, ['{'] = CHAR_PUNCTUATION, ['}'] = CHAR_PUNCTUATION,
+    ['+'] = CHAR_ARITHMETIC, ['-'] = CHAR_ARITHMETIC, ['*'] = CHAR_ARITHMETIC, ['/'] = CHAR_ARITHMETIC,
+    ['='] = CHAR_EQUALS,
+    ['<'] = CHAR_LESS,
+    ['>'] = CHAR_GREATER,
+    ['!'] = CHAR_BANG,
+    ['&'] = CHAR_AMPERSAND,
+    ['|'] = CHAR_PIPE,
+};
+
+// Transition table, any pair not listed goes to LEX_REJECT
+static const unsigned char transitions[LEX_STATE_COUNT][CHAR_CLASS_COUNT] = {
+    [LEX_START] = {
+        [CHAR_DIGIT] = LEX_NUMBER,
+        [CHAR_LETTER] = LEX_IDENTIFIER,
+        [CHAR_UNDERSCORE] = LEX_BAD_WORD,
+        [CHAR_PUNCTUATION] = LEX_SINGLE,
+        [CHAR_ARITHMETIC] = LEX_SINGLE,
+        [CHAR_EQUALS] = LEX_EQUALS,
+        [CHAR_LESS] = LEX_LESS,
+        [CHAR_GREATER] = LEX_GREATER,
+        [CHAR_BANG] = LEX_BANG,
+        [CHAR_AMPERSAND] = LEX_AMPERSAND,
+        [CHAR_PIPE] = LEX_PIPE,
+    },
+    [LEX_NUMBER] = {
+        [CHAR_DIGIT] = LEX_NUMBER,
+        [CHAR_LETTER] = LEX_BAD_WORD,
+        [CHAR_UNDERSCORE] = LEX_BAD_WORD,
+    },
+    [LEX_IDENTIFIER] = {
+        [CHAR_DIGIT] = LEX_IDENTIFIER,
+        [CHAR_LETTER] = LEX_IDENTIFIER,
+        [CHAR_UNDERSCORE] = LEX_IDENTIFIER,
+    },
+    [LEX_BAD_WORD] = {
+        [CHAR_DIGIT] = LEX_BAD_WORD,
+        [CHAR_LETTER] = LEX_BAD_WORD,
+        [CHAR_UNDERSCORE] = LEX_BAD_WORD,
+    },
+    [LEX_LESS] = {[CHAR_EQUALS] = LEX_DOUBLE},
+    [LEX_GREATER] = {[CHAR_EQUALS] = LEX_DOUBLE},
+    [LEX_EQUALS] = {[CHAR_EQUALS] = LEX_DOUBLE},
+    [LEX_BANG] = {[CHAR_EQUALS] = LEX_DOUBLE},
+    [LEX_AMPERSAND] = {[CHAR_AMPERSAND] = LEX_DOUBLE},
+    [LEX_PIPE] = {[CHAR_PIPE] = LEX_DOUBLE},
+};
+
+// Token types of the one-character tokens
+static const unsigned char single_character_tokens[256] = {
+    [','] = TOKEN_COMMA, [';'] = TOKEN_SEMICOLON, ['('] = TOKEN_LPAREN,
+    [')'] = TOKEN_RPAREN, ['{'] = TOKEN_LBRACE, ['}'] = TOKEN_RBRACE,
+    ['+'] = TOKEN_PLUS, ['-'] = TOKEN_MINUS, ['*'] = TOKEN_STAR, ['/'] = TOKEN_SLASH,
+    ['='] = TOKEN_ASSIGN, ['<'] = TOKEN_LT, ['>'] = TOKEN_GT, ['!'] = TOKEN_NOT,
+};
+
+// Token types of the two-character operators, indexed by their first character
+static const unsigned char double_character_tokens[256] = {
+    ['='] = TOKEN_EQ, ['!'] = TOKEN_NEQ, ['<'] = TOKEN_LTE,
+    ['>'] = TOKEN_GTE, ['&'] = TOKEN_AND, ['|'] = TOKEN_OR,
+};
+
+typedef struct
+{
+    const char *text;
+    unsigned char length;
+    unsigned char type;
+} Keyword;
+
+// Perfect hash over the keywords: (2 * length + first + last) mod 32 puts each
+// of the twelve keywords in its own slot, so a lookup is one hash and one compare
+#define KEYWORD_HASH(first, last, length) (((length) * 2 + (first) + (last)) & 31)
+
+static const Keyword keyword_table[32] = {
+    [1] = {"true", 4, TOKEN_TRUE},
+    [3] = {"int", 3, TOKEN_INT},
+    [6] = {"while", 5, TOKEN_WHILE},
+    [9] = {"LOW", 3, TOKEN_LOW},
+    [12] = {"return", 6, TOKEN_RETURN},
+    [15] = {"SET_PIN", 7, TOKEN_SET_PIN},
+    [16] = {"READ_PIN", 8, TOKEN_READ_PIN},
+    [18] = {"else", 4, TOKEN_ELSE},
+    [19] = {"if", 2, TOKEN_IF},
+    [21] = {"false", 5, TOKEN_FALSE},
+    [22] = {"bool", 4, TOKEN_BOOL},
+    [24] = {"HIGH", 4, TOKEN_HIGH},
+};
+
+// Resolve an identifier-shaped word to its keyword type, or TOKEN_IDENTIFIER
+static TokenType get_word_type(const char *word, int length)
+{
+    const Keyword *keyword = &keyword_table[KEYWORD_HASH((unsigned char)word[0], (unsigned char)word[length - 1], length)];
+    if (keyword->length == length && memcmp(keyword->text, word, length) == 0)
     {
-        return 0;
+        return (TokenType)keyword->type;
+    }
+    return TOKEN_IDENTIFIER;
+}
+
+// Outcome of scanning one token
+typedef enum
+{
+    SCAN_TOKEN,     // A token was produced
+    SCAN_SKIPPED,   // Bytes were consumed and reported as an error, no token
+    SCAN_NEED_MORE, // The token may continue past the available bytes
+    SCAN_FAILED     // Reading more input or interning a name failed
+} ScanResult;
+
+// Move the unconsumed bytes from keep_from onwards to the front of the buffer and
+// read more after them. Returns 0 on a read error, otherwise 1 (input_exhausted is
+// set once the reader has nothing left).
+static int refill_lexer(Lexer *lexer, const char *keep_from)
+{
+    if (!lexer->buffer)
+    {
+        lexer->input_exhausted = 1;
+        return 1;
     }
 
-    size_t length = strlen(string);
-    for (size_t i = 0; i < length; i++)
+    size_t kept = lexer->end - keep_from;
+    size_t cursor_position = lexer->cursor - keep_from;
+    lexer->data_offset += keep_from - lexer->data;
+    memmove(lexer->buffer, keep_from, kept);
+
+    // A single token filled the whole buffer, make room for the rest of it
+    if (kept == lexer->buffer_capacity)
     {
-        if (!isdigit(string[i]))
+        size_t new_capacity = lexer->buffer_capacity * 2;
+        char *new_buffer = realloc(lexer->buffer, new_capacity);
+        if (!new_buffer)
         {
+            add_new_error(lexer->error_list, lexer->line_number, lexer->column_number, LEXER, "Failed to grow lexer buffer");
             return 0;
         }
+        lexer->buffer = new_buffer;
+        lexer->buffer_capacity = new_capacity;
     }
 
-    return 1;
-}
+    ssize_t bytes_read;
+    char *target = lexer->buffer + kept;
+    size_t space = lexer->buffer_capacity - kept;
 
-// Check if the token is a valid identifier
-static int is_valid_identifier_token(char *string)
-{
-    if (!string || !isalpha(*string))
+    if (lexer->file)
+    {
+        bytes_read = fread(target, 1, space, lexer->file);
+        if (bytes_read == 0 && ferror(lexer->file))
+        {
+            bytes_read = -1;
+        }
+    }
+    else
+    {
+        do
+        {
+            bytes_read = read(lexer->fd, target, space);
+        } while (bytes_read < 0 && errno == EINTR);
+    }
+
+    if (bytes_read < 0)
     {
+        add_new_error(lexer->error_list, lexer->line_number, lexer->column_number, LEXER, "Failed to read source input");
         return 0;
     }
 
-    size_t length = strlen(string);
-    for (size_t i = 1; i < length; i++)
+    if (bytes_read == 0)
+    {
+        lexer->input_exhausted = 1;
+    }
+    else
     {
-        if (!(isalnum(string[i]) || string[i] == '_'))
+        lexer->ends_with_newline = target[bytes_read - 1] == '\n';
+    }
+
+    lexer->data = lexer->buffer;
+    lexer->cursor = lexer->buffer + cursor_position;
+    lexer->end = target + bytes_read;
+    return 1;
+}
+
+// Skip a comment by jumping straight to the end of the line, refilling as needed
+static int skip_comment(Lexer *lexer)
+{
+    lexer->cursor = find_newline(lexer->cursor, lexer->end);
+
+    while (lexer->cursor == lexer->end && !lexer->input_exhausted)
+    {
+        if (!refill_lexer(lexer, lexer->end))
         {
             return 0;
         }
+        lexer->cursor = find_newline(lexer->cursor, lexer->end);
     }
 
+    if (lexer->cursor < lexer->end)
+    {
+        lexer->cursor++;
+        lexer->line_number++;
+        lexer->column_number = 1;
+    }
     return 1;
 }
 
-// Check if a string is a keyword
-static TokenType get_keyword_type(char *string)
-{
-    if (strcmp(string, "int") == 0)
-        return TOKEN_INT;
-    if (strcmp(string, "bool") == 0)
-        return TOKEN_BOOL;
-    if (strcmp(string, "true") == 0)
-        return TOKEN_TRUE;
-    if (strcmp(string, "false") == 0)
-        return TOKEN_FALSE;
-    if (strcmp(string, "if") == 0)
-        return TOKEN_IF;
-    if (strcmp(string, "else") == 0)
-        return TOKEN_ELSE;
-    if (strcmp(string, "while") == 0)
-        return TOKEN_WHILE;
-    if (strcmp(string, "SET_PIN") == 0)
-        return TOKEN_SET_PIN;
-    if (strcmp(string, "READ_PIN") == 0)
-        return TOKEN_READ_PIN;
-    if (strcmp(string, "HIGH") == 0)
-        return TOKEN_HIGH;
-    if (strcmp(string, "LOW") == 0)
-        return TOKEN_LOW;
-    return TOKEN_ERROR;
-}
-
-// Check if a string is an operator
-static TokenType get_operator_type(char *string)
-{
-    if (strcmp(string, "+") == 0)
-        return TOKEN_PLUS;
-    if (strcmp(string, "-") == 0)
-        return TOKEN_MINUS;
-    if (strcmp(string, "*") == 0)
-        return TOKEN_STAR;
-    if (strcmp(string, "/") == 0)
-        return TOKEN_SLASH;
-    if (strcmp(string, "=") == 0)
-        return TOKEN_ASSIGN;
-    if (strcmp(string, "==") == 0)
-        return TOKEN_EQ;
-    if (strcmp(string, "!=") == 0)
-        return TOKEN_NEQ;
-    if (strcmp(string, "<") == 0)
-        return TOKEN_LT;
-    if (strcmp(string, ">") == 0)
-        return TOKEN_GT;
-    if (strcmp(string, "<=") == 0)
-        return TOKEN_LTE;
-    if (strcmp(string, ">=") == 0)
-        return TOKEN_GTE;
-    if (strcmp(string, "&&") == 0)
-        return TOKEN_AND;
-    if (strcmp(string, "||") == 0)
-        return TOKEN_OR;
-    if (strcmp(string, "!") == 0)
-        return TOKEN_NOT;
-    return TOKEN_ERROR;
-}
+// Consume the rest of a word that is too long to keep, refilling as needed
+static int skip_long_word(Lexer *lexer)
+{
+    for (;;)
+    {
+        size_t run_length = scan_word(lexer->cursor, lexer->end);
+        lexer->cursor += run_length;
+        lexer->column_number += run_length;
 
-// Check if a string is punctuation
-static TokenType get_punctuation_type(char *string)
-{
-    if (strcmp(string, ";") == 0)
-        return TOKEN_SEMICOLON;
-    if (strcmp(string, ",") == 0)
-        return TOKEN_COMMA;
-    if (strcmp(string, "(") == 0)
-        return TOKEN_LPAREN;
-    if (strcmp(string, ")") == 0)
-        return TOKEN_RPAREN;
-    if (strcmp(string, "{") == 0)
-        return TOKEN_LBRACE;
-    if (strcmp(string, "}") == 0)
-        return TOKEN_RBRACE;
-    return TOKEN_ERROR;
+        if (lexer->cursor < lexer->end || lexer->input_exhausted)
+        {
+            return 1;
+        }
+        if (!refill_lexer(lexer, lexer->end))
+        {
+            return 0;
+        }
+    }
 }
 
-// Check if a string is a number or identifier
-static TokenType get_identifier_or_number_type(char *string)
+// Run the DFA from the cursor and produce the longest token it accepts, reporting anything it rejects
+static ScanResult scan_token(Lexer *lexer, Token *token)
 {
-    if (isdigit(string[0]) && is_valid_number_token(string))
-        return TOKEN_NUMBER;
-    if (is_valid_identifier_token(string))
-        return TOKEN_IDENTIFIER;
-    return TOKEN_ERROR;
+    const char *token_start = lexer->cursor;
+    const char *position = lexer->cursor;
+    const char *end = lexer->end;
+    LexerState state = LEX_START;
+
+    // Identifiers and keywords are the bulk of the words, find their end a block at a time
+    if (char_classes[(unsigned char)*position] == CHAR_LETTER)
+    {
+        state = LEX_IDENTIFIER;
+        position += scan_word(position, end);
+    }
+
+    while (position < end)
+    {
+        LexerState next_state = transitions[state][char_classes[(unsigned char)*position]];
+        if (next_state == LEX_REJECT)
+        {
+            break;
+        }
+        state = next_state;
+        position++;
+    }
+
+    int length = position - token_start;
+    int start_column = lexer->column_number;
+    int may_continue = position == end && !lexer->input_exhausted;
+
+    // The token might carry on in the next chunk
+    if (may_continue && length <= MAX_TOKEN_LENGTH)
+    {
+        return SCAN_NEED_MORE;
+    }
+
+    if (length > MAX_TOKEN_LENGTH)
+    {
+        add_new_error(lexer->error_list, lexer->line_number, start_column, LEXER, "Token exceeds maximum length");
+        lexer->cursor = position;
+        lexer->column_number += length;
+
+        // Only words grow this long, drop whatever is left of it without buffering it
+        if (may_continue && !skip_long_word(lexer))
+        {
+            return SCAN_FAILED;
+        }
+        return SCAN_SKIPPED;
+    }
+
+    TokenType token_type = TOKEN_ERROR;
+
+    switch (state)
+    {
+    case LEX_NUMBER:
+        token_type = TOKEN_NUMBER;
+        break;
+    case LEX_IDENTIFIER:
+        token_type = get_word_type(token_start, length);
+        break;
+    case LEX_SINGLE:
+    case LEX_LESS:
+    case LEX_GREATER:
+    case LEX_EQUALS:
+    case LEX_BANG:
+        token_type = (TokenType)single_character_tokens[(unsigned char)*token_start];
+        break;
+    case LEX_DOUBLE:
+        token_type = (TokenType)double_character_tokens[(unsigned char)*token_start];
+        break;
+    case LEX_BAD_WORD:
+        break;
+    default:
+        // Nothing was accepted, skip the offending character on its own
+        add_new_coded_error(lexer->error_list, lexer->line_number, start_column, LEXER, ERROR_UNRECOGNIZED_TOKEN);
+        lexer->cursor = token_start + 1;
+        lexer->column_number++;
+        return SCAN_SKIPPED;
+    }
+
+    lexer->cursor = position;
+    lexer->column_number += length;
+
+    if (token_type == TOKEN_ERROR)
+    {
+        add_new_coded_error(lexer->error_list, lexer->line_number, start_column, LEXER, ERROR_INVALID_TOKEN);
+        return SCAN_SKIPPED;
+    }
+
+    // Intern the name while its bytes are still in the buffer
+    uint32_t symbol = NO_SYMBOL;
+    if (token_type == TOKEN_IDENTIFIER && lexer->symbol_table)
+    {
+        symbol = intern_symbol(lexer->symbol_table, token_start, length);
+        if (symbol == NO_SYMBOL)
+        {
+            add_new_error(lexer->error_list, lexer->line_number, start_column, LEXER, "Failed to intern identifier");
+            return SCAN_FAILED;
+        }
+    }
+
+    token->type = token_type;
+    token->offset = lexer->data_offset + (token_start - lexer->data);
+    token->length = length;
+    token->line = lexer->line_number;
+    token->column = start_column;
+    token->symbol = symbol;
+    return SCAN_TOKEN;
 }
 
-static TokenType get_token_type(char *string)
+// Produce the EOF token, or report that the input held nothing to lex
+static int finish_lexing(Lexer *lexer, Token *token)
 {
-    if (!string || strlen(string) == 0)
+    lexer->finished = 1;
+
+    if (!lexer->has_content)
+    {
+        add_new_error(lexer->error_list, 0, 0, LEXER, "Input contains no valid tokens");
+        return 0;
+    }
+
+    // If the last character processed was a newline i.e. the input ended with newline, increment the line number
+    if (lexer->ends_with_newline)
     {
-        return TOKEN_ERROR;
+        lexer->line_number++;
+        lexer->column_number = 1;
     }
 
-    // Check for specific token categories
-    TokenType token_type;
+    token->type = TOKEN_EOF;
+    token->offset = lexer->data_offset + (lexer->end - lexer->data);
+    token->length = 0;
+    token->line = lexer->line_number;
+    token->column = lexer->column_number;
+    token->symbol = NO_SYMBOL;
+    return 1;
+}
 
-    // Check for keywords
-    token_type = get_keyword_type(string);
-    if (token_type != TOKEN_ERROR)
-        return token_type;
+static inline int next_token(Lexer *lexer, Token *token)
+{
+    if (lexer->finished)
+    {
+        return 0;
+    }
 
-    // Check for operators
-    token_type = get_operator_type(string);
-    if (token_type != TOKEN_ERROR)
-        return token_type;
+    for (;;)
+    {
+        if (lexer->cursor == lexer->end)
+        {
+            if (lexer->input_exhausted)
+            {
+                if (lexer->partial)
+                {
+                    lexer->finished = 1;
+                    lexer->reached_end = 1;
+                    return 0;
+                }
+                return finish_lexing(lexer, token);
+            }
+            if (!refill_lexer(lexer, lexer->end))
+            {
+                lexer->finished = 1;
+                return 0;
+            }
+            continue;
+        }
 
-    // Check for punctuation
-    token_type = get_punctuation_type(string);
-    if (token_type != TOKEN_ERROR)
-        return token_type;
+        switch (char_classes[(unsigned char)*lexer->cursor])
+        {
+        case CHAR_NEWLINE:
+            lexer->line_number++;
+            lexer->column_number = 1;
+            lexer->cursor++;
+            break;
+        case CHAR_SPACE:
+            if (*lexer->cursor == ' ' || *lexer->cursor == '\t')
+            {
+                // Indentation comes in runs, skip the whole run at once
+                size_t run_length = scan_spaces(lexer->cursor, lexer->end);
+                lexer->column_number += run_length;
+                lexer->cursor += run_length;
+            }
+            else
+            {
+                lexer->has_content = 1;
+                lexer->column_number++;
+                lexer->cursor++;
+            }
+            break;
+        case CHAR_HASH:
+            lexer->has_content = 1;
+            if (!skip_comment(lexer))
+            {
+                lexer->finished = 1;
+                return 0;
+            }
+            break;
+        default:
+            lexer->has_content = 1;
+            switch (scan_token(lexer, token))
+            {
+            case SCAN_TOKEN:
+                return 1;
+            case SCAN_SKIPPED:
+                // Past the error limit, stop rather than report a cascade nobody will read
+                if (error_limit_reached(lexer->error_list))
+                {
+                    lexer->finished = 1;
+                    return 0;
+                }
+                break;
+            case SCAN_NEED_MORE:
+                // Keep the partial token at the front of the buffer and read the rest of it
+                if (!refill_lexer(lexer, lexer->cursor))
+                {
+                    lexer->finished = 1;
+                    return 0;
+                }
+                break;
+            case SCAN_FAILED:
+                lexer->finished = 1;
+                return 0;
+            }
+            break;
+        }
+    }
+}
 
-    // Check for identifiers and numbers
-    token_type = get_identifier_or_number_type(string);
-    if (token_type != TOKEN_ERROR)
-        return token_type;
+int lexer_next_token(Lexer *lexer, Token *token)
+{
+    if (!lexer || !token)
+    {
+        return 0;
+    }
 
-    // Default case: token not recognized
-    return TOKEN_ERROR;
+    return next_token(lexer, token);
 }
 
-// Check if a character is a special character i.e. punctuation
-static int is_special_character(char c)
+const char *lexer_get_lexeme(Lexer *lexer, Token *token, int *length)
 {
-    return (c == ',' || c == ';' || c == '(' ||
-            c == ')' || c == '{' || c == '}' );
+    // EOF has no source text behind it
+    if (token->type == TOKEN_EOF)
+    {
+        *length = 3;
+        return "EOF";
+    }
+
+    *length = token->length;
+    return lexer->data + (token->offset - lexer->data_offset);
 }
 
-// Check if a character is a single-character operator
-static int is_single_character_operator(char c)
+static void init_buffer_lexer(Lexer *lexer, const char *input, size_t length, ErrorList *error_list)
 {
-    return (c == '+' || c == '-' || c == '*' ||
-            c == '/' || c == '=' || c == '<' ||
-            c == '>' || c == '!');
+    memset(lexer, 0, sizeof(Lexer));
+    lexer->error_list = error_list;
+    lexer->fd = -1;
+    lexer->data = input;
+    lexer->cursor = input;
+    lexer->end = input + length;
+    lexer->input_exhausted = 1;
+    lexer->line_number = 1;
+    lexer->column_number = 1;
+    lexer->ends_with_newline = length > 0 && input[length - 1] == '\n';
 }
 
-// Check if two characters form a double-character operator
-static int is_double_character_operator(char c1, char c2)
+Lexer *create_lexer_from_buffer(const char *input, size_t length, ErrorList *error_list)
 {
-    char operator_str[3] = {c1, c2, '\0'};
-    TokenType token_type = get_operator_type(operator_str);
-    return token_type != TOKEN_ERROR;
+    Lexer *lexer = calloc(1, sizeof(Lexer));
+    if (!lexer)
+    {
+        add_new_error(error_list, 0, 0, LEXER, "Failed to initialise lexer");
+        return NULL;
+    }
+
+    init_buffer_lexer(lexer, input, input ? length : 0, error_list);
+    return lexer;
 }
 
-// Handle whitespace
-static void handle_whitespace(char **cursor, int *line_number, int *column_number)
+static Lexer *create_reader_lexer(int fd, FILE *file, size_t chunk_size, ErrorList *error_list)
 {
-    if (**cursor == '\n')
+    Lexer *lexer = calloc(1, sizeof(Lexer));
+    if (!lexer)
     {
-        (*line_number)++;
-        *column_number = 1;
+        add_new_error(error_list, 0, 0, LEXER, "Failed to initialise lexer");
+        return NULL;
     }
-    else
+
+    lexer->buffer_capacity = chunk_size ? chunk_size : DEFAULT_LEXER_CHUNK_SIZE;
+    lexer->buffer = malloc(lexer->buffer_capacity);
+    if (!lexer->buffer)
     {
-        (*column_number)++;
+        add_new_error(error_list, 0, 0, LEXER, "Failed to initialise lexer");
+        free(lexer);
+        return NULL;
     }
-    (*cursor)++;
+
+    lexer->error_list = error_list;
+    lexer->fd = fd;
+    lexer->file = file;
+    lexer->data = lexer->buffer;
+    lexer->cursor = lexer->buffer;
+    lexer->end = lexer->buffer;
+    lexer->line_number = 1;
+    lexer->column_number = 1;
+    return lexer;
 }
 
-// Handle comments
-static void handle_comment(char **cursor, int *line_number, int *column_number) 
+Lexer *create_lexer_from_fd(int fd, size_t chunk_size, ErrorList *error_list)
 {
-    while (**cursor && **cursor != '\n') {
-        (*cursor)++;
-    }
+    return create_reader_lexer(fd, NULL, chunk_size, error_list);
+}
+
+Lexer *create_lexer_from_file(FILE *file, size_t chunk_size, ErrorList *error_list)
+{
+    return create_reader_lexer(-1, file, chunk_size, error_list);
+}
 
-    if (**cursor == '\n')
+void free_lexer(Lexer *lexer)
+{
+    if (!lexer)
     {
-        (*cursor)++;
-        (*line_number)++;
-        *column_number = 1;
+        return;
     }
+
+    free(lexer->buffer);
+    free(lexer);
 }
 
-// Handle special characters
-static int handle_special_character(TokenStream *token_stream, char **cursor, int line_number, int column_number, ErrorList *error_list)
+// Lex length bytes of input into token_stream, whose lexemes then point back into input.
+// Returns 0 if the input holds no tokens or lexing had to stop before EOF.
+int lex_into_token_stream(TokenStream *token_stream, const char *input, size_t length, ErrorList *error_list)
 {
-    char special_char_str[2] = {**cursor, '\0'};
-    TokenType token_type = get_token_type(special_char_str);
-    if (token_type != TOKEN_ERROR)
+    if (!input)
+    {
+        add_new_error(error_list, 0, 0, LEXER, "Input contains no valid tokens");
+        return 0;
+    }
+
+    token_stream->source = input;
+
+    Lexer lexer;
+    Token token;
+    init_buffer_lexer(&lexer, input, length, error_list);
+    lexer.symbol_table = token_stream->symbol_table;
+
+    while (next_token(&lexer, &token))
     {
-        if (!add_new_token(token_stream, token_type, special_char_str, line_number, column_number))
+        if (!add_new_token(token_stream, token.type, token.offset, token.length, token.line, token.column, token.symbol))
         {
-            add_new_error(error_list, line_number, column_number, LEXER, "Failed to create special character token");
+            add_new_error(error_list, token.line, token.column, LEXER, "Failed to create token");
             return 0;
         }
     }
-    else
+
+    // Nothing to lex, or the lexer gave up before reaching EOF
+    return token_stream->size > 0 && token_stream->types[token_stream->size - 1] == TOKEN_EOF;
+}
+
+// One newline-aligned slice of the input lexed by lex_into_token_stream_parallel
+typedef struct
+{
+    Lexer lexer;
+    Arena *arena;         // Owns tokens and errors
+    TokenStream *tokens;  // Lines counted from the chunk's first line, symbols from the chunk's own table
+    ErrorList *errors;    // Lines counted the same way
+    TokenStream *target;  // Stream the tokens are copied into
+    int first_token;      // Index of the chunk's first token in target
+    int first_line;       // Line of the chunk's first byte in the whole input
+    uint32_t *symbols;    // Target symbol ID of each chunk symbol, NULL if identifiers are not interned
+    pthread_t thread;
+    int started;
+} LexerChunk;
+
+static int init_lexer_chunk(LexerChunk *chunk, const char *input, size_t length, size_t start, size_t end,
+                            TokenStream *target, int max_errors)
+{
+    chunk->target = target;
+    chunk->arena = create_arena(DEFAULT_ARENA_BLOCK_SIZE);
+    chunk->tokens = chunk->arena ? create_new_token_stream(chunk->arena) : NULL;
+    chunk->errors = chunk->arena ? create_new_error_list(chunk->arena) : NULL;
+    if (!chunk->tokens || !chunk->errors ||
+        !reserve_token_stream(chunk->tokens, (end - start) / 6 + DEFAULT_TOKEN_STREAM_CAPACITY))
     {
-        add_new_error(error_list, line_number, column_number, LEXER, "Invalid special character");
+        return 0;
     }
-    (*cursor)++;
+    chunk->errors->max_errors = max_errors;
+
+    init_buffer_lexer(&chunk->lexer, input, length, chunk->errors);
+    chunk->lexer.cursor = input + start;
+    chunk->lexer.end = input + end;
+    chunk->lexer.partial = 1;
+    chunk->lexer.symbol_table = target->symbol_table ? chunk->tokens->symbol_table : NULL;
     return 1;
 }
 
-// Handle single character operators
-static int handle_single_character_operator(TokenStream *token_stream, char **cursor, int line_number, int column_number, ErrorList *error_list)
+static void *lex_chunk(void *argument)
 {
-    char operator_str[2] = {**cursor, '\0'};
-    TokenType token_type = get_token_type(operator_str);
-    if (token_type != TOKEN_ERROR)
+    LexerChunk *chunk = argument;
+    Token token;
+    while (next_token(&chunk->lexer, &token))
     {
-        if (!add_new_token(token_stream, token_type, operator_str, line_number, column_number))
+        if (!add_new_token(chunk->tokens, token.type, token.offset, token.length, token.line, token.column, token.symbol))
         {
-            add_new_error(error_list, line_number, column_number, LEXER, "Failed to create operator token");
-            return 0;
+            add_new_error(chunk->errors, token.line, token.column, LEXER, "Failed to create token");
+            chunk->lexer.reached_end = 0;
+            break;
         }
     }
-    else
+    return NULL;
+}
+
+// Copy the chunk's tokens to their place in the target, moving their lines and symbols there too
+static void *copy_chunk_tokens(void *argument)
+{
+    LexerChunk *chunk = argument;
+    TokenStream *from = chunk->tokens;
+    TokenStream *to = chunk->target;
+    int first = chunk->first_token;
+    int line_delta = chunk->first_line - 1;
+
+    memcpy(to->types + first, from->types, from->size * sizeof(uint8_t));
+    memcpy(to->columns + first, from->columns, from->size * sizeof(int));
+    memcpy(to->offsets + first, from->offsets, from->size * sizeof(int));
+    memcpy(to->lengths + first, from->lengths, from->size * sizeof(int));
+    for (int i = 0; i < from->size; i++)
     {
-        add_new_error(error_list, line_number, column_number, LEXER, "Invalid operator detected");
+        to->lines[first + i] = from->lines[i] + line_delta;
+    }
+    for (int i = 0; i < from->size; i++)
+    {
+        uint32_t symbol = from->symbols[i];
+        to->symbols[first + i] = symbol == NO_SYMBOL ? NO_SYMBOL : chunk->symbols[symbol];
+    }
+    return NULL;
+}
+
+// Run work on every chunk, the first on the calling thread, and wait for all of
+// them. A chunk whose thread cannot be started is worked on here instead.
+static void run_lexer_chunks(LexerChunk *chunks, int chunk_count, void *(*work)(void *))
+{
+    for (int i = 1; i < chunk_count; i++)
+    {
+        chunks[i].started = pthread_create(&chunks[i].thread, NULL, work, &chunks[i]) == 0;
+    }
+
+    work(&chunks[0]);
+    for (int i = 1; i < chunk_count; i++)
+    {
+        if (chunks[i].started)
+        {
+            pthread_join(chunks[i].thread, NULL);
+        }
+        else
+        {
+            work(&chunks[i]);
+        }
     }
-    (*cursor)++;
-    return 1;
 }
 
-// Handle double character operators
-static int handle_double_character_operator(TokenStream *token_stream, char **cursor, int line_number, int column_number, ErrorList *error_list)
+// Join the chunks' errors, symbols and tokens in source order. Returns 0 where the
+// sequential lexer would have stopped: at the error limit, or on running out of memory.
+static int join_lexer_chunks(TokenStream *token_stream, LexerChunk *chunks, int chunk_count, ErrorList *error_list)
 {
-    if (!(*cursor) || !(*(*cursor + 1)))
+    // A prefix sum over the chunks' line counts places each chunk in the whole input
+    int total = token_stream->size, line = 1, has_content = 0;
+    for (int i = 0; i < chunk_count; i++)
     {
-        add_new_error(error_list, line_number, column_number, LEXER, "Unexpected end of input for double-character operator");
+        LexerChunk *chunk = &chunks[i];
+        for (int e = 0; e < chunk->errors->size; e++)
+        {
+            Error *error = &chunk->errors->errors[e];
+            copy_error(error_list, chunk->errors, e, error->line + line - 1, error->column);
+
+            // The sequential lexer stops at the error that reaches the limit
+            if (error_limit_reached(error_list))
+            {
+                return 0;
+            }
+        }
+        if (!chunk->lexer.reached_end)
+        {
+            return 0;
+        }
+
+        chunk->first_token = total;
+        chunk->first_line = line;
+        total += chunk->tokens->size;
+        line += chunk->lexer.line_number - 1;
+        has_content |= chunk->lexer.has_content;
+    }
+
+    if (!has_content)
+    {
+        add_new_error(error_list, 0, 0, LEXER, "Input contains no valid tokens");
         return 0;
     }
 
-    char operator_str[3] = {**cursor, *(*cursor+1), '\0'};
-    TokenType token_type = get_token_type(operator_str);
-    if (token_type != TOKEN_ERROR)
+    // Chunk symbols are numbered in order of first use within the chunk, so interning
+    // them chunk by chunk numbers them in order of first use in the whole input
+    for (int i = 0; i < chunk_count && token_stream->symbol_table; i++)
     {
-        if (!add_new_token(token_stream, token_type, operator_str, line_number, column_number))
+        InternTable *table = chunks[i].tokens->symbol_table;
+        chunks[i].symbols = arena_alloc(chunks[i].arena, (table->symbol_count + 1) * sizeof(uint32_t));
+        if (!chunks[i].symbols)
         {
-            add_new_error(error_list, line_number, column_number, LEXER, "Failed to create operator token");
+            add_new_error(error_list, 0, 0, LEXER, "Failed to intern identifier");
             return 0;
         }
+        for (uint32_t symbol = 0; symbol < table->symbol_count; symbol++)
+        {
+            chunks[i].symbols[symbol] = intern_symbol(token_stream->symbol_table, table->names[symbol],
+                                                      table->name_lengths[symbol]);
+            if (chunks[i].symbols[symbol] == NO_SYMBOL)
+            {
+                add_new_error(error_list, 0, 0, LEXER, "Failed to intern identifier");
+                return 0;
+            }
+        }
     }
-    else
+
+    if (!reserve_token_stream(token_stream, total + 1))
     {
-        add_new_error(error_list, line_number, column_number, LEXER, "Invalid operator detected");
+        add_new_error(error_list, 0, 0, LEXER, "Failed to create token");
+        return 0;
+    }
+    run_lexer_chunks(chunks, chunk_count, copy_chunk_tokens);
+    token_stream->size = total;
+
+    // The last chunk ends where the input does, its lexer places EOF
+    LexerChunk *last = &chunks[chunk_count - 1];
+    Token token;
+    last->lexer.has_content = 1;
+    finish_lexing(&last->lexer, &token);
+    if (!add_new_token(token_stream, token.type, token.offset, token.length, token.line + last->first_line - 1,
+                       token.column, token.symbol))
+    {
+        add_new_error(error_list, token.line, token.column, LEXER, "Failed to create token");
+        return 0;
     }
-    (*cursor)+=2;
     return 1;
 }
 
-// Handle keywords, identifiers, and numbers
-static int handle_identifier_or_number(TokenStream *token_stream, char **cursor, int *line_number, int *column_number, ErrorList *error_list)
+int lex_into_token_stream_parallel(TokenStream *token_stream, const char *input, size_t length,
+                                   ErrorList *error_list, int thread_count)
 {
-    char token_buffer[256];
-    int token_length = 0;
-    int exceeded = 0; // Flag to track if the token length was exceeded
-    int start_column = *column_number; // Copy of the starting column of the token in case token length exceeds
+    // Each chunk may report as many errors as are left before the limit
+    int max_errors = 0;
+    if (error_list && error_list->max_errors > 0)
+    {
+        max_errors = error_list->max_errors - error_list->size;
+    }
 
-    while (**cursor && (isalnum(**cursor) || **cursor == '_'))
+    if ((size_t)thread_count > length / MIN_PARALLEL_LEXER_CHUNK_SIZE)
     {
-        if (token_length < 255)
-        {
-            token_buffer[token_length++] = **cursor;
-        }
-        else
+        thread_count = length / MIN_PARALLEL_LEXER_CHUNK_SIZE;
+    }
+    if (!input || thread_count < 2 || max_errors < 0 || error_limit_reached(error_list))
+    {
+        return lex_into_token_stream(token_stream, input, length, error_list);
+    }
+
+    LexerChunk *chunks = calloc(thread_count, sizeof(LexerChunk));
+    if (!chunks)
+    {
+        return lex_into_token_stream(token_stream, input, length, error_list);
+    }
+
+    // Cut after the first newline past an even share of what is left, no token spans one
+    int chunk_count = 0, ready = 1;
+    size_t start = 0;
+    while (start < length && chunk_count < thread_count)
+    {
+        size_t end = length;
+        if (chunk_count < thread_count - 1)
         {
-            exceeded = 1;
+            size_t cut = start + (length - start) / (thread_count - chunk_count);
+            const char *newline = memchr(input + cut, '\n', length - cut);
+            end = newline ? (size_t)(newline - input) + 1 : length;
         }
+        ready &= init_lexer_chunk(&chunks[chunk_count++], input, length, start, end, token_stream, max_errors);
+        start = end;
+    }
+
+    int lexed = 0;
+    if (ready)
+    {
+        token_stream->source = input;
+        run_lexer_chunks(chunks, chunk_count, lex_chunk);
+        lexed = join_lexer_chunks(token_stream, chunks, chunk_count, error_list);
+    }
 
-        (*cursor)++;
-        (*column_number)++;
+    for (int i = 0; i < chunk_count; i++)
+    {
+        free_arena(chunks[i].arena);
     }
+    free(chunks);
 
-    token_buffer[token_length] = '\0';
+    // Without memory for the chunks the input is lexed on this thread alone
+    return ready ? lexed : lex_into_token_stream(token_stream, input, length, error_list);
+}
+
+int lex_into_token_queue(TokenQueue *queue, const char *input, size_t length, ErrorList *error_list)
+{
+    if (!input)
+    {
+        add_new_error(error_list, 0, 0, LEXER, "Input contains no valid tokens");
+        close_token_queue(queue, TOKEN_QUEUE_FAILED);
+        return 0;
+    }
 
-    if (exceeded) {
-        add_new_error(error_list, *line_number, start_column, LEXER, "Token exceeds maximum length");
+    Lexer lexer;
+    Token token;
+    init_buffer_lexer(&lexer, input, length, error_list);
 
-        // Skip remaining characters of the oversized token
-        while (**cursor && (isalnum(**cursor) || **cursor == '_'))
+    TokenBatch *batch = reserve_token_batch(queue);
+    uint32_t count = 0;
+    int reached_eof = 0;
+    while (batch && next_token(&lexer, &token))
+    {
+        reached_eof = token.type == TOKEN_EOF;
+        batch->tokens[count++] = token;
+        if (count == TOKEN_BATCH_SIZE)
         {
-            (*cursor)++;
-            (*column_number)++;
+            batch->count = count;
+            publish_token_batch(queue);
+            batch = reserve_token_batch(queue);
+            count = 0;
         }
-
-        return 1; // Continue processing other tokens
     }
+    if (batch && count > 0)
+    {
+        batch->count = count;
+        publish_token_batch(queue);
+    }
+
+    int finished = batch && reached_eof;
+    close_token_queue(queue, finished ? TOKEN_QUEUE_FINISHED : TOKEN_QUEUE_FAILED);
+    return finished;
+}
 
-    TokenType token_type = get_token_type(token_buffer);
-    if (token_type != TOKEN_ERROR)
+// Index of the first of the size tokens that starts at or after offset
+static int find_token_at_offset(TokenStream *token_stream, int size, long offset)
+{
+    int low = 0, high = size;
+    while (low < high)
     {
-        if (!add_new_token(token_stream, token_type, token_buffer, *line_number, start_column))
+        int middle = low + (high - low) / 2;
+        if (token_stream->offsets[middle] < offset)
         {
-            add_new_error(error_list, *line_number, start_column, LEXER, "Failed to create identifier/number token");
-            return 0;
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
         }
     }
-    else
+    return low;
+}
+
+static int count_newlines(const char *start, const char *end)
+{
+    int count = 0;
+    for (const char *c = start; c < end; c++)
     {
-        add_new_error(error_list, *line_number, start_column, LEXER, "Invalid token detected");
+        count += *c == '\n';
     }
-    return 1;
+    return count;
 }
 
-// Get the token stram from the input file
-TokenStream *get_token_stream_from_input_file(char *input, ErrorList *error_list)
+// Throw the stream away and lex the whole input again
+static int relex_whole_stream(TokenStream *token_stream, const char *input, size_t length,
+                              ErrorList *error_list, TokenEdit *token_edit)
 {
-    if (!input || strspn(input, " \t\n") == strlen(input))
+    token_edit->first = 0;
+    token_edit->old_end = token_stream->size;
+    token_edit->line_delta = 0;
+    token_edit->column_delta = 0;
+    token_edit->resync_line = -1;
+
+    token_stream->size = 0;
+    int lexed = lex_into_token_stream(token_stream, input, length, error_list);
+    if (!lexed)
     {
-        add_new_error(error_list, 0, 0, LEXER, "Input contains no valid tokens");
-        return NULL;
+        token_stream->size = 0;
     }
 
-    TokenStream *token_stream = create_new_token_stream();
-    if (!token_stream)
+    token_edit->new_end = token_stream->size;
+    return lexed;
+}
+
+int relex_token_stream(TokenStream *token_stream, const char *input, size_t length, SourceEdit edit,
+                       ErrorList *previous_errors, ErrorList *error_list, TokenEdit *token_edit)
+{
+    int old_size = token_stream->size;
+    if (!input || old_size == 0 || token_stream->types[old_size - 1] != TOKEN_EOF)
     {
-        add_new_error(error_list, 0, 0, LEXER, "Failed to initialise token stream");
-        return NULL;
+        return relex_whole_stream(token_stream, input, length, error_list, token_edit);
     }
 
-    int line_number = 1, column_number = 1;
-    char *cursor = input;
+    // The EOF token sits at the end of the previous source
+    size_t old_length = token_stream->offsets[old_size - 1];
+    if (edit.start > old_length || edit.removed_length > old_length - edit.start ||
+        old_length - edit.removed_length + edit.inserted_length != length)
+    {
+        add_new_error(error_list, 0, 0, LEXER, "Edit does not match the source");
+        token_stream->size = 0;
+        return 0;
+    }
 
-    while (*cursor)
+    // Lexing restarts at the start of the edited line, where no token can be open.
+    // Bytes before the edit are unchanged, so the previous tokens there still hold.
+    size_t restart = edit.start;
+    while (restart > 0 && input[restart - 1] != '\n')
     {
-        if (*cursor == '#') {
-            handle_comment(&cursor, &line_number, &column_number);
-            continue;
-        }
+        restart--;
+    }
+
+    int first = find_token_at_offset(token_stream, old_size, restart);
+    int restart_line = 1;
+    if (first == 0)
+    {
+        // Only blank lines and comments come before, lex from the top so a blank source is still caught
+        restart = 0;
+    }
+    else
+    {
+        int previous_offset = token_stream->offsets[first - 1];
+        restart_line = token_stream->lines[first - 1] + count_newlines(input + previous_offset, input + restart);
+    }
+
+    // Errors on earlier lines stand as they are
+    int error_count = previous_errors ? previous_errors->size : 0;
+    int kept_errors = 0;
+    while (kept_errors < error_count && previous_errors->errors[kept_errors].line < restart_line)
+    {
+        Error *error = &previous_errors->errors[kept_errors];
+        copy_error(error_list, previous_errors, kept_errors++, error->line, error->column);
+    }
+
+    Lexer lexer;
+    Token token;
+    init_buffer_lexer(&lexer, input, length, error_list);
+    lexer.cursor = input + restart;
+    lexer.line_number = restart_line;
+    lexer.has_content = first > 0;
+    lexer.symbol_table = token_stream->symbol_table;
+
+    // Re-lex until a token past the edit starts where a previous token started. Both
+    // lexers are then at a token boundary in the same bytes, so every later token is
+    // the previous one moved.
+    long offset_delta = (long)edit.inserted_length - (long)edit.removed_length;
+    size_t edit_end = edit.start + edit.inserted_length;
+    int resync = -1, candidate = first;
+    Token *tokens = NULL;
+    int token_count = 0, token_capacity = 0, reached_eof = 0;
 
-        if (isspace(*cursor))
+    while (next_token(&lexer, &token))
+    {
+        if (token.type == TOKEN_EOF)
         {
-            handle_whitespace(&cursor, &line_number, &column_number);
-            continue;
+            reached_eof = 1;
         }
-
-        if (is_special_character(*cursor))
+        else if ((size_t)token.offset >= edit_end)
         {
-            if (!handle_special_character(token_stream, &cursor, line_number, column_number, error_list))
+            long old_offset = token.offset - offset_delta;
+            while (candidate < old_size - 1 && token_stream->offsets[candidate] < old_offset)
             {
-                free_token_stream(token_stream);
-                return NULL;
+                candidate++;
             }
-            column_number++;
-            continue;
-        }
-
-        if (*(cursor + 1) && is_double_character_operator(*cursor, *(cursor + 1)))
-        {
-            if (!handle_double_character_operator(token_stream, &cursor, line_number, column_number, error_list))
+            if (candidate < old_size - 1 && token_stream->offsets[candidate] == old_offset)
             {
-                free_token_stream(token_stream);
-                return NULL;
+                resync = candidate;
+                break;
             }
-            column_number += 2;
-            continue;
         }
 
-        if (is_single_character_operator(*cursor))
+        if (token_count == token_capacity)
         {
-            if (!handle_single_character_operator(token_stream, &cursor, line_number, column_number, error_list))
+            int new_capacity = token_capacity ? token_capacity * 2 : 64;
+            Token *new_tokens = realloc(tokens, new_capacity * sizeof(Token));
+            if (!new_tokens)
             {
-                free_token_stream(token_stream);
-                return NULL;
+                add_new_error(error_list, token.line, token.column, LEXER, "Failed to create token");
+                free(tokens);
+                token_stream->size = 0;
+                return 0;
             }
-            column_number++;
-            continue;
+            tokens = new_tokens;
+            token_capacity = new_capacity;
         }
+        tokens[token_count++] = token;
+    }
+
+    if (resync < 0 && !reached_eof)
+    {
+        free(tokens);
+        token_stream->size = 0;
+        return 0;
+    }
+
+    token_edit->first = first;
+    token_edit->old_end = resync >= 0 ? resync : old_size;
+    token_edit->new_end = first + token_count;
+    token_edit->line_delta = resync >= 0 ? token.line - token_stream->lines[resync] : 0;
+    token_edit->column_delta = resync >= 0 ? token.column - token_stream->columns[resync] : 0;
+    token_edit->resync_line = resync >= 0 ? token_stream->lines[resync] : -1;
 
-        if (isalnum(*cursor) || *cursor == '_')
+    // Errors from the first lined-up token on are the previous ones, moved
+    if (resync >= 0)
+    {
+        int resync_line = token_stream->lines[resync], resync_column = token_stream->columns[resync];
+        for (int i = kept_errors; i < error_count; i++)
         {
-            if (!handle_identifier_or_number(token_stream, &cursor, &line_number, &column_number, error_list))
+            Error *error = &previous_errors->errors[i];
+            if (error->line > resync_line || (error->line == resync_line && error->column >= resync_column))
             {
-                free_token_stream(token_stream);
-                return NULL;
+                int line = error->line, column = error->column;
+                shift_position_past_edit(token_edit, &line, &column);
+                copy_error(error_list, previous_errors, i, line, column);
             }
-            continue;
         }
+    }
 
-        add_new_error(error_list, line_number, column_number, LEXER, "Unrecognized or invalid token");
-        cursor++;
-        column_number++;
+    int replaced = replace_token_range(token_stream, first, token_edit->old_end, tokens, token_count,
+                                       (int)offset_delta, token_edit);
+    free(tokens);
+    if (!replaced)
+    {
+        add_new_error(error_list, 0, 0, LEXER, "Failed to create token");
+        token_stream->size = 0;
+        return 0;
     }
 
-    // If the last character processed was a newline i.e. the input ended with newline, increment the line number
-    if (*(cursor - 1) == '\n') {
-        line_number++;
-        column_number = 1;
+    token_stream->source = input;
+    return 1;
+}
+
+// Lex length bytes of input into a new heap-allocated token stream
+static TokenStream *lex_buffer(const char *input, size_t length, ErrorList *error_list)
+{
+    TokenStream *token_stream = create_new_token_stream(NULL);
+    if (!token_stream)
+    {
+        add_new_error(error_list, 0, 0, LEXER, "Failed to initialise token stream");
+        return NULL;
     }
 
-    if (!add_new_token(token_stream, TOKEN_EOF, "EOF", line_number, column_number))
+    if (!lex_into_token_stream(token_stream, input, length, error_list))
     {
-        add_new_error(error_list, line_number, column_number, LEXER, "Failed to create EOF token");
         free_token_stream(token_stream);
         return NULL;
     }
 
     return token_stream;
 }
+
+// Get the token stram from the input file
+TokenStream *get_token_stream_from_input_file(char *input, ErrorList *error_list)
+{
+    return lex_buffer(input, input ? strlen(input) : 0, error_list);
+}
+
+// Get the token stream from the file at path, lexing directly out of a read-only mapping of it
+TokenStream *get_token_stream_from_path(const char *path, ErrorList *error_list)
+{
+    SourceBuffer *source = open_source_file(path, error_list);
+    if (!source)
+    {
+        return NULL;
+    }
+
+    TokenStream *token_stream = lex_buffer(source->data, source->length, error_list);
+    if (!token_stream)
+    {
+        close_source_file(source);
+        return NULL;
+    }
+
+    // The token spans point into the mapping, so the stream keeps it alive
+    token_stream->mapped_source = source;
+    return token_stream;
+}
@@ -0,0 +1,263 @@
+#include "lexer_simd.h"
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define LEXER_SIMD_X86 1
+#endif
+
+typedef struct
+{
+    const char *name;
+    size_t (*scan_spaces)(const char *cursor, const char *end);
+    size_t (*scan_word)(const char *cursor, const char *end);
+    const char *(*find_newline)(const char *cursor, const char *end);
+} ScanKernels;
+
+static int is_word_character(unsigned char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+}
+
+static size_t scan_spaces_scalar(const char *cursor, const char *end)
+{
+    const char *position = cursor;
+    while (position < end && (*position == ' ' || *position == '\t'))
+    {
+        position++;
+    }
+    return position - cursor;
+}
+
+static size_t scan_word_scalar(const char *cursor, const char *end)
+{
+    const char *position = cursor;
+    while (position < end && is_word_character((unsigned char)*position))
+    {
+        position++;
+    }
+    return position - cursor;
+}
+
+static const char *find_newline_scalar(const char *cursor, const char *end)
+{
+    while (cursor < end && *cursor != '\n')
+    {
+        cursor++;
+    }
+    return cursor;
+}
+
+static const ScanKernels scalar_kernels = {"scalar", scan_spaces_scalar, scan_word_scalar, find_newline_scalar};
+
+#ifdef LEXER_SIMD_X86
+
+// The block kernels below build a bitmask with one bit per byte that does NOT
+// belong to the run, so the run ends at the lowest set bit
+
+static inline __m128i word_mask_sse2(__m128i block)
+{
+    // Folding case with | 0x20 maps A-Z onto a-z; the signed compares reject bytes >= 0x80
+    __m128i lower = _mm_or_si128(block, _mm_set1_epi8(0x20));
+    __m128i letter = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                   _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8('0' - 1)),
+                                  _mm_cmplt_epi8(block, _mm_set1_epi8('9' + 1)));
+    __m128i underscore = _mm_cmpeq_epi8(block, _mm_set1_epi8('_'));
+    return _mm_or_si128(_mm_or_si128(letter, digit), underscore);
+}
+
+static size_t scan_spaces_sse2(const char *cursor, const char *end)
+{
+    const char *position = cursor;
+    while (end - position >= 16)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *)position);
+        __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8(' ')),
+                                     _mm_cmpeq_epi8(block, _mm_set1_epi8('\t')));
+        unsigned stop = ~(unsigned)_mm_movemask_epi8(blank) & 0xFFFF;
+        if (stop)
+        {
+            return position - cursor + __builtin_ctz(stop);
+        }
+        position += 16;
+    }
+    return position - cursor + scan_spaces_scalar(position, end);
+}
+
+static size_t scan_word_sse2(const char *cursor, const char *end)
+{
+    const char *position = cursor;
+    while (end - position >= 16)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *)position);
+        unsigned stop = ~(unsigned)_mm_movemask_epi8(word_mask_sse2(block)) & 0xFFFF;
+        if (stop)
+        {
+            return position - cursor + __builtin_ctz(stop);
+        }
+        position += 16;
+    }
+    return position - cursor + scan_word_scalar(position, end);
+}
+
+static const char *find_newline_sse2(const char *cursor, const char *end)
+{
+    while (end - cursor >= 16)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *)cursor);
+        unsigned found = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8('\n')));
+        if (found)
+        {
+            return cursor + __builtin_ctz(found);
+        }
+        cursor += 16;
+    }
+    return find_newline_scalar(cursor, end);
+}
+
+static const ScanKernels sse2_kernels = {"sse2", scan_spaces_sse2, scan_word_sse2, find_newline_sse2};
+
+// Most indentation runs and identifiers end within 16 bytes, so the AVX2 kernels
+// probe one 16-byte block before switching to 32-byte blocks for long runs
+
+__attribute__((target("avx2")))
+static inline __m256i word_mask_avx2(__m256i block)
+{
+    __m256i lower = _mm256_or_si256(block, _mm256_set1_epi8(0x20));
+    __m256i letter = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                                      _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+    __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(block, _mm256_set1_epi8('0' - 1)),
+                                     _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), block));
+    __m256i underscore = _mm256_cmpeq_epi8(block, _mm256_set1_epi8('_'));
+    return _mm256_or_si256(_mm256_or_si256(letter, digit), underscore);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_spaces_avx2(const char *cursor, const char *end)
+{
+    const char *position = cursor;
+    if (end - position >= 16)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *)position);
+        __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8(' ')),
+                                     _mm_cmpeq_epi8(block, _mm_set1_epi8('\t')));
+        unsigned stop = ~(unsigned)_mm_movemask_epi8(blank) & 0xFFFF;
+        if (stop)
+        {
+            return __builtin_ctz(stop);
+        }
+        position += 16;
+    }
+    while (end - position >= 32)
+    {
+        __m256i block = _mm256_loadu_si256((const __m256i *)position);
+        __m256i blank = _mm256_or_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(' ')),
+                                        _mm256_cmpeq_epi8(block, _mm256_set1_epi8('\t')));
+        unsigned stop = ~(unsigned)_mm256_movemask_epi8(blank);
+        if (stop)
+        {
+            return position - cursor + __builtin_ctz(stop);
+        }
+        position += 32;
+    }
+    return position - cursor + scan_spaces_sse2(position, end);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_word_avx2(const char *cursor, const char *end)
+{
+    const char *position = cursor;
+    if (end - position >= 16)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *)position);
+        unsigned stop = ~(unsigned)_mm_movemask_epi8(word_mask_sse2(block)) & 0xFFFF;
+        if (stop)
+        {
+            return __builtin_ctz(stop);
+        }
+        position += 16;
+    }
+    while (end - position >= 32)
+    {
+        __m256i block = _mm256_loadu_si256((const __m256i *)position);
+        unsigned stop = ~(unsigned)_mm256_movemask_epi8(word_mask_avx2(block));
+        if (stop)
+        {
+            return position - cursor + __builtin_ctz(stop);
+        }
+        position += 32;
+    }
+    return position - cursor + scan_word_sse2(position, end);
+}
+
+__attribute__((target("avx2")))
+static const char *find_newline_avx2(const char *cursor, const char *end)
+{
+    while (end - cursor >= 32)
+    {
+        __m256i block = _mm256_loadu_si256((const __m256i *)cursor);
+        unsigned found = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, _mm256_set1_epi8('\n')));
+        if (found)
+        {
+            return cursor + __builtin_ctz(found);
+        }
+        cursor += 32;
+    }
+    return find_newline_sse2(cursor, end);
+}
+
+static const ScanKernels avx2_kernels = {"avx2", scan_spaces_avx2, scan_word_avx2, find_newline_avx2};
+
+#endif
+
+static const ScanKernels *kernels = &scalar_kernels;
+
+// Pick the kernels before main runs so every thread sees the final choice
+__attribute__((constructor))
+static void select_scan_kernels()
+{
+    const char *forced = getenv("DSL_LEXER_SIMD");
+
+#ifdef LEXER_SIMD_X86
+    __builtin_cpu_init();
+    int has_avx2 = __builtin_cpu_supports("avx2");
+
+    if (forced && strcmp(forced, "scalar") == 0)
+    {
+        kernels = &scalar_kernels;
+    }
+    else if (forced && strcmp(forced, "sse2") == 0)
+    {
+        kernels = &sse2_kernels;
+    }
+    else
+    {
+        kernels = has_avx2 ? &avx2_kernels : &sse2_kernels;
+    }
+#else
+    (void)forced;
+    kernels = &scalar_kernels;
+#endif
+}
+
+size_t scan_spaces(const char *cursor, const char *end)
+{
+    return kernels->scan_spaces(cursor, end);
+}
+
+size_t scan_word(const char *cursor, const char *end)
+{
+    return kernels->scan_word(cursor, end);
+}
+
+const char *find_newline(const char *cursor, const char *end)
+{
+    return kernels->find_newline(cursor, end);
+}
+
+const char *lexer_simd_implementation()
+{
+    return kernels->name;
+}
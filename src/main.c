@@ -0,0 +1,1005 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "compilation.h"
+#include "thread_pool.h"
+#include "cache.h"
+#include "serialize.h"
+#include "bytecode.h"
+#include "vm.h"
+#include "optimize.h"
+#include "c_backend.h"
+#include "ir.h"
+#include "regalloc.h"
+#include "wcet.h"
+#include "time_report.h"
+
+// Long enough for any test, short enough that a stuck polling loop still ends
+#define DEFAULT_MAX_CYCLES 1000000000ULL
+
+// What a cached compilation replays besides its diagnostics
+enum
+{
+    JOB_OUTPUT_TEXT,    // What the job printed, the C back end's report
+    JOB_OUTPUT_C,       // <file>.c
+    JOB_OUTPUT_BINARY,  // <file>.dslb
+    JOB_OUTPUT_COUNT
+};
+
+struct Driver;
+
+// One input file and everything compiling it produced
+typedef struct
+{
+    struct Driver *driver;
+    const char *path;
+    CompilationContext *context;
+    FILE *output_file;        // Collects what the job prints besides diagnostics, NULL if nothing will be
+    char *output;             // What output_file collected once it is closed
+    size_t output_length;
+    TimeReport timing;        // What each phase cost, when the driver asked for it
+    int uncacheable;          // An output failed to write, which says nothing about the source
+    int succeeded;
+    int done;
+} CompileJob;
+
+// Jobs finish in any order, done flags let the main thread report them in input order
+typedef struct Driver
+{
+    CompileJob *jobs;
+    int job_count;
+    CompilationCache *cache;  // NULL when caching is off
+    const char *options;      // Options that change what a compilation produces, part of each cache key
+    int optimize;             // Run the AST optimizer before the back end
+    int optimization_report;  // Print what the optimizer removed
+    int emit_binary;          // Write each file's tokens and AST next to it as <file>.dslb
+    int emit_c;               // Write each file as C next to it as <file>.c
+    TargetConfig *target;     // Pins and ports the C is written for, registers the IR is allocated to, cycle costs
+    int wcet;                 // Print each function's worst-case cycles
+    int dump_ir;              // Print each file's IR with the register of every value
+    int dump_bytecode;        // Print each file's bytecode
+    int run;                  // Run each file's main in the VM
+    PinBank *trace;           // Pin inputs every run starts from
+    uint64_t max_cycles;      // Per run, 0 for no limit
+    int time_report;          // Print what each phase of each file cost
+    int time_phases;          // Measure each phase, for the printed report or the JSON one
+    int max_errors;           // Stop a file's compilation after this many errors, 0 for no limit
+    int pipeline;             // Lex each file on a thread of its own while it is parsed
+    int lex_threads;          // Threads to split lexing a large file across
+    int parse_threads;        // Threads to split parsing a large file across
+    pthread_mutex_t lock;
+    pthread_cond_t job_done;
+} Driver;
+
+static void print_usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [-j N] [--cache-dir DIR] [--cache-size MB] [--cache-stats] [-O [--opt-report]]\n"
+            "       [--emit-binary] [--emit-c [--target FILE]] [--dump-ir] [--wcet]\n"
+            "       [--dump-bytecode] [--run [--trace FILE] [--max-cycles N]]\n"
+            "       [--time-report] [--time-report-json FILE] [--max-errors N] [--error-format text|json]\n"
+            "       [--pipeline] [--lex-threads N] [--parse-threads N] file...\n", program);
+    fprintf(stderr, "  -j N             compile up to N files at once (default: number of processors)\n");
+    fprintf(stderr, "  --cache-dir DIR  reuse results of earlier compilations of the same source (default: $DSL_CACHE_DIR)\n");
+    fprintf(stderr, "  --cache-size MB  evict least recently used results beyond this size (default: %d)\n",
+            DEFAULT_CACHE_MAX_BYTES / (1024 * 1024));
+    fprintf(stderr, "  --cache-stats    print cache hits and misses to stderr\n");
+    fprintf(stderr, "  -O               fold constants and remove dead code before the back end\n");
+    fprintf(stderr, "  --opt-report     print how many AST nodes the optimizer removed\n");
+    fprintf(stderr, "  --emit-binary    write each file's tokens and AST to <file>.dslb\n");
+    fprintf(stderr, "  --emit-c         write each file as C to <file>.c, batching pin writes per port\n");
+    fprintf(stderr, "  --target FILE    use the ports, registers and cycle costs of the target FILE describes (default: 8 pins per port, %d registers)\n",
+            TARGET_DEFAULT_REGISTERS);
+    fprintf(stderr, "  --dump-ir        print each file's SSA IR with the register or spill slot of every value\n");
+    fprintf(stderr, "  --wcet           print each function's worst-case cycles on the target, or why it has none\n");
+    fprintf(stderr, "  --dump-bytecode  print each file's bytecode\n");
+    fprintf(stderr, "  --run            run each file's main, printing the pin changes it makes and its result\n");
+    fprintf(stderr, "  --trace FILE     drive the input pins from FILE, lines of '<cycle> <pin> HIGH|LOW'\n");
+    fprintf(stderr, "  --max-cycles N   stop a run after N instructions (default: %llu)\n",
+            (unsigned long long)DEFAULT_MAX_CYCLES);
+    fprintf(stderr, "  --time-report    print each phase's wall time, throughput, allocations and peak RSS\n");
+    fprintf(stderr, "  --time-report-json FILE\n"
+            "                   write the same figures for every file to FILE as JSON\n");
+    fprintf(stderr, "  --max-errors N   stop compiling a file once it has N errors (default: no limit)\n");
+    fprintf(stderr, "  --error-format text|json\n"
+            "                   print diagnostics as text, or as one JSON object per file (default: text)\n");
+    fprintf(stderr, "  --pipeline       lex each file on a second thread while it is parsed\n");
+    fprintf(stderr, "  --lex-threads N  split lexing each large file across N threads (default: 1)\n");
+    fprintf(stderr, "  --parse-threads N\n"
+            "                   split parsing each large file across N threads, a range of functions each (default: 1)\n");
+}
+
+// Lex, parse and check a loaded source, and optimize it if asked. It compiles only if
+// nothing was reported.
+static int compile_source(CompileJob *job)
+{
+    CompilationContext *context = job->context;
+    int parsed;
+    if (job->driver->pipeline)
+    {
+        begin_phase(&job->timing, "lex+parse");
+        parsed = run_pipelined_front_end(context);
+        end_phase(&job->timing, context->token_stream ? context->token_stream->size : 0, "tokens");
+    }
+    else
+    {
+        begin_phase(&job->timing, "lex");
+        int lexed = run_lexer(context);
+        end_phase(&job->timing, lexed ? context->token_stream->size : 0, "tokens");
+        if (!lexed)
+        {
+            return 0;
+        }
+
+        begin_phase(&job->timing, "parse");
+        parsed = run_parser(context);
+        end_phase(&job->timing, parsed ? context->ast->node_count : 0, "nodes");
+    }
+    if (!parsed || context->error_list->size > 0)
+    {
+        return 0;
+    }
+
+    begin_phase(&job->timing, "check");
+    int checked = run_semantic_analysis(context);
+    end_phase(&job->timing, context->ast->node_count, "nodes");
+    if (!checked)
+    {
+        return 0;
+    }
+
+    if (job->driver->optimize)
+    {
+        OptimizationReport report;
+        uint32_t node_count = context->ast->node_count;
+        begin_phase(&job->timing, "optimize");
+        int optimized = run_optimizer(context, &report);
+        end_phase(&job->timing, node_count, "nodes");
+        if (!optimized)
+        {
+            return 0;
+        }
+        if (job->driver->optimization_report)
+        {
+            print_optimization_report(&report, job->output_file);
+        }
+    }
+    return 1;
+}
+
+// <path><suffix>, reporting to the job's errors if it cannot be allocated
+static char *get_output_path(CompileJob *job, const char *suffix)
+{
+    size_t length = strlen(job->path) + strlen(suffix) + 1;
+    char *output_path = malloc(length);
+    if (!output_path)
+    {
+        add_new_error(job->context->error_list, 0, 0, CODEGEN, "Failed to allocate output path");
+        return NULL;
+    }
+
+    snprintf(output_path, length, "%s%s", job->path, suffix);
+    return output_path;
+}
+
+// Write the front end's output for tools to map, a file that fails to write fails the job
+static int emit_binary_file(CompileJob *job)
+{
+    CompilationContext *context = job->context;
+    char *binary_path = get_output_path(job, ".dslb");
+    if (!binary_path)
+    {
+        job->uncacheable = 1;
+        return 0;
+    }
+
+    int written = write_serialized_file(binary_path, context->token_stream, context->ast, context->error_list);
+    job->uncacheable |= !written;
+    free(binary_path);
+    return written;
+}
+
+// Write the AST as C for the driver's target and print what batching and caching
+// the pin accesses saved. A file that fails to compile or write fails the job.
+static int emit_c_file(CompileJob *job)
+{
+    CompilationContext *context = job->context;
+    char *c_path = get_output_path(job, ".c");
+    if (!c_path)
+    {
+        job->uncacheable = 1;
+        return 0;
+    }
+
+    FILE *file = fopen(c_path, "w");
+    CBackendReport report;
+    int written = file && generate_c_program(context->ast, job->driver->target, file, &report, context->error_list);
+    if (file && fclose(file) != 0)
+    {
+        written = 0;
+    }
+    if (!file || (!written && context->error_list->size == 0))
+    {
+        add_new_error(context->error_list, 0, 0, CODEGEN, "Failed to write C output");
+        job->uncacheable = 1;
+    }
+    if (!written && file)
+    {
+        remove(c_path);
+    }
+    if (written)
+    {
+        print_c_backend_report(&report, job->output_file);
+    }
+
+    free(c_path);
+    return written;
+}
+
+// Lower the AST to SSA, give its values the target's registers and print both,
+// checking each against what the later stages rely on
+static int dump_ir_file(CompileJob *job)
+{
+    CompilationContext *context = job->context;
+    IRProgram *program = lower_to_ir(context->ast, context->error_list);
+    if (!program || !verify_ir_program(program, context->error_list))
+    {
+        free_ir_program(program);
+        return 0;
+    }
+
+    RegisterAllocation *allocation = allocate_registers(program, job->driver->target->register_count);
+    int allocated = allocation && verify_register_allocation(program, allocation, context->error_list);
+    if (!allocation)
+    {
+        add_new_error(context->error_list, 0, 0, CODEGEN, "Failed to allocate registers");
+    }
+    if (allocated)
+    {
+        print_ir_program(program, allocation, job->output_file);
+    }
+
+    free_register_allocation(allocation);
+    free_ir_program(program);
+    return allocated;
+}
+
+// Print the worst-case cycles of every function for the driver's target
+static int print_timing(CompileJob *job)
+{
+    CompilationContext *context = job->context;
+    TimingReport *report = estimate_timing(context->ast, job->driver->target, context->error_list);
+    if (!report)
+    {
+        return 0;
+    }
+
+    print_timing_report(report, job->output_file);
+    free_timing_report(report);
+    return 1;
+}
+
+// Lower the AST to bytecode, then list it and run it as asked, writing both to the
+// job's output. A program that fails to compile or stops with an error fails the job.
+static int run_back_end(CompileJob *job)
+{
+    Driver *driver = job->driver;
+    CompilationContext *context = job->context;
+    FILE *output = job->output_file;
+    BytecodeProgram *program = compile_bytecode(context->ast, context->error_list);
+    if (!program)
+    {
+        return 0;
+    }
+
+    PinBank *bank = driver->run ? create_pin_bank_from(driver->trace) : NULL;
+    if (driver->run && !bank)
+    {
+        add_new_error(context->error_list, 0, 0, RUNTIME, "Failed to allocate pin bank");
+        free_bytecode_program(program);
+        return 0;
+    }
+
+    int succeeded = 1;
+    if (driver->dump_bytecode)
+    {
+        print_bytecode_program(program, output);
+    }
+    if (driver->run)
+    {
+        VMResult result;
+        bank->output = output;
+        succeeded = run_bytecode_program(program, bank, driver->max_cycles, &result, context->error_list);
+        if (succeeded)
+        {
+            fprintf(output, "main returned %d after %llu cycles\n", result.result, (unsigned long long)result.cycles);
+        }
+    }
+
+    free_pin_bank(bank);
+    free_bytecode_program(program);
+    return succeeded;
+}
+
+// Run one back-end stage as a phase of the job's time report, its throughput is
+// in the AST nodes it consumed
+static int run_job_phase(CompileJob *job, const char *name, int (*stage)(CompileJob *))
+{
+    begin_phase(&job->timing, name);
+    int succeeded = stage(job);
+    end_phase(&job->timing, job->context->ast ? job->context->ast->node_count : 0, "nodes");
+    return succeeded;
+}
+
+// Read back an output the job wrote, into a cache output of its bytes
+static int read_output_file(CompileJob *job, const char *suffix, CacheOutput *output)
+{
+    char *path = get_output_path(job, suffix);
+    FILE *file = path ? fopen(path, "rb") : NULL;
+    free(path);
+    if (!file)
+    {
+        return 0;
+    }
+
+    long size = fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+    output->data = size >= 0 ? malloc(size + 1) : NULL;
+    output->size = size;
+    int read = output->data && fseek(file, 0, SEEK_SET) == 0 && fread(output->data, 1, size, file) == (size_t)size;
+    fclose(file);
+    if (!read)
+    {
+        free(output->data);
+        output->data = NULL;
+    }
+    return read;
+}
+
+// Write a replayed output where compiling would have, a file that fails to write fails the job
+static int write_output_file(CompileJob *job, const char *suffix, const CacheOutput *output)
+{
+    char *path = get_output_path(job, suffix);
+    if (!path)
+    {
+        return 0;
+    }
+
+    FILE *file = fopen(path, "wb");
+    int written = file && fwrite(output->data, 1, output->size, file) == output->size;
+    if (file && fclose(file) != 0)
+    {
+        written = 0;
+    }
+    if (!written)
+    {
+        char message[256];
+        snprintf(message, sizeof(message), "Failed to write '%s'", path);
+        add_new_error(job->context->error_list, 0, 0, CODEGEN, message);
+    }
+    free(path);
+    return written;
+}
+
+// What a finished compilation printed and wrote, read back for the cache. Returns 0
+// if an output it wrote cannot be read, the compilation is then not stored.
+static int collect_job_outputs(CompileJob *job, CacheOutput *outputs)
+{
+    Driver *driver = job->driver;
+    memset(outputs, 0, JOB_OUTPUT_COUNT * sizeof(CacheOutput));
+    if (job->output_file && fflush(job->output_file) == 0 && job->output_length > 0)
+    {
+        outputs[JOB_OUTPUT_TEXT].data = malloc(job->output_length);
+        if (!outputs[JOB_OUTPUT_TEXT].data)
+        {
+            return 0;
+        }
+        memcpy(outputs[JOB_OUTPUT_TEXT].data, job->output, job->output_length);
+        outputs[JOB_OUTPUT_TEXT].size = job->output_length;
+    }
+    if (driver->emit_c && job->succeeded && !read_output_file(job, ".c", &outputs[JOB_OUTPUT_C]))
+    {
+        return 0;
+    }
+    if (driver->emit_binary && job->context->token_stream &&
+        !read_output_file(job, ".dslb", &outputs[JOB_OUTPUT_BINARY]))
+    {
+        return 0;
+    }
+    return 1;
+}
+
+// Print and write again what a cached compilation did
+static void replay_job_outputs(CompileJob *job, const CacheOutput *outputs)
+{
+    if (outputs[JOB_OUTPUT_TEXT].data && job->output_file)
+    {
+        fwrite(outputs[JOB_OUTPUT_TEXT].data, 1, outputs[JOB_OUTPUT_TEXT].size, job->output_file);
+    }
+    if (outputs[JOB_OUTPUT_BINARY].data && !write_output_file(job, ".dslb", &outputs[JOB_OUTPUT_BINARY]))
+    {
+        job->succeeded = 0;
+    }
+    if (outputs[JOB_OUTPUT_C].data && !write_output_file(job, ".c", &outputs[JOB_OUTPUT_C]))
+    {
+        job->succeeded = 0;
+    }
+}
+
+static void free_job_outputs(CacheOutput *outputs)
+{
+    for (int i = 0; i < JOB_OUTPUT_COUNT; i++)
+    {
+        free(outputs[i].data);
+    }
+}
+
+// Run the front end over one file, every object it creates belongs to the job's own context
+static void compile_job(void *argument)
+{
+    CompileJob *job = argument;
+    Driver *driver = job->driver;
+    CompilationContext *context = create_new_compilation_context();
+
+    job->context = context;
+    job->timing.enabled = driver->time_phases;
+    if (context)
+    {
+        context->error_list->max_errors = driver->max_errors;
+        context->lex_threads = driver->lex_threads;
+        context->parse_threads = driver->parse_threads;
+    }
+    if (context && (driver->dump_bytecode || driver->run || driver->optimization_report || driver->emit_c ||
+                    driver->dump_ir || driver->wcet || driver->time_report))
+    {
+        job->output_file = open_memstream(&job->output, &job->output_length);
+        if (!job->output_file)
+        {
+            add_new_error(context->error_list, 0, 0, CODEGEN, "Failed to allocate output buffer");
+        }
+    }
+
+    int loaded = 0;
+    if (context && context->error_list->size == 0)
+    {
+        begin_phase(&job->timing, "load");
+        loaded = load_source_file(context, job->path);
+        end_phase(&job->timing, loaded ? context->source->length : 0, "bytes");
+    }
+
+    if (loaded)
+    {
+        // The IR, timing, bytecode and optimizer reports and runs are not stored, they always compile
+        int cached = driver->cache && !driver->dump_ir && !driver->wcet && !driver->dump_bytecode && !driver->run &&
+                     !driver->optimization_report;
+        CacheOutput outputs[JOB_OUTPUT_COUNT];
+        CacheKey key;
+        int hit = 0;
+        if (cached)
+        {
+            // A hit replays the stored diagnostics and outputs in place of the whole compilation
+            begin_phase(&job->timing, "cache");
+            key = compute_cache_key(context->source->data, context->source->length, driver->options);
+            hit = lookup_compilation_cache(driver->cache, &key, context->error_list, &job->succeeded, outputs,
+                                           JOB_OUTPUT_COUNT);
+            if (hit)
+            {
+                replay_job_outputs(job, outputs);
+                free_job_outputs(outputs);
+            }
+            end_phase(&job->timing, 0, NULL);
+        }
+
+        if (!hit)
+        {
+            job->succeeded = compile_source(job);
+            if (driver->emit_binary && context->token_stream && !run_job_phase(job, "emit-binary", emit_binary_file))
+            {
+                job->succeeded = 0;
+            }
+            if (driver->emit_c && job->succeeded && !run_job_phase(job, "emit-c", emit_c_file))
+            {
+                job->succeeded = 0;
+            }
+            if (driver->dump_ir && job->succeeded && !run_job_phase(job, "ir", dump_ir_file))
+            {
+                job->succeeded = 0;
+            }
+            if (driver->wcet && job->succeeded && !run_job_phase(job, "wcet", print_timing))
+            {
+                job->succeeded = 0;
+            }
+            if ((driver->dump_bytecode || driver->run) && job->succeeded &&
+                !run_job_phase(job, "bytecode", run_back_end))
+            {
+                job->succeeded = 0;
+            }
+        }
+
+        if (cached && !hit && !job->uncacheable)
+        {
+            if (collect_job_outputs(job, outputs))
+            {
+                store_compilation_cache(driver->cache, &key, context->error_list, job->succeeded, outputs,
+                                        JOB_OUTPUT_COUNT);
+            }
+            free_job_outputs(outputs);
+        }
+    }
+
+    if (job->output_file)
+    {
+        if (driver->time_report && job->timing.phase_count > 0)
+        {
+            print_time_report(&job->timing, job->output_file);
+        }
+        fclose(job->output_file);
+        job->output_file = NULL;
+    }
+
+    pthread_mutex_lock(&job->driver->lock);
+    job->done = 1;
+    pthread_cond_broadcast(&job->driver->job_done);
+    pthread_mutex_unlock(&job->driver->lock);
+}
+
+// Write a finished job's output and diagnostics and release it. As text, a file
+// with neither is left out, as JSON every file gets its line after its output.
+static void report_job(CompileJob *job, ErrorWriter *writer)
+{
+    ErrorList *error_list = job->context ? job->context->error_list : NULL;
+    int text = writer->format == ERROR_FORMAT_TEXT;
+    if (!job->context || (text && (job->output_length > 0 || error_list->size > 0 || error_list->dropped > 0)))
+    {
+        write_error_writer_bytes(writer, "In file ", 8);
+        write_error_writer_bytes(writer, job->path, strlen(job->path));
+        write_error_writer_bytes(writer, ":\n", 2);
+    }
+    if (!job->context)
+    {
+        const char *message = "Failed to create compilation context\n\n";
+        write_error_writer_bytes(writer, message, strlen(message));
+        return;
+    }
+
+    if (job->output)
+    {
+        write_error_writer_bytes(writer, job->output, job->output_length);
+    }
+    if (!text || error_list->size > 0 || error_list->dropped > 0)
+    {
+        write_errors(writer, job->path, error_list);
+    }
+
+    free(job->output);
+    job->output = NULL;
+    free_compilation_context(job->context);
+    job->context = NULL;
+}
+
+// Write "--target=<SHA-256 of the file's bytes>" to text, for the cache key
+static void hash_target_file(FILE *file, char *text, size_t size)
+{
+    unsigned char buffer[4096], digest[SHA256_DIGEST_SIZE];
+    size_t count;
+    Sha256 sha;
+
+    sha256_init(&sha);
+    rewind(file);
+    while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        sha256_update(&sha, buffer, count);
+    }
+    sha256_final(&sha, digest);
+
+    int length = snprintf(text, size, "--target=");
+    for (int i = 0; i < SHA256_DIGEST_SIZE && length + 2 < (int)size; i++)
+    {
+        length += snprintf(text + length, size - length, "%02x", digest[i]);
+    }
+}
+
+// Parse a whole decimal number in [1, max], returns 0 if text is not one
+static long parse_count(const char *text, long max)
+{
+    char *end;
+    long count = text ? strtol(text, &end, 10) : 0;
+    return text && *text && *end == '\0' && count > 0 && count <= max ? count : 0;
+}
+
+int main(int argc, char **argv)
+{
+    int thread_count = 0;
+    const char *cache_directory = getenv("DSL_CACHE_DIR");
+    long cache_megabytes = DEFAULT_CACHE_MAX_BYTES / (1024 * 1024);
+    int print_cache_statistics = 0;
+    int optimize = 0;
+    int optimization_report = 0;
+    int emit_binary = 0;
+    int emit_c = 0;
+    const char *target_path = NULL;
+    int dump_ir = 0;
+    int wcet = 0;
+    int dump_bytecode = 0;
+    int run = 0;
+    const char *trace_path = NULL;
+    uint64_t max_cycles = DEFAULT_MAX_CYCLES;
+    int time_report = 0;
+    const char *time_report_path = NULL;
+    int max_errors = 0;
+    int pipeline = 0;
+    int lex_threads = 1;
+    int parse_threads = 1;
+    ErrorFormat error_format = ERROR_FORMAT_TEXT;
+    const char **paths = malloc(argc * sizeof(char *));
+    int path_count = 0;
+
+    if (!paths)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "-j", 2) == 0)
+        {
+            const char *value = argv[i][2] ? argv[i] + 2 : (i + 1 < argc ? argv[++i] : NULL);
+            thread_count = (int)parse_count(value, 1024);
+            if (!thread_count)
+            {
+                fprintf(stderr, "Invalid thread count for -j\n");
+                free(paths);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--cache-dir") == 0 && i + 1 < argc)
+        {
+            cache_directory = argv[++i];
+        }
+        else if (strcmp(argv[i], "--cache-size") == 0)
+        {
+            cache_megabytes = parse_count(i + 1 < argc ? argv[++i] : NULL, 1024 * 1024);
+            if (!cache_megabytes)
+            {
+                fprintf(stderr, "Invalid cache size for --cache-size\n");
+                free(paths);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--cache-stats") == 0)
+        {
+            print_cache_statistics = 1;
+        }
+        else if (strcmp(argv[i], "-O") == 0)
+        {
+            optimize = 1;
+        }
+        else if (strcmp(argv[i], "--opt-report") == 0)
+        {
+            optimization_report = 1;
+        }
+        else if (strcmp(argv[i], "--emit-binary") == 0)
+        {
+            emit_binary = 1;
+        }
+        else if (strcmp(argv[i], "--emit-c") == 0)
+        {
+            emit_c = 1;
+        }
+        else if (strcmp(argv[i], "--target") == 0 && i + 1 < argc)
+        {
+            target_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--dump-ir") == 0)
+        {
+            dump_ir = 1;
+        }
+        else if (strcmp(argv[i], "--wcet") == 0)
+        {
+            wcet = 1;
+        }
+        else if (strcmp(argv[i], "--dump-bytecode") == 0)
+        {
+            dump_bytecode = 1;
+        }
+        else if (strcmp(argv[i], "--run") == 0)
+        {
+            run = 1;
+        }
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+        {
+            trace_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--max-cycles") == 0)
+        {
+            char *end;
+            const char *value = i + 1 < argc ? argv[++i] : "";
+            max_cycles = strtoull(value, &end, 10);
+            if (*value < '0' || *value > '9' || *end != '\0')
+            {
+                fprintf(stderr, "Invalid cycle count for --max-cycles\n");
+                free(paths);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--time-report") == 0)
+        {
+            time_report = 1;
+        }
+        else if (strcmp(argv[i], "--time-report-json") == 0 && i + 1 < argc)
+        {
+            time_report_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--pipeline") == 0)
+        {
+            pipeline = 1;
+        }
+        else if (strcmp(argv[i], "--lex-threads") == 0)
+        {
+            lex_threads = (int)parse_count(i + 1 < argc ? argv[++i] : NULL, 1024);
+            if (!lex_threads)
+            {
+                fprintf(stderr, "Invalid thread count for --lex-threads\n");
+                free(paths);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--parse-threads") == 0)
+        {
+            parse_threads = (int)parse_count(i + 1 < argc ? argv[++i] : NULL, 1024);
+            if (!parse_threads)
+            {
+                fprintf(stderr, "Invalid thread count for --parse-threads\n");
+                free(paths);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--max-errors") == 0)
+        {
+            max_errors = (int)parse_count(i + 1 < argc ? argv[++i] : NULL, 1000000000);
+            if (!max_errors)
+            {
+                fprintf(stderr, "Invalid error count for --max-errors\n");
+                free(paths);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--error-format") == 0)
+        {
+            const char *value = i + 1 < argc ? argv[++i] : "";
+            if (strcmp(value, "text") != 0 && strcmp(value, "json") != 0)
+            {
+                fprintf(stderr, "Invalid format for --error-format, expected text or json\n");
+                free(paths);
+                return 1;
+            }
+            error_format = strcmp(value, "json") == 0 ? ERROR_FORMAT_JSON : ERROR_FORMAT_TEXT;
+        }
+        else if (argv[i][0] == '-' && argv[i][1] != '\0')
+        {
+            fprintf(stderr, "Unknown option '%s'\n", argv[i]);
+            print_usage(argv[0]);
+            free(paths);
+            return 1;
+        }
+        else
+        {
+            paths[path_count++] = argv[i];
+        }
+    }
+
+    if (path_count == 0)
+    {
+        print_usage(argv[0]);
+        free(paths);
+        return 1;
+    }
+
+    if (thread_count == 0)
+    {
+        thread_count = get_processor_count();
+    }
+    if (thread_count > path_count)
+    {
+        thread_count = path_count;
+    }
+
+    // Only -O, the error limit and the outputs asked for change what a cached compilation
+    // produces, -j only changes scheduling. The C also depends on the target, which is
+    // added below once it is read.
+    char options[192];
+    int options_length = snprintf(options, sizeof(options), "%s%s%s", optimize ? "-O " : "",
+                                  emit_binary ? "--emit-binary " : "", emit_c ? "--emit-c " : "");
+    if (max_errors)
+    {
+        options_length += snprintf(options + options_length, sizeof(options) - options_length, "--max-errors=%d ",
+                                   max_errors);
+    }
+
+    Driver driver = {
+        .job_count = path_count,
+        .options = options,
+        .optimize = optimize,
+        .optimization_report = optimize && optimization_report,
+        .emit_binary = emit_binary,
+        .emit_c = emit_c,
+        .dump_ir = dump_ir,
+        .wcet = wcet,
+        .dump_bytecode = dump_bytecode,
+        .run = run,
+        .max_cycles = max_cycles,
+        .time_report = time_report,
+        .time_phases = time_report || time_report_path,
+        .max_errors = max_errors,
+        .pipeline = pipeline,
+        .lex_threads = lex_threads,
+        .parse_threads = parse_threads,
+    };
+
+    // The trace is read once, every run replays it from the start
+    if (trace_path)
+    {
+        ErrorList *trace_errors = create_new_error_list(NULL);
+        FILE *trace_file = fopen(trace_path, "r");
+        driver.trace = create_pin_bank();
+        if (!trace_file || !driver.trace || !trace_errors ||
+            !load_pin_trace(driver.trace, trace_file, trace_path, trace_errors))
+        {
+            fprintf(stderr, "Cannot use trace '%s'\n", trace_path);
+            if (trace_errors)
+            {
+                report_errors(trace_errors);
+            }
+            free_error_list(trace_errors);
+            free_pin_bank(driver.trace);
+            if (trace_file)
+            {
+                fclose(trace_file);
+            }
+            free(paths);
+            return 1;
+        }
+        fclose(trace_file);
+        free_error_list(trace_errors);
+    }
+
+    // Without --target, pins 8n to 8n+7 are port PORTn
+    if (emit_c || dump_ir || wcet)
+    {
+        ErrorList *target_errors = target_path ? create_new_error_list(NULL) : NULL;
+        FILE *target_file = target_path ? fopen(target_path, "r") : NULL;
+        driver.target = target_path ? create_target_config() : create_default_target_config();
+        if (!driver.target ||
+            (target_path && (!target_file || !target_errors ||
+                             !load_target_config(driver.target, target_file, target_path, target_errors))))
+        {
+            fprintf(stderr, "Cannot use target '%s'\n", target_path ? target_path : "default");
+            if (target_errors)
+            {
+                report_errors(target_errors);
+            }
+            free_error_list(target_errors);
+            free_target_config(driver.target);
+            free_pin_bank(driver.trace);
+            if (target_file)
+            {
+                fclose(target_file);
+            }
+            free(paths);
+            return 1;
+        }
+        if (target_file)
+        {
+            hash_target_file(target_file, options + options_length, sizeof(options) - options_length);
+            fclose(target_file);
+        }
+        free_error_list(target_errors);
+    }
+    if (cache_directory && *cache_directory)
+    {
+        driver.cache = create_compilation_cache(cache_directory, (size_t)cache_megabytes * 1024 * 1024);
+        if (!driver.cache)
+        {
+            // Compiling without the cache is slower but still right
+            fprintf(stderr, "Cannot use cache directory '%s', compiling without it\n", cache_directory);
+        }
+    }
+
+    driver.jobs = calloc(path_count, sizeof(CompileJob));
+    ThreadPool *pool = driver.jobs ? create_thread_pool(thread_count) : NULL;
+    if (!pool)
+    {
+        fprintf(stderr, "Failed to start %d compiler threads\n", thread_count);
+        free_compilation_cache(driver.cache);
+        free_pin_bank(driver.trace);
+        free_target_config(driver.target);
+        free(driver.jobs);
+        free(paths);
+        return 1;
+    }
+    pthread_mutex_init(&driver.lock, NULL);
+    pthread_cond_init(&driver.job_done, NULL);
+
+    for (int i = 0; i < path_count; i++)
+    {
+        driver.jobs[i].driver = &driver;
+        driver.jobs[i].path = paths[i];
+        if (!submit_thread_pool_task(pool, compile_job, &driver.jobs[i]))
+        {
+            // Compile it here rather than drop it
+            compile_job(&driver.jobs[i]);
+        }
+    }
+
+    // Report each file as soon as it and every file before it are done, so the
+    // output is the same for any thread count while later files are still compiling.
+    // Everything goes through one buffered writer, flushed whenever it has to wait.
+    static ErrorWriter writer;
+    init_error_writer(&writer, stdout, error_format);
+    int failures = 0;
+    for (int i = 0; i < path_count; i++)
+    {
+        pthread_mutex_lock(&driver.lock);
+        if (!driver.jobs[i].done)
+        {
+            // Show what is ready before waiting for the next file
+            pthread_mutex_unlock(&driver.lock);
+            flush_error_writer(&writer);
+            pthread_mutex_lock(&driver.lock);
+        }
+        while (!driver.jobs[i].done)
+        {
+            pthread_cond_wait(&driver.job_done, &driver.lock);
+        }
+        pthread_mutex_unlock(&driver.lock);
+
+        failures += !driver.jobs[i].succeeded;
+        report_job(&driver.jobs[i], &writer);
+    }
+    flush_error_writer(&writer);
+
+    free_thread_pool(pool);
+
+    // One object per file in input order, written once every phase has ended
+    if (time_report_path)
+    {
+        FILE *json = fopen(time_report_path, "w");
+        if (json)
+        {
+            fputs("{\"files\": [\n", json);
+            for (int i = 0; i < path_count; i++)
+            {
+                fputs(i ? ",\n" : "", json);
+                print_time_report_json(&driver.jobs[i].timing, driver.jobs[i].path, driver.jobs[i].succeeded, json);
+            }
+            fputs("\n]}\n", json);
+        }
+        if (!json || fclose(json) != 0)
+        {
+            fprintf(stderr, "Cannot write time report '%s'\n", time_report_path);
+            failures++;
+        }
+    }
+
+    if (driver.cache)
+    {
+        if (driver.cache->stores > 0)
+        {
+            trim_compilation_cache(driver.cache);
+        }
+        if (print_cache_statistics)
+        {
+            report_cache_statistics(driver.cache, stderr);
+        }
+        free_compilation_cache(driver.cache);
+    }
+
+    pthread_mutex_destroy(&driver.lock);
+    pthread_cond_destroy(&driver.job_done);
+    free_pin_bank(driver.trace);
+    free_target_config(driver.target);
+    free(driver.jobs);
+    free(paths);
+
+    return failures > 0;
+}
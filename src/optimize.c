@@ -0,0 +1,805 @@
+#include "optimize.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Expression and statement nesting optimized before leaving the AST as it is
+// rather than overflowing the call stack
+#define MAX_OPTIMIZER_DEPTH 20000
+
+// What is known about a variable in scope, innermost last
+typedef struct
+{
+    uint32_t symbol;
+    int known;     // Holds value wherever the current statement can be reached from
+    int32_t value;
+} ConstantBinding;
+
+// State of one optimization. The new pool is built beside the old one; finished
+// nodes wait on stack for their parent, as in the parser.
+typedef struct
+{
+    AST *ast;
+    TokenStream *token_stream;
+    ASTNode *old_nodes;
+    uint32_t *old_children;
+    ASTNode *nodes;
+    uint32_t node_count;
+    uint32_t node_capacity;
+    uint32_t *children;
+    uint32_t child_count;
+    uint32_t child_capacity;
+    uint32_t *stack;
+    uint32_t stack_size;
+    uint32_t stack_capacity;
+    ConstantBinding *bindings;
+    uint32_t binding_count;
+    uint32_t binding_capacity;
+    OptimizationReport *report;
+    int depth;
+    int failed;          // Out of memory or nested too deeply
+} Optimizer;
+
+// A saved copy of every binding's state, to merge the arms of an if
+typedef struct
+{
+    int *known;
+    int32_t *values;
+    uint32_t count;
+} BindingSnapshot;
+
+static int push_new_node(Optimizer *optimizer, uint32_t index)
+{
+    if (optimizer->stack_size == optimizer->stack_capacity)
+    {
+        uint32_t capacity = optimizer->stack_capacity ? optimizer->stack_capacity * 2 : 64;
+        uint32_t *stack = realloc(optimizer->stack, capacity * sizeof(uint32_t));
+        if (!stack)
+        {
+            optimizer->failed = 1;
+            return 0;
+        }
+        optimizer->stack = stack;
+        optimizer->stack_capacity = capacity;
+    }
+
+    optimizer->stack[optimizer->stack_size++] = index;
+    return 1;
+}
+
+// Create a node whose children are the top num_children entries of the stack and push it
+static int add_new_node(Optimizer *optimizer, ASTNodeType type, uint32_t token, uint32_t num_children)
+{
+    // The rebuilt pool never outgrows the old one, nothing is ever added
+    if (optimizer->failed || optimizer->node_count == optimizer->node_capacity ||
+        optimizer->child_count + num_children > optimizer->child_capacity)
+    {
+        optimizer->failed = 1;
+        return 0;
+    }
+
+    // A leaf may come before anything was pushed, when the stack is still unallocated
+    optimizer->stack_size -= num_children;
+    if (num_children)
+    {
+        memcpy(optimizer->children + optimizer->child_count, optimizer->stack + optimizer->stack_size,
+               num_children * sizeof(uint32_t));
+    }
+
+    uint32_t index = optimizer->node_count++;
+    ASTNode *node = &optimizer->nodes[index];
+    node->type = (uint8_t)type;
+    node->token = token;
+    node->first_child = optimizer->child_count;
+    node->num_children = num_children;
+    optimizer->child_count += num_children;
+
+    return push_new_node(optimizer, index);
+}
+
+static int add_constant(Optimizer *optimizer, uint32_t token, int32_t value)
+{
+    if (!add_new_node(optimizer, CONSTANT, token, 0))
+    {
+        return 0;
+    }
+    optimizer->nodes[optimizer->node_count - 1].value = value;
+    return 1;
+}
+
+// Copy a node that has no children
+static int copy_leaf(Optimizer *optimizer, uint32_t index)
+{
+    ASTNode *node = &optimizer->old_nodes[index];
+    return add_new_node(optimizer, node->type, node->token, 0);
+}
+
+static uint32_t old_child(Optimizer *optimizer, uint32_t index, uint32_t child)
+{
+    return optimizer->old_children[optimizer->old_nodes[index].first_child + child];
+}
+
+// Value of a finished new node, if it is a constant. NUMBER tokens too big for an
+// int are not, codegen reports them.
+static int new_node_value(Optimizer *optimizer, uint32_t index, int32_t *value)
+{
+    ASTNode *node = &optimizer->nodes[index];
+    TokenType type = optimizer->token_stream->types[node->token];
+
+    switch (node->type)
+    {
+    case CONSTANT:
+        *value = node->value;
+        return 1;
+    case BOOL_VALUE:
+        *value = type == TOKEN_TRUE;
+        return 1;
+    case NUMBER_LITERAL:
+    {
+        int length;
+        const char *lexeme = get_token_lexeme(optimizer->token_stream, node->token, &length);
+        int64_t number = 0;
+        for (int i = 0; i < length; i++)
+        {
+            number = number * 10 + (lexeme[i] - '0');
+            if (number > INT32_MAX)
+            {
+                return 0;
+            }
+        }
+        *value = (int32_t)number;
+        return 1;
+    }
+    default:
+        return 0;
+    }
+}
+
+static int top_value(Optimizer *optimizer, uint32_t depth, int32_t *value)
+{
+    return new_node_value(optimizer, optimizer->stack[optimizer->stack_size - 1 - depth], value);
+}
+
+static ConstantBinding *find_binding(Optimizer *optimizer, uint32_t symbol)
+{
+    for (uint32_t i = optimizer->binding_count; i-- > 0;)
+    {
+        if (optimizer->bindings[i].symbol == symbol)
+        {
+            return &optimizer->bindings[i];
+        }
+    }
+    return NULL;
+}
+
+static int bind_variable(Optimizer *optimizer, uint32_t symbol, int known, int32_t value)
+{
+    if (optimizer->binding_count == optimizer->binding_capacity)
+    {
+        uint32_t capacity = optimizer->binding_capacity ? optimizer->binding_capacity * 2 : 64;
+        ConstantBinding *bindings = realloc(optimizer->bindings, capacity * sizeof(ConstantBinding));
+        if (!bindings)
+        {
+            optimizer->failed = 1;
+            return 0;
+        }
+        optimizer->bindings = bindings;
+        optimizer->binding_capacity = capacity;
+    }
+
+    optimizer->bindings[optimizer->binding_count++] = (ConstantBinding){symbol, known, value};
+    return 1;
+}
+
+// Forget the value of every variable the old statement at index assigns. Every
+// binding with the name goes, whichever one the assignment meant.
+static void forget_assigned(Optimizer *optimizer, uint32_t index)
+{
+    ASTNode *node = &optimizer->old_nodes[index];
+    switch (node->type)
+    {
+    case ASSIGNMENT:
+    {
+        uint32_t symbol = optimizer->token_stream->symbols[node->token];
+        for (uint32_t i = 0; i < optimizer->binding_count; i++)
+        {
+            if (optimizer->bindings[i].symbol == symbol)
+            {
+                optimizer->bindings[i].known = 0;
+            }
+        }
+        break;
+    }
+    case STATEMENT_LIST:
+        for (uint32_t i = 0; i < node->num_children; i++)
+        {
+            forget_assigned(optimizer, old_child(optimizer, index, i));
+        }
+        break;
+    case CONDITIONAL:
+    case WHILE_LOOP:
+        // Expressions assign nothing, only the blocks after the condition matter
+        for (uint32_t i = 1; i < node->num_children; i++)
+        {
+            forget_assigned(optimizer, old_child(optimizer, index, i));
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static int save_bindings(Optimizer *optimizer, BindingSnapshot *snapshot)
+{
+    snapshot->count = optimizer->binding_count;
+    snapshot->known = malloc((snapshot->count + 1) * sizeof(int));
+    snapshot->values = malloc((snapshot->count + 1) * sizeof(int32_t));
+    if (!snapshot->known || !snapshot->values)
+    {
+        free(snapshot->known);
+        free(snapshot->values);
+        optimizer->failed = 1;
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < snapshot->count; i++)
+    {
+        snapshot->known[i] = optimizer->bindings[i].known;
+        snapshot->values[i] = optimizer->bindings[i].value;
+    }
+    return 1;
+}
+
+// Swap the saved states with the current ones
+static void swap_bindings(Optimizer *optimizer, BindingSnapshot *snapshot)
+{
+    for (uint32_t i = 0; i < snapshot->count; i++)
+    {
+        int known = optimizer->bindings[i].known;
+        int32_t value = optimizer->bindings[i].value;
+        optimizer->bindings[i].known = snapshot->known[i];
+        optimizer->bindings[i].value = snapshot->values[i];
+        snapshot->known[i] = known;
+        snapshot->values[i] = value;
+    }
+}
+
+// Keep a value only where both paths agree on it
+static void merge_bindings(Optimizer *optimizer, BindingSnapshot *snapshot)
+{
+    for (uint32_t i = 0; i < snapshot->count; i++)
+    {
+        ConstantBinding *binding = &optimizer->bindings[i];
+        binding->known = binding->known && snapshot->known[i] && binding->value == snapshot->values[i];
+    }
+}
+
+static void free_snapshot(BindingSnapshot *snapshot)
+{
+    free(snapshot->known);
+    free(snapshot->values);
+}
+
+static int enter_node(Optimizer *optimizer)
+{
+    if (++optimizer->depth > MAX_OPTIMIZER_DEPTH)
+    {
+        optimizer->report->skipped = 1;
+        optimizer->failed = 1;
+    }
+    return !optimizer->failed;
+}
+
+// Wrapping arithmetic and 0/1 comparisons, as the VM computes them. Division by
+// zero is not folded, it has to fail at run time.
+static int fold_binary(TokenType type, int32_t left, int32_t right, int32_t *value)
+{
+    uint32_t x = (uint32_t)left, y = (uint32_t)right;
+    switch (type)
+    {
+    case TOKEN_PLUS:
+        *value = (int32_t)(x + y);
+        return 1;
+    case TOKEN_MINUS:
+        *value = (int32_t)(x - y);
+        return 1;
+    case TOKEN_STAR:
+        *value = (int32_t)(x * y);
+        return 1;
+    case TOKEN_SLASH:
+        if (right == 0)
+        {
+            return 0;
+        }
+        *value = right == -1 ? (int32_t)(0u - x) : left / right;
+        return 1;
+    case TOKEN_EQ:
+        *value = left == right;
+        return 1;
+    case TOKEN_NEQ:
+        *value = left != right;
+        return 1;
+    case TOKEN_LT:
+        *value = left < right;
+        return 1;
+    case TOKEN_GT:
+        *value = left > right;
+        return 1;
+    case TOKEN_LTE:
+        *value = left <= right;
+        return 1;
+    case TOKEN_GTE:
+        *value = left >= right;
+        return 1;
+    case TOKEN_AND:
+        *value = left != 0 && right != 0;
+        return 1;
+    case TOKEN_OR:
+        *value = left != 0 || right != 0;
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+// Where the new pool ended before a subexpression was built
+typedef struct
+{
+    uint32_t node_count;
+    uint32_t child_count;
+    uint32_t stack_size;
+} OptimizerMark;
+
+static OptimizerMark mark_optimizer(Optimizer *optimizer)
+{
+    OptimizerMark mark = {optimizer->node_count, optimizer->child_count, optimizer->stack_size};
+    return mark;
+}
+
+// Drop every node built since mark. They are the subtrees just folded into a
+// constant, and nothing else refers to them.
+static void rewind_optimizer(Optimizer *optimizer, OptimizerMark mark)
+{
+    optimizer->node_count = mark.node_count;
+    optimizer->child_count = mark.child_count;
+    optimizer->stack_size = mark.stack_size;
+}
+
+static int optimize_expression(Optimizer *optimizer, uint32_t index);
+
+static int optimize_binary_expression(Optimizer *optimizer, uint32_t index)
+{
+    ASTNode *node = &optimizer->old_nodes[index];
+    TokenType type = optimizer->token_stream->types[node->token];
+    OptimizerMark mark = mark_optimizer(optimizer);
+    int32_t left, right, value;
+
+    if (!optimize_expression(optimizer, old_child(optimizer, index, 0)))
+    {
+        return 0;
+    }
+
+    // false && x and true || x never look at x
+    if ((type == TOKEN_AND || type == TOKEN_OR) && top_value(optimizer, 0, &left) && (left != 0) == (type == TOKEN_OR))
+    {
+        rewind_optimizer(optimizer, mark);
+        optimizer->report->folded++;
+        return add_constant(optimizer, node->token, type == TOKEN_OR);
+    }
+
+    if (!optimize_expression(optimizer, old_child(optimizer, index, 1)))
+    {
+        return 0;
+    }
+
+    if (top_value(optimizer, 1, &left) && top_value(optimizer, 0, &right) && fold_binary(type, left, right, &value))
+    {
+        rewind_optimizer(optimizer, mark);
+        optimizer->report->folded++;
+        return add_constant(optimizer, node->token, value);
+    }
+    return add_new_node(optimizer, BINARY_EXPRESSION, node->token, 2);
+}
+
+// Push the optimized form of the expression at index
+static int optimize_expression(Optimizer *optimizer, uint32_t index)
+{
+    ASTNode *node = &optimizer->old_nodes[index];
+    TokenType type = optimizer->token_stream->types[node->token];
+    OptimizerMark mark = mark_optimizer(optimizer);
+    int32_t value;
+    int result = 0;
+
+    if (!enter_node(optimizer))
+    {
+        return 0;
+    }
+
+    switch (node->type)
+    {
+    case IDENTIFIER:
+    {
+        ConstantBinding *binding = find_binding(optimizer, optimizer->token_stream->symbols[node->token]);
+        if (binding && binding->known)
+        {
+            optimizer->report->propagated++;
+            result = add_constant(optimizer, node->token, binding->value);
+        }
+        else
+        {
+            result = copy_leaf(optimizer, index);
+        }
+        break;
+    }
+    case UNARY_EXPRESSION:
+        result = optimize_expression(optimizer, old_child(optimizer, index, 0));
+        if (result && top_value(optimizer, 0, &value))
+        {
+            rewind_optimizer(optimizer, mark);
+            optimizer->report->folded++;
+            result = add_constant(optimizer, node->token, type == TOKEN_NOT ? value == 0 : (int32_t)(0u - (uint32_t)value));
+        }
+        else if (result)
+        {
+            result = add_new_node(optimizer, UNARY_EXPRESSION, node->token, 1);
+        }
+        break;
+    case BINARY_EXPRESSION:
+        result = optimize_binary_expression(optimizer, index);
+        break;
+    case CALL_EXPRESSION:
+    case GPIO_OPERATION:
+        result = 1;
+        for (uint32_t i = 0; i < node->num_children && result; i++)
+        {
+            result = optimize_expression(optimizer, old_child(optimizer, index, i));
+        }
+        result = result && add_new_node(optimizer, node->type, node->token, node->num_children);
+        break;
+    case CONSTANT:
+        result = add_constant(optimizer, node->token, node->value);
+        break;
+    default:
+        result = copy_leaf(optimizer, index);
+        break;
+    }
+
+    optimizer->depth--;
+    return result;
+}
+
+static int optimize_statement_list(Optimizer *optimizer, uint32_t index, uint32_t *count, int *returns);
+
+// Whether a block declares a variable of its own, which keeps it from being merged
+// into the enclosing one
+static int declares_variables(Optimizer *optimizer, uint32_t index)
+{
+    ASTNode *node = &optimizer->old_nodes[index];
+    for (uint32_t i = 0; i < node->num_children; i++)
+    {
+        ASTNodeType type = optimizer->old_nodes[old_child(optimizer, index, i)].type;
+        if (type == IDENTIFIER_DECLARATION || type == IDENTIFIER_DEFINITION)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Push the arm of an if that always runs, in place of the if. A block that declares
+// variables stays a block, as if (true) { ... }.
+static int optimize_taken_arm(Optimizer *optimizer, uint32_t if_index, uint32_t arm, uint32_t *count, int *returns)
+{
+    uint32_t token = optimizer->old_nodes[if_index].token;
+    if (!declares_variables(optimizer, arm))
+    {
+        return optimize_statement_list(optimizer, arm, count, returns);
+    }
+
+    uint32_t arm_count;
+    if (!add_constant(optimizer, token, 1) || !optimize_statement_list(optimizer, arm, &arm_count, returns) ||
+        !add_new_node(optimizer, STATEMENT_LIST, optimizer->old_nodes[arm].token, arm_count))
+    {
+        return 0;
+    }
+    *count = 1;
+    return add_new_node(optimizer, CONDITIONAL, token, 2);
+}
+
+static int optimize_conditional(Optimizer *optimizer, uint32_t index, uint32_t *count, int *returns)
+{
+    ASTNode *node = &optimizer->old_nodes[index];
+    int has_else = node->num_children == 3;
+    OptimizerMark mark = mark_optimizer(optimizer);
+    int32_t condition;
+
+    if (!optimize_expression(optimizer, old_child(optimizer, index, 0)))
+    {
+        return 0;
+    }
+
+    if (top_value(optimizer, 0, &condition))
+    {
+        rewind_optimizer(optimizer, mark);
+        optimizer->report->branches_pruned += has_else || !condition;
+        if (condition || has_else)
+        {
+            return optimize_taken_arm(optimizer, index, old_child(optimizer, index, condition ? 1 : 2), count, returns);
+        }
+        *count = 0;
+        return 1;
+    }
+
+    BindingSnapshot snapshot;
+    uint32_t arm_count;
+    int then_returns, else_returns = 0;
+    if (!save_bindings(optimizer, &snapshot))
+    {
+        return 0;
+    }
+
+    uint32_t then_arm = old_child(optimizer, index, 1);
+    int result = optimize_statement_list(optimizer, then_arm, &arm_count, &then_returns) &&
+                 add_new_node(optimizer, STATEMENT_LIST, optimizer->old_nodes[then_arm].token, arm_count);
+
+    // Each arm starts from the state before the if; an arm that returns does not
+    // reach the code after it
+    swap_bindings(optimizer, &snapshot);
+    if (result && has_else)
+    {
+        uint32_t else_arm = old_child(optimizer, index, 2);
+        result = optimize_statement_list(optimizer, else_arm, &arm_count, &else_returns) &&
+                 add_new_node(optimizer, STATEMENT_LIST, optimizer->old_nodes[else_arm].token, arm_count);
+    }
+    if (then_returns && !else_returns)
+    {
+        // The then arm's state is dead, the current one stands
+    }
+    else if (else_returns && !then_returns)
+    {
+        swap_bindings(optimizer, &snapshot);
+    }
+    else
+    {
+        merge_bindings(optimizer, &snapshot);
+    }
+    free_snapshot(&snapshot);
+
+    *count = 1;
+    *returns = then_returns && else_returns;
+    return result && add_new_node(optimizer, CONDITIONAL, node->token, node->num_children);
+}
+
+static int optimize_while_loop(Optimizer *optimizer, uint32_t index, uint32_t *count)
+{
+    ASTNode *node = &optimizer->old_nodes[index];
+    OptimizerMark mark = mark_optimizer(optimizer);
+    int32_t condition;
+    int returns;
+
+    // Anything the loop assigns may differ from one iteration to the next
+    forget_assigned(optimizer, index);
+
+    if (!optimize_expression(optimizer, old_child(optimizer, index, 0)))
+    {
+        return 0;
+    }
+    if (top_value(optimizer, 0, &condition) && !condition)
+    {
+        rewind_optimizer(optimizer, mark);
+        optimizer->report->loops_removed++;
+        *count = 0;
+        return 1;
+    }
+
+    uint32_t body = old_child(optimizer, index, 1), body_count;
+    if (!optimize_statement_list(optimizer, body, &body_count, &returns) ||
+        !add_new_node(optimizer, STATEMENT_LIST, optimizer->old_nodes[body].token, body_count))
+    {
+        return 0;
+    }
+
+    // The body may have left values that only hold after its last iteration
+    forget_assigned(optimizer, index);
+    *count = 1;
+    return add_new_node(optimizer, WHILE_LOOP, node->token, 2);
+}
+
+// Push the optimized form of a statement, which may be no statement or several,
+// and say how many and whether they always return
+static int optimize_statement(Optimizer *optimizer, uint32_t index, uint32_t *count, int *returns)
+{
+    ASTNode *node = &optimizer->old_nodes[index];
+    uint32_t symbol = optimizer->token_stream->symbols[node->token];
+    int32_t value;
+    int result = 1;
+
+    *count = 1;
+    *returns = 0;
+    if (!enter_node(optimizer))
+    {
+        return 0;
+    }
+
+    switch (node->type)
+    {
+    case IDENTIFIER_DECLARATION:
+        // Never assigned yet, its value is not something to rely on
+        result = copy_leaf(optimizer, index) && bind_variable(optimizer, symbol, 0, 0);
+        break;
+    case IDENTIFIER_DEFINITION:
+        result = optimize_expression(optimizer, old_child(optimizer, index, 0));
+        if (result)
+        {
+            int known = top_value(optimizer, 0, &value);
+            result = add_new_node(optimizer, node->type, node->token, 1) && bind_variable(optimizer, symbol, known, value);
+        }
+        break;
+    case ASSIGNMENT:
+        result = optimize_expression(optimizer, old_child(optimizer, index, 0));
+        if (result)
+        {
+            ConstantBinding *binding = find_binding(optimizer, symbol);
+            if (binding)
+            {
+                binding->known = top_value(optimizer, 0, &binding->value);
+            }
+            result = add_new_node(optimizer, ASSIGNMENT, node->token, 1);
+        }
+        break;
+    case CONDITIONAL:
+        result = optimize_conditional(optimizer, index, count, returns);
+        break;
+    case WHILE_LOOP:
+        result = optimize_while_loop(optimizer, index, count);
+        break;
+    case RETURN_STATEMENT:
+        result = optimize_expression(optimizer, old_child(optimizer, index, 0)) &&
+                 add_new_node(optimizer, RETURN_STATEMENT, node->token, 1);
+        *returns = 1;
+        break;
+    case GPIO_OPERATION:
+        for (uint32_t i = 0; i < node->num_children && result; i++)
+        {
+            result = copy_leaf(optimizer, old_child(optimizer, index, i));
+        }
+        result = result && add_new_node(optimizer, GPIO_OPERATION, node->token, node->num_children);
+        break;
+    default:
+        result = optimize_expression(optimizer, old_child(optimizer, index, 0)) &&
+                 add_new_node(optimizer, node->type, node->token, 1);
+        break;
+    }
+
+    optimizer->depth--;
+    return result;
+}
+
+// Push the optimized statements of a block, not the block itself. Its variables go
+// out of scope at the end, and nothing after a statement that always returns is kept.
+static int optimize_statement_list(Optimizer *optimizer, uint32_t index, uint32_t *count, int *returns)
+{
+    ASTNode *node = &optimizer->old_nodes[index];
+    uint32_t saved_binding_count = optimizer->binding_count;
+
+    *count = 0;
+    *returns = 0;
+    for (uint32_t i = 0; i < node->num_children; i++)
+    {
+        if (*returns)
+        {
+            optimizer->report->statements_removed += node->num_children - i;
+            break;
+        }
+
+        uint32_t statement_count;
+        if (!optimize_statement(optimizer, old_child(optimizer, index, i), &statement_count, returns))
+        {
+            return 0;
+        }
+        *count += statement_count;
+    }
+
+    optimizer->binding_count = saved_binding_count;
+    return 1;
+}
+
+static int optimize_function(Optimizer *optimizer, uint32_t index)
+{
+    ASTNode *node = &optimizer->old_nodes[index];
+    uint32_t parameters = old_child(optimizer, index, 0), body = old_child(optimizer, index, 1);
+    ASTNode *parameter_list = &optimizer->old_nodes[parameters];
+    uint32_t body_count;
+    int returns;
+
+    optimizer->binding_count = 0;
+    for (uint32_t i = 0; i < parameter_list->num_children; i++)
+    {
+        uint32_t parameter = old_child(optimizer, parameters, i);
+        if (!copy_leaf(optimizer, parameter) ||
+            !bind_variable(optimizer, optimizer->token_stream->symbols[optimizer->old_nodes[parameter].token], 0, 0))
+        {
+            return 0;
+        }
+    }
+
+    return add_new_node(optimizer, FUNCTION_PARAMETERS, parameter_list->token, parameter_list->num_children) &&
+           optimize_statement_list(optimizer, body, &body_count, &returns) &&
+           add_new_node(optimizer, STATEMENT_LIST, optimizer->old_nodes[body].token, body_count) &&
+           add_new_node(optimizer, FUNCTION, node->token, 2);
+}
+
+int optimize_ast(AST *ast, OptimizationReport *report, ErrorList *error_list)
+{
+    memset(report, 0, sizeof(OptimizationReport));
+    if (!ast || ast->root == AST_NO_NODE)
+    {
+        add_new_error(error_list, 0, 0, CODEGEN, "Invalid AST passed");
+        return 0;
+    }
+
+    Arena *arena = ast->arena;
+    Optimizer optimizer = {
+        .ast = ast,
+        .token_stream = ast->token_stream,
+        .old_nodes = ast->nodes,
+        .old_children = ast->children,
+        .node_capacity = ast->node_count,
+        .child_capacity = ast->child_count,
+        .report = report,
+    };
+    optimizer.nodes = arena_alloc(arena, (ast->node_count ? ast->node_count : 1) * sizeof(ASTNode));
+    optimizer.children = arena_alloc(arena, (ast->child_count ? ast->child_count : 1) * sizeof(uint32_t));
+
+    ASTNode *root = &ast->nodes[ast->root];
+    int optimized = optimizer.nodes && optimizer.children;
+    for (uint32_t i = 0; i < root->num_children && optimized; i++)
+    {
+        optimized = optimize_function(&optimizer, ast->children[root->first_child + i]);
+    }
+    optimized = optimized && add_new_node(&optimizer, FUNCTION_LIST, root->token, root->num_children);
+
+    free(optimizer.stack);
+    free(optimizer.bindings);
+    report->nodes_before = ast->node_count;
+
+    if (!optimized)
+    {
+        arena_free(arena, optimizer.nodes);
+        arena_free(arena, optimizer.children);
+        report->nodes_after = ast->node_count;
+        if (report->skipped)
+        {
+            // Too deep to follow, which is not an error: the program is just not optimized
+            return 1;
+        }
+        add_new_error(error_list, 0, 0, CODEGEN, "Out of memory while optimizing");
+        return 0;
+    }
+
+    arena_free(arena, ast->nodes);
+    arena_free(arena, ast->children);
+    ast->nodes = optimizer.nodes;
+    ast->node_count = optimizer.node_count;
+    ast->children = optimizer.children;
+    ast->child_count = optimizer.child_count;
+    ast->node_capacity = optimizer.node_capacity;
+    ast->child_capacity = optimizer.child_capacity;
+    ast->root = optimizer.node_count - 1;
+    ast->segment_count = 0;
+    report->nodes_after = ast->node_count;
+    return 1;
+}
+
+void print_optimization_report(OptimizationReport *report, FILE *file)
+{
+    if (report->skipped)
+    {
+        fprintf(file, "optimizer: nesting too deep, nothing optimized\n");
+        return;
+    }
+
+    fprintf(file, "optimizer: removed %u of %u nodes (%u folded, %u propagated, %u branches pruned, "
+            "%u loops removed, %u unreachable statements)\n",
+            report->nodes_before - report->nodes_after, report->nodes_before, report->folded, report->propagated,
+            report->branches_pruned, report->loops_removed, report->statements_removed);
+}
@@ -1,41 +1,1525 @@
 #include "parser.h"
 #include "errors.h"
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 
-// Used for moving the look_ahead token to the next token in token stream
-static Token *get_next_token(TokenStream *token_stream, int *current_index) 
+#define DEFAULT_PARSER_STACK_CAPACITY 64
+
+// Expression nesting parsed on the call stack before switching to an explicit stack,
+// DSL_PARSER_RECURSION_LIMIT overrides it (0 parses every expression on the explicit stack)
+#define DEFAULT_PARSER_RECURSION_LIMIT 256
+
+// Binding powers of the binary operators, zero for every token that is not one.
+// && and || share the loosest level, as in the grammar, so a || b && c is (a || b) && c.
+static const unsigned char binary_binding_powers[TOKEN_ERROR + 1] = {
+    [TOKEN_AND] = 1, [TOKEN_OR] = 1,
+    [TOKEN_LT] = 2, [TOKEN_GT] = 2, [TOKEN_LTE] = 2, [TOKEN_GTE] = 2, [TOKEN_EQ] = 2, [TOKEN_NEQ] = 2,
+    [TOKEN_PLUS] = 3, [TOKEN_MINUS] = 3,
+    [TOKEN_STAR] = 4, [TOKEN_SLASH] = 4,
+};
+
+// Prefix ! and - bind tighter than every binary operator
+#define UNARY_BINDING_POWER 5
+
+// Pending construct on the explicit expression stack
+typedef enum
+{
+    FRAME_UNARY,  // Prefix operator waiting for its operand
+    FRAME_BINARY, // Binary operator waiting for its right operand
+    FRAME_GROUP,  // '(' waiting for its ')'
+    FRAME_CALL    // Call waiting for its remaining arguments
+} ExpressionFrameKind;
+
+typedef struct
+{
+    uint8_t kind;           // ExpressionFrameKind
+    uint8_t binding_power;  // Of a FRAME_BINARY operator
+    int token;              // Operator, '(' or callee name
+    uint32_t num_arguments; // Arguments a FRAME_CALL has completed
+} ExpressionFrame;
+
+// Longest piece of a lexeme quoted in an error message
+#define MAX_QUOTED_LEXEME 64
+
+// State of a single parse
+typedef struct
+{
+    TokenStream *token_stream;
+    const uint8_t *types;   // token_stream->types, the only array lookahead touches
+    ErrorList *error_list;
+    AST *ast;
+    int current;            // Index of the lookahead token
+    uint32_t *stack;        // Finished nodes waiting for their parent to be created
+    uint32_t stack_size;
+    uint32_t stack_capacity;
+    ExpressionFrame *frames; // Explicit expression stack, only used past the recursion limit
+    uint32_t frame_count;
+    uint32_t frame_capacity;
+    int depth;               // Expressions currently open on the call stack
+    int recursion_limit;
+    int error_base;          // Size of error_list when the parse started
+    int out_of_memory;
+    int available;           // Tokens the stream holds, fewer than it will while a feed still supplies them
+    TokenFeed feed;          // NULL when the whole stream was lexed before the parse
+    void *feed_state;
+    int feed_failed;         // The feed ended without EOF, the parse is abandoned
+} Parser;
+
+// Position to rewind to when a statement or function fails to parse
+typedef struct
+{
+    uint32_t node_count;
+    uint32_t child_count;
+    uint32_t stack_size;
+} ParserMark;
+
+const char *ast_node_type_to_string(ASTNodeType type)
 {
-    if (*current_index >= token_stream->size)
+    switch (type)
     {
-        return NULL; // End of token stream
+    case FUNCTION_LIST:
+        return "FUNCTION_LIST";
+    case FUNCTION:
+        return "FUNCTION";
+    case FUNCTION_PARAMETERS:
+        return "FUNCTION_PARAMETERS";
+    case STATEMENT_LIST:
+        return "STATEMENT_LIST";
+    case IDENTIFIER_DECLARATION:
+        return "IDENTIFIER_DECLARATION";
+    case IDENTIFIER_DEFINITION:
+        return "IDENTIFIER_DEFINITION";
+    case ASSIGNMENT:
+        return "ASSIGNMENT";
+    case CONDITIONAL:
+        return "CONDITIONAL";
+    case WHILE_LOOP:
+        return "WHILE_LOOP";
+    case RETURN_STATEMENT:
+        return "RETURN_STATEMENT";
+    case EXPRESSION_STATEMENT:
+        return "EXPRESSION_STATEMENT";
+    case GPIO_OPERATION:
+        return "GPIO_OPERATION";
+    case GPIO_PIN:
+        return "GPIO_PIN";
+    case GPIO_VALUES:
+        return "GPIO_VALUES";
+    case BINARY_EXPRESSION:
+        return "BINARY_EXPRESSION";
+    case UNARY_EXPRESSION:
+        return "UNARY_EXPRESSION";
+    case CALL_EXPRESSION:
+        return "CALL_EXPRESSION";
+    case IDENTIFIER:
+        return "IDENTIFIER";
+    case NUMBER_LITERAL:
+        return "NUMBER_LITERAL";
+    case BOOL_VALUE:
+        return "BOOL_VALUE";
+    case CONSTANT:
+        return "CONSTANT";
+    default:
+        return "UNKNOWN_NODE";
     }
-    return &token_stream->tokens[(*current_index)++];
 }
 
-// Matches the current token with the expected type
-static void match(TokenStream *token_stream, TokenType expected_type, ErrorList *error_list, int *current_index)
+// Grow an arena array of element_size elements so it holds at least needed of them
+static int grow_ast_array(Arena *arena, void **array, uint32_t *capacity, uint32_t needed, size_t element_size)
+{
+    uint32_t new_capacity = *capacity ? *capacity : 16;
+    while (new_capacity < needed)
+    {
+        new_capacity *= 2;
+    }
+
+    void *temp_array = arena_realloc(arena, *array, *capacity * element_size, new_capacity * element_size);
+    if (!temp_array)
+    {
+        return 0;
+    }
+
+    *array = temp_array;
+    *capacity = new_capacity;
+    return 1;
+}
+
+static int push_node(Parser *parser, uint32_t index)
+{
+    if (parser->stack_size == parser->stack_capacity)
+    {
+        uint32_t new_capacity = parser->stack_capacity * 2;
+        uint32_t *temp_stack = realloc(parser->stack, new_capacity * sizeof(uint32_t));
+        if (!temp_stack)
+        {
+            parser->out_of_memory = 1;
+            return 0;
+        }
+        parser->stack = temp_stack;
+        parser->stack_capacity = new_capacity;
+    }
+
+    parser->stack[parser->stack_size++] = index;
+    return 1;
+}
+
+// Create a node whose children are the top num_children finished nodes, replacing them on the stack
+static int add_node(Parser *parser, ASTNodeType type, int token, uint32_t num_children)
+{
+    AST *ast = parser->ast;
+
+    if ((ast->node_count == ast->node_capacity &&
+         !grow_ast_array(ast->arena, (void **)&ast->nodes, &ast->node_capacity, ast->node_count + 1, sizeof(ASTNode))) ||
+        (ast->child_count + num_children > ast->child_capacity &&
+         !grow_ast_array(ast->arena, (void **)&ast->children, &ast->child_capacity, ast->child_count + num_children, sizeof(uint32_t))))
+    {
+        parser->out_of_memory = 1;
+        add_new_error(parser->error_list, 0, 0, PARSER, "Failed to allocate AST node");
+        return 0;
+    }
+
+    // A range's AST has no child array until its first node with children
+    parser->stack_size -= num_children;
+    if (num_children)
+    {
+        memcpy(ast->children + ast->child_count, parser->stack + parser->stack_size, num_children * sizeof(uint32_t));
+    }
+
+    uint32_t index = ast->node_count++;
+    ASTNode *node = &ast->nodes[index];
+    node->type = (uint8_t)type;
+    node->token = token;
+    node->first_child = ast->child_count;
+    node->num_children = num_children;
+    ast->child_count += num_children;
+
+    return push_node(parser, index);
+}
+
+static ParserMark mark_parser(Parser *parser)
+{
+    ParserMark mark = {parser->ast->node_count, parser->ast->child_count, parser->stack_size};
+    return mark;
+}
+
+// Drop every node created since mark, they all belong to the construct that failed
+static void rewind_parser(Parser *parser, ParserMark mark)
+{
+    parser->ast->node_count = mark.node_count;
+    parser->ast->child_count = mark.child_count;
+    parser->stack_size = mark.stack_size;
+}
+
+// Pull tokens from the feed until index is in the stream. A feed that ends
+// without reaching it abandons the parse, which then only sees EOF.
+static int fill_tokens(Parser *parser, int index)
+{
+    while (index >= parser->token_stream->size)
+    {
+        if (!parser->feed || parser->feed_failed || !parser->feed(parser->feed_state, parser->token_stream))
+        {
+            parser->feed_failed = 1;
+            return 0;
+        }
+    }
+
+    // Appending may have moved the arrays
+    parser->types = parser->token_stream->types;
+    parser->available = parser->token_stream->size;
+    return 1;
+}
+
+static inline TokenType token_type_at(Parser *parser, int index)
 {
-    Token *current_token = getNextToken(token_stream, current_index);
-    if (!current_token || current_token->type != expected_type)
+    if (index >= parser->available && !fill_tokens(parser, index))
+    {
+        return TOKEN_EOF;
+    }
+    return (TokenType)parser->types[index];
+}
+
+static inline TokenType peek(Parser *parser)
+{
+    return token_type_at(parser, parser->current);
+}
+
+// Consume the lookahead token and return its index, EOF is never consumed
+static inline int advance(Parser *parser)
+{
+    int index = parser->current;
+    if (token_type_at(parser, index) != TOKEN_EOF)
+    {
+        parser->current++;
+    }
+    return index;
+}
+
+static void report_unexpected_token(Parser *parser, const char *expected)
+{
+    TokenStream *token_stream = parser->token_stream;
+    int index = parser->current;
+    int lexeme_length;
+    if (parser->feed_failed)
+    {
+        // Past the end of what the lexer produced, the caller reports the lexer's errors instead
+        return;
+    }
+
+    const char *lexeme = get_token_lexeme(token_stream, index, &lexeme_length);
+
+    // Only the lexeme is copied, the message is formatted if it is ever reported
+    add_unexpected_token_error(parser->error_list, token_stream->lines[index], token_stream->columns[index], lexeme,
+                               lexeme_length > MAX_QUOTED_LEXEME ? MAX_QUOTED_LEXEME : lexeme_length,
+                               token_type_to_string(token_stream->types[index]), expected);
+}
+
+// Consume a token of the expected type and return its index, or report it and return -1
+static int match(Parser *parser, TokenType expected_type, const char *expected)
+{
+    if (peek(parser) != expected_type)
+    {
+        report_unexpected_token(parser, expected);
+        return -1;
+    }
+    return advance(parser);
+}
+
+// Skip the rest of a broken statement: up to and including its ';', or up to the '}'
+// closing the enclosing block. A block opened while skipping is skipped whole.
+static void synchronize_statement(Parser *parser)
+{
+    int depth = 0;
+
+    for (;;)
+    {
+        switch (peek(parser))
+        {
+        case TOKEN_EOF:
+            return;
+        case TOKEN_SEMICOLON:
+            advance(parser);
+            if (depth == 0)
+            {
+                return;
+            }
+            break;
+        case TOKEN_LBRACE:
+            advance(parser);
+            depth++;
+            break;
+        case TOKEN_RBRACE:
+            if (depth == 0)
+            {
+                return;
+            }
+            advance(parser);
+            if (--depth == 0)
+            {
+                return;
+            }
+            break;
+        default:
+            advance(parser);
+            break;
+        }
+    }
+}
+
+// Skip the rest of a broken function, up to the next type keyword outside any braces
+static void synchronize_function(Parser *parser)
+{
+    int depth = 0;
+
+    advance(parser);
+    while (peek(parser) != TOKEN_EOF)
+    {
+        TokenType type = peek(parser);
+        if (depth == 0 && (type == TOKEN_INT || type == TOKEN_BOOL))
+        {
+            return;
+        }
+        if (type == TOKEN_LBRACE)
+        {
+            depth++;
+        }
+        else if (type == TOKEN_RBRACE && depth > 0)
+        {
+            depth--;
+        }
+        advance(parser);
+    }
+}
+
+static int parse_binary_expression(Parser *parser, int min_binding_power);
+static int parse_statement_list(Parser *parser);
+
+// expression -> logical_expression, parsed by binding power rather than one function per level
+static inline int parse_expression(Parser *parser)
+{
+    return parse_binary_expression(parser, 0);
+}
+
+// Operands that nothing nests inside: identifier | NUMBER | true | false | READ_PIN ( GPIO_PIN )
+static int parse_leaf(Parser *parser)
+{
+    int token = parser->current;
+
+    switch (peek(parser))
+    {
+    case TOKEN_IDENTIFIER:
+        advance(parser);
+        return add_node(parser, IDENTIFIER, token, 0);
+    case TOKEN_NUMBER:
+        advance(parser);
+        return add_node(parser, NUMBER_LITERAL, token, 0);
+    case TOKEN_TRUE:
+    case TOKEN_FALSE:
+        advance(parser);
+        return add_node(parser, BOOL_VALUE, token, 0);
+    case TOKEN_READ_PIN:
+    {
+        advance(parser);
+        int pin;
+        if (match(parser, TOKEN_LPAREN, "'('") < 0 ||
+            (pin = match(parser, TOKEN_NUMBER, "a pin number")) < 0 ||
+            !add_node(parser, GPIO_PIN, pin, 0) ||
+            match(parser, TOKEN_RPAREN, "')'") < 0)
+        {
+            return 0;
+        }
+        return add_node(parser, GPIO_OPERATION, token, 1);
+    }
+    default:
+        report_unexpected_token(parser, "an expression");
+        return 0;
+    }
+}
+
+// prefix -> ! prefix | - prefix | ( expression ) | identifier ( arguments ) | leaf
+static int parse_prefix(Parser *parser)
+{
+    int token = parser->current;
+
+    switch (peek(parser))
     {
-        char message[256];
-        snprintf(message, sizeof(message),
-                    "Unexpected token '%s' of type '%s'.",
-                    current_token ? current_token->lexeme : "NULL",
-                    current_token ? token_type_to_string(current_token->type) : "UNKNOWN");
+    case TOKEN_NOT:
+    case TOKEN_MINUS:
+        advance(parser);
+        return parse_binary_expression(parser, UNARY_BINDING_POWER) &&
+               add_node(parser, UNARY_EXPRESSION, token, 1);
+    case TOKEN_LPAREN:
+        advance(parser);
+        return parse_expression(parser) && match(parser, TOKEN_RPAREN, "')'") >= 0;
+    case TOKEN_IDENTIFIER:
+        if (token_type_at(parser, token + 1) == TOKEN_LPAREN)
+        {
+            advance(parser);
+            advance(parser);
 
-        add_new_error(error_list, current_token ? current_token->line : -1,
-                        current_token ? current_token->column : -1,
-                        PARSER, message);
+            uint32_t num_arguments = 0;
+            if (peek(parser) != TOKEN_RPAREN)
+            {
+                do
+                {
+                    if (!parse_expression(parser))
+                    {
+                        return 0;
+                    }
+                    num_arguments++;
+                } while (peek(parser) == TOKEN_COMMA && advance(parser) >= 0);
+            }
+            return match(parser, TOKEN_RPAREN, "')'") >= 0 &&
+                   add_node(parser, CALL_EXPRESSION, token, num_arguments);
+        }
+        return parse_leaf(parser);
+    default:
+        return parse_leaf(parser);
     }
 }
 
-ASTNode *parse_token_stream(TokenStream *token_stream, ErrorList *error_list) {
-    if (!token_stream || token_stream->size == 0) {
+static int push_frame(Parser *parser, ExpressionFrameKind kind, int token, int binding_power)
+{
+    if (parser->frame_count == parser->frame_capacity)
+    {
+        uint32_t new_capacity = parser->frame_capacity ? parser->frame_capacity * 2 : DEFAULT_PARSER_STACK_CAPACITY;
+        ExpressionFrame *temp_frames = realloc(parser->frames, new_capacity * sizeof(ExpressionFrame));
+        if (!temp_frames)
+        {
+            parser->out_of_memory = 1;
+            add_new_error(parser->error_list, 0, 0, PARSER, "Failed to grow expression stack");
+            return 0;
+        }
+        parser->frames = temp_frames;
+        parser->frame_capacity = new_capacity;
+    }
+
+    ExpressionFrame *frame = &parser->frames[parser->frame_count++];
+    frame->kind = (uint8_t)kind;
+    frame->binding_power = (uint8_t)binding_power;
+    frame->token = token;
+    frame->num_arguments = 0;
+    return 1;
+}
+
+// The same grammar as parse_binary_expression without recursion: pending prefix
+// operators, binary operators, groups and calls wait on the frame stack above base
+// while their operands are parsed, so nesting depth only costs heap memory.
+static int parse_expression_with_stack(Parser *parser, uint32_t base, int min_binding_power)
+{
+    for (;;)
+    {
+        // Operand position: open prefix operators, groups and calls until an operand completes
+        int token = parser->current;
+        switch (peek(parser))
+        {
+        case TOKEN_NOT:
+        case TOKEN_MINUS:
+            if (!push_frame(parser, FRAME_UNARY, advance(parser), UNARY_BINDING_POWER))
+            {
+                return 0;
+            }
+            continue;
+        case TOKEN_LPAREN:
+            if (!push_frame(parser, FRAME_GROUP, advance(parser), 0))
+            {
+                return 0;
+            }
+            continue;
+        case TOKEN_IDENTIFIER:
+            if (token_type_at(parser, token + 1) == TOKEN_LPAREN)
+            {
+                advance(parser);
+                advance(parser);
+                if (peek(parser) != TOKEN_RPAREN)
+                {
+                    if (!push_frame(parser, FRAME_CALL, token, 0))
+                    {
+                        return 0;
+                    }
+                    continue;
+                }
+                advance(parser);
+                if (!add_node(parser, CALL_EXPRESSION, token, 0))
+                {
+                    return 0;
+                }
+                break;
+            }
+            if (!parse_leaf(parser))
+            {
+                return 0;
+            }
+            break;
+        default:
+            if (!parse_leaf(parser))
+            {
+                return 0;
+            }
+            break;
+        }
+
+        // Operator position: close whatever the next token ends, until an operator needs a right operand
+        for (;;)
+        {
+            int binding_power = binary_binding_powers[peek(parser)];
+
+            // Every pending operator that binds at least as tightly as the next one is complete
+            while (parser->frame_count > base)
+            {
+                ExpressionFrame frame = parser->frames[parser->frame_count - 1];
+                if (frame.kind == FRAME_UNARY)
+                {
+                    parser->frame_count--;
+                    if (!add_node(parser, UNARY_EXPRESSION, frame.token, 1))
+                    {
+                        return 0;
+                    }
+                }
+                else if (frame.kind == FRAME_BINARY && frame.binding_power >= binding_power)
+                {
+                    parser->frame_count--;
+                    if (!add_node(parser, BINARY_EXPRESSION, frame.token, 2))
+                    {
+                        return 0;
+                    }
+                }
+                else
+                {
+                    break;
+                }
+            }
+
+            if (binding_power > 0 && (parser->frame_count > base || binding_power > min_binding_power))
+            {
+                if (!push_frame(parser, FRAME_BINARY, advance(parser), binding_power))
+                {
+                    return 0;
+                }
+                break;
+            }
+
+            if (parser->frame_count == base)
+            {
+                return 1;
+            }
+
+            ExpressionFrame *frame = &parser->frames[parser->frame_count - 1];
+            if (frame->kind == FRAME_GROUP)
+            {
+                if (match(parser, TOKEN_RPAREN, "')'") < 0)
+                {
+                    return 0;
+                }
+                parser->frame_count--;
+                continue;
+            }
+
+            // The innermost frame is a call and one more argument is complete
+            frame->num_arguments++;
+            if (peek(parser) == TOKEN_COMMA)
+            {
+                advance(parser);
+                break;
+            }
+            if (match(parser, TOKEN_RPAREN, "')'") < 0)
+            {
+                return 0;
+            }
+            parser->frame_count--;
+            if (!add_node(parser, CALL_EXPRESSION, frame->token, frame->num_arguments))
+            {
+                return 0;
+            }
+        }
+    }
+}
+
+// Pratt parser: a prefix operand, then every binary operator binding tighter than
+// min_binding_power together with its right operand. Past the recursion limit the
+// rest of the expression is parsed on an explicit stack instead of the call stack.
+static int parse_binary_expression(Parser *parser, int min_binding_power)
+{
+    if (parser->depth >= parser->recursion_limit)
+    {
+        uint32_t base = parser->frame_count;
+        int parsed = parse_expression_with_stack(parser, base, min_binding_power);
+        parser->frame_count = base;
+        return parsed;
+    }
+
+    parser->depth++;
+    int parsed = parse_prefix(parser);
+
+    int binding_power;
+    while (parsed && (binding_power = binary_binding_powers[peek(parser)]) > min_binding_power)
+    {
+        int operator_token = advance(parser);
+        parsed = parse_binary_expression(parser, binding_power) &&
+                 add_node(parser, BINARY_EXPRESSION, operator_token, 2);
+    }
+
+    parser->depth--;
+    return parsed;
+}
+
+// type identifier ; | type identifier = expression ;
+static int parse_variable(Parser *parser)
+{
+    advance(parser);
+    int name = match(parser, TOKEN_IDENTIFIER, "an identifier");
+    if (name < 0)
+    {
+        return 0;
+    }
+
+    if (peek(parser) != TOKEN_ASSIGN)
+    {
+        return match(parser, TOKEN_SEMICOLON, "';' or '='") >= 0 &&
+               add_node(parser, IDENTIFIER_DECLARATION, name, 0);
+    }
+
+    advance(parser);
+    return parse_expression(parser) &&
+           match(parser, TOKEN_SEMICOLON, "';'") >= 0 &&
+           add_node(parser, IDENTIFIER_DEFINITION, name, 1);
+}
+
+// if ( expression ) { statementList } [ else { statementList } ]
+static int parse_conditional(Parser *parser)
+{
+    int token = advance(parser);
+
+    if (match(parser, TOKEN_LPAREN, "'('") < 0 || !parse_expression(parser) ||
+        match(parser, TOKEN_RPAREN, "')'") < 0 || !parse_statement_list(parser))
+    {
+        return 0;
+    }
+
+    if (peek(parser) != TOKEN_ELSE)
+    {
+        return add_node(parser, CONDITIONAL, token, 2);
+    }
+
+    advance(parser);
+    return parse_statement_list(parser) && add_node(parser, CONDITIONAL, token, 3);
+}
+
+// while ( expression ) { statementList }
+static int parse_while_loop(Parser *parser)
+{
+    int token = advance(parser);
+
+    return match(parser, TOKEN_LPAREN, "'('") >= 0 && parse_expression(parser) &&
+           match(parser, TOKEN_RPAREN, "')'") >= 0 && parse_statement_list(parser) &&
+           add_node(parser, WHILE_LOOP, token, 2);
+}
+
+// SET_PIN ( GPIO_PIN , GPIO_values ) ;
+static int parse_set_pin(Parser *parser)
+{
+    int token = advance(parser);
+    int pin;
+
+    if (match(parser, TOKEN_LPAREN, "'('") < 0 ||
+        (pin = match(parser, TOKEN_NUMBER, "a pin number")) < 0 ||
+        !add_node(parser, GPIO_PIN, pin, 0) ||
+        match(parser, TOKEN_COMMA, "','") < 0)
+    {
+        return 0;
+    }
+
+    if (peek(parser) != TOKEN_HIGH && peek(parser) != TOKEN_LOW)
+    {
+        report_unexpected_token(parser, "HIGH or LOW");
+        return 0;
+    }
+
+    return add_node(parser, GPIO_VALUES, advance(parser), 0) &&
+           match(parser, TOKEN_RPAREN, "')'") >= 0 &&
+           match(parser, TOKEN_SEMICOLON, "';'") >= 0 &&
+           add_node(parser, GPIO_OPERATION, token, 2);
+}
+
+static int parse_statement(Parser *parser)
+{
+    int token = parser->current;
+
+    switch (peek(parser))
+    {
+    case TOKEN_INT:
+    case TOKEN_BOOL:
+        return parse_variable(parser);
+    case TOKEN_IF:
+        return parse_conditional(parser);
+    case TOKEN_WHILE:
+        return parse_while_loop(parser);
+    case TOKEN_SET_PIN:
+        return parse_set_pin(parser);
+    case TOKEN_RETURN:
+        advance(parser);
+        return parse_expression(parser) &&
+               match(parser, TOKEN_SEMICOLON, "';'") >= 0 &&
+               add_node(parser, RETURN_STATEMENT, token, 1);
+    case TOKEN_IDENTIFIER:
+        // The token after an identifier is at worst EOF, so this never reads past the stream
+        if (token_type_at(parser, token + 1) == TOKEN_ASSIGN)
+        {
+            advance(parser);
+            advance(parser);
+            return parse_expression(parser) &&
+                   match(parser, TOKEN_SEMICOLON, "';'") >= 0 &&
+                   add_node(parser, ASSIGNMENT, token, 1);
+        }
+        // fall through
+    default:
+        return parse_expression(parser) &&
+               match(parser, TOKEN_SEMICOLON, "';'") >= 0 &&
+               add_node(parser, EXPRESSION_STATEMENT, token, 1);
+    }
+}
+
+// { statementList }, a statement that fails to parse is reported, dropped and skipped
+static int parse_statement_list(Parser *parser)
+{
+    int token = match(parser, TOKEN_LBRACE, "'{'");
+    if (token < 0)
+    {
+        return 0;
+    }
+
+    uint32_t first = parser->stack_size;
+    while (peek(parser) != TOKEN_RBRACE && peek(parser) != TOKEN_EOF)
+    {
+        ParserMark mark = mark_parser(parser);
+        if (!parse_statement(parser))
+        {
+            if (parser->out_of_memory)
+            {
+                return 0;
+            }
+            rewind_parser(parser, mark);
+            synchronize_statement(parser);
+        }
+    }
+
+    return match(parser, TOKEN_RBRACE, "'}'") >= 0 &&
+           add_node(parser, STATEMENT_LIST, token, parser->stack_size - first);
+}
+
+// type identifier ( function_parameters ) { statementList }
+static int parse_function(Parser *parser)
+{
+    if (peek(parser) != TOKEN_INT && peek(parser) != TOKEN_BOOL)
+    {
+        report_unexpected_token(parser, "a function return type");
+        return 0;
+    }
+    advance(parser);
+
+    int name = match(parser, TOKEN_IDENTIFIER, "a function name");
+    int parameters = name < 0 ? -1 : match(parser, TOKEN_LPAREN, "'('");
+    if (parameters < 0)
+    {
+        return 0;
+    }
+
+    uint32_t first = parser->stack_size;
+    if (peek(parser) != TOKEN_RPAREN)
+    {
+        do
+        {
+            if (peek(parser) != TOKEN_INT && peek(parser) != TOKEN_BOOL)
+            {
+                report_unexpected_token(parser, "a parameter type");
+                return 0;
+            }
+            advance(parser);
+
+            int parameter = match(parser, TOKEN_IDENTIFIER, "a parameter name");
+            if (parameter < 0 || !add_node(parser, IDENTIFIER_DECLARATION, parameter, 0))
+            {
+                return 0;
+            }
+        } while (peek(parser) == TOKEN_COMMA && advance(parser) >= 0);
+    }
+
+    return match(parser, TOKEN_RPAREN, "')'") >= 0 &&
+           add_node(parser, FUNCTION_PARAMETERS, parameters, parser->stack_size - first) &&
+           parse_statement_list(parser) &&
+           add_node(parser, FUNCTION, name, 2);
+}
+
+// Note where the next top-level attempt starts, or that the last one has ended
+static int add_segment(Parser *parser)
+{
+    AST *ast = parser->ast;
+    if (ast->segment_count == ast->segment_capacity &&
+        !grow_ast_array(ast->arena, (void **)&ast->segments, &ast->segment_capacity, ast->segment_count + 1, sizeof(ParseSegment)))
+    {
+        parser->out_of_memory = 1;
+        add_new_error(parser->error_list, 0, 0, PARSER, "Failed to allocate AST node");
+        return 0;
+    }
+
+    ParseSegment *segment = &ast->segments[ast->segment_count++];
+    segment->token = parser->current;
+    segment->node = ast->node_count;
+    segment->child = ast->child_count;
+    segment->error = parser->error_list ? parser->error_list->size - parser->error_base : 0;
+    return 1;
+}
+
+// Parse one function, or report it and skip to where the next one may start
+static int parse_next_function(Parser *parser)
+{
+    if (!add_segment(parser))
+    {
+        return 0;
+    }
+
+    ParserMark mark = mark_parser(parser);
+    if (!parse_function(parser))
+    {
+        if (parser->out_of_memory)
+        {
+            return 0;
+        }
+        rewind_parser(parser, mark);
+        synchronize_function(parser);
+    }
+    return 1;
+}
+
+// function_list -> function function_list | ε
+static int parse_function_list(Parser *parser)
+{
+    while (peek(parser) != TOKEN_EOF)
+    {
+        if (error_limit_reached(parser->error_list) || !parse_next_function(parser))
+        {
+            return 0;
+        }
+    }
+
+    return add_segment(parser) && add_node(parser, FUNCTION_LIST, 0, parser->stack_size);
+}
+
+static int init_parser(Parser *parser, AST *ast, ErrorList *error_list)
+{
+    memset(parser, 0, sizeof(Parser));
+    parser->token_stream = ast->token_stream;
+    parser->types = ast->token_stream->types;
+    parser->error_list = error_list;
+    parser->ast = ast;
+    parser->stack_capacity = DEFAULT_PARSER_STACK_CAPACITY;
+    parser->recursion_limit = DEFAULT_PARSER_RECURSION_LIMIT;
+    parser->error_base = error_list ? error_list->size : 0;
+    parser->available = parser->token_stream->size;
+    parser->stack = malloc(parser->stack_capacity * sizeof(uint32_t));
+
+    const char *recursion_limit = getenv("DSL_PARSER_RECURSION_LIMIT");
+    if (recursion_limit && *recursion_limit)
+    {
+        parser->recursion_limit = atoi(recursion_limit);
+    }
+
+    return parser->stack != NULL;
+}
+
+static void free_parser(Parser *parser)
+{
+    free(parser->stack);
+    free(parser->frames);
+}
+
+// Parse the stream, pulling its tokens from feed as they are needed if there is one
+static AST *parse_tokens(TokenStream *token_stream, int expected_tokens, TokenFeed feed, void *feed_state,
+                         ErrorList *error_list)
+{
+    Arena *arena = token_stream->arena;
+    AST *ast = arena_calloc(arena, 1, sizeof(AST));
+    if (!ast)
+    {
+        add_new_error(error_list, 0, 0, PARSER, "Failed to allocate AST");
+        return NULL;
+    }
+    ast->arena = arena;
+    ast->token_stream = token_stream;
+    ast->root = AST_NO_NODE;
+
+    // Programs run at about one node for every two tokens, reserving that up front avoids most regrowth
+    Parser parser;
+    uint32_t expected_nodes = expected_tokens / 2 + 16;
+    if (!init_parser(&parser, ast, error_list) ||
+        !grow_ast_array(arena, (void **)&ast->nodes, &ast->node_capacity, expected_nodes, sizeof(ASTNode)) ||
+        !grow_ast_array(arena, (void **)&ast->children, &ast->child_capacity, expected_nodes, sizeof(uint32_t)))
+    {
+        add_new_error(error_list, 0, 0, PARSER, "Failed to allocate AST");
+        free_parser(&parser);
+        free_ast(ast);
+        return NULL;
+    }
+
+    parser.feed = feed;
+    parser.feed_state = feed_state;
+    if (!parse_function_list(&parser) || parser.feed_failed)
+    {
+        free_parser(&parser);
+        free_ast(ast);
+        return NULL;
+    }
+
+    ast->root = parser.stack[0];
+    free_parser(&parser);
+    return ast;
+}
+
+AST *parse_token_stream(TokenStream *token_stream, ErrorList *error_list)
+{
+    if (!token_stream || token_stream->size == 0 || token_stream->types[token_stream->size - 1] != TOKEN_EOF)
+    {
+        add_new_error(error_list, 0, 0, PARSER, "Invalid token stream passed");
+        return NULL;
+    }
+
+    return parse_tokens(token_stream, token_stream->size, NULL, NULL, error_list);
+}
+
+AST *parse_token_feed(TokenStream *token_stream, int expected_tokens, TokenFeed feed, void *feed_state,
+                      ErrorList *error_list)
+{
+    if (!token_stream || !feed)
+    {
+        add_new_error(error_list, 0, 0, PARSER, "Invalid token stream passed");
+        return NULL;
+    }
+
+    return parse_tokens(token_stream, expected_tokens, feed, feed_state, error_list);
+}
+
+// Top-level attempts parsed on their own for parse_token_stream_parallel, from a
+// token the pre-scan expects one to start at up to the first one at or past stop
+typedef struct
+{
+    AST ast;              // Heap-owned nodes, children and segments, numbered from 0
+    ErrorList *errors;    // Errors of the range, segment errors count from 0
+    uint32_t *functions;  // Function nodes in order
+    uint32_t function_count;
+    int start;
+    int stop;
+    int end;              // Token the attempt after the last one parsed starts at
+    int failed;           // Memory ran out
+    pthread_t thread;
+    int started;
+} ParseRange;
+
+static void *parse_range(void *argument)
+{
+    ParseRange *range = argument;
+    Parser parser;
+    if (!init_parser(&parser, &range->ast, range->errors))
+    {
+        free_parser(&parser);
+        range->failed = 1;
+        return NULL;
+    }
+
+    // The loop of parse_function_list, ending at stop instead of EOF
+    parser.current = range->start;
+    while (parser.current < range->stop && peek(&parser) != TOKEN_EOF && !error_limit_reached(range->errors))
+    {
+        if (!parse_next_function(&parser))
+        {
+            range->failed = 1;
+            break;
+        }
+    }
+    range->end = parser.current;
+
+    // The stack holds nothing but the range's functions
+    range->functions = parser.stack;
+    range->function_count = parser.stack_size;
+    parser.stack = NULL;
+    free_parser(&parser);
+    return NULL;
+}
+
+static int init_parse_range(ParseRange *range, TokenStream *token_stream, int start, int stop, int max_errors)
+{
+    memset(range, 0, sizeof(ParseRange));
+    range->ast.token_stream = token_stream;
+    range->ast.root = AST_NO_NODE;
+    range->start = start;
+    range->stop = stop;
+    range->errors = create_new_error_list(NULL);
+    if (range->errors)
+    {
+        range->errors->max_errors = max_errors;
+    }
+    return range->errors != NULL;
+}
+
+static void free_parse_range(ParseRange *range)
+{
+    free(range->ast.nodes);
+    free(range->ast.children);
+    free(range->ast.segments);
+    free(range->functions);
+    free_error_list(range->errors);
+}
+
+// Cut the stream into up to range_count ranges of about equal size at the starts of
+// top-level functions: an int or bool keyword right after a '}' that closes every
+// open brace. Returns the number of ranges, or 0 if the braces do not balance.
+static int find_parse_ranges(TokenStream *token_stream, int *starts, int range_count)
+{
+    const uint8_t *types = token_stream->types;
+    int size = token_stream->size;
+    int target = size / range_count;
+    int count = 1, depth = 0;
+    starts[0] = 0;
+
+    for (int i = 0; i < size; i++)
+    {
+        switch (types[i])
+        {
+        case TOKEN_LBRACE:
+            depth++;
+            break;
+        case TOKEN_RBRACE:
+            if (--depth < 0)
+            {
+                return 0;
+            }
+            break;
+        case TOKEN_INT:
+        case TOKEN_BOOL:
+            if (depth == 0 && i > 0 && types[i - 1] == TOKEN_RBRACE && i >= target * count && count < range_count)
+            {
+                starts[count++] = i;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    return depth == 0 ? count : 0;
+}
+
+// Move one range's attempts, with its errors, behind those already joined into ast.
+// Returns 0 where parse_function_list would have stopped at the error limit.
+static int join_parse_range(AST *ast, ParseRange *range, ErrorList *error_list, int error_base)
+{
+    AST *from = &range->ast;
+    uint32_t node_delta = ast->node_count, child_delta = ast->child_count;
+    if (!grow_ast_array(ast->arena, (void **)&ast->nodes, &ast->node_capacity, ast->node_count + from->node_count,
+                        sizeof(ASTNode)) ||
+        !grow_ast_array(ast->arena, (void **)&ast->children, &ast->child_capacity,
+                        ast->child_count + from->child_count, sizeof(uint32_t)) ||
+        !grow_ast_array(ast->arena, (void **)&ast->segments, &ast->segment_capacity,
+                        ast->segment_count + from->segment_count, sizeof(ParseSegment)))
+    {
+        add_new_error(error_list, 0, 0, PARSER, "Failed to allocate AST node");
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < from->segment_count; i++)
+    {
+        if (error_limit_reached(error_list))
+        {
+            return 0;
+        }
+
+        ParseSegment segment = from->segments[i];
+        uint32_t error_end = i + 1 < from->segment_count ? from->segments[i + 1].error : (uint32_t)range->errors->size;
+        segment.node += node_delta;
+        segment.child += child_delta;
+        segment.error = error_list ? error_list->size - error_base : 0;
+        ast->segments[ast->segment_count++] = segment;
+
+        for (uint32_t e = from->segments[i].error; e < error_end; e++)
+        {
+            Error *error = &range->errors->errors[e];
+            copy_error(error_list, range->errors, e, error->line, error->column);
+        }
+    }
+
+    // What the range dropped past its limit would have been dropped here too
+    if (error_list)
+    {
+        error_list->dropped += range->errors->dropped;
+    }
+
+    for (uint32_t i = 0; i < from->node_count; i++)
+    {
+        ASTNode node = from->nodes[i];
+        node.first_child += child_delta;
+        ast->nodes[ast->node_count++] = node;
+    }
+    for (uint32_t i = 0; i < from->child_count; i++)
+    {
+        ast->children[ast->child_count++] = from->children[i] + node_delta;
+    }
+    for (uint32_t i = 0; i < range->function_count; i++)
+    {
+        range->functions[i] += node_delta;
+    }
+    return 1;
+}
+
+// Join the ranges in order into one AST laid out as parse_tokens lays it out. A
+// range is only used if the attempts before it ended exactly where it starts,
+// from the first one that did not the rest is parsed here on its own.
+static AST *join_parse_ranges(TokenStream *token_stream, ParseRange *ranges, int range_count, ErrorList *error_list)
+{
+    Arena *arena = token_stream->arena;
+    AST *ast = arena_calloc(arena, 1, sizeof(AST));
+    if (!ast)
+    {
+        add_new_error(error_list, 0, 0, PARSER, "Failed to allocate AST");
+        return NULL;
+    }
+    ast->arena = arena;
+    ast->token_stream = token_stream;
+    ast->root = AST_NO_NODE;
+
+    int error_base = error_list ? error_list->size : 0;
+    int used = 0, end = 0;
+    while (used < range_count && token_stream->types[end] != TOKEN_EOF)
+    {
+        ParseRange *range = &ranges[used++];
+        if (range->failed || range->start != end)
+        {
+            // parse_function_list would stop here, before parsing another attempt
+            if (error_limit_reached(error_list))
+            {
+                free_ast(ast);
+                return NULL;
+            }
+
+            int max_errors = error_list && error_list->max_errors > 0 ? error_list->max_errors - error_list->size : 0;
+            free_parse_range(range);
+            if (init_parse_range(range, token_stream, end, token_stream->size, max_errors))
+            {
+                parse_range(range);
+            }
+            else
+            {
+                range->failed = 1;
+            }
+            if (range->failed)
+            {
+                add_new_error(error_list, 0, 0, PARSER, "Failed to allocate AST node");
+                free_ast(ast);
+                return NULL;
+            }
+        }
+
+        if (!join_parse_range(ast, range, error_list, error_base))
+        {
+            free_ast(ast);
+            return NULL;
+        }
+        end = range->end;
+    }
+
+    // The last range stopped at the error limit before EOF, and so would the parse have
+    if (token_stream->types[end] != TOKEN_EOF)
+    {
+        free_ast(ast);
+        return NULL;
+    }
+
+    uint32_t function_count = 0;
+    for (int i = 0; i < used; i++)
+    {
+        function_count += ranges[i].function_count;
+    }
+    if (!grow_ast_array(arena, (void **)&ast->nodes, &ast->node_capacity, ast->node_count + 1, sizeof(ASTNode)) ||
+        !grow_ast_array(arena, (void **)&ast->children, &ast->child_capacity, ast->child_count + function_count,
+                        sizeof(uint32_t)) ||
+        !grow_ast_array(arena, (void **)&ast->segments, &ast->segment_capacity, ast->segment_count + 1,
+                        sizeof(ParseSegment)))
+    {
+        add_new_error(error_list, 0, 0, PARSER, "Failed to allocate AST node");
+        free_ast(ast);
+        return NULL;
+    }
+
+    // The closing segment and the FUNCTION_LIST node, as parse_function_list adds them
+    ParseSegment *closing = &ast->segments[ast->segment_count++];
+    closing->token = end;
+    closing->node = ast->node_count;
+    closing->child = ast->child_count;
+    closing->error = error_list ? error_list->size - error_base : 0;
+
+    ast->root = ast->node_count++;
+    ASTNode *root = &ast->nodes[ast->root];
+    root->type = FUNCTION_LIST;
+    root->token = 0;
+    root->first_child = ast->child_count;
+    root->num_children = function_count;
+    // A range that kept no function may have no stack either
+    for (int i = 0; i < used; i++)
+    {
+        if (ranges[i].function_count)
+        {
+            memcpy(ast->children + ast->child_count, ranges[i].functions, ranges[i].function_count * sizeof(uint32_t));
+        }
+        ast->child_count += ranges[i].function_count;
+    }
+    return ast;
+}
+
+AST *parse_token_stream_parallel(TokenStream *token_stream, ErrorList *error_list, int thread_count)
+{
+    if (!token_stream || token_stream->size == 0 || token_stream->types[token_stream->size - 1] != TOKEN_EOF)
+    {
         add_new_error(error_list, 0, 0, PARSER, "Invalid token stream passed");
         return NULL;
     }
 
-    // TODO: Implement the rest of the function
-}
\ No newline at end of file
+    if (thread_count > token_stream->size / MIN_PARALLEL_PARSER_TOKENS)
+    {
+        thread_count = token_stream->size / MIN_PARALLEL_PARSER_TOKENS;
+    }
+    int *starts = thread_count > 1 ? malloc(thread_count * sizeof(int)) : NULL;
+    ParseRange *ranges = starts ? calloc(thread_count, sizeof(ParseRange)) : NULL;
+    int range_count = ranges ? find_parse_ranges(token_stream, starts, thread_count) : 0;
+    if (range_count < 2 || error_limit_reached(error_list))
+    {
+        free(starts);
+        free(ranges);
+        return parse_tokens(token_stream, token_stream->size, NULL, NULL, error_list);
+    }
+
+    // Each range may report as many errors as the whole parse could, the join stops where the parse would have
+    int max_errors = error_list && error_list->max_errors > 0 ? error_list->max_errors - error_list->size : 0;
+    int ready = 1;
+    for (int i = 0; i < range_count; i++)
+    {
+        ready &= init_parse_range(&ranges[i], token_stream, starts[i],
+                                  i + 1 < range_count ? starts[i + 1] : token_stream->size, max_errors);
+    }
+
+    AST *ast = NULL;
+    if (ready)
+    {
+        for (int i = 1; i < range_count; i++)
+        {
+            ranges[i].started = pthread_create(&ranges[i].thread, NULL, parse_range, &ranges[i]) == 0;
+        }
+        parse_range(&ranges[0]);
+        for (int i = 1; i < range_count; i++)
+        {
+            if (ranges[i].started)
+            {
+                pthread_join(ranges[i].thread, NULL);
+            }
+            else
+            {
+                parse_range(&ranges[i]);
+            }
+        }
+        ast = join_parse_ranges(token_stream, ranges, range_count, error_list);
+    }
+
+    for (int i = 0; i < range_count; i++)
+    {
+        free_parse_range(&ranges[i]);
+    }
+    free(ranges);
+    free(starts);
+    return ready ? ast : parse_tokens(token_stream, token_stream->size, NULL, NULL, error_list);
+}
+
+// A reparse appends the attempts it parses after the previous root. This moves them
+// in place of the attempts the edit replaced, and moves the previous attempts from
+// tail on (up to the closing segment) after them, renumbering indices on the way.
+// The first kept attempts stay; the parsed nodes and children start at region.node
+// and region.child, its segments at region_segment. Unsigned wraparound keeps every
+// index delta exact.
+static int place_reparsed_region(Parser *parser, uint32_t kept, ParseSegment resume, ParseSegment region,
+                                 uint32_t region_segment, uint32_t tail, const TokenEdit *edit, ErrorList *previous_errors)
+{
+    AST *ast = parser->ast;
+    ParseSegment *segments = ast->segments;
+    ParseSegment from = segments[tail], end = segments[region_segment - 1];
+    uint32_t new_nodes = ast->node_count - region.node, new_children = ast->child_count - region.child;
+    uint32_t new_segments = ast->segment_count - region_segment;
+    uint32_t tail_nodes = end.node - from.node, tail_children = end.child - from.child;
+    uint32_t tail_segments = region_segment - 1 - tail;
+
+    // The parsed region is only as large as the edit, set it aside while the tail moves
+    ASTNode *nodes = malloc((new_nodes + 1) * sizeof(ASTNode));
+    uint32_t *children = malloc((new_children + 1) * sizeof(uint32_t));
+    ParseSegment *parsed_segments = malloc((new_segments + 1) * sizeof(ParseSegment));
+    if (!nodes || !children || !parsed_segments)
+    {
+        free(nodes);
+        free(children);
+        free(parsed_segments);
+        parser->out_of_memory = 1;
+        add_new_error(parser->error_list, 0, 0, PARSER, "Failed to allocate AST node");
+        return 0;
+    }
+    memcpy(nodes, ast->nodes + region.node, new_nodes * sizeof(ASTNode));
+    memcpy(children, ast->children + region.child, new_children * sizeof(uint32_t));
+    memcpy(parsed_segments, segments + region_segment, new_segments * sizeof(ParseSegment));
+
+    uint32_t region_node_delta = resume.node - region.node, region_child_delta = resume.child - region.child;
+    uint32_t tail_node_delta = resume.node + new_nodes - from.node;
+    uint32_t tail_child_delta = resume.child + new_children - from.child;
+    uint32_t token_delta = (uint32_t)(edit->new_end - edit->old_end);
+
+    // Renumber the functions on the stack: the parsed ones, then the previous ones that follow
+    for (uint32_t i = 0; i < parser->stack_size; i++)
+    {
+        if (parser->stack[i] >= region.node)
+        {
+            parser->stack[i] += region_node_delta;
+        }
+    }
+    ASTNode root = ast->nodes[ast->root];
+    for (uint32_t i = 0; i < root.num_children; i++)
+    {
+        uint32_t function = ast->children[root.first_child + i];
+        if (function >= from.node && function < end.node && !push_node(parser, function + tail_node_delta))
+        {
+            free(nodes);
+            free(children);
+            free(parsed_segments);
+            return 0;
+        }
+    }
+
+    // Move the tail, which is a no-op when the edit kept every count the same
+    uint32_t error_start = parser->error_list ? parser->error_list->size - parser->error_base : 0;
+    uint32_t tail_node_start = from.node + tail_node_delta, tail_child_start = from.child + tail_child_delta;
+    memmove(ast->nodes + tail_node_start, ast->nodes + from.node, tail_nodes * sizeof(ASTNode));
+    memmove(ast->children + tail_child_start, ast->children + from.child, tail_children * sizeof(uint32_t));
+    memmove(segments + kept + new_segments, segments + tail, tail_segments * sizeof(ParseSegment));
+
+    if (token_delta != 0 || tail_child_delta != 0)
+    {
+        ASTNode *moved = ast->nodes + tail_node_start;
+        for (uint32_t i = 0; i < tail_nodes; i++)
+        {
+            moved[i].token += token_delta;
+            moved[i].first_child += tail_child_delta;
+        }
+    }
+    if (tail_node_delta != 0)
+    {
+        uint32_t *moved = ast->children + tail_child_start;
+        for (uint32_t i = 0; i < tail_children; i++)
+        {
+            moved[i] += tail_node_delta;
+        }
+    }
+    for (uint32_t i = 0; i < tail_segments; i++)
+    {
+        ParseSegment *segment = &segments[kept + new_segments + i];
+        segment->token += token_delta;
+        segment->node += tail_node_delta;
+        segment->child += tail_child_delta;
+        segment->error = error_start + (segment->error - from.error);
+    }
+
+    // Put the parsed region where the replaced attempts were
+    for (uint32_t i = 0; i < new_nodes; i++)
+    {
+        nodes[i].first_child += region_child_delta;
+        ast->nodes[resume.node + i] = nodes[i];
+    }
+    for (uint32_t i = 0; i < new_children; i++)
+    {
+        ast->children[resume.child + i] = children[i] + region_node_delta;
+    }
+    for (uint32_t i = 0; i < new_segments; i++)
+    {
+        parsed_segments[i].node += region_node_delta;
+        parsed_segments[i].child += region_child_delta;
+        segments[kept + i] = parsed_segments[i];
+    }
+
+    for (uint32_t i = from.error; i < end.error; i++)
+    {
+        int line = previous_errors->errors[i].line, column = previous_errors->errors[i].column;
+        shift_position_past_edit(edit, &line, &column);
+        copy_error(parser->error_list, previous_errors, i, line, column);
+    }
+
+    ast->node_count = resume.node + new_nodes + tail_nodes;
+    ast->child_count = resume.child + new_children + tail_children;
+    ast->segment_count = kept + new_segments + tail_segments;
+    parser->current = parser->token_stream->size - 1;
+
+    free(nodes);
+    free(children);
+    free(parsed_segments);
+    return 1;
+}
+
+int reparse_token_stream(AST *ast, const TokenEdit *edit, ErrorList *previous_errors, ErrorList *error_list)
+{
+    TokenStream *token_stream = ast ? ast->token_stream : NULL;
+    if (!token_stream || token_stream->size == 0 || token_stream->types[token_stream->size - 1] != TOKEN_EOF)
+    {
+        add_new_error(error_list, 0, 0, PARSER, "Invalid token stream passed");
+        return 0;
+    }
+
+    Parser parser;
+    if (!init_parser(&parser, ast, error_list))
+    {
+        add_new_error(error_list, 0, 0, PARSER, "Failed to allocate AST");
+        return 0;
+    }
+
+    // Nothing to keep, parse it all again
+    if (ast->root == AST_NO_NODE || ast->segment_count == 0)
+    {
+        ast->node_count = 0;
+        ast->child_count = 0;
+        ast->segment_count = 0;
+        int parsed = parse_function_list(&parser);
+        ast->root = parsed ? parser.stack[0] : AST_NO_NODE;
+        free_parser(&parser);
+        return parsed;
+    }
+
+    // Keep the attempts that, along with the token that ended them, come before the
+    // edit. The first attempt starts at token 0, so parsing resumes at or before it.
+    uint32_t kept = 0;
+    while (kept + 1 < ast->segment_count && ast->segments[kept + 1].token < (uint32_t)edit->first)
+    {
+        kept++;
+    }
+    ParseSegment resume = ast->segments[kept];
+
+    ASTNode root = ast->nodes[ast->root];
+    for (uint32_t i = 0; i < root.num_children && ast->children[root.first_child + i] < resume.node; i++)
+    {
+        if (!push_node(&parser, ast->children[root.first_child + i]))
+        {
+            free_parser(&parser);
+            return 0;
+        }
+    }
+    for (uint32_t i = 0; i < resume.error; i++)
+    {
+        copy_error(error_list, previous_errors, i, previous_errors->errors[i].line, previous_errors->errors[i].column);
+    }
+
+    // Parse after the previous root, leaving the previous attempts in place until
+    // the reparse lines up with one that starts wholly after the edit
+    uint32_t region_segment = ast->segment_count, tail = region_segment - 1;
+    ParseSegment region = {resume.token, ast->node_count, ast->child_count, resume.error};
+    uint32_t candidate = kept + 1;
+    parser.current = resume.token;
+
+    int parsed = 1;
+    while (parsed && peek(&parser) != TOKEN_EOF)
+    {
+        if (parser.current >= edit->new_end)
+        {
+            uint32_t old_token = (uint32_t)(parser.current - edit->new_end + edit->old_end);
+            while (candidate < region_segment - 1 && ast->segments[candidate].token < old_token)
+            {
+                candidate++;
+            }
+            if (candidate < region_segment - 1 && ast->segments[candidate].token == old_token)
+            {
+                tail = candidate;
+                break;
+            }
+        }
+        parsed = parse_next_function(&parser);
+    }
+
+    parsed = parsed &&
+             place_reparsed_region(&parser, kept, resume, region, region_segment, tail, edit, previous_errors) &&
+             add_segment(&parser) &&
+             add_node(&parser, FUNCTION_LIST, 0, parser.stack_size);
+    ast->root = parsed ? parser.stack[0] : AST_NO_NODE;
+
+    free_parser(&parser);
+    return parsed;
+}
+
+void free_ast(AST *ast)
+{
+    if (!ast)
+    {
+        return;
+    }
+
+    Arena *arena = ast->arena;
+    arena_free(arena, ast->nodes);
+    arena_free(arena, ast->children);
+    arena_free(arena, ast->segments);
+    arena_free(arena, ast);
+}
@@ -0,0 +1,411 @@
+#include "regalloc.h"
+#include <stdlib.h>
+
+// Uses inside more loops than this weigh the same
+#define MAX_WEIGHTED_DEPTH 6
+
+// Live range of the values of one function, by instruction position in it. A
+// value needs its location from starts[v] until ends[v], exclusive; a value
+// last used by an instruction ends there, so that instruction's own value can
+// take its place.
+typedef struct
+{
+    uint32_t *starts;
+    uint32_t *ends;
+    uint64_t *weights;
+} Intervals;
+
+static uint64_t depth_weight(uint32_t loop_depth)
+{
+    uint64_t weight = 1;
+    for (uint32_t i = 0; i < loop_depth && i < MAX_WEIGHTED_DEPTH; i++)
+    {
+        weight *= 10;
+    }
+    return weight;
+}
+
+static void extend_interval(Intervals *intervals, uint32_t value, uint32_t end)
+{
+    if (intervals->ends[value] < end)
+    {
+        intervals->ends[value] = end;
+    }
+}
+
+// A value used in block is live into it and out of every predecessor, and so on
+// back to its definition, which dominates them all. visited marks the blocks
+// already walked for this value, stack holds those still to walk.
+static void extend_to_use(IRProgram *program, IRFunction *function, Intervals *intervals, uint32_t value,
+                          uint32_t block, uint32_t *visited, uint32_t *stack)
+{
+    uint32_t first = function->first_instruction, definition_block = program->instructions[first + value].block;
+    uint32_t depth = 0;
+
+    if (block != definition_block && visited[block - function->first_block] != value)
+    {
+        visited[block - function->first_block] = value;
+        stack[depth++] = block;
+    }
+    while (depth > 0)
+    {
+        IRBlock *live_in = &program->blocks[stack[--depth]];
+        for (uint32_t p = 0; p < live_in->predecessor_count; p++)
+        {
+            uint32_t predecessor = program->predecessors[live_in->first_predecessor + p];
+            IRBlock *live_out = &program->blocks[predecessor];
+            extend_interval(intervals, value, live_out->first_instruction + live_out->instruction_count - first);
+            if (predecessor != definition_block && visited[predecessor - function->first_block] != value)
+            {
+                visited[predecessor - function->first_block] = value;
+                stack[depth++] = predecessor;
+            }
+        }
+    }
+}
+
+// Live ranges as hulls of where each value is live, walking back from each use
+// to the definition. A phi uses its operand at the end of the predecessor it
+// names. The uses are grouped by value first, so each walk marks blocks for one
+// value only. Returns 0 if memory runs out.
+static int find_intervals(IRProgram *program, IRFunction *function, Intervals *intervals)
+{
+    uint32_t count = function->instruction_count, first = function->first_instruction;
+    uint32_t *visited = malloc((function->block_count + 1) * sizeof(uint32_t));
+    uint32_t *stack = malloc((function->block_count + 1) * sizeof(uint32_t));
+    uint32_t *first_use = calloc(count + 2, sizeof(uint32_t));
+    uint32_t use_count = 0;
+    for (uint32_t i = 0; first_use && i < count; i++)
+    {
+        IRInstruction *instruction = &program->instructions[first + i];
+        int is_phi = instruction->opcode == IR_PHI;
+        for (uint32_t j = is_phi; j < instruction->operand_count; j += 1 + is_phi)
+        {
+            first_use[program->operands[instruction->first_operand + j] - first + 2]++;
+            use_count++;
+        }
+    }
+    uint32_t *use_blocks = malloc((use_count + 1) * sizeof(uint32_t));
+    uint32_t *use_ends = malloc((use_count + 1) * sizeof(uint32_t));
+    if (!visited || !stack || !first_use || !use_blocks || !use_ends)
+    {
+        free(visited);
+        free(stack);
+        free(first_use);
+        free(use_blocks);
+        free(use_ends);
+        return 0;
+    }
+
+    // The uses of value v end up at [first_use[v], first_use[v + 1])
+    for (uint32_t v = 2; v < count + 2; v++)
+    {
+        first_use[v] += first_use[v - 1];
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        IRInstruction *instruction = &program->instructions[first + i];
+        uint32_t *operands = &program->operands[instruction->first_operand];
+        int is_phi = instruction->opcode == IR_PHI;
+        for (uint32_t j = is_phi; j < instruction->operand_count; j += 1 + is_phi)
+        {
+            uint32_t use = first_use[operands[j] - first + 1]++;
+            IRBlock *block = &program->blocks[is_phi ? operands[j - 1] : instruction->block];
+            use_blocks[use] = is_phi ? operands[j - 1] : instruction->block;
+            use_ends[use] = is_phi ? block->first_instruction + block->instruction_count - first : i;
+            intervals->weights[operands[j] - first] += depth_weight(program->blocks[instruction->block].loop_depth);
+        }
+    }
+
+    for (uint32_t b = 0; b < function->block_count; b++)
+    {
+        visited[b] = IR_NO_VALUE;
+    }
+    for (uint32_t v = 0; v < count; v++)
+    {
+        IRInstruction *instruction = &program->instructions[first + v];
+        intervals->starts[v] = v;
+        intervals->ends[v] = v + 1;
+        intervals->weights[v] += depth_weight(program->blocks[instruction->block].loop_depth);
+        for (uint32_t use = first_use[v]; use < first_use[v + 1]; use++)
+        {
+            extend_interval(intervals, v, use_ends[use]);
+            extend_to_use(program, function, intervals, v, use_blocks[use], visited, stack);
+        }
+    }
+
+    free(visited);
+    free(stack);
+    free(first_use);
+    free(use_blocks);
+    free(use_ends);
+    return 1;
+}
+
+// Give the values of one function registers, then spill slots to those that got none
+static int allocate_function(IRProgram *program, IRFunction *function, RegisterAllocation *allocation,
+                             FunctionAllocation *usage)
+{
+    uint32_t count = function->instruction_count, first = function->first_instruction;
+    uint32_t register_count = allocation->register_count;
+    uint32_t *locations = &allocation->locations[first];
+    Intervals intervals;
+    intervals.starts = malloc((count + 1) * sizeof(uint32_t));
+    intervals.ends = malloc((count + 1) * sizeof(uint32_t));
+    intervals.weights = calloc(count + 1, sizeof(uint64_t));
+    uint32_t *active = malloc((count + register_count + 1) * sizeof(uint32_t));
+    uint32_t *holders = malloc((count + register_count + 1) * sizeof(uint32_t));
+    int allocated = intervals.starts && intervals.ends && intervals.weights && active && holders &&
+                    find_intervals(program, function, &intervals);
+
+    // active lists the values holding registers, holders[r] the value in register r
+    uint32_t active_count = 0;
+    for (uint32_t r = 0; allocated && r < register_count; r++)
+    {
+        holders[r] = IR_NO_VALUE;
+    }
+    for (uint32_t v = 0; allocated && v < count; v++)
+    {
+        locations[v] = REGALLOC_NO_LOCATION;
+        if (!ir_defines_value(program->instructions[first + v].opcode))
+        {
+            continue;
+        }
+
+        uint32_t kept = 0;
+        for (uint32_t a = 0; a < active_count; a++)
+        {
+            if (intervals.ends[active[a]] <= intervals.starts[v])
+            {
+                holders[locations[active[a]]] = IR_NO_VALUE;
+            }
+            else
+            {
+                active[kept++] = active[a];
+            }
+        }
+        active_count = kept;
+
+        uint32_t reg = 0;
+        while (reg < register_count && holders[reg] != IR_NO_VALUE)
+        {
+            reg++;
+        }
+
+        // With none free, the value used least often goes to memory, of those the
+        // one that would hold its register longest
+        if (reg == register_count)
+        {
+            uint32_t victim = v, victim_index = active_count;
+            for (uint32_t a = 0; a < active_count; a++)
+            {
+                uint32_t candidate = active[a];
+                if (intervals.weights[candidate] < intervals.weights[victim] ||
+                    (intervals.weights[candidate] == intervals.weights[victim] &&
+                     intervals.ends[candidate] > intervals.ends[victim]))
+                {
+                    victim = candidate;
+                    victim_index = a;
+                }
+            }
+
+            locations[victim] = REGALLOC_SPILLED;
+            usage->spilled_values++;
+            if (victim == v)
+            {
+                continue;
+            }
+            active[victim_index] = active[--active_count];
+            for (reg = 0; holders[reg] != victim; reg++)
+            {
+            }
+        }
+
+        holders[reg] = v;
+        locations[v] = reg;
+        active[active_count++] = v;
+        if (reg + 1 > usage->registers_used)
+        {
+            usage->registers_used = reg + 1;
+        }
+    }
+
+    // Spilled values share slots the same way values share registers, with as
+    // many slots as it takes
+    active_count = 0;
+    for (uint32_t v = 0; allocated && v < count; v++)
+    {
+        if (locations[v] != REGALLOC_SPILLED)
+        {
+            continue;
+        }
+
+        uint32_t kept = 0;
+        for (uint32_t a = 0; a < active_count; a++)
+        {
+            if (intervals.ends[active[a]] <= intervals.starts[v])
+            {
+                holders[locations[active[a]] & ~REGALLOC_SPILLED] = IR_NO_VALUE;
+            }
+            else
+            {
+                active[kept++] = active[a];
+            }
+        }
+        active_count = kept;
+
+        uint32_t slot = 0;
+        while (slot < usage->spill_slots && holders[slot] != IR_NO_VALUE)
+        {
+            slot++;
+        }
+        if (slot == usage->spill_slots)
+        {
+            usage->spill_slots++;
+        }
+        holders[slot] = v;
+        locations[v] = REGALLOC_SPILLED | slot;
+        active[active_count++] = v;
+    }
+
+    free(intervals.starts);
+    free(intervals.ends);
+    free(intervals.weights);
+    free(active);
+    free(holders);
+    return allocated;
+}
+
+RegisterAllocation *allocate_registers(IRProgram *program, uint32_t register_count)
+{
+    if (!program)
+    {
+        return NULL;
+    }
+
+    RegisterAllocation *allocation = calloc(1, sizeof(RegisterAllocation));
+    if (!allocation)
+    {
+        return NULL;
+    }
+
+    allocation->locations = malloc((program->instruction_count + 1) * sizeof(uint32_t));
+    allocation->functions = calloc(program->function_count + 1, sizeof(FunctionAllocation));
+    allocation->function_count = program->function_count;
+    allocation->register_count = register_count;
+    if (!allocation->locations || !allocation->functions)
+    {
+        free_register_allocation(allocation);
+        return NULL;
+    }
+
+    for (uint32_t f = 0; f < program->function_count; f++)
+    {
+        if (!allocate_function(program, &program->functions[f], allocation, &allocation->functions[f]))
+        {
+            free_register_allocation(allocation);
+            return NULL;
+        }
+    }
+
+    return allocation;
+}
+
+void free_register_allocation(RegisterAllocation *allocation)
+{
+    if (!allocation)
+    {
+        return;
+    }
+
+    free(allocation->locations);
+    free(allocation->functions);
+    free(allocation);
+}
+
+static int report_allocation_error(IRProgram *program, IRFunction *function, ErrorList *error_list,
+                                   const char *reason)
+{
+    char message[256];
+    int length;
+    const char *name = get_symbol_name(program->symbol_table, function->symbol, &length);
+    snprintf(message, sizeof(message), "Register allocation of function '%.*s': %s", length > 64 ? 64 : length, name,
+             reason);
+    add_new_error(error_list, 0, 0, CODEGEN, message);
+    return 0;
+}
+
+int verify_register_allocation(IRProgram *program, RegisterAllocation *allocation, ErrorList *error_list)
+{
+    if (!program || !allocation || allocation->function_count != program->function_count)
+    {
+        add_new_error(error_list, 0, 0, CODEGEN, "Invalid register allocation passed");
+        return 0;
+    }
+
+    char reason[128];
+    int valid = 1;
+    for (uint32_t f = 0; f < program->function_count && valid; f++)
+    {
+        IRFunction *function = &program->functions[f];
+        FunctionAllocation *usage = &allocation->functions[f];
+        uint32_t count = function->instruction_count, first = function->first_instruction;
+        uint32_t places = allocation->register_count + usage->spill_slots;
+        Intervals intervals;
+        intervals.starts = malloc((count + 1) * sizeof(uint32_t));
+        intervals.ends = malloc((count + 1) * sizeof(uint32_t));
+        intervals.weights = calloc(count + 1, sizeof(uint64_t));
+        uint32_t *last_holders = malloc((places + 1) * sizeof(uint32_t));
+        if (!intervals.starts || !intervals.ends || !intervals.weights || !last_holders ||
+            !find_intervals(program, function, &intervals))
+        {
+            add_new_error(error_list, 0, 0, CODEGEN, "Out of memory while verifying register allocation");
+            valid = 0;
+        }
+
+        // Values start in order, so each one only has to clear the last value
+        // placed where it is, which of those placed there so far ends last
+        for (uint32_t p = 0; valid && p < places; p++)
+        {
+            last_holders[p] = IR_NO_VALUE;
+        }
+        for (uint32_t v = 0; valid && v < count; v++)
+        {
+            uint32_t location = allocation->locations[first + v];
+            if (!ir_defines_value(program->instructions[first + v].opcode))
+            {
+                continue;
+            }
+
+            uint32_t place = location & REGALLOC_SPILLED ? allocation->register_count + (location & ~REGALLOC_SPILLED)
+                                                         : location;
+            if (location == REGALLOC_NO_LOCATION || place >= places ||
+                (!(location & REGALLOC_SPILLED) && location >= allocation->register_count))
+            {
+                snprintf(reason, sizeof(reason), "%%%u has no valid location", v);
+                valid = report_allocation_error(program, function, error_list, reason);
+                break;
+            }
+
+            uint32_t previous = last_holders[place];
+            if (previous != IR_NO_VALUE && intervals.ends[previous] > intervals.starts[v])
+            {
+                snprintf(reason, sizeof(reason), "%%%u and %%%u are live at once in the same %s", previous, v,
+                         location & REGALLOC_SPILLED ? "spill slot" : "register");
+                valid = report_allocation_error(program, function, error_list, reason);
+                break;
+            }
+            if (previous == IR_NO_VALUE || intervals.ends[v] > intervals.ends[previous])
+            {
+                last_holders[place] = v;
+            }
+        }
+
+        free(intervals.starts);
+        free(intervals.ends);
+        free(intervals.weights);
+        free(last_holders);
+    }
+
+    return valid;
+}
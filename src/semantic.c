@@ -0,0 +1,481 @@
+#include "semantic.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Statement nesting checked before giving up rather than overflowing the call stack
+#define MAX_SEMANTIC_DEPTH 20000
+
+// No binding, or no function, for a symbol
+#define NO_BINDING UINT32_MAX
+
+// Longest part of a name quoted in a message
+#define MAX_QUOTED_NAME_LENGTH 64
+
+// A declared variable. The bindings double as the undo log of the scopes: each
+// remembers the binding its name had before, which is put back when its block ends.
+typedef struct
+{
+    uint32_t symbol;
+    uint32_t shadowed; // Binding the name had before this one, NO_BINDING if none
+    uint8_t type;      // ValueType
+} SemanticBinding;
+
+// State of checking one AST. Names are looked up by symbol ID, which the intern
+// table hands out densely, so each lookup is a single array access.
+typedef struct
+{
+    AST *ast;
+    TokenStream *token_stream;
+    ErrorList *error_list;
+    uint32_t *innermost;        // Per symbol, its innermost binding in scope
+    uint32_t *functions;        // Per symbol, the FUNCTION node of that name
+    SemanticBinding *bindings;
+    uint32_t binding_count;
+    uint32_t binding_capacity;
+    uint32_t *scopes;           // Per open block, the binding count when it opened
+    uint32_t scope_count;
+    uint32_t scope_capacity;
+    uint8_t *node_types;        // ValueType of each expression node checked so far
+    ValueType return_type;      // Of the function being checked
+    int depth;
+    int out_of_memory;
+} SemanticChecker;
+
+const char *value_type_to_string(ValueType type)
+{
+    switch (type)
+    {
+    case TYPE_INT:
+        return "int";
+    case TYPE_BOOL:
+        return "bool";
+    case TYPE_ERROR:
+        return "error";
+    default:
+        return "none";
+    }
+}
+
+// Report an error at a token. format quotes the token's lexeme with '%.*s', then
+// may use first and second, type names mostly.
+static void report_semantic_error(SemanticChecker *checker, uint32_t token, const char *format, const char *first,
+                                  const char *second)
+{
+    int length;
+    const char *lexeme = get_token_lexeme(checker->token_stream, token, &length);
+    char message[MAX_ERROR_MESSAGE_LENGTH];
+    snprintf(message, sizeof(message), format, length > MAX_QUOTED_NAME_LENGTH ? MAX_QUOTED_NAME_LENGTH : length,
+             lexeme, first, second);
+    add_new_error(checker->error_list, checker->token_stream->lines[token], checker->token_stream->columns[token],
+                  SEMANTIC, message);
+}
+
+// Report at an argument's token that the call of callee passes it as the
+// parameter named by parameter_token although it has the wrong type
+static void report_argument_error(SemanticChecker *checker, uint32_t token, uint32_t callee, uint32_t parameter_token,
+                                  ValueType argument, ValueType parameter)
+{
+    int callee_length, parameter_length;
+    const char *callee_name = get_token_lexeme(checker->token_stream, callee, &callee_length);
+    const char *parameter_name = get_token_lexeme(checker->token_stream, parameter_token, &parameter_length);
+    char message[MAX_ERROR_MESSAGE_LENGTH];
+    snprintf(message, sizeof(message), "Call to '%.*s' passes %s as parameter '%.*s', which is %s",
+             callee_length > MAX_QUOTED_NAME_LENGTH ? MAX_QUOTED_NAME_LENGTH : callee_length, callee_name,
+             value_type_to_string(argument),
+             parameter_length > MAX_QUOTED_NAME_LENGTH ? MAX_QUOTED_NAME_LENGTH : parameter_length, parameter_name,
+             value_type_to_string(parameter));
+    add_new_error(checker->error_list, checker->token_stream->lines[token], checker->token_stream->columns[token],
+                  SEMANTIC, message);
+}
+
+// Type named by the keyword token, int or bool
+static ValueType keyword_type(SemanticChecker *checker, uint32_t token)
+{
+    switch (checker->token_stream->types[token])
+    {
+    case TOKEN_INT:
+        return TYPE_INT;
+    case TOKEN_BOOL:
+        return TYPE_BOOL;
+    default:
+        return TYPE_ERROR;
+    }
+}
+
+// Declare the variable named by token in the innermost block
+static void declare_variable(SemanticChecker *checker, uint32_t token, ValueType type)
+{
+    uint32_t symbol = checker->token_stream->symbols[token];
+    uint32_t previous = checker->innermost[symbol];
+    if (previous != NO_BINDING && previous >= checker->scopes[checker->scope_count - 1])
+    {
+        report_semantic_error(checker, token, "Variable '%.*s' is already declared in this block", NULL, NULL);
+        return;
+    }
+
+    if (checker->binding_count == checker->binding_capacity)
+    {
+        uint32_t capacity = checker->binding_capacity ? checker->binding_capacity * 2 : 64;
+        SemanticBinding *bindings = realloc(checker->bindings, capacity * sizeof(SemanticBinding));
+        if (!bindings)
+        {
+            checker->out_of_memory = 1;
+            return;
+        }
+        checker->bindings = bindings;
+        checker->binding_capacity = capacity;
+    }
+
+    checker->innermost[symbol] = checker->binding_count;
+    checker->bindings[checker->binding_count++] = (SemanticBinding){symbol, previous, type};
+}
+
+static int open_scope(SemanticChecker *checker)
+{
+    if (checker->scope_count == checker->scope_capacity)
+    {
+        uint32_t capacity = checker->scope_capacity ? checker->scope_capacity * 2 : 16;
+        uint32_t *scopes = realloc(checker->scopes, capacity * sizeof(uint32_t));
+        if (!scopes)
+        {
+            checker->out_of_memory = 1;
+            return 0;
+        }
+        checker->scopes = scopes;
+        checker->scope_capacity = capacity;
+    }
+
+    checker->scopes[checker->scope_count++] = checker->binding_count;
+    return 1;
+}
+
+// Undo the innermost block's declarations, newest first
+static void close_scope(SemanticChecker *checker)
+{
+    uint32_t start = checker->scopes[--checker->scope_count];
+    while (checker->binding_count > start)
+    {
+        SemanticBinding *binding = &checker->bindings[--checker->binding_count];
+        checker->innermost[binding->symbol] = binding->shadowed;
+    }
+}
+
+// Type of the variable named by token, reporting it if there is none
+static ValueType find_variable_type(SemanticChecker *checker, uint32_t token)
+{
+    uint32_t binding = checker->innermost[checker->token_stream->symbols[token]];
+    if (binding == NO_BINDING)
+    {
+        report_semantic_error(checker, token, "Undefined variable '%.*s'", NULL, NULL);
+        return TYPE_ERROR;
+    }
+    return checker->bindings[binding].type;
+}
+
+// Both operands of the operator at node must be of type, the operator gives result
+static ValueType check_operands(SemanticChecker *checker, ASTNode *node, ValueType left, ValueType right,
+                                ValueType type, ValueType result)
+{
+    if ((left != type && left != TYPE_ERROR) || (right != type && right != TYPE_ERROR))
+    {
+        ValueType wrong = left != type && left != TYPE_ERROR ? left : right;
+        report_semantic_error(checker, node->token, "Operator '%.*s' needs %s operands, not %s",
+                              value_type_to_string(type), value_type_to_string(wrong));
+    }
+    return result;
+}
+
+static ValueType check_binary_expression(SemanticChecker *checker, ASTNode *node, ValueType left, ValueType right)
+{
+    switch (checker->token_stream->types[node->token])
+    {
+    case TOKEN_PLUS:
+    case TOKEN_MINUS:
+    case TOKEN_STAR:
+    case TOKEN_SLASH:
+        return check_operands(checker, node, left, right, TYPE_INT, TYPE_INT);
+    case TOKEN_LT:
+    case TOKEN_GT:
+    case TOKEN_LTE:
+    case TOKEN_GTE:
+        return check_operands(checker, node, left, right, TYPE_INT, TYPE_BOOL);
+    case TOKEN_AND:
+    case TOKEN_OR:
+        return check_operands(checker, node, left, right, TYPE_BOOL, TYPE_BOOL);
+    case TOKEN_EQ:
+    case TOKEN_NEQ:
+        if (left != right && left != TYPE_ERROR && right != TYPE_ERROR)
+        {
+            report_semantic_error(checker, node->token, "Operator '%.*s' compares %s with %s",
+                                  value_type_to_string(left), value_type_to_string(right));
+        }
+        return TYPE_BOOL;
+    default:
+        return TYPE_ERROR;
+    }
+}
+
+static ValueType check_call(SemanticChecker *checker, uint32_t index)
+{
+    AST *ast = checker->ast;
+    ASTNode *node = get_ast_node(ast, index);
+    uint32_t function = checker->functions[checker->token_stream->symbols[node->token]];
+    if (function == NO_BINDING)
+    {
+        report_semantic_error(checker, node->token, "Call to undefined function '%.*s'", NULL, NULL);
+        return TYPE_ERROR;
+    }
+
+    ASTNode *definition = get_ast_node(ast, function);
+    uint32_t parameters = get_ast_child(ast, function, 0);
+    uint32_t parameter_count = get_ast_node(ast, parameters)->num_children;
+    if (node->num_children != parameter_count)
+    {
+        report_semantic_error(checker, node->token, "Wrong number of arguments in call to '%.*s'", NULL, NULL);
+    }
+    else
+    {
+        for (uint32_t i = 0; i < parameter_count; i++)
+        {
+            uint32_t argument_node = get_ast_child(ast, index, i);
+            ValueType argument = checker->node_types[argument_node];
+            uint32_t name = get_ast_node(ast, get_ast_child(ast, parameters, i))->token;
+            ValueType parameter = keyword_type(checker, name - 1);
+            if (argument != parameter && argument != TYPE_ERROR)
+            {
+                report_argument_error(checker, get_ast_node(ast, argument_node)->token, node->token, name,
+                                      argument, parameter);
+            }
+        }
+    }
+    return keyword_type(checker, definition->token - 1);
+}
+
+// Type of the expression at index. Nodes are stored after their children and a
+// subtree occupies a contiguous run ending at its root, so the run is typed in
+// order without recursing, however deeply the expression nests.
+static ValueType check_expression(SemanticChecker *checker, uint32_t index)
+{
+    AST *ast = checker->ast;
+    uint32_t first = index;
+    while (get_ast_node(ast, first)->num_children > 0)
+    {
+        first = get_ast_child(ast, first, 0);
+    }
+
+    for (uint32_t i = first; i <= index; i++)
+    {
+        ASTNode *node = get_ast_node(ast, i);
+        ValueType type = TYPE_NONE;
+        switch (node->type)
+        {
+        case IDENTIFIER:
+            type = find_variable_type(checker, node->token);
+            break;
+        case NUMBER_LITERAL:
+            type = TYPE_INT;
+            break;
+        case BOOL_VALUE:
+        case GPIO_OPERATION: // READ_PIN, SET_PIN is a statement
+            type = TYPE_BOOL;
+            break;
+        case CONSTANT:
+            // Only an optimized AST has them, and whatever they were was checked
+            type = TYPE_ERROR;
+            break;
+        case UNARY_EXPRESSION:
+        {
+            ValueType operand = checker->node_types[get_ast_child(ast, i, 0)];
+            type = checker->token_stream->types[node->token] == TOKEN_NOT ? TYPE_BOOL : TYPE_INT;
+            if (operand != type && operand != TYPE_ERROR)
+            {
+                report_semantic_error(checker, node->token, "Operator '%.*s' needs an operand of type %s, not %s",
+                                      value_type_to_string(type), value_type_to_string(operand));
+            }
+            break;
+        }
+        case BINARY_EXPRESSION:
+            type = check_binary_expression(checker, node, checker->node_types[get_ast_child(ast, i, 0)],
+                                           checker->node_types[get_ast_child(ast, i, 1)]);
+            break;
+        case CALL_EXPRESSION:
+            type = check_call(checker, i);
+            break;
+        default:
+            break;
+        }
+        checker->node_types[i] = type;
+    }
+    return checker->node_types[index];
+}
+
+// The value at index must have type, format reports at token what it is instead
+static void expect_type(SemanticChecker *checker, uint32_t index, ValueType type, uint32_t token, const char *format)
+{
+    ValueType value = check_expression(checker, index);
+    if (value != type && value != TYPE_ERROR && type != TYPE_ERROR)
+    {
+        report_semantic_error(checker, token, format, value_type_to_string(type), value_type_to_string(value));
+    }
+}
+
+static void check_statement_list(SemanticChecker *checker, uint32_t index);
+
+static void check_statement(SemanticChecker *checker, uint32_t index)
+{
+    AST *ast = checker->ast;
+    ASTNode *node = get_ast_node(ast, index);
+    switch (node->type)
+    {
+    case IDENTIFIER_DECLARATION:
+        declare_variable(checker, node->token, keyword_type(checker, node->token - 1));
+        break;
+    case IDENTIFIER_DEFINITION:
+    {
+        // The name is only declared after its value, which cannot refer to it
+        ValueType type = keyword_type(checker, node->token - 1);
+        expect_type(checker, get_ast_child(ast, index, 0), type, node->token,
+                    "Variable '%.*s' is %s but its value is %s");
+        declare_variable(checker, node->token, type);
+        break;
+    }
+    case ASSIGNMENT:
+    {
+        ValueType type = find_variable_type(checker, node->token);
+        expect_type(checker, get_ast_child(ast, index, 0), type, node->token,
+                    "Variable '%.*s' is %s but its value is %s");
+        break;
+    }
+    case CONDITIONAL:
+    case WHILE_LOOP:
+        expect_type(checker, get_ast_child(ast, index, 0), TYPE_BOOL, node->token,
+                    "Condition of '%.*s' must be %s, not %s");
+        for (uint32_t i = 1; i < node->num_children; i++)
+        {
+            check_statement_list(checker, get_ast_child(ast, index, i));
+        }
+        break;
+    case RETURN_STATEMENT:
+        expect_type(checker, get_ast_child(ast, index, 0), checker->return_type, node->token,
+                    "'%.*s' needs a value of type %s, not %s");
+        break;
+    case EXPRESSION_STATEMENT:
+        check_expression(checker, get_ast_child(ast, index, 0));
+        break;
+    default:
+        break;
+    }
+}
+
+// Check a block's statements with its declarations in a scope of their own
+static void check_statement_list(SemanticChecker *checker, uint32_t index)
+{
+    ASTNode *node = get_ast_node(checker->ast, index);
+    if (checker->depth >= MAX_SEMANTIC_DEPTH)
+    {
+        report_semantic_error(checker, node->token, "Blocks nested too deeply to check at '%.*s'", NULL, NULL);
+        return;
+    }
+    if (!open_scope(checker))
+    {
+        return;
+    }
+
+    checker->depth++;
+    for (uint32_t i = 0; i < node->num_children && !checker->out_of_memory; i++)
+    {
+        check_statement(checker, get_ast_child(checker->ast, index, i));
+    }
+    checker->depth--;
+    close_scope(checker);
+}
+
+// Parameters are declared in a scope around the body, which the body's own
+// declarations may not shadow
+static void check_function(SemanticChecker *checker, uint32_t index)
+{
+    AST *ast = checker->ast;
+    ASTNode *function = get_ast_node(ast, index);
+    uint32_t parameters = get_ast_child(ast, index, 0);
+    uint32_t body = get_ast_child(ast, index, 1);
+    checker->return_type = keyword_type(checker, function->token - 1);
+    if (!open_scope(checker))
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < get_ast_node(ast, parameters)->num_children; i++)
+    {
+        check_statement(checker, get_ast_child(ast, parameters, i));
+    }
+
+    // The body's block is the parameters' scope, so a local cannot redeclare one
+    ASTNode *block = get_ast_node(ast, body);
+    for (uint32_t i = 0; i < block->num_children && !checker->out_of_memory; i++)
+    {
+        check_statement(checker, get_ast_child(ast, body, i));
+    }
+    close_scope(checker);
+}
+
+int check_semantics(AST *ast, ErrorList *error_list)
+{
+    if (!ast || ast->root == AST_NO_NODE || !error_list)
+    {
+        add_new_error(error_list, 0, 0, SEMANTIC, "Invalid AST passed");
+        return 0;
+    }
+
+    TokenStream *token_stream = ast->token_stream;
+    uint32_t symbol_count = token_stream->symbol_table->symbol_count;
+    SemanticChecker checker = {
+        .ast = ast,
+        .token_stream = token_stream,
+        .error_list = error_list,
+        .innermost = malloc((symbol_count + 1) * sizeof(uint32_t)),
+        .functions = malloc((symbol_count + 1) * sizeof(uint32_t)),
+        .node_types = calloc(ast->node_count + 1, 1),
+    };
+    int errors_before = error_list->size + error_list->dropped;
+
+    if (checker.innermost && checker.functions && checker.node_types)
+    {
+        memset(checker.innermost, 0xff, (symbol_count + 1) * sizeof(uint32_t));
+        memset(checker.functions, 0xff, (symbol_count + 1) * sizeof(uint32_t));
+
+        // Every function is known before any body is checked, so calls may come first
+        ASTNode *root = get_ast_node(ast, ast->root);
+        for (uint32_t i = 0; i < root->num_children; i++)
+        {
+            uint32_t function = get_ast_child(ast, ast->root, i);
+            uint32_t symbol = token_stream->symbols[get_ast_node(ast, function)->token];
+            if (checker.functions[symbol] != NO_BINDING)
+            {
+                report_semantic_error(&checker, get_ast_node(ast, function)->token,
+                                      "Function '%.*s' is defined more than once", NULL, NULL);
+                continue;
+            }
+            checker.functions[symbol] = function;
+        }
+
+        for (uint32_t i = 0; i < root->num_children && !checker.out_of_memory && !error_limit_reached(error_list); i++)
+        {
+            check_function(&checker, get_ast_child(ast, ast->root, i));
+        }
+    }
+    else
+    {
+        checker.out_of_memory = 1;
+    }
+
+    if (checker.out_of_memory)
+    {
+        add_new_error(error_list, 0, 0, SEMANTIC, "Out of memory while checking semantics");
+    }
+    free(checker.innermost);
+    free(checker.functions);
+    free(checker.bindings);
+    free(checker.scopes);
+    free(checker.node_types);
+    return error_list->size + error_list->dropped == errors_before;
+}
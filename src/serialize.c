@@ -0,0 +1,422 @@
+#include "serialize.h"
+#include "intern.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Readers use these layouts directly on the mapped bytes
+_Static_assert(sizeof(SerializedHeader) == 112, "SerializedHeader layout changed");
+_Static_assert(sizeof(SerializedSymbol) == 8, "SerializedSymbol layout changed");
+_Static_assert(sizeof(SerializedToken) == 24, "SerializedToken layout changed");
+_Static_assert(sizeof(SerializedNode) == 16, "SerializedNode layout changed");
+
+#define SERIALIZE_BUFFER_SIZE 65536
+
+// Buffered little-endian output, the first failure sticks
+typedef struct {
+    FILE *file;
+    unsigned char buffer[SERIALIZE_BUFFER_SIZE];
+    size_t used;
+    uint64_t written;
+    int failed;
+} Writer;
+
+static void flush_writer(Writer *writer)
+{
+    if (writer->used > 0 && fwrite(writer->buffer, 1, writer->used, writer->file) != writer->used)
+    {
+        writer->failed = 1;
+    }
+    writer->used = 0;
+}
+
+static void write_bytes(Writer *writer, const void *data, size_t size)
+{
+    const unsigned char *bytes = data;
+    writer->written += size;
+    while (size > 0)
+    {
+        if (writer->used == SERIALIZE_BUFFER_SIZE)
+        {
+            flush_writer(writer);
+        }
+        size_t chunk = SERIALIZE_BUFFER_SIZE - writer->used < size ? SERIALIZE_BUFFER_SIZE - writer->used : size;
+        memcpy(writer->buffer + writer->used, bytes, chunk);
+        writer->used += chunk;
+        bytes += chunk;
+        size -= chunk;
+    }
+}
+
+// Make room for size more bytes, size being at most a record
+static unsigned char *reserve_writer(Writer *writer, size_t size)
+{
+    if (writer->used + size > SERIALIZE_BUFFER_SIZE)
+    {
+        flush_writer(writer);
+    }
+    unsigned char *bytes = writer->buffer + writer->used;
+    writer->used += size;
+    writer->written += size;
+    return bytes;
+}
+
+static void write_u8(Writer *writer, uint8_t value)
+{
+    *reserve_writer(writer, 1) = value;
+}
+
+static void write_u32(Writer *writer, uint32_t value)
+{
+    unsigned char *bytes = reserve_writer(writer, 4);
+    bytes[0] = value;
+    bytes[1] = value >> 8;
+    bytes[2] = value >> 16;
+    bytes[3] = value >> 24;
+}
+
+static void write_u64(Writer *writer, uint64_t value)
+{
+    write_u32(writer, (uint32_t)value);
+    write_u32(writer, (uint32_t)(value >> 32));
+}
+
+// Zero-fill up to the next section boundary
+static void pad_writer(Writer *writer)
+{
+    static const unsigned char zeros[8] = {0};
+    write_bytes(writer, zeros, (8 - writer->written % 8) % 8);
+}
+
+static uint64_t align_section(uint64_t offset)
+{
+    return (offset + 7) & ~(uint64_t)7;
+}
+
+// Fields in declaration order, which the static assertions pin to the struct layout
+static void write_header(Writer *writer, const SerializedHeader *header)
+{
+    write_bytes(writer, header->magic, 4);
+    write_u32(writer, header->version);
+    write_u32(writer, header->header_size);
+    write_u32(writer, header->flags);
+    write_u64(writer, header->file_size);
+    write_u64(writer, header->source_offset);
+    write_u64(writer, header->source_size);
+    write_u64(writer, header->names_offset);
+    write_u64(writer, header->names_size);
+    write_u64(writer, header->symbols_offset);
+    write_u64(writer, header->tokens_offset);
+    write_u64(writer, header->nodes_offset);
+    write_u64(writer, header->children_offset);
+    write_u32(writer, header->symbol_count);
+    write_u32(writer, header->token_count);
+    write_u32(writer, header->node_count);
+    write_u32(writer, header->child_count);
+    write_u32(writer, header->root);
+    write_u32(writer, header->reserved);
+}
+
+int write_serialized_file(const char *path, TokenStream *token_stream, AST *ast, ErrorList *error_list)
+{
+    if (!token_stream || token_stream->size == 0 || token_stream->types[token_stream->size - 1] != TOKEN_EOF)
+    {
+        add_new_error(error_list, 0, 0, CODEGEN, "Invalid token stream passed");
+        return 0;
+    }
+
+    InternTable *symbol_table = token_stream->symbol_table;
+    uint32_t symbol_count = symbol_table ? symbol_table->symbol_count : 0;
+    uint64_t names_size = 0;
+    for (uint32_t i = 0; i < symbol_count; i++)
+    {
+        names_size += symbol_table->name_lengths[i];
+    }
+
+    // Lay the sections out one after another
+    SerializedHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SERIALIZED_FILE_MAGIC, 4);
+    header.version = SERIALIZED_FILE_VERSION;
+    header.header_size = sizeof(SerializedHeader);
+    header.flags = ast ? SERIALIZED_HAS_AST : 0;
+    header.source_offset = align_section(sizeof(SerializedHeader));
+    header.source_size = (uint64_t)token_stream->offsets[token_stream->size - 1];
+    header.names_offset = align_section(header.source_offset + header.source_size);
+    header.names_size = names_size;
+    header.symbols_offset = align_section(header.names_offset + names_size);
+    header.tokens_offset = align_section(header.symbols_offset + (uint64_t)symbol_count * sizeof(SerializedSymbol));
+    header.nodes_offset = align_section(header.tokens_offset + (uint64_t)token_stream->size * sizeof(SerializedToken));
+    header.children_offset = align_section(header.nodes_offset + (ast ? (uint64_t)ast->node_count * sizeof(SerializedNode) : 0));
+    header.file_size = header.children_offset + (ast ? (uint64_t)ast->child_count * sizeof(uint32_t) : 0);
+    header.symbol_count = symbol_count;
+    header.token_count = token_stream->size;
+    header.node_count = ast ? ast->node_count : 0;
+    header.child_count = ast ? ast->child_count : 0;
+    header.root = ast ? ast->root : AST_NO_NODE;
+
+    // Token and name offsets are 32-bit
+    if (header.source_size > UINT32_MAX || names_size > UINT32_MAX)
+    {
+        add_new_error(error_list, 0, 0, CODEGEN, "Source too large to serialize");
+        return 0;
+    }
+
+    Writer *writer = calloc(1, sizeof(Writer));
+    if (!writer)
+    {
+        add_new_error(error_list, 0, 0, CODEGEN, "Failed to allocate serialization buffer");
+        return 0;
+    }
+
+    writer->file = fopen(path, "wb");
+    if (!writer->file)
+    {
+        char message[256];
+        snprintf(message, sizeof(message), "Failed to create '%s'", path);
+        add_new_error(error_list, 0, 0, CODEGEN, message);
+        free(writer);
+        return 0;
+    }
+
+    write_header(writer, &header);
+    pad_writer(writer);
+    write_bytes(writer, token_stream->source, header.source_size);
+    pad_writer(writer);
+
+    for (uint32_t i = 0; i < symbol_count; i++)
+    {
+        write_bytes(writer, symbol_table->names[i], symbol_table->name_lengths[i]);
+    }
+    pad_writer(writer);
+
+    uint32_t name_offset = 0;
+    for (uint32_t i = 0; i < symbol_count; i++)
+    {
+        write_u32(writer, name_offset);
+        write_u32(writer, symbol_table->name_lengths[i]);
+        name_offset += symbol_table->name_lengths[i];
+    }
+    pad_writer(writer);
+
+    for (int i = 0; i < token_stream->size; i++)
+    {
+        write_u32(writer, token_stream->offsets[i]);
+        write_u32(writer, token_stream->lengths[i]);
+        write_u32(writer, token_stream->lines[i]);
+        write_u32(writer, token_stream->columns[i]);
+        write_u32(writer, token_stream->symbols[i]);
+        write_u8(writer, token_stream->types[i]);
+        write_bytes(writer, "\0\0\0", 3);
+    }
+    pad_writer(writer);
+
+    for (uint32_t i = 0; ast && i < ast->node_count; i++)
+    {
+        write_u32(writer, ast->nodes[i].token);
+        write_u32(writer, ast->nodes[i].first_child);
+        write_u32(writer, ast->nodes[i].num_children);
+        write_u8(writer, ast->nodes[i].type);
+        write_bytes(writer, "\0\0\0", 3);
+    }
+    pad_writer(writer);
+
+    for (uint32_t i = 0; ast && i < ast->child_count; i++)
+    {
+        write_u32(writer, ast->children[i]);
+    }
+
+    flush_writer(writer);
+    int failed = writer->failed || writer->written != header.file_size;
+    if (fclose(writer->file) != 0 || failed)
+    {
+        char message[256];
+        snprintf(message, sizeof(message), "Failed to write '%s'", path);
+        add_new_error(error_list, 0, 0, CODEGEN, message);
+        free(writer);
+        return 0;
+    }
+
+    free(writer);
+    return 1;
+}
+
+// Whether count records of size bytes from offset lie inside the file, on a section boundary
+static int section_fits(SerializedFile *file, uint64_t offset, uint64_t count, uint64_t size)
+{
+    return offset % 8 == 0 && offset <= file->size && count <= (file->size - offset) / size;
+}
+
+static void report_invalid_file(ErrorList *error_list, const char *path, const char *reason)
+{
+    char message[256];
+    snprintf(message, sizeof(message), "'%s' is not a usable serialized file: %s", path, reason);
+    add_new_error(error_list, 0, 0, CODEGEN, message);
+}
+
+SerializedFile *open_serialized_file(const char *path, ErrorList *error_list)
+{
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+    report_invalid_file(error_list, path, "records are little-endian and this host is not");
+    return NULL;
+#endif
+
+    int fd = open(path, O_RDONLY);
+    struct stat file_stat;
+    if (fd < 0 || fstat(fd, &file_stat) != 0)
+    {
+        report_invalid_file(error_list, path, "cannot open it");
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return NULL;
+    }
+
+    if ((size_t)file_stat.st_size < sizeof(SerializedHeader))
+    {
+        report_invalid_file(error_list, path, "too short for a header");
+        close(fd);
+        return NULL;
+    }
+
+    SerializedFile *file = calloc(1, sizeof(SerializedFile));
+    void *data = file ? mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        report_invalid_file(error_list, path, "cannot map it");
+        free(file);
+        return NULL;
+    }
+
+    file->data = data;
+    file->size = file_stat.st_size;
+    file->header = data;
+
+    const SerializedHeader *header = file->header;
+    const char *reason = NULL;
+    if (memcmp(header->magic, SERIALIZED_FILE_MAGIC, 4) != 0)
+    {
+        reason = "bad magic";
+    }
+    else if (header->version != SERIALIZED_FILE_VERSION || header->header_size != sizeof(SerializedHeader))
+    {
+        reason = "unsupported version";
+    }
+    else if (header->file_size != file->size)
+    {
+        reason = "truncated";
+    }
+    else if (!section_fits(file, header->source_offset, header->source_size, 1) ||
+             !section_fits(file, header->names_offset, header->names_size, 1) ||
+             !section_fits(file, header->symbols_offset, header->symbol_count, sizeof(SerializedSymbol)) ||
+             !section_fits(file, header->tokens_offset, header->token_count, sizeof(SerializedToken)) ||
+             !section_fits(file, header->nodes_offset, header->node_count, sizeof(SerializedNode)) ||
+             !section_fits(file, header->children_offset, header->child_count, sizeof(uint32_t)))
+    {
+        reason = "section out of bounds";
+    }
+    else if (header->token_count == 0)
+    {
+        reason = "no tokens";
+    }
+    else if ((header->flags & SERIALIZED_HAS_AST) && header->root >= header->node_count)
+    {
+        reason = "bad AST root";
+    }
+
+    if (reason)
+    {
+        report_invalid_file(error_list, path, reason);
+        close_serialized_file(file);
+        return NULL;
+    }
+
+    const char *base = data;
+    file->source = base + header->source_offset;
+    file->names = base + header->names_offset;
+    file->symbols = (const SerializedSymbol *)(base + header->symbols_offset);
+    file->tokens = (const SerializedToken *)(base + header->tokens_offset);
+    if (header->flags & SERIALIZED_HAS_AST)
+    {
+        file->nodes = (const SerializedNode *)(base + header->nodes_offset);
+        file->children = (const uint32_t *)(base + header->children_offset);
+    }
+    return file;
+}
+
+int verify_serialized_file(SerializedFile *file, ErrorList *error_list)
+{
+    const SerializedHeader *header = file->header;
+    char message[256];
+
+    for (uint32_t i = 0; i < header->symbol_count; i++)
+    {
+        const SerializedSymbol *symbol = &file->symbols[i];
+        if (symbol->name_offset > header->names_size || symbol->name_length > header->names_size - symbol->name_offset)
+        {
+            snprintf(message, sizeof(message), "Symbol %u lies outside the string table", i);
+            add_new_error(error_list, 0, 0, CODEGEN, message);
+            return 0;
+        }
+    }
+
+    for (uint32_t i = 0; i < header->token_count; i++)
+    {
+        const SerializedToken *token = &file->tokens[i];
+        if (token->type > TOKEN_ERROR || (token->type == TOKEN_EOF) != (i == header->token_count - 1) ||
+            token->offset > header->source_size || token->length > header->source_size - token->offset ||
+            (token->symbol != NO_SYMBOL && token->symbol >= header->symbol_count))
+        {
+            snprintf(message, sizeof(message), "Token %u is malformed", i);
+            add_new_error(error_list, 0, 0, CODEGEN, message);
+            return 0;
+        }
+    }
+
+    for (uint32_t i = 0; file->nodes && i < header->node_count; i++)
+    {
+        const SerializedNode *node = &file->nodes[i];
+        if (node->type >= AST_NODE_TYPE_COUNT || node->token >= header->token_count ||
+            (node->type == CONSTANT ? node->num_children != 0 :
+             node->first_child > header->child_count || node->num_children > header->child_count - node->first_child))
+        {
+            snprintf(message, sizeof(message), "AST node %u is malformed", i);
+            add_new_error(error_list, 0, 0, CODEGEN, message);
+            return 0;
+        }
+    }
+
+    // Children come before their parent, which also rules out cycles
+    for (uint32_t i = 0; file->nodes && i < header->node_count; i++)
+    {
+        const SerializedNode *node = &file->nodes[i];
+        for (uint32_t c = 0; c < node->num_children; c++)
+        {
+            if (file->children[node->first_child + c] >= i)
+            {
+                snprintf(message, sizeof(message), "AST node %u has a child that does not precede it", i);
+                add_new_error(error_list, 0, 0, CODEGEN, message);
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+void close_serialized_file(SerializedFile *file)
+{
+    if (!file)
+    {
+        return;
+    }
+
+    munmap((void *)file->data, file->size);
+    free(file);
+}
@@ -0,0 +1,206 @@
+#include "sha256.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SHA256_X86 1
+#endif
+
+static const uint32_t round_constants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static inline uint32_t rotate_right(uint32_t value, int bits)
+{
+    return (value >> bits) | (value << (32 - bits));
+}
+
+// Mix one 64-byte block into the state
+static void compress_block(uint32_t state[8], const unsigned char *block)
+{
+    uint32_t schedule[64];
+    for (int i = 0; i < 16; i++)
+    {
+        schedule[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 |
+                      (uint32_t)block[i * 4 + 2] << 8 | (uint32_t)block[i * 4 + 3];
+    }
+    for (int i = 16; i < 64; i++)
+    {
+        uint32_t s0 = rotate_right(schedule[i - 15], 7) ^ rotate_right(schedule[i - 15], 18) ^ (schedule[i - 15] >> 3);
+        uint32_t s1 = rotate_right(schedule[i - 2], 17) ^ rotate_right(schedule[i - 2], 19) ^ (schedule[i - 2] >> 10);
+        schedule[i] = schedule[i - 16] + s0 + schedule[i - 7] + s1;
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++)
+    {
+        uint32_t t1 = h + (rotate_right(e, 6) ^ rotate_right(e, 11) ^ rotate_right(e, 25)) +
+                      ((e & f) ^ (~e & g)) + round_constants[i] + schedule[i];
+        uint32_t t2 = (rotate_right(a, 2) ^ rotate_right(a, 13) ^ rotate_right(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+static void compress_blocks_scalar(uint32_t state[8], const unsigned char *blocks, size_t count)
+{
+    for (; count > 0; count--, blocks += 64)
+    {
+        compress_block(state, blocks);
+    }
+}
+
+#ifdef SHA256_X86
+
+// The same rounds on the SHA extensions, which keep the state as ABEF and CDGH halves
+// and run two rounds per instruction
+__attribute__((target("sha,sse4.1")))
+static void compress_blocks_sha_ni(uint32_t state[8], const unsigned char *blocks, size_t count)
+{
+    const __m128i byte_swap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i cdab = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xB1);
+    __m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1B);
+    __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+    __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xF0);
+
+    for (; count > 0; count--, blocks += 64)
+    {
+        __m128i saved_abef = abef, saved_cdgh = cdgh;
+        __m128i schedule[4];
+        for (int i = 0; i < 4; i++)
+        {
+            schedule[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(blocks + i * 16)), byte_swap);
+        }
+
+        // Group i holds schedule words 4i..4i+3; once used, its slot takes group i + 4
+        for (int i = 0; i < 16; i++)
+        {
+            __m128i message = _mm_add_epi32(schedule[i & 3], _mm_loadu_si128((const __m128i *)&round_constants[i * 4]));
+            cdgh = _mm_sha256rnds2_epu32(cdgh, abef, message);
+            abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(message, 0x0E));
+
+            if (i < 12)
+            {
+                __m128i next = _mm_sha256msg1_epu32(schedule[i & 3], schedule[(i + 1) & 3]);
+                next = _mm_add_epi32(next, _mm_alignr_epi8(schedule[(i + 3) & 3], schedule[(i + 2) & 3], 4));
+                schedule[i & 3] = _mm_sha256msg2_epu32(next, schedule[(i + 3) & 3]);
+            }
+        }
+
+        abef = _mm_add_epi32(abef, saved_abef);
+        cdgh = _mm_add_epi32(cdgh, saved_cdgh);
+    }
+
+    __m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+    __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+    _mm_storeu_si128((__m128i *)&state[0], _mm_blend_epi16(feba, dchg, 0xF0));
+    _mm_storeu_si128((__m128i *)&state[4], _mm_alignr_epi8(dchg, feba, 8));
+}
+
+#endif
+
+static void (*compress_blocks)(uint32_t state[8], const unsigned char *blocks, size_t count) = compress_blocks_scalar;
+
+// Pick the block function before main runs so every thread sees the final choice
+__attribute__((constructor))
+static void select_compress_blocks()
+{
+#ifdef SHA256_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("sha") && __builtin_cpu_supports("sse4.1"))
+    {
+        compress_blocks = compress_blocks_sha_ni;
+    }
+#endif
+}
+
+void sha256_init(Sha256 *sha)
+{
+    static const uint32_t initial_state[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+    };
+    memcpy(sha->state, initial_state, sizeof(initial_state));
+    sha->length = 0;
+    sha->block_size = 0;
+}
+
+void sha256_update(Sha256 *sha, const void *data, size_t length)
+{
+    const unsigned char *bytes = data;
+    sha->length += length;
+
+    if (sha->block_size > 0)
+    {
+        size_t take = 64 - sha->block_size < length ? 64 - sha->block_size : length;
+        memcpy(sha->block + sha->block_size, bytes, take);
+        sha->block_size += take;
+        bytes += take;
+        length -= take;
+        if (sha->block_size < 64)
+        {
+            return;
+        }
+        compress_blocks(sha->state, sha->block, 1);
+        sha->block_size = 0;
+    }
+
+    // Whole blocks straight from the input
+    size_t block_count = length / 64;
+    compress_blocks(sha->state, bytes, block_count);
+    bytes += block_count * 64;
+    length -= block_count * 64;
+
+    memcpy(sha->block, bytes, length);
+    sha->block_size = length;
+}
+
+void sha256_final(Sha256 *sha, unsigned char digest[SHA256_DIGEST_SIZE])
+{
+    uint64_t bit_length = sha->length * 8;
+
+    // A 1 bit, zeros up to 56 bytes into a block, then the length in bits big-endian
+    sha->block[sha->block_size++] = 0x80;
+    if (sha->block_size > 56)
+    {
+        memset(sha->block + sha->block_size, 0, 64 - sha->block_size);
+        compress_blocks(sha->state, sha->block, 1);
+        sha->block_size = 0;
+    }
+    memset(sha->block + sha->block_size, 0, 56 - sha->block_size);
+    for (int i = 0; i < 8; i++)
+    {
+        sha->block[56 + i] = (unsigned char)(bit_length >> (56 - i * 8));
+    }
+    compress_blocks(sha->state, sha->block, 1);
+
+    for (int i = 0; i < 8; i++)
+    {
+        digest[i * 4] = (unsigned char)(sha->state[i] >> 24);
+        digest[i * 4 + 1] = (unsigned char)(sha->state[i] >> 16);
+        digest[i * 4 + 2] = (unsigned char)(sha->state[i] >> 8);
+        digest[i * 4 + 3] = (unsigned char)sha->state[i];
+    }
+}
@@ -0,0 +1,85 @@
+#include "source.h"
+#include "errors.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Map the file at path read-only so the lexer can slice lexemes out of it without copying
+SourceBuffer *open_source_file(const char *path, ErrorList *error_list)
+{
+    char message[256];
+
+    if (!path)
+    {
+        add_new_error(error_list, 0, 0, LEXER, "No source file given");
+        return NULL;
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        snprintf(message, sizeof(message), "Failed to open source file '%s'", path);
+        add_new_error(error_list, 0, 0, LEXER, message);
+        return NULL;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0)
+    {
+        snprintf(message, sizeof(message), "Failed to stat source file '%s'", path);
+        add_new_error(error_list, 0, 0, LEXER, message);
+        close(fd);
+        return NULL;
+    }
+
+    SourceBuffer *source = calloc(1, sizeof(SourceBuffer));
+    if (!source)
+    {
+        add_new_error(error_list, 0, 0, LEXER, "Failed to allocate source buffer");
+        close(fd);
+        return NULL;
+    }
+
+    source->length = (size_t)file_stat.st_size;
+
+    // mmap rejects zero-length mappings, an empty file is simply an empty buffer
+    if (source->length > 0)
+    {
+        void *data = mmap(NULL, source->length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            snprintf(message, sizeof(message), "Failed to map source file '%s'", path);
+            add_new_error(error_list, 0, 0, LEXER, message);
+            free(source);
+            close(fd);
+            return NULL;
+        }
+
+        // The lexer makes a single forward pass, let the kernel read ahead aggressively
+        madvise(data, source->length, MADV_SEQUENTIAL);
+        source->data = data;
+        source->is_mapped = 1;
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+    return source;
+}
+
+void close_source_file(SourceBuffer *source)
+{
+    if (!source)
+    {
+        return;
+    }
+
+    if (source->is_mapped)
+    {
+        munmap((void *)source->data, source->length);
+    }
+
+    free(source);
+}
@@ -0,0 +1,261 @@
+#include "target.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+static const char *const target_cost_names[TARGET_COST_COUNT] = {
+    [TARGET_COST_CONSTANT] = "constant",
+    [TARGET_COST_ARITHMETIC] = "arithmetic",
+    [TARGET_COST_MULTIPLY] = "multiply",
+    [TARGET_COST_DIVIDE] = "divide",
+    [TARGET_COST_COMPARE] = "compare",
+    [TARGET_COST_LOGIC] = "logic",
+    [TARGET_COST_MOVE] = "move",
+    [TARGET_COST_BRANCH] = "branch",
+    [TARGET_COST_CALL] = "call",
+    [TARGET_COST_RETURN] = "return",
+    [TARGET_COST_SET_PIN] = "set-pin",
+    [TARGET_COST_READ_PIN] = "read-pin",
+};
+
+// Division is a library call and pin registers sit behind a peripheral bus
+static const uint32_t default_cycle_costs[TARGET_COST_COUNT] = {
+    [TARGET_COST_CONSTANT] = 1,
+    [TARGET_COST_ARITHMETIC] = 1,
+    [TARGET_COST_MULTIPLY] = 1,
+    [TARGET_COST_DIVIDE] = 40,
+    [TARGET_COST_COMPARE] = 1,
+    [TARGET_COST_LOGIC] = 1,
+    [TARGET_COST_MOVE] = 1,
+    [TARGET_COST_BRANCH] = 3,
+    [TARGET_COST_CALL] = 4,
+    [TARGET_COST_RETURN] = 4,
+    [TARGET_COST_SET_PIN] = 2,
+    [TARGET_COST_READ_PIN] = 2,
+};
+
+const char *target_cost_to_string(TargetCost cost)
+{
+    return cost < TARGET_COST_COUNT ? target_cost_names[cost] : "unknown";
+}
+
+TargetConfig *create_target_config()
+{
+    TargetConfig *target = calloc(1, sizeof(TargetConfig));
+    if (target)
+    {
+        memset(target->pin_ports, TARGET_NO_PORT, sizeof(target->pin_ports));
+        target->register_count = TARGET_DEFAULT_REGISTERS;
+        memcpy(target->cycle_costs, default_cycle_costs, sizeof(target->cycle_costs));
+    }
+    return target;
+}
+
+TargetConfig *create_default_target_config()
+{
+    TargetConfig *target = create_target_config();
+    if (!target)
+    {
+        return NULL;
+    }
+
+    for (uint32_t port = 0; port < GPIO_PIN_COUNT / 8; port++)
+    {
+        TargetPort *entry = &target->ports[target->port_count++];
+        snprintf(entry->name, sizeof(entry->name), "PORT%u", port);
+        snprintf(entry->set_register, sizeof(entry->set_register), "PORT%u_SET", port);
+        snprintf(entry->clear_register, sizeof(entry->clear_register), "PORT%u_CLEAR", port);
+        snprintf(entry->input_register, sizeof(entry->input_register), "PORT%u_IN", port);
+    }
+    for (uint32_t pin = 0; pin < GPIO_PIN_COUNT; pin++)
+    {
+        target->pin_ports[pin] = (uint8_t)(pin / 8);
+        target->pin_bits[pin] = (uint8_t)(pin % 8);
+    }
+    return target;
+}
+
+void free_target_config(TargetConfig *target)
+{
+    free(target);
+}
+
+static void report_target_error(ErrorList *error_list, const char *name, int line, const char *reason)
+{
+    char message[256];
+    snprintf(message, sizeof(message), "In target '%s': %s", name, reason);
+    add_new_error(error_list, line, 0, CODEGEN, message);
+}
+
+static int is_identifier(const char *text)
+{
+    if (!isalpha((unsigned char)*text) && *text != '_')
+    {
+        return 0;
+    }
+    while (*++text)
+    {
+        if (!isalnum((unsigned char)*text) && *text != '_')
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static uint32_t find_target_port(TargetConfig *target, const char *name)
+{
+    for (uint32_t i = 0; i < target->port_count; i++)
+    {
+        if (strcmp(target->ports[i].name, name) == 0)
+        {
+            return i;
+        }
+    }
+    return TARGET_NO_PORT;
+}
+
+// Apply one directive, returning the reason it is wrong or NULL
+static const char *apply_target_directive(TargetConfig *target, const char *text)
+{
+    char directive[16], words[4][TARGET_NAME_LENGTH], extra;
+    unsigned first, last, bit;
+
+    if (sscanf(text, "%15s", directive) != 1)
+    {
+        return "expected a directive";
+    }
+
+    if (strcmp(directive, "header") == 0)
+    {
+        if (sscanf(text, "%*s %63s %c", target->header, &extra) != 1)
+        {
+            return "expected 'header FILE'";
+        }
+    }
+    else if (strcmp(directive, "port") == 0)
+    {
+        if (sscanf(text, "%*s %63s %63s %63s %63s %c", words[0], words[1], words[2], words[3], &extra) != 4)
+        {
+            return "expected 'port NAME SET CLEAR|- INPUT'";
+        }
+        if (!is_identifier(words[0]))
+        {
+            return "port names must be identifiers";
+        }
+        if (find_target_port(target, words[0]) != TARGET_NO_PORT)
+        {
+            return "port is defined more than once";
+        }
+        if (target->port_count == TARGET_MAX_PORTS)
+        {
+            return "too many ports";
+        }
+
+        TargetPort *port = &target->ports[target->port_count++];
+        strcpy(port->name, words[0]);
+        strcpy(port->set_register, words[1]);
+        strcpy(port->clear_register, strcmp(words[2], "-") == 0 ? "" : words[2]);
+        strcpy(port->input_register, words[3]);
+    }
+    else if (strcmp(directive, "pins") == 0)
+    {
+        if (sscanf(text, "%*s %u %u %63s %u %c", &first, &last, words[0], &bit, &extra) != 4)
+        {
+            return "expected 'pins FIRST LAST PORT BIT'";
+        }
+        uint32_t port = find_target_port(target, words[0]);
+        if (port == TARGET_NO_PORT)
+        {
+            return "pins must name a port defined before them";
+        }
+        if (first > last || last >= GPIO_PIN_COUNT)
+        {
+            return "pin range out of order or out of range";
+        }
+        if (bit + (last - first) >= 32)
+        {
+            return "port bits must be below 32";
+        }
+        for (unsigned pin = first; pin <= last; pin++)
+        {
+            target->pin_ports[pin] = (uint8_t)port;
+            target->pin_bits[pin] = (uint8_t)(bit + pin - first);
+        }
+    }
+    else if (strcmp(directive, "cache-reads") == 0)
+    {
+        if (sscanf(text, "%*s %63s %c", words[0], &extra) != 1 ||
+            (strcmp(words[0], "yes") != 0 && strcmp(words[0], "no") != 0))
+        {
+            return "expected 'cache-reads yes|no'";
+        }
+        target->cache_reads = strcmp(words[0], "yes") == 0;
+    }
+    else if (strcmp(directive, "registers") == 0)
+    {
+        if (sscanf(text, "%*s %u %c", &first, &extra) != 1 || first > TARGET_MAX_REGISTERS)
+        {
+            return "expected 'registers N' with N at most 1024";
+        }
+        target->register_count = first;
+    }
+    else if (strcmp(directive, "cycles") == 0)
+    {
+        if (sscanf(text, "%*s %63s %u %c", words[0], &first, &extra) != 2)
+        {
+            return "expected 'cycles CLASS N'";
+        }
+        uint32_t cost = 0;
+        while (cost < TARGET_COST_COUNT && strcmp(target_cost_names[cost], words[0]) != 0)
+        {
+            cost++;
+        }
+        if (cost == TARGET_COST_COUNT)
+        {
+            return "unknown cost class";
+        }
+        target->cycle_costs[cost] = first;
+    }
+    else
+    {
+        return "unknown directive";
+    }
+
+    return NULL;
+}
+
+int load_target_config(TargetConfig *target, FILE *file, const char *name, ErrorList *error_list)
+{
+    char text[512];
+    int line = 0;
+
+    while (fgets(text, sizeof(text), file))
+    {
+        line++;
+        char *comment = strchr(text, '#');
+        if (comment)
+        {
+            *comment = '\0';
+        }
+
+        char *cursor = text;
+        while (isspace((unsigned char)*cursor))
+        {
+            cursor++;
+        }
+        if (*cursor == '\0')
+        {
+            continue;
+        }
+
+        const char *reason = apply_target_directive(target, cursor);
+        if (reason)
+        {
+            report_target_error(error_list, name, line, reason);
+            return 0;
+        }
+    }
+
+    return 1;
+}
@@ -0,0 +1,282 @@
+#include "thread_pool.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+typedef struct
+{
+    ThreadPool *pool;
+    int index;
+} WorkerStart;
+
+// Queue of the worker running on this thread, -1 outside the pool
+static __thread int current_worker = -1;
+static __thread ThreadPool *current_pool = NULL;
+
+static int push_task(WorkerQueue *queue, ThreadPoolTask task)
+{
+    pthread_mutex_lock(&queue->lock);
+
+    if (queue->size == queue->capacity)
+    {
+        int new_capacity = queue->capacity * 2;
+        ThreadPoolTask *new_tasks = malloc(new_capacity * sizeof(ThreadPoolTask));
+        if (!new_tasks)
+        {
+            pthread_mutex_unlock(&queue->lock);
+            return 0;
+        }
+
+        // Unwrap the ring so the tasks start at index 0 again
+        for (int i = 0; i < queue->size; i++)
+        {
+            new_tasks[i] = queue->tasks[(queue->top + i) % queue->capacity];
+        }
+        free(queue->tasks);
+        queue->tasks = new_tasks;
+        queue->capacity = new_capacity;
+        queue->top = 0;
+    }
+
+    queue->tasks[(queue->top + queue->size) % queue->capacity] = task;
+    queue->size++;
+
+    pthread_mutex_unlock(&queue->lock);
+    return 1;
+}
+
+// Newest task of the worker's own queue, so work it just created runs while still warm in cache
+static int pop_task(WorkerQueue *queue, ThreadPoolTask *task)
+{
+    pthread_mutex_lock(&queue->lock);
+
+    int found = queue->size > 0;
+    if (found)
+    {
+        queue->size--;
+        *task = queue->tasks[(queue->top + queue->size) % queue->capacity];
+    }
+
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+// Oldest task of another worker's queue, which is the one its owner would reach last
+static int steal_task(WorkerQueue *queue, ThreadPoolTask *task)
+{
+    if (pthread_mutex_trylock(&queue->lock) != 0)
+    {
+        return 0;
+    }
+
+    int found = queue->size > 0;
+    if (found)
+    {
+        *task = queue->tasks[queue->top];
+        queue->top = (queue->top + 1) % queue->capacity;
+        queue->size--;
+    }
+
+    pthread_mutex_unlock(&queue->lock);
+    return found;
+}
+
+static int take_task(ThreadPool *pool, int index, ThreadPoolTask *task)
+{
+    if (pop_task(&pool->queues[index], task))
+    {
+        return 1;
+    }
+
+    for (int offset = 1; offset < pool->thread_count; offset++)
+    {
+        if (steal_task(&pool->queues[(index + offset) % pool->thread_count], task))
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void *run_worker(void *argument)
+{
+    WorkerStart *start = argument;
+    ThreadPool *pool = start->pool;
+    int index = start->index;
+    free(start);
+
+    current_worker = index;
+    current_pool = pool;
+
+    for (;;)
+    {
+        ThreadPoolTask task;
+        if (take_task(pool, index, &task))
+        {
+            pthread_mutex_lock(&pool->lock);
+            pool->queued--;
+            pthread_mutex_unlock(&pool->lock);
+
+            task.function(task.argument);
+
+            pthread_mutex_lock(&pool->lock);
+            if (--pool->pending == 0)
+            {
+                pthread_cond_broadcast(&pool->all_done);
+            }
+            pthread_mutex_unlock(&pool->lock);
+            continue;
+        }
+
+        // Nothing to run or steal, sleep until a task is queued. A queued task that
+        // another worker is about to take just costs one more pass through the queues.
+        pthread_mutex_lock(&pool->lock);
+        while (pool->queued == 0 && !pool->shutting_down)
+        {
+            pthread_cond_wait(&pool->work_available, &pool->lock);
+        }
+        int stop = pool->queued == 0 && pool->shutting_down;
+        pthread_mutex_unlock(&pool->lock);
+
+        if (stop)
+        {
+            return NULL;
+        }
+    }
+}
+
+int get_processor_count()
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (int)count : 1;
+}
+
+ThreadPool *create_thread_pool(int thread_count)
+{
+    ThreadPool *pool = calloc(1, sizeof(ThreadPool));
+    if (!pool)
+    {
+        return NULL;
+    }
+
+    pool->thread_count = thread_count > 0 ? thread_count : get_processor_count();
+    pool->threads = calloc(pool->thread_count, sizeof(pthread_t));
+    pool->queues = calloc(pool->thread_count, sizeof(WorkerQueue));
+    if (!pool->threads || !pool->queues)
+    {
+        free(pool->threads);
+        free(pool->queues);
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work_available, NULL);
+    pthread_cond_init(&pool->all_done, NULL);
+
+    for (int i = 0; i < pool->thread_count; i++)
+    {
+        WorkerQueue *queue = &pool->queues[i];
+        pthread_mutex_init(&queue->lock, NULL);
+        queue->capacity = DEFAULT_WORKER_QUEUE_CAPACITY;
+        queue->tasks = malloc(queue->capacity * sizeof(ThreadPoolTask));
+    }
+
+    for (int i = 0; i < pool->thread_count; i++)
+    {
+        WorkerStart *start = pool->queues[i].tasks ? malloc(sizeof(WorkerStart)) : NULL;
+        if (!start)
+        {
+            free_thread_pool(pool);
+            return NULL;
+        }
+
+        start->pool = pool;
+        start->index = i;
+        if (pthread_create(&pool->threads[i], NULL, run_worker, start) != 0)
+        {
+            free(start);
+            free_thread_pool(pool);
+            return NULL;
+        }
+    }
+
+    return pool;
+}
+
+int submit_thread_pool_task(ThreadPool *pool, ThreadPoolFunction function, void *argument)
+{
+    ThreadPoolTask task = {function, argument};
+    int index;
+
+    pthread_mutex_lock(&pool->lock);
+    if (current_pool == pool)
+    {
+        index = current_worker;
+    }
+    else
+    {
+        index = pool->next_queue;
+        pool->next_queue = (pool->next_queue + 1) % pool->thread_count;
+    }
+    pool->pending++;
+    pthread_mutex_unlock(&pool->lock);
+
+    if (!push_task(&pool->queues[index], task))
+    {
+        pthread_mutex_lock(&pool->lock);
+        pool->pending--;
+        pthread_mutex_unlock(&pool->lock);
+        return 0;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->queued++;
+    pthread_cond_signal(&pool->work_available);
+    pthread_mutex_unlock(&pool->lock);
+    return 1;
+}
+
+void wait_thread_pool(ThreadPool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending > 0)
+    {
+        pthread_cond_wait(&pool->all_done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+void free_thread_pool(ThreadPool *pool)
+{
+    if (!pool)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->shutting_down = 1;
+    pthread_cond_broadcast(&pool->work_available);
+    pthread_mutex_unlock(&pool->lock);
+
+    // Threads that failed to start were left zeroed by calloc
+    for (int i = 0; i < pool->thread_count; i++)
+    {
+        if (pool->threads[i])
+        {
+            pthread_join(pool->threads[i], NULL);
+        }
+    }
+
+    for (int i = 0; i < pool->thread_count; i++)
+    {
+        pthread_mutex_destroy(&pool->queues[i].lock);
+        free(pool->queues[i].tasks);
+    }
+
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->work_available);
+    pthread_cond_destroy(&pool->all_done);
+    free(pool->threads);
+    free(pool->queues);
+    free(pool);
+}
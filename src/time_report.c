@@ -0,0 +1,144 @@
+#include "time_report.h"
+#include <time.h>
+#include <sys/resource.h>
+
+static uint64_t monotonic_nanoseconds()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + (uint64_t)now.tv_nsec;
+}
+
+// ru_maxrss is in kilobytes on Linux
+static long peak_rss_kb()
+{
+    struct rusage usage;
+    return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : 0;
+}
+
+void begin_phase(TimeReport *report, const char *name)
+{
+    if (!report->enabled || report->phase_count == TIME_REPORT_MAX_PHASES)
+    {
+        return;
+    }
+
+    report->phases[report->phase_count] = (PhaseTiming){.name = name};
+    report->started_statistics = get_arena_statistics();
+    report->started = monotonic_nanoseconds();
+}
+
+void end_phase(TimeReport *report, uint64_t items, const char *unit)
+{
+    uint64_t ended = monotonic_nanoseconds();
+    if (!report->enabled || report->phase_count == TIME_REPORT_MAX_PHASES)
+    {
+        return;
+    }
+
+    ArenaStatistics statistics = get_arena_statistics();
+    PhaseTiming *phase = &report->phases[report->phase_count++];
+    phase->unit = unit;
+    phase->items = items;
+    phase->nanoseconds = ended - report->started;
+    phase->allocations = statistics.allocations - report->started_statistics.allocations;
+    phase->allocated_bytes = statistics.bytes - report->started_statistics.bytes;
+    phase->peak_rss_kb = peak_rss_kb();
+}
+
+// Items per second, 0 for a phase too quick for the clock
+static double throughput(const PhaseTiming *phase)
+{
+    return phase->nanoseconds ? (double)phase->items * 1e9 / (double)phase->nanoseconds : 0.0;
+}
+
+// Sum of every phase, with the highest peak
+static PhaseTiming total_timing(TimeReport *report)
+{
+    PhaseTiming total = {.name = "total"};
+    for (uint32_t i = 0; i < report->phase_count; i++)
+    {
+        PhaseTiming *phase = &report->phases[i];
+        total.nanoseconds += phase->nanoseconds;
+        total.allocations += phase->allocations;
+        total.allocated_bytes += phase->allocated_bytes;
+        total.peak_rss_kb = phase->peak_rss_kb > total.peak_rss_kb ? phase->peak_rss_kb : total.peak_rss_kb;
+    }
+    return total;
+}
+
+static void print_phase_row(const PhaseTiming *phase, FILE *file)
+{
+    char rate[48] = "";
+    if (phase->unit)
+    {
+        snprintf(rate, sizeof(rate), "%.0f %s/s", throughput(phase), phase->unit);
+    }
+    fprintf(file, "%-12s %10.3f  %-24s %11llu %13llu %12ld\n", phase->name, phase->nanoseconds / 1e6, rate,
+            (unsigned long long)phase->allocations, (unsigned long long)phase->allocated_bytes, phase->peak_rss_kb);
+}
+
+void print_time_report(TimeReport *report, FILE *file)
+{
+    PhaseTiming total = total_timing(report);
+    fprintf(file, "%-12s %10s  %-24s %11s %13s %12s\n", "phase", "wall ms", "throughput", "allocations", "bytes",
+            "peak RSS KB");
+    for (uint32_t i = 0; i < report->phase_count; i++)
+    {
+        print_phase_row(&report->phases[i], file);
+    }
+    print_phase_row(&total, file);
+}
+
+static void print_json_string(const char *text, FILE *file)
+{
+    fputc('"', file);
+    for (const unsigned char *c = (const unsigned char *)text; *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+        {
+            fprintf(file, "\\%c", *c);
+        }
+        else if (*c < 0x20)
+        {
+            fprintf(file, "\\u%04x", *c);
+        }
+        else
+        {
+            fputc(*c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+static void print_json_phase(const PhaseTiming *phase, FILE *file)
+{
+    fputs("{\"name\": ", file);
+    print_json_string(phase->name, file);
+    fprintf(file, ", \"wall_ns\": %llu", (unsigned long long)phase->nanoseconds);
+    if (phase->unit)
+    {
+        fputs(", \"unit\": ", file);
+        print_json_string(phase->unit, file);
+        fprintf(file, ", \"items\": %llu, \"items_per_second\": %.0f", (unsigned long long)phase->items,
+                throughput(phase));
+    }
+    fprintf(file, ", \"allocations\": %llu, \"allocated_bytes\": %llu, \"peak_rss_kb\": %ld}",
+            (unsigned long long)phase->allocations, (unsigned long long)phase->allocated_bytes, phase->peak_rss_kb);
+}
+
+void print_time_report_json(TimeReport *report, const char *path, int succeeded, FILE *file)
+{
+    PhaseTiming total = total_timing(report);
+    fputs("{\"path\": ", file);
+    print_json_string(path, file);
+    fprintf(file, ", \"succeeded\": %s, \"phases\": [", succeeded ? "true" : "false");
+    for (uint32_t i = 0; i < report->phase_count; i++)
+    {
+        fputs(i ? ", " : "", file);
+        print_json_phase(&report->phases[i], file);
+    }
+    fputs("], \"total\": ", file);
+    print_json_phase(&total, file);
+    fputc('}', file);
+}
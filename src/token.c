@@ -2,29 +2,39 @@
 #include <stdlib.h>
 #include <string.h>
 
-static int resize_token_stream(TokenStream *token_stream)
+// Grow one of the parallel arrays from old_capacity to capacity elements of element_size bytes
+static int resize_token_array(Arena *arena, void **array, int old_capacity, int capacity, size_t element_size)
 {
-    Token **temp_token_stream = realloc(token_stream->tokens, token_stream->capacity * 2 * sizeof(Token *));
-    if (!temp_token_stream)
+    void *temp_array = arena_realloc(arena, *array, old_capacity * element_size, capacity * element_size);
+    if (!temp_array)
     {
         return 0;
     }
 
-    token_stream->tokens = temp_token_stream;
-    token_stream->capacity *= 2;
-
+    *array = temp_array;
     return 1;
 }
 
-static void free_token(Token *token)
+static int resize_token_stream(TokenStream *token_stream, int new_capacity)
 {
-    if (!token)
+    Arena *arena = token_stream->arena;
+    int old_capacity = token_stream->capacity;
+
+    // A failed resize can leave some arrays grown and others not, so the stream keeps
+    // its old capacity, which every array still satisfies
+    if (!resize_token_array(arena, (void **)&token_stream->types, old_capacity, new_capacity, sizeof(uint8_t)) ||
+        !resize_token_array(arena, (void **)&token_stream->lines, old_capacity, new_capacity, sizeof(int)) ||
+        !resize_token_array(arena, (void **)&token_stream->columns, old_capacity, new_capacity, sizeof(int)) ||
+        !resize_token_array(arena, (void **)&token_stream->offsets, old_capacity, new_capacity, sizeof(int)) ||
+        !resize_token_array(arena, (void **)&token_stream->lengths, old_capacity, new_capacity, sizeof(int)) ||
+        !resize_token_array(arena, (void **)&token_stream->symbols, old_capacity, new_capacity, sizeof(uint32_t)))
     {
-        return;
+        return 0;
     }
 
-    free(token->lexeme);
-    free(token);
+    token_stream->capacity = new_capacity;
+
+    return 1;
 }
 
 const char *token_type_to_string(TokenType type)
@@ -54,6 +64,8 @@ const char *token_type_to_string(TokenType type)
         return "TOKEN_HIGH";
     case TOKEN_LOW:
         return "TOKEN_LOW";
+    case TOKEN_RETURN:
+        return "TOKEN_RETURN";
 
     // Identifiers and literals
     case TOKEN_IDENTIFIER:
@@ -117,30 +129,38 @@ const char *token_type_to_string(TokenType type)
     }
 }
 
-TokenStream *create_new_token_stream()
+TokenStream *create_new_token_stream(Arena *arena)
 {
-    TokenStream *token_stream = calloc(1, sizeof(TokenStream));
+    TokenStream *token_stream = arena_calloc(arena, 1, sizeof(TokenStream));
     if (!token_stream)
     {
         return NULL;
     }
 
+    token_stream->arena = arena;
     token_stream->capacity = DEFAULT_TOKEN_STREAM_CAPACITY;
     token_stream->size = 0;
 
-    token_stream->tokens = calloc(token_stream->capacity, sizeof(Token *));
-    if (!token_stream->tokens)
+    token_stream->types = arena_alloc(arena, token_stream->capacity * sizeof(uint8_t));
+    token_stream->lines = arena_alloc(arena, token_stream->capacity * sizeof(int));
+    token_stream->columns = arena_alloc(arena, token_stream->capacity * sizeof(int));
+    token_stream->offsets = arena_alloc(arena, token_stream->capacity * sizeof(int));
+    token_stream->lengths = arena_alloc(arena, token_stream->capacity * sizeof(int));
+    token_stream->symbols = arena_alloc(arena, token_stream->capacity * sizeof(uint32_t));
+    token_stream->symbol_table = create_intern_table(arena);
+    if (!token_stream->types || !token_stream->lines || !token_stream->columns ||
+        !token_stream->offsets || !token_stream->lengths || !token_stream->symbols || !token_stream->symbol_table)
     {
-        free(token_stream);
+        free_token_stream(token_stream);
         return NULL;
     }
 
     return token_stream;
 }
 
-int add_new_token(TokenStream *token_stream, TokenType token_type, char *string, int line, int column)
+int add_new_token(TokenStream *token_stream, TokenType token_type, int offset, int length, int line, int column, uint32_t symbol)
 {
-    if (!token_stream || line < 0 || column < 0 || !string)
+    if (!token_stream || line < 0 || column < 0 || offset < 0 || length < 0)
     {
         return 0;
     }
@@ -151,49 +171,143 @@ int add_new_token(TokenStream *token_stream, TokenType token_type, char *string,
         return 0;
     }
 
-    Token *new_token = calloc(1, sizeof(Token));
-    if (!new_token)
+    if (token_stream->size == token_stream->capacity) {
+        if (!resize_token_stream(token_stream, token_stream->capacity * 2)) {
+            return 0;
+        }
+    }
+
+    int index = token_stream->size;
+    token_stream->types[index] = (uint8_t)token_type;
+    token_stream->offsets[index] = offset;
+    token_stream->lengths[index] = length;
+    token_stream->lines[index] = line;
+    token_stream->columns[index] = column;
+    token_stream->symbols[index] = symbol;
+
+    token_stream->size++;
+
+    return 1;
+}
+
+// Make room for at least capacity tokens up front, so a stream of known size never regrows
+int reserve_token_stream(TokenStream *token_stream, int capacity)
+{
+    if (!token_stream || capacity <= token_stream->capacity)
     {
-        return 0;
+        return 1;
     }
 
-    new_token->line = line;
-    new_token->column = column;
+    return resize_token_stream(token_stream, capacity);
+}
 
-    new_token->lexeme = strdup(string);
-    if (!new_token->lexeme)
+// Move the tail of one parallel array to start at index to
+static void move_token_tail(void *array, size_t element_size, int from, int to, int count)
+{
+    memmove((char *)array + to * element_size, (char *)array + from * element_size, count * element_size);
+}
+
+int replace_token_range(TokenStream *token_stream, int first, int old_end, const Token *tokens, int count,
+                        int offset_delta, const TokenEdit *edit)
+{
+    int tail = token_stream->size - old_end;
+    int new_size = first + count + tail;
+
+    // Leave room to grow so a run of insertions does not resize on every edit
+    if (new_size > token_stream->capacity && !resize_token_stream(token_stream, new_size * 2))
     {
-        free(new_token);
         return 0;
     }
 
-    new_token->type = token_type;
+    int tail_start = first + count;
+    if (tail_start != old_end)
+    {
+        move_token_tail(token_stream->types, sizeof(uint8_t), old_end, tail_start, tail);
+        move_token_tail(token_stream->lines, sizeof(int), old_end, tail_start, tail);
+        move_token_tail(token_stream->columns, sizeof(int), old_end, tail_start, tail);
+        move_token_tail(token_stream->offsets, sizeof(int), old_end, tail_start, tail);
+        move_token_tail(token_stream->lengths, sizeof(int), old_end, tail_start, tail);
+        move_token_tail(token_stream->symbols, sizeof(uint32_t), old_end, tail_start, tail);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        int index = first + i;
+        token_stream->types[index] = (uint8_t)tokens[i].type;
+        token_stream->offsets[index] = tokens[i].offset;
+        token_stream->lengths[index] = tokens[i].length;
+        token_stream->lines[index] = tokens[i].line;
+        token_stream->columns[index] = tokens[i].column;
+        token_stream->symbols[index] = tokens[i].symbol;
+    }
 
-    if (token_stream->size == token_stream->capacity) {
-        if (!resize_token_stream(token_stream)) {
-            free_token(new_token);
-            return 0;
+    // Only the moved tokens on the line the edit ended on change column, and they come first
+    for (int index = tail_start; index < new_size && token_stream->lines[index] == edit->resync_line; index++)
+    {
+        token_stream->columns[index] += edit->column_delta;
+    }
+    if (offset_delta != 0)
+    {
+        for (int index = tail_start; index < new_size; index++)
+        {
+            token_stream->offsets[index] += offset_delta;
+        }
+    }
+    if (edit->line_delta != 0)
+    {
+        for (int index = tail_start; index < new_size; index++)
+        {
+            token_stream->lines[index] += edit->line_delta;
         }
     }
 
-    token_stream->tokens[token_stream->size] = new_token;
-    token_stream->size++;
-
+    token_stream->size = new_size;
     return 1;
 }
 
-void free_token_stream(TokenStream *token_stream) {
-    if (!token_stream) {
-        return;
+// Gather the token at index out of the parallel arrays
+Token get_token(TokenStream *token_stream, int index)
+{
+    Token token = {
+        .type = (TokenType)token_stream->types[index],
+        .offset = token_stream->offsets[index],
+        .length = token_stream->lengths[index],
+        .line = token_stream->lines[index],
+        .column = token_stream->columns[index],
+        .symbol = token_stream->symbols[index],
+    };
+    return token;
+}
+
+// Get the lexeme of a token, the returned text is not NUL-terminated and is length bytes long
+const char *get_token_lexeme(TokenStream *token_stream, int index, int *length)
+{
+    // EOF has no source text behind it
+    if (token_stream->types[index] == TOKEN_EOF)
+    {
+        *length = 3;
+        return "EOF";
     }
 
-    if (token_stream->tokens) {
-        for (int i = 0; i < token_stream->size; i++) {
-            free(token_stream->tokens[i]);
-        }
+    *length = token_stream->lengths[index];
+    return token_stream->source + token_stream->offsets[index];
+}
 
-        free(token_stream->tokens);
+void free_token_stream(TokenStream *token_stream) {
+    if (!token_stream) {
+        return;
     }
 
-    free(token_stream);
-}
\ No newline at end of file
+    // One free per array regardless of the number of tokens, none at all inside an arena
+    Arena *arena = token_stream->arena;
+    arena_free(arena, token_stream->types);
+    arena_free(arena, token_stream->lines);
+    arena_free(arena, token_stream->columns);
+    arena_free(arena, token_stream->offsets);
+    arena_free(arena, token_stream->lengths);
+    arena_free(arena, token_stream->symbols);
+    free_intern_table(token_stream->symbol_table);
+    close_source_file(token_stream->mapped_source);
+    token_stream->mapped_source = NULL;
+    arena_free(arena, token_stream);
+}
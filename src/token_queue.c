@@ -0,0 +1,93 @@
+#include "token_queue.h"
+#include <stdlib.h>
+#include <sched.h>
+
+TokenQueue *create_token_queue(uint32_t capacity)
+{
+    uint32_t batches = 1;
+    while (batches < (capacity ? capacity : DEFAULT_TOKEN_QUEUE_BATCHES))
+    {
+        batches *= 2;
+    }
+
+    TokenQueue *queue = aligned_alloc(CACHE_LINE_SIZE, sizeof(TokenQueue));
+    TokenBatch *batch_array = aligned_alloc(CACHE_LINE_SIZE, batches * sizeof(TokenBatch));
+    if (!queue || !batch_array)
+    {
+        free(queue);
+        free(batch_array);
+        return NULL;
+    }
+
+    queue->batches = batch_array;
+    queue->capacity = batches;
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    atomic_init(&queue->state, TOKEN_QUEUE_OPEN);
+    atomic_init(&queue->cancelled, 0);
+    return queue;
+}
+
+void free_token_queue(TokenQueue *queue)
+{
+    if (!queue)
+    {
+        return;
+    }
+
+    free(queue->batches);
+    free(queue);
+}
+
+TokenBatch *reserve_token_batch(TokenQueue *queue)
+{
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    while (tail - atomic_load_explicit(&queue->head, memory_order_acquire) == queue->capacity)
+    {
+        if (atomic_load_explicit(&queue->cancelled, memory_order_relaxed))
+        {
+            return NULL;
+        }
+        sched_yield();
+    }
+    return &queue->batches[tail & (queue->capacity - 1)];
+}
+
+void publish_token_batch(TokenQueue *queue)
+{
+    // Release orders the batch's tokens before the index that hands them over
+    uint32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+}
+
+void close_token_queue(TokenQueue *queue, TokenQueueState state)
+{
+    atomic_store_explicit(&queue->state, state, memory_order_release);
+}
+
+TokenBatch *next_token_batch(TokenQueue *queue)
+{
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    while (atomic_load_explicit(&queue->tail, memory_order_acquire) == head)
+    {
+        // The state is set after the last publish, so once it is the tail is final
+        if (atomic_load_explicit(&queue->state, memory_order_acquire) != TOKEN_QUEUE_OPEN &&
+            atomic_load_explicit(&queue->tail, memory_order_acquire) == head)
+        {
+            return NULL;
+        }
+        sched_yield();
+    }
+    return &queue->batches[head & (queue->capacity - 1)];
+}
+
+void release_token_batch(TokenQueue *queue)
+{
+    uint32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+}
+
+void cancel_token_queue(TokenQueue *queue)
+{
+    atomic_store_explicit(&queue->cancelled, 1, memory_order_relaxed);
+}
@@ -0,0 +1,297 @@
+#include "vm.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_VM_REGISTER_CAPACITY 4096
+
+// Instruction with its opcode replaced by the address of its handler, so dispatch
+// is a single indirect jump with no bounds check or table lookup
+typedef struct
+{
+    const void *handler;
+    uint8_t a;
+    uint8_t b;
+    uint8_t c;
+    int32_t immediate;
+} ThreadedInstruction;
+
+typedef struct
+{
+    const ThreadedInstruction *return_to;
+    size_t base;         // Caller's register window
+    uint8_t destination; // Caller's register for the result
+} CallFrame;
+
+// Wrapping arithmetic, signed overflow would be undefined in C
+static inline int32_t wrap_add(int32_t x, int32_t y)
+{
+    return (int32_t)((uint32_t)x + (uint32_t)y);
+}
+
+static inline int32_t wrap_sub(int32_t x, int32_t y)
+{
+    return (int32_t)((uint32_t)x - (uint32_t)y);
+}
+
+static inline int32_t wrap_mul(int32_t x, int32_t y)
+{
+    return (int32_t)((uint32_t)x * (uint32_t)y);
+}
+
+int run_bytecode_program(BytecodeProgram *program, PinBank *bank, uint64_t max_cycles, VMResult *result,
+                         ErrorList *error_list)
+{
+    static const void *const handlers[OPCODE_COUNT] = {
+        [OP_LOAD_CONST] = &&op_load_const,
+        [OP_MOVE] = &&op_move,
+        [OP_ADD] = &&op_add,
+        [OP_SUB] = &&op_sub,
+        [OP_MUL] = &&op_mul,
+        [OP_DIV] = &&op_div,
+        [OP_ADD_IMMEDIATE] = &&op_add_immediate,
+        [OP_EQ] = &&op_eq,
+        [OP_NEQ] = &&op_neq,
+        [OP_LT] = &&op_lt,
+        [OP_GT] = &&op_gt,
+        [OP_LTE] = &&op_lte,
+        [OP_GTE] = &&op_gte,
+        [OP_NOT] = &&op_not,
+        [OP_NEG] = &&op_neg,
+        [OP_JUMP] = &&op_jump,
+        [OP_JUMP_IF_FALSE] = &&op_jump_if_false,
+        [OP_JUMP_IF_TRUE] = &&op_jump_if_true,
+        [OP_JUMP_UNLESS_EQ] = &&op_jump_unless_eq,
+        [OP_JUMP_UNLESS_NEQ] = &&op_jump_unless_neq,
+        [OP_JUMP_UNLESS_LT] = &&op_jump_unless_lt,
+        [OP_JUMP_UNLESS_GT] = &&op_jump_unless_gt,
+        [OP_JUMP_UNLESS_LTE] = &&op_jump_unless_lte,
+        [OP_JUMP_UNLESS_GTE] = &&op_jump_unless_gte,
+        [OP_READ_PIN] = &&op_read_pin,
+        [OP_SET_PIN] = &&op_set_pin,
+        [OP_CALL] = &&op_call,
+        [OP_RETURN] = &&op_return,
+    };
+
+    if (program->main_function == BYTECODE_NO_FUNCTION)
+    {
+        add_new_error(error_list, 0, 0, RUNTIME, "Program has no main function");
+        return 0;
+    }
+
+    BytecodeFunction *main_function = &program->functions[program->main_function];
+    if (main_function->parameter_count > 0)
+    {
+        add_new_error(error_list, program->lines[main_function->entry], program->columns[main_function->entry], RUNTIME,
+                      "main must not take parameters");
+        return 0;
+    }
+
+    ThreadedInstruction *code = malloc(program->instruction_count * sizeof(ThreadedInstruction));
+    size_t register_capacity = DEFAULT_VM_REGISTER_CAPACITY;
+    int32_t *register_stack = calloc(register_capacity, sizeof(int32_t));
+    size_t frame_capacity = 64, frame_count = 0;
+    CallFrame *frames = malloc(frame_capacity * sizeof(CallFrame));
+    if (!code || !register_stack || !frames)
+    {
+        free(code);
+        free(register_stack);
+        free(frames);
+        add_new_error(error_list, 0, 0, RUNTIME, "Failed to allocate virtual machine");
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < program->instruction_count; i++)
+    {
+        Instruction *instruction = &program->code[i];
+        code[i] = (ThreadedInstruction){handlers[instruction->opcode], instruction->a, instruction->b, instruction->c,
+                                        instruction->immediate};
+    }
+
+    const ThreadedInstruction *ip = code + main_function->entry;
+    int32_t *registers = register_stack;
+    uint64_t cycles = 0, cycle_limit = max_cycles ? max_cycles : UINT64_MAX;
+    const char *error = NULL;
+    int32_t value;
+
+// Each handler ends by dispatching the next instruction itself, giving the branch
+// predictor one indirect jump per handler to learn rather than one for the whole loop
+#define DISPATCH() do { cycles++; goto *ip->handler; } while (0)
+#define NEXT() do { ip++; DISPATCH(); } while (0)
+#define R(field) registers[ip->field]
+
+// Taken jumps are where loops go round, so that is where the cycle limit is checked
+#define JUMP_TO(target) do { \
+        ip = code + (target); \
+        if (__builtin_expect(cycles >= cycle_limit, 0)) goto cycle_limit_reached; \
+        DISPATCH(); \
+    } while (0)
+
+#define COMPARE_JUMP(condition) do { \
+        if (condition) NEXT(); \
+        JUMP_TO(ip->immediate); \
+    } while (0)
+
+    DISPATCH();
+
+op_load_const:
+    R(a) = ip->immediate;
+    NEXT();
+op_move:
+    R(a) = R(b);
+    NEXT();
+op_add:
+    R(a) = wrap_add(R(b), R(c));
+    NEXT();
+op_sub:
+    R(a) = wrap_sub(R(b), R(c));
+    NEXT();
+op_mul:
+    R(a) = wrap_mul(R(b), R(c));
+    NEXT();
+op_div:
+    if (__builtin_expect(R(c) == 0, 0))
+    {
+        error = "Division by zero";
+        goto failed;
+    }
+    // INT32_MIN / -1 overflows, it wraps like the other operators
+    R(a) = R(c) == -1 ? wrap_sub(0, R(b)) : R(b) / R(c);
+    NEXT();
+op_add_immediate:
+    R(a) = wrap_add(R(b), ip->immediate);
+    NEXT();
+op_eq:
+    R(a) = R(b) == R(c);
+    NEXT();
+op_neq:
+    R(a) = R(b) != R(c);
+    NEXT();
+op_lt:
+    R(a) = R(b) < R(c);
+    NEXT();
+op_gt:
+    R(a) = R(b) > R(c);
+    NEXT();
+op_lte:
+    R(a) = R(b) <= R(c);
+    NEXT();
+op_gte:
+    R(a) = R(b) >= R(c);
+    NEXT();
+op_not:
+    R(a) = R(b) == 0;
+    NEXT();
+op_neg:
+    R(a) = wrap_sub(0, R(b));
+    NEXT();
+op_jump:
+    JUMP_TO(ip->immediate);
+op_jump_if_false:
+    COMPARE_JUMP(R(a) != 0);
+op_jump_if_true:
+    COMPARE_JUMP(R(a) == 0);
+op_jump_unless_eq:
+    COMPARE_JUMP(R(b) == R(c));
+op_jump_unless_neq:
+    COMPARE_JUMP(R(b) != R(c));
+op_jump_unless_lt:
+    COMPARE_JUMP(R(b) < R(c));
+op_jump_unless_gt:
+    COMPARE_JUMP(R(b) > R(c));
+op_jump_unless_lte:
+    COMPARE_JUMP(R(b) <= R(c));
+op_jump_unless_gte:
+    COMPARE_JUMP(R(b) >= R(c));
+op_read_pin:
+    R(a) = read_pin(bank, ip->immediate, cycles);
+    NEXT();
+op_set_pin:
+    write_pin(bank, ip->immediate, ip->a, cycles);
+    NEXT();
+op_call:
+{
+    BytecodeFunction *callee = &program->functions[ip->immediate];
+    size_t base = (size_t)(registers - register_stack) + ip->b;
+
+    if (__builtin_expect(frame_count == frame_capacity, 0))
+    {
+        if (frame_capacity == VM_MAX_CALL_DEPTH)
+        {
+            error = "Call stack overflow";
+            goto failed;
+        }
+        CallFrame *new_frames = realloc(frames, frame_capacity * 2 * sizeof(CallFrame));
+        if (!new_frames)
+        {
+            error = "Out of memory for the call stack";
+            goto failed;
+        }
+        frames = new_frames;
+        frame_capacity *= 2;
+    }
+    if (__builtin_expect(base + callee->register_count > register_capacity, 0))
+    {
+        size_t offset = (size_t)(registers - register_stack);
+        int32_t *new_stack = realloc(register_stack, register_capacity * 2 * sizeof(int32_t));
+        if (!new_stack)
+        {
+            error = "Out of memory for registers";
+            goto failed;
+        }
+        register_stack = new_stack;
+        registers = register_stack + offset;
+        register_capacity *= 2;
+    }
+
+    frames[frame_count++] = (CallFrame){ip + 1, (size_t)(registers - register_stack), ip->a};
+    registers = register_stack + base;
+    JUMP_TO(callee->entry);
+}
+op_return:
+    value = R(a);
+    if (frame_count == 0)
+    {
+        goto finished;
+    }
+    frame_count--;
+    registers = register_stack + frames[frame_count].base;
+    ip = frames[frame_count].return_to;
+    registers[frames[frame_count].destination] = value;
+    DISPATCH();
+
+    // error stays NULL for the cycle limit. It is only checked at taken jumps, so
+    // a run may pass it by a few instructions; the message names the limit itself.
+cycle_limit_reached:
+failed:
+    {
+        uint32_t index = (uint32_t)(ip - code);
+        char message[256];
+        if (error)
+        {
+            snprintf(message, sizeof(message), "%s after %llu cycles", error, (unsigned long long)cycles);
+        }
+        else
+        {
+            snprintf(message, sizeof(message), "Cycle limit of %llu reached", (unsigned long long)cycle_limit);
+        }
+        add_new_error(error_list, program->lines[index], program->columns[index], RUNTIME, message);
+        free(code);
+        free(register_stack);
+        free(frames);
+        return 0;
+    }
+
+finished:
+    result->result = value;
+    result->cycles = cycles;
+    free(code);
+    free(register_stack);
+    free(frames);
+    return 1;
+
+#undef DISPATCH
+#undef NEXT
+#undef R
+#undef JUMP_TO
+#undef COMPARE_JUMP
+}
@@ -0,0 +1,864 @@
+#include "wcet.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Statement and expression nesting analysed before giving up rather than
+// overflowing the call stack
+#define MAX_TIMING_DEPTH 20000
+
+typedef enum
+{
+    FUNCTION_UNVISITED,
+    FUNCTION_ON_STACK,   // Its callees are being visited
+    FUNCTION_DONE
+} FunctionState;
+
+// A '# @bound N' comment
+typedef struct
+{
+    int line;
+    uint64_t bound;
+} BoundAnnotation;
+
+typedef struct
+{
+    AST *ast;
+    TokenStream *token_stream;
+    const uint32_t *costs;
+    TimingReport *report;
+    ErrorList *error_list;
+    BoundAnnotation *annotations;   // In line order
+    uint32_t annotation_count;
+    uint32_t *function_nodes;       // FUNCTION node of each report entry
+    uint32_t *symbol_functions;     // Report entry of each symbol that names a function, UINT32_MAX otherwise
+    uint8_t *states;                // FunctionState of each report entry
+    uint32_t loop_capacity;
+    FunctionTiming *current;        // Function whose cost is being added up
+    int depth;
+    int too_deep;                   // Nesting went past MAX_TIMING_DEPTH somewhere
+    int out_of_memory;
+} TimingAnalysis;
+
+static uint64_t add_cycles(uint64_t a, uint64_t b)
+{
+    return a > UINT64_MAX - b ? UINT64_MAX : a + b;
+}
+
+static uint64_t multiply_cycles(uint64_t cycles, uint64_t count)
+{
+    return count && cycles > UINT64_MAX / count ? UINT64_MAX : cycles * count;
+}
+
+static uint64_t cost(TimingAnalysis *analysis, TargetCost operation)
+{
+    return analysis->costs[operation];
+}
+
+static void report_timing_error(TimingAnalysis *analysis, int token, const char *format)
+{
+    char message[256];
+    int length;
+    const char *lexeme = get_token_lexeme(analysis->token_stream, token, &length);
+    snprintf(message, sizeof(message), format, length > 64 ? 64 : length, lexeme);
+    add_new_error(analysis->error_list, analysis->token_stream->lines[token], analysis->token_stream->columns[token],
+                  CODEGEN, message);
+}
+
+// The first reason a function has no worst case is the one reported
+static void mark_unbounded(TimingAnalysis *analysis, TimingStatus status, uint32_t token)
+{
+    if (analysis->current->status == TIMING_BOUNDED)
+    {
+        analysis->current->status = (uint8_t)status;
+        analysis->current->reason_token = token;
+    }
+}
+
+// Collect the '# @bound N' comments of the source. The DSL has no strings, so
+// every '#' starts a comment.
+static int collect_annotations(TimingAnalysis *analysis)
+{
+    TokenStream *token_stream = analysis->token_stream;
+    int last = token_stream->size - 1;
+    const char *source = token_stream->source;
+    const char *end = source + token_stream->offsets[last] + token_stream->lengths[last];
+    const char *line_start = source;
+    uint32_t capacity = 0;
+    int line = 1;
+
+    for (const char *cursor = source; cursor < end; cursor++)
+    {
+        if (*cursor == '\n')
+        {
+            line++;
+            line_start = cursor + 1;
+            continue;
+        }
+        if (*cursor != '#')
+        {
+            continue;
+        }
+
+        const char *text = cursor + 1;
+        while (text < end && (*text == ' ' || *text == '\t'))
+        {
+            text++;
+        }
+        if (end - text >= 6 && strncmp(text, "@bound", 6) == 0)
+        {
+            text += 6;
+            while (text < end && (*text == ' ' || *text == '\t'))
+            {
+                text++;
+            }
+            uint64_t bound = 0;
+            const char *digits = text;
+            while (text < end && *text >= '0' && *text <= '9' && bound <= UINT32_MAX)
+            {
+                bound = bound * 10 + (uint64_t)(*text++ - '0');
+            }
+            if (text == digits || bound > UINT32_MAX)
+            {
+                add_new_error(analysis->error_list, line, (int)(cursor - line_start) + 1, CODEGEN,
+                              "Malformed loop bound, expected '# @bound N' with N below 2^32");
+                return 0;
+            }
+
+            if (analysis->annotation_count == capacity)
+            {
+                capacity = capacity ? capacity * 2 : 16;
+                BoundAnnotation *grown = realloc(analysis->annotations, capacity * sizeof(BoundAnnotation));
+                if (!grown)
+                {
+                    analysis->out_of_memory = 1;
+                    return 0;
+                }
+                analysis->annotations = grown;
+            }
+            analysis->annotations[analysis->annotation_count++] = (BoundAnnotation){line, bound};
+        }
+
+        while (cursor + 1 < end && cursor[1] != '\n')
+        {
+            cursor++;
+        }
+    }
+    return 1;
+}
+
+// The annotation of the while at token: the last one after the previous token's
+// line, up to and including the while's own line
+static int find_annotation(TimingAnalysis *analysis, uint32_t token, uint64_t *bound)
+{
+    int line = analysis->token_stream->lines[token];
+    int previous_line = token > 0 ? analysis->token_stream->lines[token - 1] : 0;
+    uint32_t low = 0, high = analysis->annotation_count;
+
+    // First annotation past line
+    while (low < high)
+    {
+        uint32_t middle = low + (high - low) / 2;
+        if (analysis->annotations[middle].line <= line)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    if (low == 0 || analysis->annotations[low - 1].line <= previous_line)
+    {
+        return 0;
+    }
+    *bound = analysis->annotations[low - 1].bound;
+    return 1;
+}
+
+// First node of the subtree at index, which is laid out in post-order before it
+static uint32_t first_subtree_node(AST *ast, uint32_t index)
+{
+    while (get_ast_node(ast, index)->num_children > 0)
+    {
+        index = get_ast_child(ast, index, 0);
+    }
+    return index;
+}
+
+// Number of statements in the subtree at index that set or declare symbol
+static uint32_t count_writes(TimingAnalysis *analysis, uint32_t index, uint32_t symbol)
+{
+    uint32_t count = 0;
+    for (uint32_t i = first_subtree_node(analysis->ast, index); i <= index; i++)
+    {
+        ASTNode *node = get_ast_node(analysis->ast, i);
+        if ((node->type == ASSIGNMENT || node->type == IDENTIFIER_DEFINITION || node->type == IDENTIFIER_DECLARATION) &&
+            analysis->token_stream->symbols[node->token] == symbol)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+// Value of a literal, folded constant or negated literal
+static int constant_value(TimingAnalysis *analysis, uint32_t index, int64_t *value)
+{
+    ASTNode *node = get_ast_node(analysis->ast, index);
+    TokenType type = analysis->token_stream->types[node->token];
+
+    if (node->type == CONSTANT)
+    {
+        *value = node->value;
+        return 1;
+    }
+    if (node->type == BOOL_VALUE)
+    {
+        *value = type == TOKEN_TRUE;
+        return 1;
+    }
+    if (node->type == UNARY_EXPRESSION && type == TOKEN_MINUS &&
+        constant_value(analysis, get_ast_child(analysis->ast, index, 0), value))
+    {
+        *value = -*value;
+        return 1;
+    }
+    if (node->type != NUMBER_LITERAL)
+    {
+        return 0;
+    }
+
+    int length;
+    const char *lexeme = get_token_lexeme(analysis->token_stream, node->token, &length);
+    *value = 0;
+    for (int i = 0; i < length; i++)
+    {
+        *value = *value * 10 + (lexeme[i] - '0');
+        if (*value > INT32_MAX)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int is_variable(TimingAnalysis *analysis, uint32_t index, uint32_t symbol)
+{
+    ASTNode *node = get_ast_node(analysis->ast, index);
+    return node->type == IDENTIFIER && analysis->token_stream->symbols[node->token] == symbol;
+}
+
+// Counter, comparison and limit of a condition 'counter OP constant', turned
+// around when the constant comes first
+static int match_loop_condition(TimingAnalysis *analysis, uint32_t index, uint32_t *symbol, TokenType *comparison,
+                                int64_t *limit)
+{
+    AST *ast = analysis->ast;
+    ASTNode *node = get_ast_node(ast, index);
+    TokenType type = analysis->token_stream->types[node->token];
+    if (node->type != BINARY_EXPRESSION ||
+        (type != TOKEN_LT && type != TOKEN_LTE && type != TOKEN_GT && type != TOKEN_GTE && type != TOKEN_NEQ))
+    {
+        return 0;
+    }
+
+    uint32_t left = get_ast_child(ast, index, 0), right = get_ast_child(ast, index, 1);
+    if (get_ast_node(ast, left)->type == IDENTIFIER && constant_value(analysis, right, limit))
+    {
+        *symbol = analysis->token_stream->symbols[get_ast_node(ast, left)->token];
+        *comparison = type;
+        return 1;
+    }
+    if (get_ast_node(ast, right)->type == IDENTIFIER && constant_value(analysis, left, limit))
+    {
+        *symbol = analysis->token_stream->symbols[get_ast_node(ast, right)->token];
+        *comparison = type == TOKEN_LT ? TOKEN_GT : type == TOKEN_GT ? TOKEN_LT : type == TOKEN_LTE ? TOKEN_GTE
+                    : type == TOKEN_GTE ? TOKEN_LTE : type;
+        return 1;
+    }
+    return 0;
+}
+
+// Step of the only write to the counter in the body, which must be a statement
+// of the body itself so every iteration runs it: 'counter = counter + c',
+// 'counter = c + counter' or 'counter = counter - c'
+static int match_loop_step(TimingAnalysis *analysis, uint32_t body, uint32_t symbol, int64_t *step)
+{
+    AST *ast = analysis->ast;
+    if (count_writes(analysis, body, symbol) != 1)
+    {
+        return 0;
+    }
+
+    ASTNode *list = get_ast_node(ast, body);
+    for (uint32_t i = 0; i < list->num_children; i++)
+    {
+        uint32_t statement = get_ast_child(ast, body, i);
+        ASTNode *node = get_ast_node(ast, statement);
+        if (node->type != ASSIGNMENT || analysis->token_stream->symbols[node->token] != symbol)
+        {
+            continue;
+        }
+
+        uint32_t value = get_ast_child(ast, statement, 0);
+        ASTNode *operation = get_ast_node(ast, value);
+        TokenType type = analysis->token_stream->types[operation->token];
+        if (operation->type != BINARY_EXPRESSION || (type != TOKEN_PLUS && type != TOKEN_MINUS))
+        {
+            return 0;
+        }
+        uint32_t left = get_ast_child(ast, value, 0), right = get_ast_child(ast, value, 1);
+        if (is_variable(analysis, left, symbol) && constant_value(analysis, right, step))
+        {
+            *step = type == TOKEN_MINUS ? -*step : *step;
+            return *step != 0;
+        }
+        if (type == TOKEN_PLUS && is_variable(analysis, right, symbol) && constant_value(analysis, left, step))
+        {
+            return *step != 0;
+        }
+        return 0;
+    }
+    return 0;
+}
+
+// Value the counter starts from: the statements before the loop in its list are
+// searched back to the one that sets it, which must set a constant, and none in
+// between may write it
+static int match_loop_start(TimingAnalysis *analysis, uint32_t list, uint32_t position, uint32_t symbol,
+                            int64_t *start)
+{
+    AST *ast = analysis->ast;
+    while (position-- > 0)
+    {
+        uint32_t statement = get_ast_child(ast, list, position);
+        ASTNode *node = get_ast_node(ast, statement);
+        int sets_counter = analysis->token_stream->symbols[node->token] == symbol;
+        if (sets_counter && node->type == IDENTIFIER_DECLARATION)
+        {
+            *start = 0;
+            return 1;
+        }
+        if (sets_counter && (node->type == IDENTIFIER_DEFINITION || node->type == ASSIGNMENT))
+        {
+            return constant_value(analysis, get_ast_child(ast, statement, 0), start);
+        }
+        if (count_writes(analysis, statement, symbol) > 0)
+        {
+            return 0;
+        }
+    }
+    return 0;
+}
+
+// Iterations of the while at list[position], if it counts from a constant to a
+// constant by a constant and the counter cannot wrap around on the way
+static int infer_loop_bound(TimingAnalysis *analysis, uint32_t list, uint32_t position, uint64_t *bound)
+{
+    AST *ast = analysis->ast;
+    uint32_t loop = get_ast_child(ast, list, position);
+    uint32_t condition = get_ast_child(ast, loop, 0), symbol;
+    int64_t limit, step, start;
+    TokenType comparison;
+
+    if (constant_value(analysis, condition, &limit))
+    {
+        *bound = 0;
+        return limit == 0;
+    }
+    if (!match_loop_condition(analysis, condition, &symbol, &comparison, &limit) ||
+        !match_loop_step(analysis, get_ast_child(ast, loop, 1), symbol, &step) ||
+        !match_loop_start(analysis, list, position, symbol, &start))
+    {
+        return 0;
+    }
+
+    // Turn counting down into counting up
+    if (comparison == TOKEN_GT || comparison == TOKEN_GTE)
+    {
+        start = -start;
+        limit = -limit;
+        step = -step;
+        comparison = comparison == TOKEN_GT ? TOKEN_LT : TOKEN_LTE;
+    }
+
+    // The last value the counter steps to must still be an int
+    int64_t distance = limit - start;
+    switch (comparison)
+    {
+    case TOKEN_LT:
+        if (distance <= 0)
+        {
+            *bound = 0;
+            return 1;
+        }
+        *bound = step > 0 ? (uint64_t)((distance + step - 1) / step) : 0;
+        return step > 0 && limit - 1 + step <= INT32_MAX;
+    case TOKEN_LTE:
+        if (distance < 0)
+        {
+            *bound = 0;
+            return 1;
+        }
+        *bound = step > 0 ? (uint64_t)(distance / step + 1) : 0;
+        return step > 0 && limit + step <= INT32_MAX;
+    default:
+        // != only stops if the counter lands on the limit
+        *bound = step != 0 && distance % step == 0 && distance / step >= 0 ? (uint64_t)(distance / step) : 0;
+        return step != 0 && distance % step == 0 && distance / step >= 0;
+    }
+}
+
+static int enter_nesting(TimingAnalysis *analysis, int token)
+{
+    if (++analysis->depth <= MAX_TIMING_DEPTH)
+    {
+        return 1;
+    }
+    if (!analysis->too_deep)
+    {
+        analysis->too_deep = 1;
+        report_timing_error(analysis, token, "Expression nested too deeply to analyse at '%.*s'");
+    }
+    return 0;
+}
+
+static uint64_t expression_cycles(TimingAnalysis *analysis, uint32_t index)
+{
+    AST *ast = analysis->ast;
+    ASTNode *node = get_ast_node(ast, index);
+    TokenType type = analysis->token_stream->types[node->token];
+    uint64_t cycles = 0;
+
+    if (!enter_nesting(analysis, node->token))
+    {
+        analysis->depth--;
+        return 0;
+    }
+
+    switch (node->type)
+    {
+    case NUMBER_LITERAL:
+    case BOOL_VALUE:
+    case CONSTANT:
+        cycles = cost(analysis, TARGET_COST_CONSTANT);
+        break;
+    case UNARY_EXPRESSION:
+        cycles = add_cycles(expression_cycles(analysis, get_ast_child(ast, index, 0)),
+                            cost(analysis, type == TOKEN_NOT ? TARGET_COST_LOGIC : TARGET_COST_ARITHMETIC));
+        break;
+    case BINARY_EXPRESSION:
+        cycles = add_cycles(expression_cycles(analysis, get_ast_child(ast, index, 0)),
+                            expression_cycles(analysis, get_ast_child(ast, index, 1)));
+        switch (type)
+        {
+        case TOKEN_PLUS:
+        case TOKEN_MINUS:
+            cycles = add_cycles(cycles, cost(analysis, TARGET_COST_ARITHMETIC));
+            break;
+        case TOKEN_STAR:
+            cycles = add_cycles(cycles, cost(analysis, TARGET_COST_MULTIPLY));
+            break;
+        case TOKEN_SLASH:
+            cycles = add_cycles(cycles, cost(analysis, TARGET_COST_DIVIDE));
+            break;
+        case TOKEN_AND:
+        case TOKEN_OR:
+            // At worst both sides run, with the branch that could have skipped the right
+            cycles = add_cycles(cycles, cost(analysis, TARGET_COST_BRANCH) + cost(analysis, TARGET_COST_LOGIC));
+            break;
+        default:
+            cycles = add_cycles(cycles, cost(analysis, TARGET_COST_COMPARE));
+            break;
+        }
+        break;
+    case CALL_EXPRESSION:
+    {
+        uint32_t callee = analysis->symbol_functions[analysis->token_stream->symbols[node->token]];
+        FunctionTiming *timing = &analysis->report->functions[callee];
+        for (uint32_t i = 0; i < node->num_children; i++)
+        {
+            cycles = add_cycles(cycles, expression_cycles(analysis, get_ast_child(ast, index, i)));
+            cycles = add_cycles(cycles, cost(analysis, TARGET_COST_MOVE));
+        }
+        cycles = add_cycles(cycles, cost(analysis, TARGET_COST_CALL));
+        if (analysis->states[callee] != FUNCTION_DONE)
+        {
+            mark_unbounded(analysis, TIMING_RECURSIVE, node->token);
+        }
+        else if (timing->status != TIMING_BOUNDED)
+        {
+            mark_unbounded(analysis, TIMING_UNBOUNDED_CALLEE, node->token);
+        }
+        else
+        {
+            cycles = add_cycles(cycles, timing->cycles);
+        }
+        break;
+    }
+    case GPIO_OPERATION:
+        cycles = cost(analysis, TARGET_COST_READ_PIN);
+        break;
+    default:
+        break;
+    }
+
+    analysis->depth--;
+    return cycles;
+}
+
+static int add_loop(TimingAnalysis *analysis, uint32_t token, uint64_t bound, LoopBoundSource source)
+{
+    TimingReport *report = analysis->report;
+    if (report->loop_count == analysis->loop_capacity)
+    {
+        uint32_t capacity = analysis->loop_capacity ? analysis->loop_capacity * 2 : 16;
+        LoopTiming *grown = realloc(report->loops, capacity * sizeof(LoopTiming));
+        if (!grown)
+        {
+            analysis->out_of_memory = 1;
+            return 0;
+        }
+        report->loops = grown;
+        analysis->loop_capacity = capacity;
+    }
+
+    report->loops[report->loop_count++] = (LoopTiming){token, bound, (uint8_t)source};
+    analysis->current->loop_count++;
+    return 1;
+}
+
+static uint64_t statement_list_cycles(TimingAnalysis *analysis, uint32_t index);
+
+// The while at list[position] tests its condition once more than its body runs
+static uint64_t loop_cycles(TimingAnalysis *analysis, uint32_t list, uint32_t position)
+{
+    AST *ast = analysis->ast;
+    uint32_t loop = get_ast_child(ast, list, position);
+    uint32_t token = get_ast_node(ast, loop)->token;
+    uint64_t bound = 0, annotated;
+    LoopBoundSource source = LOOP_UNBOUNDED;
+
+    if (infer_loop_bound(analysis, list, position, &bound))
+    {
+        source = LOOP_INFERRED;
+    }
+    if (find_annotation(analysis, token, &annotated) && (source == LOOP_UNBOUNDED || annotated < bound))
+    {
+        bound = annotated;
+        source = LOOP_ANNOTATED;
+    }
+    if (source == LOOP_UNBOUNDED)
+    {
+        mark_unbounded(analysis, TIMING_UNBOUNDED_LOOP, token);
+    }
+    if (!add_loop(analysis, token, bound, source))
+    {
+        return 0;
+    }
+
+    uint64_t test = add_cycles(expression_cycles(analysis, get_ast_child(ast, loop, 0)),
+                               cost(analysis, TARGET_COST_BRANCH));
+    uint64_t body = add_cycles(statement_list_cycles(analysis, get_ast_child(ast, loop, 1)),
+                               cost(analysis, TARGET_COST_BRANCH));
+    return add_cycles(multiply_cycles(test, bound + 1), multiply_cycles(body, bound));
+}
+
+static uint64_t statement_cycles(TimingAnalysis *analysis, uint32_t list, uint32_t position)
+{
+    AST *ast = analysis->ast;
+    uint32_t index = get_ast_child(ast, list, position);
+    ASTNode *node = get_ast_node(ast, index);
+    uint64_t cycles = 0, then_cycles, else_cycles;
+
+    if (!enter_nesting(analysis, node->token))
+    {
+        analysis->depth--;
+        return 0;
+    }
+
+    switch (node->type)
+    {
+    case IDENTIFIER_DECLARATION:
+        cycles = add_cycles(cost(analysis, TARGET_COST_CONSTANT), cost(analysis, TARGET_COST_MOVE));
+        break;
+    case IDENTIFIER_DEFINITION:
+    case ASSIGNMENT:
+        cycles = add_cycles(expression_cycles(analysis, get_ast_child(ast, index, 0)), cost(analysis, TARGET_COST_MOVE));
+        break;
+    case CONDITIONAL:
+        // The then arm jumps over the else arm
+        cycles = add_cycles(expression_cycles(analysis, get_ast_child(ast, index, 0)), cost(analysis, TARGET_COST_BRANCH));
+        then_cycles = statement_list_cycles(analysis, get_ast_child(ast, index, 1));
+        else_cycles = 0;
+        if (node->num_children == 3)
+        {
+            then_cycles = add_cycles(then_cycles, cost(analysis, TARGET_COST_BRANCH));
+            else_cycles = statement_list_cycles(analysis, get_ast_child(ast, index, 2));
+        }
+        cycles = add_cycles(cycles, then_cycles > else_cycles ? then_cycles : else_cycles);
+        break;
+    case WHILE_LOOP:
+        cycles = loop_cycles(analysis, list, position);
+        break;
+    case RETURN_STATEMENT:
+        cycles = add_cycles(expression_cycles(analysis, get_ast_child(ast, index, 0)), cost(analysis, TARGET_COST_RETURN));
+        break;
+    case GPIO_OPERATION:
+        cycles = cost(analysis, node->num_children < 2 ? TARGET_COST_READ_PIN : TARGET_COST_SET_PIN);
+        break;
+    default:
+        cycles = expression_cycles(analysis, get_ast_child(ast, index, 0));
+        break;
+    }
+
+    analysis->depth--;
+    return cycles;
+}
+
+static uint64_t statement_list_cycles(TimingAnalysis *analysis, uint32_t index)
+{
+    ASTNode *node = get_ast_node(analysis->ast, index);
+    uint64_t cycles = 0;
+    for (uint32_t i = 0; i < node->num_children && !analysis->out_of_memory; i++)
+    {
+        cycles = add_cycles(cycles, statement_cycles(analysis, index, i));
+    }
+    return cycles;
+}
+
+// Every function ends in a return whether or not the source spells it out
+static void time_function(TimingAnalysis *analysis, uint32_t function)
+{
+    FunctionTiming *timing = &analysis->report->functions[function];
+    analysis->current = timing;
+    timing->first_loop = analysis->report->loop_count;
+    uint32_t body = get_ast_child(analysis->ast, analysis->function_nodes[function], 1);
+    timing->cycles = add_cycles(statement_list_cycles(analysis, body), cost(analysis, TARGET_COST_RETURN));
+    analysis->states[function] = FUNCTION_DONE;
+}
+
+// Next function called from the node range [*cursor, end), moving the cursor past it
+static uint32_t next_callee(TimingAnalysis *analysis, uint32_t *cursor, uint32_t end)
+{
+    while (*cursor < end)
+    {
+        ASTNode *node = get_ast_node(analysis->ast, (*cursor)++);
+        if (node->type == CALL_EXPRESSION)
+        {
+            return analysis->symbol_functions[analysis->token_stream->symbols[node->token]];
+        }
+    }
+    return UINT32_MAX;
+}
+
+// Time callees before their callers, depth first with an explicit stack. A call
+// back to a function still on the stack is recursion.
+static void time_functions(TimingAnalysis *analysis)
+{
+    uint32_t count = analysis->report->function_count;
+    uint32_t *stack = malloc((count + 1) * sizeof(uint32_t));
+    uint32_t *cursors = malloc((count + 1) * sizeof(uint32_t));
+    if (!stack || !cursors)
+    {
+        free(stack);
+        free(cursors);
+        analysis->out_of_memory = 1;
+        return;
+    }
+
+    for (uint32_t root = 0; root < count && !analysis->out_of_memory; root++)
+    {
+        if (analysis->states[root] != FUNCTION_UNVISITED)
+        {
+            continue;
+        }
+
+        uint32_t depth = 0;
+        stack[depth++] = root;
+        cursors[root] = first_subtree_node(analysis->ast, analysis->function_nodes[root]);
+        analysis->states[root] = FUNCTION_ON_STACK;
+        while (depth > 0 && !analysis->out_of_memory)
+        {
+            uint32_t function = stack[depth - 1];
+            uint32_t callee = next_callee(analysis, &cursors[function], analysis->function_nodes[function]);
+            if (callee == UINT32_MAX)
+            {
+                time_function(analysis, function);
+                depth--;
+            }
+            else if (analysis->states[callee] == FUNCTION_UNVISITED)
+            {
+                cursors[callee] = first_subtree_node(analysis->ast, analysis->function_nodes[callee]);
+                analysis->states[callee] = FUNCTION_ON_STACK;
+                stack[depth++] = callee;
+            }
+        }
+    }
+
+    free(stack);
+    free(cursors);
+}
+
+// Map each function name to its report entry and check every call names one
+static int find_functions(TimingAnalysis *analysis)
+{
+    AST *ast = analysis->ast;
+    ASTNode *root = get_ast_node(ast, ast->root);
+    TimingReport *report = analysis->report;
+    int valid = 1;
+
+    for (uint32_t i = 0; i < root->num_children; i++)
+    {
+        uint32_t function = get_ast_child(ast, ast->root, i);
+        uint32_t token = get_ast_node(ast, function)->token;
+        uint32_t symbol = analysis->token_stream->symbols[token];
+        if (analysis->symbol_functions[symbol] != UINT32_MAX)
+        {
+            report_timing_error(analysis, token, "Function '%.*s' is defined more than once");
+            valid = 0;
+            continue;
+        }
+
+        analysis->symbol_functions[symbol] = report->function_count;
+        analysis->function_nodes[report->function_count] = function;
+        report->functions[report->function_count++] = (FunctionTiming){.symbol = symbol, .status = TIMING_BOUNDED};
+    }
+
+    for (uint32_t i = 0; i < ast->node_count; i++)
+    {
+        ASTNode *node = get_ast_node(ast, i);
+        if (node->type == CALL_EXPRESSION && analysis->symbol_functions[analysis->token_stream->symbols[node->token]] ==
+                                                 UINT32_MAX)
+        {
+            report_timing_error(analysis, node->token, "Call to undefined function '%.*s'");
+            valid = 0;
+        }
+    }
+    return valid;
+}
+
+TimingReport *estimate_timing(AST *ast, const TargetConfig *target, ErrorList *error_list)
+{
+    if (!ast || ast->root == AST_NO_NODE || !target)
+    {
+        add_new_error(error_list, 0, 0, CODEGEN, "Invalid AST passed");
+        return NULL;
+    }
+
+    TokenStream *token_stream = ast->token_stream;
+    uint32_t function_count = get_ast_node(ast, ast->root)->num_children;
+    uint32_t symbol_count = token_stream->symbol_table->symbol_count;
+    TimingReport *report = calloc(1, sizeof(TimingReport));
+    TimingAnalysis analysis = {
+        .ast = ast,
+        .token_stream = token_stream,
+        .costs = target->cycle_costs,
+        .report = report,
+        .error_list = error_list,
+        .function_nodes = malloc((function_count + 1) * sizeof(uint32_t)),
+        .symbol_functions = malloc((symbol_count + 1) * sizeof(uint32_t)),
+        .states = calloc(function_count + 1, 1),
+    };
+    if (report)
+    {
+        report->functions = calloc(function_count + 1, sizeof(FunctionTiming));
+        report->token_stream = token_stream;
+    }
+
+    int valid = report && report->functions && analysis.function_nodes && analysis.symbol_functions && analysis.states;
+    if (valid)
+    {
+        memset(analysis.symbol_functions, 0xFF, (symbol_count + 1) * sizeof(uint32_t));
+        valid = find_functions(&analysis);
+        valid = collect_annotations(&analysis) && valid;
+    }
+    if (valid)
+    {
+        time_functions(&analysis);
+    }
+    if (!report || analysis.out_of_memory || !report->functions || !analysis.function_nodes ||
+        !analysis.symbol_functions || !analysis.states)
+    {
+        add_new_error(error_list, 0, 0, CODEGEN, "Out of memory while estimating execution time");
+        valid = 0;
+    }
+    if (analysis.too_deep)
+    {
+        valid = 0;
+    }
+
+    free(analysis.annotations);
+    free(analysis.function_nodes);
+    free(analysis.symbol_functions);
+    free(analysis.states);
+    if (!valid || analysis.out_of_memory)
+    {
+        free_timing_report(report);
+        return NULL;
+    }
+    return report;
+}
+
+void free_timing_report(TimingReport *report)
+{
+    if (!report)
+    {
+        return;
+    }
+
+    free(report->functions);
+    free(report->loops);
+    free(report);
+}
+
+void print_timing_report(TimingReport *report, FILE *file)
+{
+    static const char *const sources[] = {"no bound", "inferred", "annotated"};
+    TokenStream *token_stream = report->token_stream;
+
+    for (uint32_t f = 0; f < report->function_count; f++)
+    {
+        FunctionTiming *timing = &report->functions[f];
+        int length, callee_length;
+        const char *name = get_symbol_name(token_stream->symbol_table, timing->symbol, &length);
+        const char *callee = NULL;
+        if (timing->status == TIMING_RECURSIVE || timing->status == TIMING_UNBOUNDED_CALLEE)
+        {
+            callee = get_token_lexeme(token_stream, timing->reason_token, &callee_length);
+        }
+
+        switch (timing->status)
+        {
+        case TIMING_BOUNDED:
+            fprintf(file, "%.*s: %llu cycles\n", length, name, (unsigned long long)timing->cycles);
+            break;
+        case TIMING_UNBOUNDED_LOOP:
+            fprintf(file, "%.*s: unbounded, while at line %d has no bound\n", length, name,
+                    token_stream->lines[timing->reason_token]);
+            break;
+        case TIMING_RECURSIVE:
+            fprintf(file, "%.*s: unbounded, recursive call to '%.*s' at line %d\n", length, name, callee_length,
+                    callee, token_stream->lines[timing->reason_token]);
+            break;
+        default:
+            fprintf(file, "%.*s: unbounded, calls unbounded '%.*s' at line %d\n", length, name, callee_length,
+                    callee, token_stream->lines[timing->reason_token]);
+            break;
+        }
+
+        for (uint32_t l = timing->first_loop; l < timing->first_loop + timing->loop_count; l++)
+        {
+            LoopTiming *loop = &report->loops[l];
+            if (loop->source == LOOP_UNBOUNDED)
+            {
+                fprintf(file, "  while at line %d: no bound\n", token_stream->lines[loop->token]);
+            }
+            else
+            {
+                fprintf(file, "  while at line %d: at most %llu iterations (%s)\n", token_stream->lines[loop->token],
+                        (unsigned long long)loop->bound, sources[loop->source]);
+            }
+        }
+    }
+}
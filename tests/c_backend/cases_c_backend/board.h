@@ -0,0 +1,4 @@
+// Registers of the target in test_c_backend_2.target
+#include <stdint.h>
+
+extern volatile uint8_t PORTB, PINB, PORTD_SET, PORTD_CLR, PIND;
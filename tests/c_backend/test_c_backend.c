@@ -0,0 +1,80 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "lexer.h"
+#include "parser.h"
+#include "c_backend.h"
+#include "semantic.h"
+#include "target.h"
+#include "token.h"
+#include "errors.h"
+
+// Read all of stdin into a NUL-terminated buffer
+static char *read_all_input()
+{
+    size_t capacity = 1024, size = 0;
+    char *input = malloc(capacity);
+
+    while (input)
+    {
+        size += fread(input + size, 1, capacity - size - 1, stdin);
+        if (size < capacity - 1)
+        {
+            break;
+        }
+        capacity *= 2;
+        char *temp_input = realloc(input, capacity);
+        if (!temp_input)
+        {
+            free(input);
+            return NULL;
+        }
+        input = temp_input;
+    }
+
+    if (input)
+    {
+        input[size] = '\0';
+    }
+    return input;
+}
+
+// Lex, parse and check stdin, then print it as C for the target described by the file
+// named on the command line, or the default one, followed by any errors
+int main(int argc, char **argv)
+{
+    ErrorList *error_list = create_new_error_list(NULL);
+    TargetConfig *target = argc > 1 ? create_target_config() : create_default_target_config();
+    FILE *target_file = argc > 1 ? fopen(argv[1], "r") : NULL;
+
+    if (argc > 1 && (!target_file || !load_target_config(target, target_file, argv[1], error_list)))
+    {
+        printf("Cannot use target '%s'\n", argv[1]);
+    }
+    else
+    {
+        char *input = read_all_input();
+        TokenStream *token_stream = input ? get_token_stream_from_input_file(input, error_list) : NULL;
+        AST *ast = token_stream ? parse_token_stream(token_stream, error_list) : NULL;
+        CBackendReport report;
+
+        if (ast && error_list->size == 0 && check_semantics(ast, error_list))
+        {
+            generate_c_program(ast, target, stdout, &report, error_list);
+        }
+
+        free_ast(ast);
+        free_token_stream(token_stream);
+        free(input);
+    }
+
+    report_errors(error_list);
+
+    if (target_file)
+    {
+        fclose(target_file);
+    }
+    free_target_config(target);
+    free_error_list(error_list);
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lexer.h"
+#include "parser.h"
+#include "ir.h"
+#include "regalloc.h"
+#include "semantic.h"
+#include "token.h"
+#include "errors.h"
+
+// Read all of stdin into a NUL-terminated buffer
+static char *read_all_input()
+{
+    size_t capacity = 1024, size = 0;
+    char *input = malloc(capacity);
+
+    while (input)
+    {
+        size += fread(input + size, 1, capacity - size - 1, stdin);
+        if (size < capacity - 1)
+        {
+            break;
+        }
+        capacity *= 2;
+        char *temp_input = realloc(input, capacity);
+        if (!temp_input)
+        {
+            free(input);
+            return NULL;
+        }
+        input = temp_input;
+    }
+
+    if (input)
+    {
+        input[size] = '\0';
+    }
+    return input;
+}
+
+// Make the first instruction with an operand use its own value, which the
+// verifier must reject
+static void corrupt_ir_program(IRProgram *program)
+{
+    for (uint32_t i = 0; i < program->instruction_count; i++)
+    {
+        IRInstruction *instruction = &program->instructions[i];
+        if (instruction->opcode != IR_PHI && instruction->operand_count > 0)
+        {
+            program->operands[instruction->first_operand] = i;
+            return;
+        }
+    }
+}
+
+// Lex, parse, check and lower stdin, then print the IR with the registers of the count
+// given on the command line (12 by default), followed by any errors. With
+// "corrupt" after the count the IR is broken before it is verified.
+int main(int argc, char **argv)
+{
+    ErrorList *error_list = create_new_error_list(NULL);
+    uint32_t register_count = argc > 1 ? (uint32_t)atoi(argv[1]) : 12;
+    int corrupt = argc > 2 && strcmp(argv[2], "corrupt") == 0;
+    char *input = read_all_input();
+    TokenStream *token_stream = input ? get_token_stream_from_input_file(input, error_list) : NULL;
+    AST *ast = token_stream ? parse_token_stream(token_stream, error_list) : NULL;
+    IRProgram *program = ast && error_list->size == 0 && check_semantics(ast, error_list) ?
+                         lower_to_ir(ast, error_list) : NULL;
+
+    if (program && corrupt)
+    {
+        corrupt_ir_program(program);
+    }
+    if (program && verify_ir_program(program, error_list))
+    {
+        RegisterAllocation *allocation = allocate_registers(program, register_count);
+        if (allocation && verify_register_allocation(program, allocation, error_list))
+        {
+            print_ir_program(program, allocation, stdout);
+        }
+        free_register_allocation(allocation);
+    }
+
+    report_errors(error_list);
+
+    free_ir_program(program);
+    free_ast(ast);
+    free_token_stream(token_stream);
+    free(input);
+    free_error_list(error_list);
+
+    return 0;
+}
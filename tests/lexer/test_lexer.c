@@ -1,40 +1,115 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include "lexer.h"
 #include "token.h"
 #include "errors.h"
 
+// Small enough that most test programs straddle several chunk boundaries
+#define TEST_CHUNK_SIZE 16
+
+// Function to print a single token in the specified format
+static void print_token(TokenType type, const char *lexeme, int lexeme_length, int line, int column)
+{
+    printf("%s \"%.*s\" [line: %d, column: %d]\n",
+            token_type_to_string(type), lexeme_length, lexeme, line, column);
+}
+
 // Function to print a token stream in the specified format
 static void print_token_stream(TokenStream *token_stream)
 {
     for (int i = 0; i < token_stream->size; i++)
     {
-        Token *token = token_stream->tokens[i];
-        printf("%s \"%s\" [line: %d, column: %d]\n",
-                token_type_to_string(token->type), token->lexeme, token->line, token->column);
+        int lexeme_length;
+        const char *lexeme = get_token_lexeme(token_stream, i, &lexeme_length);
+        print_token(token_stream->types[i], lexeme, lexeme_length, token_stream->lines[i], token_stream->columns[i]);
+    }
+}
+
+// Check that every identifier's symbol names exactly its lexeme, printing any that does not
+static void check_symbols(TokenStream *token_stream)
+{
+    for (int i = 0; i < token_stream->size; i++)
+    {
+        int lexeme_length, name_length = -1;
+        const char *lexeme = get_token_lexeme(token_stream, i, &lexeme_length);
+        uint32_t symbol = token_stream->symbols[i];
+        const char *name = symbol == NO_SYMBOL ? NULL : get_symbol_name(token_stream->symbol_table, symbol, &name_length);
+
+        int is_identifier = token_stream->types[i] == TOKEN_IDENTIFIER;
+        if (is_identifier != (symbol != NO_SYMBOL) ||
+            (name && (name_length != lexeme_length || memcmp(name, lexeme, lexeme_length) != 0)))
+        {
+            printf("Symbol mismatch for token %d\n", i);
+        }
     }
 }
 
-int main()
+// Read all of stdin into a NUL-terminated buffer
+static char *read_all_input()
 {
-    // Buffer to read the input
-    char input[1024];
+    size_t capacity = 1024, size = 0;
+    char *input = malloc(capacity);
 
+    while (input)
+    {
+        size += fread(input + size, 1, capacity - size - 1, stdin);
+        if (size < capacity - 1)
+        {
+            break;
+        }
+        capacity *= 2;
+        char *temp_input = realloc(input, capacity);
+        if (!temp_input)
+        {
+            free(input);
+            return NULL;
+        }
+        input = temp_input;
+    }
+
+    if (input)
+    {
+        input[size] = '\0';
+    }
+    return input;
+}
+
+// Lex stdin with the streaming API, printing each token as it is produced.
+// With --whole, stdin is read completely and lexed into a TokenStream instead.
+int main(int argc, char **argv)
+{
     // Create error list
-    ErrorList *error_list = create_new_error_list();
+    ErrorList *error_list = create_new_error_list(NULL);
 
-    // Read the input from stdin
-    size_t input_size = fread(input, 1, sizeof(input) - 1, stdin);
-    input[input_size] = '\0'; // Null-terminate the input string
+    if (argc > 1 && strcmp(argv[1], "--whole") == 0)
+    {
+        char *input = read_all_input();
 
-    // Get the token stream
-    TokenStream *token_stream = get_token_stream_from_input_file(input, error_list);
+        // Get the token stream
+        TokenStream *token_stream = input ? get_token_stream_from_input_file(input, error_list) : NULL;
 
-    // If the token stream exists, print it
-    if (token_stream)
+        // If the token stream exists, print it
+        if (token_stream)
+        {
+            print_token_stream(token_stream);
+            check_symbols(token_stream);
+            free_token_stream(token_stream);
+        }
+        free(input);
+    }
+    else
     {
-        print_token_stream(token_stream);
-        free_token_stream(token_stream);
+        Lexer *lexer = create_lexer_from_file(stdin, TEST_CHUNK_SIZE, error_list);
+        Token token;
+
+        while (lexer && lexer_next_token(lexer, &token))
+        {
+            int lexeme_length;
+            const char *lexeme = lexer_get_lexeme(lexer, &token, &lexeme_length);
+            print_token(token.type, lexeme, lexeme_length, token.line, token.column);
+        }
+        free_lexer(lexer);
     }
 
     // Print any errors encountered
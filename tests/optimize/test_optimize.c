@@ -0,0 +1,85 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "lexer.h"
+#include "parser.h"
+#include "optimize.h"
+#include "semantic.h"
+#include "token.h"
+#include "errors.h"
+
+// Print a node and its subtree, one node per line indented by depth, as the parser
+// test does. A CONSTANT shows its value after its token.
+static void print_ast_node(AST *ast, uint32_t index, int depth)
+{
+    ASTNode *node = get_ast_node(ast, index);
+    TokenStream *token_stream = ast->token_stream;
+    int lexeme_length;
+    const char *lexeme = get_token_lexeme(token_stream, node->token, &lexeme_length);
+
+    printf("%*s%s \"%.*s\"", depth * 2, "", ast_node_type_to_string(node->type), lexeme_length, lexeme);
+    if (node->type == CONSTANT)
+    {
+        printf(" = %d", node->value);
+    }
+    printf(" [line: %d, column: %d]\n", token_stream->lines[node->token], token_stream->columns[node->token]);
+
+    for (uint32_t i = 0; node->type != CONSTANT && i < node->num_children; i++)
+    {
+        print_ast_node(ast, get_ast_child(ast, index, i), depth + 1);
+    }
+}
+
+// Read all of stdin into a NUL-terminated buffer
+static char *read_all_input()
+{
+    size_t capacity = 1024, size = 0;
+    char *input = malloc(capacity);
+
+    while (input)
+    {
+        size += fread(input + size, 1, capacity - size - 1, stdin);
+        if (size < capacity - 1)
+        {
+            break;
+        }
+        capacity *= 2;
+        char *temp_input = realloc(input, capacity);
+        if (!temp_input)
+        {
+            free(input);
+            return NULL;
+        }
+        input = temp_input;
+    }
+
+    if (input)
+    {
+        input[size] = '\0';
+    }
+    return input;
+}
+
+// Lex, parse, check and optimize stdin, then print the optimizer's report, the AST and any errors
+int main()
+{
+    ErrorList *error_list = create_new_error_list(NULL);
+    char *input = read_all_input();
+    TokenStream *token_stream = input ? get_token_stream_from_input_file(input, error_list) : NULL;
+    AST *ast = token_stream ? parse_token_stream(token_stream, error_list) : NULL;
+    OptimizationReport report;
+
+    if (ast && check_semantics(ast, error_list) && optimize_ast(ast, &report, error_list))
+    {
+        print_optimization_report(&report, stdout);
+        print_ast_node(ast, ast->root, 0);
+    }
+
+    report_errors(error_list);
+
+    free_ast(ast);
+    free_token_stream(token_stream);
+    free(input);
+    free_error_list(error_list);
+
+    return 0;
+}
@@ -0,0 +1,224 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "incremental.h"
+#include "lexer.h"
+#include "parser.h"
+#include "token.h"
+#include "errors.h"
+
+// Edits made to the input, each checked against lexing and parsing it from scratch
+#define DEFAULT_EDIT_COUNT 300
+
+// Text edits insert, chosen to open and close blocks, break tokens and add lines
+static const char *const snippets[] = {
+    "", " ", "\n", "x", "1", "int", "bool", "{", "}", "(", ")", ";", ",", "=", "@", "&&",
+    "# note\n", "if (a) {", "} else {", "}\n", "return 1;\n", "int f() {\n", "bool b = true;\n",
+    "SET_PIN(3, HIGH);\n", "while (i < 10) { i = i + 1; }\n", "x = READ_PIN(2);", "\n\n}\nint g(int a) {\n",
+};
+
+// Deterministic across platforms, unlike rand()
+static unsigned int next_random(unsigned int *state)
+{
+    *state = *state * 1103515245u + 12345u;
+    return (*state >> 16) & 0x7fff;
+}
+
+static int same_errors(ErrorList *a, ErrorList *b)
+{
+    if (a->size != b->size)
+    {
+        return 0;
+    }
+    for (int i = 0; i < a->size; i++)
+    {
+        Error *x = &a->errors[i], *y = &b->errors[i];
+        char x_buffer[MAX_ERROR_MESSAGE_LENGTH], y_buffer[MAX_ERROR_MESSAGE_LENGTH];
+        if (x->line != y->line || x->column != y->column || x->stage != y->stage ||
+            strcmp(format_error_message(a, x, x_buffer), format_error_message(b, y, y_buffer)) != 0)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Node for node, field by field as ASTNode has padding
+static int same_nodes(AST *a, AST *b)
+{
+    for (uint32_t i = 0; i < a->node_count; i++)
+    {
+        ASTNode *x = &a->nodes[i], *y = &b->nodes[i];
+        if (x->type != y->type || x->token != y->token || x->first_child != y->first_child || x->num_children != y->num_children)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Compare the document with a fresh lex and parse of its source, naming the first difference
+static const char *compare_with_full_compile(IncrementalDocument *document)
+{
+    ErrorList *lexer_errors = create_new_error_list(NULL);
+    ErrorList *parser_errors = create_new_error_list(NULL);
+    TokenStream *expected = create_new_token_stream(NULL);
+    AST *ast = NULL;
+    const char *difference = NULL;
+
+    if (lex_into_token_stream(expected, document->source, document->length, lexer_errors))
+    {
+        ast = parse_token_stream(expected, parser_errors);
+    }
+    else
+    {
+        expected->size = 0;
+    }
+
+    TokenStream *actual = document->token_stream;
+    if (actual->size != expected->size)
+    {
+        difference = "token count";
+    }
+    for (int i = 0; !difference && i < actual->size; i++)
+    {
+        int actual_length, expected_length;
+        const char *actual_name = NULL, *expected_name = NULL;
+        if (actual->symbols[i] != NO_SYMBOL)
+        {
+            actual_name = get_symbol_name(actual->symbol_table, actual->symbols[i], &actual_length);
+        }
+        if (expected->symbols[i] != NO_SYMBOL)
+        {
+            expected_name = get_symbol_name(expected->symbol_table, expected->symbols[i], &expected_length);
+        }
+
+        if (actual->types[i] != expected->types[i] || actual->offsets[i] != expected->offsets[i] ||
+            actual->lengths[i] != expected->lengths[i] || actual->lines[i] != expected->lines[i] ||
+            actual->columns[i] != expected->columns[i] || !actual_name != !expected_name ||
+            (actual_name && (actual_length != expected_length || memcmp(actual_name, expected_name, actual_length) != 0)))
+        {
+            difference = "tokens";
+        }
+    }
+
+    if (!difference && !same_errors(document->lexer_errors, lexer_errors))
+    {
+        difference = "lexer errors";
+    }
+    if (!difference && !document->ast != !ast)
+    {
+        difference = "AST presence";
+    }
+    if (!difference && ast)
+    {
+        AST *incremental = document->ast;
+        if (incremental->node_count != ast->node_count || incremental->child_count != ast->child_count ||
+            incremental->segment_count != ast->segment_count || incremental->root != ast->root ||
+            !same_nodes(incremental, ast) ||
+            memcmp(incremental->children, ast->children, ast->child_count * sizeof(uint32_t)) != 0 ||
+            memcmp(incremental->segments, ast->segments, ast->segment_count * sizeof(ParseSegment)) != 0)
+        {
+            difference = "AST";
+        }
+        else if (!same_errors(document->parser_errors, parser_errors))
+        {
+            difference = "parser errors";
+        }
+    }
+
+    free_ast(ast);
+    free_token_stream(expected);
+    free_error_list(lexer_errors);
+    free_error_list(parser_errors);
+    return difference;
+}
+
+// Read all of stdin into a NUL-terminated buffer
+static char *read_all_input(size_t *length)
+{
+    size_t capacity = 1024, size = 0;
+    char *input = malloc(capacity);
+
+    while (input)
+    {
+        size += fread(input + size, 1, capacity - size - 1, stdin);
+        if (size < capacity - 1)
+        {
+            break;
+        }
+        capacity *= 2;
+        char *temp_input = realloc(input, capacity);
+        if (!temp_input)
+        {
+            free(input);
+            return NULL;
+        }
+        input = temp_input;
+    }
+
+    if (input)
+    {
+        input[size] = '\0';
+        *length = size;
+    }
+    return input;
+}
+
+// Apply seeded random edits to stdin, updating a document incrementally after each
+// one and checking it against a full lex and parse. Usage: test_incremental [edits] [seed]
+int main(int argc, char **argv)
+{
+    int edit_count = argc > 1 ? atoi(argv[1]) : DEFAULT_EDIT_COUNT;
+    unsigned int seed = argc > 2 ? (unsigned int)atoi(argv[2]) : 1;
+    size_t length = 0;
+    char *source = read_all_input(&length);
+    if (!source)
+    {
+        return 1;
+    }
+
+    IncrementalDocument *document = create_incremental_document(source, length);
+    const char *difference = document ? compare_with_full_compile(document) : "document creation";
+    int mismatches = difference != NULL;
+    size_t snippet_count = sizeof(snippets) / sizeof(snippets[0]);
+
+    for (int i = 0; document && i < edit_count; i++)
+    {
+        const char *inserted = snippets[next_random(&seed) % snippet_count];
+        SourceEdit edit;
+        edit.start = length ? next_random(&seed) % (length + 1) : 0;
+        edit.removed_length = next_random(&seed) % 4 == 0 ? next_random(&seed) % (length - edit.start + 1) % 16 : 0;
+        edit.inserted_length = strlen(inserted);
+
+        // The document keeps pointing at the previous text until the update, so edit a copy
+        size_t new_length = length - edit.removed_length + edit.inserted_length;
+        char *edited = malloc(new_length + 1);
+        memcpy(edited, source, edit.start);
+        memcpy(edited + edit.start, inserted, edit.inserted_length);
+        memcpy(edited + edit.start + edit.inserted_length, source + edit.start + edit.removed_length,
+               length - edit.start - edit.removed_length);
+        edited[new_length] = '\0';
+
+        update_incremental_document(document, edited, new_length, edit);
+        free(source);
+        source = edited;
+        length = new_length;
+
+        difference = compare_with_full_compile(document);
+        if (difference)
+        {
+            if (mismatches == 0)
+            {
+                printf("Edit %d: %s differ\n", i, difference);
+            }
+            mismatches++;
+        }
+    }
+
+    printf("%d edits, %d mismatches\n", edit_count, mismatches);
+
+    free_incremental_document(document);
+    free(source);
+    return 0;
+}
@@ -0,0 +1,141 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "lexer.h"
+#include "parser.h"
+#include "serialize.h"
+#include "intern.h"
+#include "token.h"
+#include "errors.h"
+
+// Print a node of the mapped AST and its subtree, in the same format as the parser test
+static void print_serialized_node(SerializedFile *file, uint32_t index, int depth)
+{
+    const SerializedNode *node = &file->nodes[index];
+    const SerializedToken *token = &file->tokens[node->token];
+    int lexeme_length;
+    const char *lexeme = get_serialized_lexeme(file, node->token, &lexeme_length);
+
+    printf("%*s%s \"%.*s\" [line: %u, column: %u]\n", depth * 2, "",
+            ast_node_type_to_string(node->type), lexeme_length, lexeme, token->line, token->column);
+
+    for (uint32_t i = 0; i < node->num_children; i++)
+    {
+        print_serialized_node(file, file->children[node->first_child + i], depth + 1);
+    }
+}
+
+// Compare the mapped tokens and symbols with the stream they were written from,
+// printing any that differ
+static void check_tokens(SerializedFile *file, TokenStream *token_stream)
+{
+    if (file->header->token_count != (uint32_t)token_stream->size)
+    {
+        printf("Token count mismatch\n");
+        return;
+    }
+
+    for (int i = 0; i < token_stream->size; i++)
+    {
+        const SerializedToken *token = &file->tokens[i];
+        int length, serialized_length;
+        const char *lexeme = get_token_lexeme(token_stream, i, &length);
+        const char *serialized_lexeme = get_serialized_lexeme(file, i, &serialized_length);
+
+        if (token->type != token_stream->types[i] || token->line != (uint32_t)token_stream->lines[i] ||
+            token->column != (uint32_t)token_stream->columns[i] || token->symbol != token_stream->symbols[i] ||
+            length != serialized_length || memcmp(lexeme, serialized_lexeme, length) != 0)
+        {
+            printf("Token mismatch at %d\n", i);
+        }
+    }
+
+    for (uint32_t i = 0; i < file->header->symbol_count; i++)
+    {
+        int length, serialized_length;
+        const char *name = get_symbol_name(token_stream->symbol_table, i, &length);
+        const char *serialized_name = get_serialized_symbol_name(file, i, &serialized_length);
+        if (length != serialized_length || memcmp(name, serialized_name, length) != 0)
+        {
+            printf("Symbol mismatch at %u\n", i);
+        }
+    }
+}
+
+// Read all of stdin into a NUL-terminated buffer
+static char *read_all_input()
+{
+    size_t capacity = 1024, size = 0;
+    char *input = malloc(capacity);
+
+    while (input)
+    {
+        size += fread(input + size, 1, capacity - size - 1, stdin);
+        if (size < capacity - 1)
+        {
+            break;
+        }
+        capacity *= 2;
+        char *temp_input = realloc(input, capacity);
+        if (!temp_input)
+        {
+            free(input);
+            return NULL;
+        }
+        input = temp_input;
+    }
+
+    if (input)
+    {
+        input[size] = '\0';
+    }
+    return input;
+}
+
+// Lex and parse stdin, write the result to path, map it back and print the AST from
+// the mapping along with the front-end errors. The output matches the parser test's.
+// A truncated copy of the file must then be rejected.
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <path>\n", argv[0]);
+        return 1;
+    }
+
+    ErrorList *error_list = create_new_error_list(NULL);
+    ErrorList *file_errors = create_new_error_list(NULL);
+    char *input = read_all_input();
+    TokenStream *token_stream = input ? get_token_stream_from_input_file(input, error_list) : NULL;
+    AST *ast = token_stream ? parse_token_stream(token_stream, error_list) : NULL;
+
+    if (ast && write_serialized_file(argv[1], token_stream, ast, file_errors))
+    {
+        SerializedFile *file = open_serialized_file(argv[1], file_errors);
+        if (file && verify_serialized_file(file, file_errors))
+        {
+            check_tokens(file, token_stream);
+            print_serialized_node(file, file->header->root, 0);
+        }
+        close_serialized_file(file);
+
+        if (truncate(argv[1], sizeof(SerializedHeader) + 1) == 0 && (file = open_serialized_file(argv[1], NULL)))
+        {
+            printf("Truncated file was accepted\n");
+            close_serialized_file(file);
+        }
+        unlink(argv[1]);
+    }
+
+    report_errors(error_list);
+    report_errors(file_errors);
+
+    free_ast(ast);
+    free_token_stream(token_stream);
+    free(input);
+    free_error_list(error_list);
+    free_error_list(file_errors);
+
+    return 0;
+}